@@ -0,0 +1,146 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#include "../src/nn.h"
+#include "../src/pubsub.h"
+
+#include "../src/utils/err.c"
+#include "../src/utils/sleep.c"
+#include "../src/utils/stopwatch.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*  Measures the cost of nn_send() on a PUB socket depending on the number of
+    connected subscribers, inproc ones unless an address is given. Messages
+    are sent in batches small enough to fit into the subscribers' buffers.
+    Only the sending is timed, the subscribers are drained between the
+    batches. With other transports, set NN_FANOUT_THREADS environment
+    variable to compare the cost with different numbers of threads doing
+    the writes. */
+
+#define MAX_SUBSCRIBERS 500
+
+int main (int argc, char *argv [])
+{
+    int subcount;
+    const char *addr;
+    int timeo;
+    size_t sz;
+    int count;
+    int batch;
+    char *buf;
+    void *msg;
+    int pub;
+    int subs [MAX_SUBSCRIBERS];
+    int rc;
+    int i;
+    int j;
+    int sent;
+    int received;
+    struct nn_stopwatch sw;
+    uint64_t total;
+
+    if (argc != 4 && argc != 5) {
+        printf ("usage: pub_fanout <subscriber-count> <msg-size> "
+            "<msg-count> [<bind-to>]\n");
+        return 1;
+    }
+    subcount = atoi (argv [1]);
+    sz = atoi (argv [2]);
+    count = atoi (argv [3]);
+    addr = argc == 5 ? argv [4] : "inproc://pub_fanout";
+    nn_assert (subcount > 0 && subcount <= MAX_SUBSCRIBERS);
+
+    pub = nn_socket (AF_SP, NN_PUB);
+    nn_assert (pub != -1);
+    rc = nn_bind (pub, addr);
+    nn_assert (rc >= 0);
+
+    for (i = 0; i != subcount; ++i) {
+        subs [i] = nn_socket (AF_SP, NN_SUB);
+        nn_assert (subs [i] != -1);
+        rc = nn_setsockopt (subs [i], NN_SUB, NN_SUB_SUBSCRIBE, "", 0);
+        nn_assert (rc == 0);
+
+        /*  Messages sent over the network may still be on the way. */
+        timeo = 1000;
+        rc = nn_setsockopt (subs [i], NN_SOL_SOCKET, NN_RCVTIMEO, &timeo,
+            sizeof (timeo));
+        nn_assert (rc == 0);
+        rc = nn_connect (subs [i], addr);
+        nn_assert (rc >= 0);
+    }
+    nn_sleep (100);
+
+    /*  Default receive buffer is 128kB. Stay well below that. */
+    batch = (int) (65536 / (sz + 1));
+    if (batch < 1)
+        batch = 1;
+
+    buf = malloc (sz);
+    nn_assert (buf);
+    memset (buf, 111, sz);
+
+    total = 0;
+    received = 0;
+    for (sent = 0; sent < count; sent += batch) {
+        if (batch > count - sent)
+            batch = count - sent;
+        nn_stopwatch_init (&sw);
+        for (i = 0; i != batch; ++i) {
+            rc = nn_send (pub, buf, sz, 0);
+            nn_assert (rc == (int) sz);
+        }
+        total += nn_stopwatch_term (&sw);
+
+        for (i = 0; i != subcount; ++i) {
+            for (j = 0; j != batch; ++j) {
+                rc = nn_recv (subs [i], &msg, NN_MSG, 0);
+                if (rc < 0)
+                    break;
+                nn_freemsg (msg);
+                ++received;
+            }
+        }
+    }
+
+    free (buf);
+    for (i = 0; i != subcount; ++i) {
+        rc = nn_close (subs [i]);
+        nn_assert (rc == 0);
+    }
+    rc = nn_close (pub);
+    nn_assert (rc == 0);
+
+    printf ("subscribers: %d\n", subcount);
+    printf ("message size: %d [B]\n", (int) sz);
+    printf ("message count: %d\n", count);
+    printf ("messages delivered: %d\n", received);
+    printf ("mean send time: %.3f [us]\n",
+        (double) total / (double) count);
+    printf ("mean send time per subscriber: %.3f [ns]\n",
+        (double) total * 1000 / (double) count / (double) subcount);
+
+    return 0;
+}
@@ -0,0 +1,190 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#include "../src/protocols/pubsub/trie.c"
+#include "../src/protocols/pubsub/ctrie.c"
+#include "../src/utils/alloc.c"
+#include "../src/utils/err.c"
+#include "../src/utils/stopwatch.c"
+#include "../src/utils/wire.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*  Measures the cost of nn_trie_match depending on the number of
+    subscriptions in the trie. Subscriptions are random topic names with
+    a shared prefix. Half of the matched strings are subscribed topics
+    followed by some payload, the other half doesn't match anything.
+    The same set is then matched using nn_trie_match_batch and finally
+    using the compact trie built from the same subscriptions, as used by
+    NN_SUB_SUBSCRIBE_BULK. Memory used per subscription is reported for
+    both kinds of tries. */
+
+#define TOPIC_PREFIX "market.data."
+#define TOPIC_LEN 20
+#define MSG_LEN 32
+#define MSG_SET 65536
+
+static uint32_t rnd = 1;
+
+static uint32_t next_rnd (void)
+{
+    rnd ^= rnd << 13;
+    rnd ^= rnd >> 17;
+    rnd ^= rnd << 5;
+    return rnd;
+}
+
+static void make_topic (uint8_t *buf)
+{
+    int i;
+    static const char hex [] = "0123456789abcdef";
+
+    memcpy (buf, TOPIC_PREFIX, sizeof (TOPIC_PREFIX) - 1);
+    for (i = sizeof (TOPIC_PREFIX) - 1; i != TOPIC_LEN; ++i)
+        buf [i] = hex [next_rnd () & 0xf];
+}
+
+int main (int argc, char *argv [])
+{
+    int subcount;
+    int count;
+    uint8_t *topics;
+    uint8_t *msgs;
+    struct nn_trie trie;
+    struct nn_ctrie ctrie;
+    uint8_t *bulk;
+    struct nn_stopwatch sw;
+    uint64_t total;
+    int matched;
+    int rc;
+    int i;
+    int j;
+    const uint8_t *batch [NN_TRIE_BATCH];
+    size_t sizes [NN_TRIE_BATCH];
+    int results [NN_TRIE_BATCH];
+
+    if (argc != 3) {
+        printf ("usage: trie_match <subscription-count> <match-count>\n");
+        return 1;
+    }
+    subcount = atoi (argv [1]);
+    count = atoi (argv [2]);
+    nn_assert (subcount > 0 && count > 0);
+
+    /*  Build the trie. */
+    topics = malloc ((size_t) subcount * TOPIC_LEN);
+    alloc_assert (topics);
+    nn_trie_init (&trie);
+    nn_stopwatch_init (&sw);
+    for (i = 0; i != subcount; ++i) {
+        make_topic (topics + (size_t) i * TOPIC_LEN);
+        rc = nn_trie_subscribe (&trie, topics + (size_t) i * TOPIC_LEN,
+            TOPIC_LEN);
+        nn_assert (rc >= 0);
+    }
+    total = nn_stopwatch_term (&sw);
+    printf ("subscriptions: %d\n", subcount);
+    printf ("mean subscribe time: %.3f [ns]\n",
+        (double) total * 1000 / (double) subcount);
+    printf ("memory per subscription: %.1f [B]\n",
+        (double) nn_trie_size (&trie) / (double) subcount);
+
+    /*  Prepare the messages to match. The set is large enough for the
+        matching not to run from the CPU cache only. */
+    msgs = malloc ((size_t) MSG_SET * MSG_LEN);
+    alloc_assert (msgs);
+    for (i = 0; i != MSG_SET; ++i) {
+        if (i % 2)
+            memcpy (msgs + i * MSG_LEN,
+                topics + (size_t) (next_rnd () % subcount) * TOPIC_LEN,
+                TOPIC_LEN);
+        else
+            make_topic (msgs + i * MSG_LEN);
+        memset (msgs + i * MSG_LEN + TOPIC_LEN, '|', MSG_LEN - TOPIC_LEN);
+    }
+
+    /*  Do the measurement. */
+    matched = 0;
+    nn_stopwatch_init (&sw);
+    for (i = 0; i != count; ++i)
+        matched += nn_trie_match (&trie, msgs + (i % MSG_SET) * MSG_LEN,
+            MSG_LEN);
+    total = nn_stopwatch_term (&sw);
+    printf ("match count: %d\n", count);
+    printf ("matched: %d\n", matched);
+    printf ("mean match time: %.3f [ns]\n",
+        (double) total * 1000 / (double) count);
+
+    matched = 0;
+    nn_stopwatch_init (&sw);
+    for (i = 0; i < count; i += NN_TRIE_BATCH) {
+        for (j = 0; j != NN_TRIE_BATCH; ++j) {
+            batch [j] = msgs + ((i + j) % MSG_SET) * MSG_LEN;
+            sizes [j] = MSG_LEN;
+        }
+        nn_trie_match_batch (&trie, count - i < NN_TRIE_BATCH ?
+            count - i : NN_TRIE_BATCH, batch, sizes, results);
+        for (j = 0; j != NN_TRIE_BATCH && i + j != count; ++j)
+            matched += results [j];
+    }
+    total = nn_stopwatch_term (&sw);
+    printf ("batch matched: %d\n", matched);
+    printf ("mean batch match time: %.3f [ns]\n",
+        (double) total * 1000 / (double) count);
+
+    /*  Same with the compact trie. */
+    bulk = malloc ((size_t) subcount * (TOPIC_LEN + 2));
+    alloc_assert (bulk);
+    for (i = 0; i != subcount; ++i) {
+        nn_puts (bulk + (size_t) i * (TOPIC_LEN + 2), TOPIC_LEN);
+        memcpy (bulk + (size_t) i * (TOPIC_LEN + 2) + 2,
+            topics + (size_t) i * TOPIC_LEN, TOPIC_LEN);
+    }
+    nn_ctrie_init (&ctrie);
+    nn_stopwatch_init (&sw);
+    rc = nn_ctrie_build (&ctrie, bulk, (size_t) subcount * (TOPIC_LEN + 2));
+    nn_assert (rc == 0);
+    total = nn_stopwatch_term (&sw);
+    printf ("compact build time: %.3f [ns] per subscription\n",
+        (double) total * 1000 / (double) subcount);
+    printf ("compact memory per subscription: %.1f [B]\n",
+        (double) nn_ctrie_size (&ctrie) / (double) subcount);
+
+    matched = 0;
+    nn_stopwatch_init (&sw);
+    for (i = 0; i != count; ++i)
+        matched += nn_ctrie_match (&ctrie, msgs + (i % MSG_SET) * MSG_LEN,
+            MSG_LEN);
+    total = nn_stopwatch_term (&sw);
+    printf ("compact matched: %d\n", matched);
+    printf ("mean compact match time: %.3f [ns]\n",
+        (double) total * 1000 / (double) count);
+
+    nn_ctrie_term (&ctrie);
+    free (bulk);
+    nn_trie_term (&trie);
+    free (msgs);
+    free (topics);
+
+    return 0;
+}
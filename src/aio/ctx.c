@@ -34,10 +34,13 @@ void nn_ctx_init (struct nn_ctx *self, struct nn_pool *pool,
     nn_queue_init (&self->events);
     nn_queue_init (&self->eventsto);
     self->onleave = onleave;
+    self->fanout = 0;
+    nn_fanout_batch_init (&self->batch);
 }
 
 void nn_ctx_term (struct nn_ctx *self)
 {
+    nn_fanout_batch_term (&self->batch);
     nn_queue_term (&self->eventsto);
     nn_queue_term (&self->events);
     nn_mutex_term (&self->sync);
@@ -100,6 +103,20 @@ struct nn_worker *nn_ctx_choose_worker (struct nn_ctx *self)
     return nn_pool_choose_worker (self->pool);
 }
 
+void nn_ctx_fanout_begin (struct nn_ctx *self)
+{
+    nn_assert (!self->fanout);
+    self->fanout = 1;
+}
+
+void nn_ctx_fanout_end (struct nn_ctx *self)
+{
+    nn_assert (self->fanout);
+    self->fanout = 0;
+    if (self->batch.count)
+        nn_fanout_flush (&self->pool->fanout, &self->batch);
+}
+
 void nn_ctx_raise (struct nn_ctx *self, struct nn_fsm_event *event)
 {
     nn_queue_push (&self->events, &event->item);
@@ -29,6 +29,7 @@
 #include "worker.h"
 #include "pool.h"
 #include "fsm.h"
+#include "fanout.h"
 
 /*  AIO context for objects using AIO subsystem. */
 
@@ -40,6 +41,11 @@ struct nn_ctx {
     struct nn_queue events;
     struct nn_queue eventsto;
     nn_ctx_onleave onleave;
+
+    /*  If set, usocks collect their writes in 'batch' instead of doing
+        them right away. */
+    int fanout;
+    struct nn_fanout_batch batch;
 };
 
 void nn_ctx_init (struct nn_ctx *self, struct nn_pool *pool,
@@ -51,6 +57,11 @@ void nn_ctx_leave (struct nn_ctx *self);
 
 struct nn_worker *nn_ctx_choose_worker (struct nn_ctx *self);
 
+/*  Writes to the network started in between these two calls are done all at
+    once by nn_ctx_fanout_end, in parallel if there are enough of them. */
+void nn_ctx_fanout_begin (struct nn_ctx *self);
+void nn_ctx_fanout_end (struct nn_ctx *self);
+
 void nn_ctx_raise (struct nn_ctx *self, struct nn_fsm_event *event);
 void nn_ctx_raiseto (struct nn_ctx *self, struct nn_fsm_event *event);
 
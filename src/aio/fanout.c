@@ -0,0 +1,248 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#include "fanout.h"
+#include "usock.h"
+
+#include "../utils/err.h"
+#include "../utils/fast.h"
+#include "../utils/alloc.h"
+
+#if !defined NN_HAVE_WINDOWS
+#include <unistd.h>
+#endif
+
+/*  States of a helper thread. */
+#define NN_FANOUT_THREAD_IDLE 0
+#define NN_FANOUT_THREAD_POSTED 1
+#define NN_FANOUT_THREAD_RUNNING 2
+#define NN_FANOUT_THREAD_STOPPED 3
+
+/*  Running, and the sender is waiting for the helper to post 'done'. */
+#define NN_FANOUT_THREAD_AWAITED 4
+
+static void nn_fanout_write (struct nn_fanout *self);
+static void nn_fanout_routine (void *arg);
+
+void nn_fanout_batch_init (struct nn_fanout_batch *self)
+{
+    self->usocks = NULL;
+    self->count = 0;
+    self->capacity = 0;
+}
+
+void nn_fanout_batch_term (struct nn_fanout_batch *self)
+{
+    nn_assert (self->count == 0);
+    nn_free (self->usocks);
+}
+
+void nn_fanout_batch_add (struct nn_fanout_batch *self,
+    struct nn_usock *usock)
+{
+    if (nn_slow (self->count == self->capacity)) {
+        self->capacity = self->capacity ? self->capacity * 2 : 64;
+        self->usocks = nn_realloc (self->usocks,
+            self->capacity * sizeof (struct nn_usock*));
+        alloc_assert (self->usocks);
+    }
+    self->usocks [self->count++] = usock;
+}
+
+void nn_fanout_init (struct nn_fanout *self, int nthreads)
+{
+#if defined NN_HAVE_WINDOWS
+    /*  Sends on Windows are asynchronous anyway. */
+    nthreads = 0;
+#else
+    if (nthreads < 0)
+        nthreads = (int) sysconf (_SC_NPROCESSORS_ONLN) - 1;
+#endif
+    if (nthreads < 0)
+        nthreads = 0;
+    if (nthreads > NN_FANOUT_MAX_THREADS)
+        nthreads = NN_FANOUT_MAX_THREADS;
+
+    self->nthreads = nthreads;
+    self->started = 0;
+    nn_atomic_init (&self->busy, 0);
+    self->usocks = NULL;
+    self->count = 0;
+    nn_atomic_init (&self->next, 0);
+}
+
+void nn_fanout_term (struct nn_fanout *self)
+{
+    int i;
+    int64_t state;
+    struct nn_fanout_thread *thread;
+
+    /*  No batch is being written, so all the helpers are idle. */
+    for (i = 0; i != self->started; ++i) {
+        thread = &self->threads [i];
+        state = nn_atomic64_cas (&thread->state, NN_FANOUT_THREAD_IDLE,
+            NN_FANOUT_THREAD_STOPPED);
+        nn_assert (state == NN_FANOUT_THREAD_IDLE);
+        nn_sem_post (&thread->go);
+        nn_thread_term (&thread->thread);
+        nn_sem_term (&thread->done);
+        nn_sem_term (&thread->go);
+        nn_atomic64_term (&thread->state);
+    }
+    nn_atomic_term (&self->next);
+    nn_atomic_term (&self->busy);
+}
+
+void nn_fanout_flush (struct nn_fanout *self, struct nn_fanout_batch *batch)
+{
+#if defined NN_HAVE_WINDOWS
+    nn_assert (batch->count == 0);
+#else
+    int rc;
+    int i;
+    int nthreads;
+    size_t j;
+    int64_t state;
+    struct nn_fanout_thread *thread;
+
+    /*  Split the writes among the sending thread and as many helpers as
+        it makes sense. */
+    nthreads = (int) (batch->count / NN_FANOUT_MIN_WRITES) - 1;
+    if (nthreads > self->nthreads)
+        nthreads = self->nthreads;
+    if (nthreads > 0 && nn_atomic_inc (&self->busy, 1) != 0) {
+        nn_atomic_dec (&self->busy, 1);
+        nthreads = 0;
+    }
+
+    if (nthreads <= 0) {
+        for (j = 0; j != batch->count; ++j)
+            nn_usock_write (batch->usocks [j]);
+    }
+    else {
+        self->usocks = batch->usocks;
+        self->count = batch->count;
+
+        /*  Nobody else touches the chunk index now, reset it to zero. */
+        nn_atomic_dec (&self->next, nn_atomic_inc (&self->next, 0));
+
+        /*  Wake the helpers up, starting those not running yet. */
+        for (i = 0; i != nthreads; ++i) {
+            thread = &self->threads [i];
+            if (i == self->started) {
+                thread->fanout = self;
+                nn_sem_init (&thread->go);
+                nn_sem_init (&thread->done);
+                nn_atomic64_init (&thread->state, NN_FANOUT_THREAD_IDLE);
+                nn_thread_init (&thread->thread, nn_fanout_routine, thread);
+                ++self->started;
+            }
+            state = nn_atomic64_cas (&thread->state, NN_FANOUT_THREAD_IDLE,
+                NN_FANOUT_THREAD_POSTED);
+            nn_assert (state == NN_FANOUT_THREAD_IDLE);
+            nn_sem_post (&thread->go);
+        }
+
+        nn_fanout_write (self);
+
+        /*  All the chunks are claimed by now. Helpers that haven't woken up
+            yet won't get any, take the batch back from them. Sleep till
+            those still writing their last chunk are done. */
+        for (i = 0; i != nthreads; ++i) {
+            thread = &self->threads [i];
+            state = nn_atomic64_cas (&thread->state,
+                NN_FANOUT_THREAD_POSTED, NN_FANOUT_THREAD_IDLE);
+            if (state != NN_FANOUT_THREAD_RUNNING)
+                continue;
+            state = nn_atomic64_cas (&thread->state,
+                NN_FANOUT_THREAD_RUNNING, NN_FANOUT_THREAD_AWAITED);
+            if (state != NN_FANOUT_THREAD_RUNNING)
+                continue;
+            do {
+                rc = nn_sem_wait (&thread->done);
+            } while (rc == -EINTR);
+            errnum_assert (rc == 0, -rc);
+        }
+        nn_atomic_dec (&self->busy, 1);
+    }
+
+    /*  Report the outcome in the order the messages were sent. */
+    for (j = 0; j != batch->count; ++j)
+        nn_usock_written (batch->usocks [j]);
+#endif
+    batch->count = 0;
+}
+
+static void nn_fanout_write (struct nn_fanout *self)
+{
+    size_t begin;
+    size_t end;
+
+    while (1) {
+        begin = (size_t) nn_atomic_inc (&self->next, 1) * NN_FANOUT_MIN_WRITES;
+        if (begin >= self->count)
+            return;
+        end = begin + NN_FANOUT_MIN_WRITES;
+        if (end > self->count)
+            end = self->count;
+        for (; begin != end; ++begin)
+            nn_usock_write (self->usocks [begin]);
+    }
+}
+
+static void nn_fanout_routine (void *arg)
+{
+    int rc;
+    int64_t state;
+    struct nn_fanout_thread *self;
+
+    self = (struct nn_fanout_thread*) arg;
+
+    while (1) {
+        do {
+            rc = nn_sem_wait (&self->go);
+        } while (rc == -EINTR);
+        errnum_assert (rc == 0, -rc);
+
+        /*  The wake-up may be stale, the sender having taken the batch back
+            already. */
+        state = nn_atomic64_cas (&self->state, NN_FANOUT_THREAD_POSTED,
+            NN_FANOUT_THREAD_RUNNING);
+        if (nn_slow (state == NN_FANOUT_THREAD_STOPPED))
+            return;
+        if (state != NN_FANOUT_THREAD_POSTED)
+            continue;
+
+        nn_fanout_write (self->fanout);
+        state = nn_atomic64_cas (&self->state, NN_FANOUT_THREAD_RUNNING,
+            NN_FANOUT_THREAD_IDLE);
+        if (state == NN_FANOUT_THREAD_RUNNING)
+            continue;
+
+        /*  The sender is waiting for this thread. */
+        nn_assert (state == NN_FANOUT_THREAD_AWAITED);
+        state = nn_atomic64_cas (&self->state, NN_FANOUT_THREAD_AWAITED,
+            NN_FANOUT_THREAD_IDLE);
+        nn_assert (state == NN_FANOUT_THREAD_AWAITED);
+        nn_sem_post (&self->done);
+    }
+}
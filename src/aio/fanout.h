@@ -0,0 +1,105 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#ifndef NN_FANOUT_INCLUDED
+#define NN_FANOUT_INCLUDED
+
+#include "../utils/atomic.h"
+#include "../utils/sem.h"
+#include "../utils/thread.h"
+
+#include <stddef.h>
+
+/*  Helper threads that write a message sent to many connections in parallel.
+    The sending thread keeps holding the socket's context, the helpers only
+    do the system calls for their share of the connections. The writes are
+    handed out in chunks that the sender claims as well, so the sender never
+    sleeps while there's work left; it only waits for the chunks the helpers
+    are already writing. The outcome of the writes is reported afterwards by
+    the sending thread. */
+
+/*  Maximum number of helper threads. */
+#define NN_FANOUT_MAX_THREADS 16
+
+/*  Minimum number of writes worth handing over to a thread, and the size of
+    the chunks the writes are claimed in. Waking a helper up costs about as
+    much as a few dozens of small writes. */
+#define NN_FANOUT_MIN_WRITES 32
+
+struct nn_usock;
+
+/*  Writes collected while a message is being sent. */
+struct nn_fanout_batch {
+    struct nn_usock **usocks;
+    size_t count;
+    size_t capacity;
+};
+
+void nn_fanout_batch_init (struct nn_fanout_batch *self);
+void nn_fanout_batch_term (struct nn_fanout_batch *self);
+void nn_fanout_batch_add (struct nn_fanout_batch *self,
+    struct nn_usock *usock);
+
+struct nn_fanout;
+
+struct nn_fanout_thread {
+    struct nn_fanout *fanout;
+    struct nn_thread thread;
+    struct nn_sem go;
+
+    /*  Posted when the sender waits for the helper to finish its chunk. */
+    struct nn_sem done;
+
+    /*  One of the NN_FANOUT_THREAD_* states. The sender and the helper hand
+        the thread over to each other by swapping it atomically. */
+    struct nn_atomic64 state;
+};
+
+struct nn_fanout {
+
+    /*  Maximum number of helpers and the number of those started so far.
+        The helpers are started when they are needed for the first time. */
+    int nthreads;
+    int started;
+    struct nn_fanout_thread threads [NN_FANOUT_MAX_THREADS];
+
+    /*  Non-zero while the helpers are working on a batch. Other sockets
+        flushing at the same time do all their writes by themselves. Only
+        the socket that set it accesses the fields below and 'started'. */
+    struct nn_atomic busy;
+
+    /*  The batch being written and the index of the next chunk to claim. */
+    struct nn_usock **usocks;
+    size_t count;
+    struct nn_atomic next;
+};
+
+/*  Prepares up to 'nthreads' helper threads. Negative value means one less
+    than the number of CPUs. */
+void nn_fanout_init (struct nn_fanout *self, int nthreads);
+void nn_fanout_term (struct nn_fanout *self);
+
+/*  Does the writes collected in the batch and empties it. Has to be called
+    from within the context the usocks belong to. */
+void nn_fanout_flush (struct nn_fanout *self, struct nn_fanout_batch *batch);
+
+#endif
@@ -25,13 +25,20 @@
 /*  TODO: The dummy implementation of a thread pool. As for now there's only
     one worker thread created. */
 
-int nn_pool_init (struct nn_pool *self)
+int nn_pool_init (struct nn_pool *self, int fanout_threads)
 {
-    return nn_worker_init (&self->worker);
+    int rc;
+
+    rc = nn_worker_init (&self->worker);
+    if (rc < 0)
+        return rc;
+    nn_fanout_init (&self->fanout, fanout_threads);
+    return 0;
 }
 
 void nn_pool_term (struct nn_pool *self)
 {
+    nn_fanout_term (&self->fanout);
     nn_worker_term (&self->worker);
 }
 
@@ -24,14 +24,20 @@
 #define NN_POOL_INCLUDED
 
 #include "worker.h"
+#include "fanout.h"
 
 /*  Worker thread pool. */
 
 struct nn_pool {
     struct nn_worker worker;
+
+    /*  Helper threads for sending a message to many connections. */
+    struct nn_fanout fanout;
 };
 
-int nn_pool_init (struct nn_pool *self);
+/*  'fanout_threads' is the maximum number of helper threads, negative value
+    meaning one less than the number of CPUs. */
+int nn_pool_init (struct nn_pool *self, int fanout_threads);
 void nn_pool_term (struct nn_pool *self);
 struct nn_worker *nn_pool_choose_worker (struct nn_pool *self);
 
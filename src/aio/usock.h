@@ -85,8 +85,17 @@ void nn_usock_activate (struct nn_usock *self);
 void nn_usock_connect (struct nn_usock *self, const struct sockaddr *addr,
     size_t addrlen);
 
+/*  Send the data. When done, NN_USOCK_SENT event is raised. If the context
+    is collecting writes (see nn_ctx_fanout_begin), the data are written once
+    the collecting ends. */
 void nn_usock_send (struct nn_usock *self, const struct nn_iovec *iov,
     int iovcnt);
+
+/*  Used by nn_fanout to do a collected write. The first function can be
+    called from any thread, the second one, which reports the outcome, only
+    from within the context. */
+void nn_usock_write (struct nn_usock *self);
+void nn_usock_written (struct nn_usock *self);
 void nn_usock_recv (struct nn_usock *self, void *buf, size_t len, int *fd);
 
 int nn_usock_geterrno (struct nn_usock *self);
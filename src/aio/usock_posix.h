@@ -70,6 +70,9 @@ struct nn_usock {
 
         /*  List of buffers being sent at the moment. Referenced from 'hdr'. */
         struct iovec iov [NN_USOCK_MAX_IOVCNT];
+
+        /*  Outcome of the write done by nn_usock_write. */
+        int rc;
     } out;
 
     /*  Asynchronous tasks for the worker. */
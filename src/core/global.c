@@ -43,10 +43,12 @@
 #include "../utils/random.h"
 #include "../utils/chunk.h"
 #include "../utils/msg.h"
+#include "../utils/wire.h"
 #include "../utils/attr.h"
 
 #include "../pubsub.h"
 #include "../pipeline.h"
+#include "../reqrep.h"
 
 #include <stddef.h>
 #include <stdlib.h>
@@ -191,6 +193,10 @@ static int nn_global_create_socket (int domain, int protocol);
 static int nn_global_hold_socket (struct nn_sock **sockp, int s);
 static int nn_global_hold_socket_locked (struct nn_sock **sockp, int s);
 static void nn_global_rele_socket(struct nn_sock *);
+static int nn_global_sendmsg (int s, int ctx, const struct nn_msghdr *msghdr,
+    int flags);
+static int nn_global_recvmsg (int s, int ctx, struct nn_msghdr *msghdr,
+    int flags);
 
 int nn_errno (void)
 {
@@ -227,6 +233,7 @@ static void nn_global_init (void)
 
     /*  Initialise the memory allocation subsystem. */
     nn_alloc_init ();
+    nn_chunk_init ();
 
     /*  Seed the pseudo-random number generator. */
     nn_random_seed ();
@@ -245,6 +252,10 @@ static void nn_global_init (void)
     /*  any non-empty string is true */
     self.print_errors = envvar && *envvar;
 
+    /*  Process-wide limit on memory used by messages, in bytes  */
+    envvar = getenv("NN_MEMORY_BUDGET");
+    nn_chunk_set_budget (envvar ? strtoull (envvar, NULL, 10) : 0);
+
     /*  Allocate the stack of unused file descriptors. */
     self.unused = (uint16_t*) (self.socks + NN_MAX_SOCKETS);
     alloc_assert (self.unused);
@@ -258,8 +269,10 @@ static void nn_global_init (void)
         }
     }
 
-    /*  Start the worker threads. */
-    nn_pool_init (&self.pool);
+    /*  Start the worker threads. Threads helping to send a message to many
+        connections have to be asked for explicitly.  */
+    envvar = getenv("NN_FANOUT_THREADS");
+    nn_pool_init (&self.pool, envvar ? atoi (envvar) : 0);
 }
 
 static void nn_global_term (void)
@@ -291,6 +304,7 @@ static void nn_global_term (void)
     self.socks = NULL;
 
     /*  Shut down the memory allocation subsystem. */
+    nn_chunk_term ();
     nn_alloc_term ();
 
     /*  On Windows, uninitialise the socket library. */
@@ -700,6 +714,219 @@ int nn_recv (int s, void *buf, size_t len, int flags)
 }
 
 int nn_sendmsg (int s, const struct nn_msghdr *msghdr, int flags)
+{
+    return nn_global_sendmsg (s, -1, msghdr, flags);
+}
+
+int nn_recvmsg (int s, struct nn_msghdr *msghdr, int flags)
+{
+    return nn_global_recvmsg (s, -1, msghdr, flags);
+}
+
+int nn_ctx_open (int s)
+{
+    int rc;
+    struct nn_sock *sock;
+
+    rc = nn_global_hold_socket (&sock, s);
+    if (nn_slow (rc < 0)) {
+        errno = -rc;
+        return -1;
+    }
+
+    rc = nn_sock_ctxopen (sock);
+    nn_global_rele_socket (sock);
+    if (nn_slow (rc < 0)) {
+        errno = -rc;
+        return -1;
+    }
+    return rc;
+}
+
+int nn_ctx_close (int s, int c)
+{
+    int rc;
+    struct nn_sock *sock;
+
+    rc = nn_global_hold_socket (&sock, s);
+    if (nn_slow (rc < 0)) {
+        errno = -rc;
+        return -1;
+    }
+
+    rc = nn_sock_ctxclose (sock, c);
+    nn_global_rele_socket (sock);
+    if (nn_slow (rc < 0)) {
+        errno = -rc;
+        return -1;
+    }
+    return 0;
+}
+
+int nn_ctx_send (int s, int c, const void *buf, size_t len, int flags)
+{
+    struct nn_iovec iov;
+    struct nn_msghdr hdr;
+
+    if (nn_slow (c < 0)) {
+        errno = EBADF;
+        return -1;
+    }
+
+    iov.iov_base = (void*) buf;
+    iov.iov_len = len;
+
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = NULL;
+    hdr.msg_controllen = 0;
+
+    return nn_global_sendmsg (s, c, &hdr, flags);
+}
+
+int nn_ctx_recv (int s, int c, void *buf, size_t len, int flags)
+{
+    struct nn_iovec iov;
+    struct nn_msghdr hdr;
+
+    if (nn_slow (c < 0)) {
+        errno = EBADF;
+        return -1;
+    }
+
+    iov.iov_base = buf;
+    iov.iov_len = len;
+
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = NULL;
+    hdr.msg_controllen = 0;
+
+    return nn_global_recvmsg (s, c, &hdr, flags);
+}
+
+int nn_req_batch (int s, const struct nn_iovec *reqs, int nreqs, int timeout)
+{
+    int rc;
+    int i;
+    size_t sz;
+    void *chunk;
+    struct nn_msg *msgs;
+    struct nn_sock *sock;
+
+    rc = nn_global_hold_socket (&sock, s);
+    if (nn_slow (rc < 0)) {
+        errno = -rc;
+        return -1;
+    }
+
+    if (nn_slow (!reqs || nreqs <= 0)) {
+        rc = -EINVAL;
+        goto fail;
+    }
+    for (i = 0; i != nreqs; ++i) {
+        if (reqs [i].iov_len == NN_MSG) {
+            if (nn_slow (!reqs [i].iov_base ||
+                  *(void**) reqs [i].iov_base == NULL)) {
+                rc = -EFAULT;
+                goto fail;
+            }
+        }
+        else if (nn_slow (!reqs [i].iov_base && reqs [i].iov_len)) {
+            rc = -EFAULT;
+            goto fail;
+        }
+    }
+
+    /*  Create a message object for each request. */
+    msgs = nn_alloc (nreqs * sizeof (struct nn_msg), "batch");
+    alloc_assert (msgs);
+    sz = 0;
+    for (i = 0; i != nreqs; ++i) {
+        if (reqs [i].iov_len == NN_MSG) {
+            chunk = *(void**) reqs [i].iov_base;
+            nn_msg_init_chunk (&msgs [i], chunk);
+        }
+        else {
+            nn_msg_init (&msgs [i], reqs [i].iov_len);
+            memcpy (nn_chunkref_data (&msgs [i].body), reqs [i].iov_base,
+                reqs [i].iov_len);
+        }
+        sz += nn_chunkref_size (&msgs [i].body);
+    }
+
+    rc = nn_sock_batch (sock, msgs, nreqs, timeout);
+    if (nn_slow (rc < 0)) {
+
+        /*  The user-supplied buffers stay with the user. */
+        for (i = 0; i != nreqs; ++i) {
+            if (reqs [i].iov_len == NN_MSG)
+                nn_chunkref_init (&msgs [i].body, 0);
+            nn_msg_term (&msgs [i]);
+        }
+        nn_free (msgs);
+        goto fail;
+    }
+    nn_free (msgs);
+
+    /*  Adjust the statistics. */
+    nn_sock_stat_increment (sock, NN_STAT_MESSAGES_SENT, nreqs);
+    nn_sock_stat_increment (sock, NN_STAT_BYTES_SENT, sz);
+
+    nn_global_rele_socket (sock);
+
+    return rc;
+
+fail:
+    nn_global_rele_socket (sock);
+
+    errno = -rc;
+    return -1;
+}
+
+int nn_req_batch_recv (int s, int b, void *buf, size_t len, int *index,
+    int flags)
+{
+    int rc;
+    struct nn_iovec iov;
+    struct nn_msghdr hdr;
+    struct nn_cmsghdr *cmsg;
+    size_t ctrl [NN_CMSG_SPACE (sizeof (size_t) + sizeof (uint32_t)) /
+        sizeof (size_t)];
+
+    if (nn_slow (b < 0)) {
+        errno = EBADF;
+        return -1;
+    }
+
+    iov.iov_base = buf;
+    iov.iov_len = len;
+
+    /*  The index of the request is passed in the SP header of the reply. */
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = ctrl;
+    hdr.msg_controllen = sizeof (ctrl);
+
+    rc = nn_global_recvmsg (s, b, &hdr, flags);
+    if (nn_slow (rc < 0))
+        return -1;
+
+    if (index) {
+        cmsg = NN_CMSG_FIRSTHDR (&hdr);
+        if (cmsg && cmsg->cmsg_level == PROTO_SP &&
+              cmsg->cmsg_type == SP_HDR &&
+              *(size_t*) NN_CMSG_DATA (cmsg) == sizeof (uint32_t))
+            *index = (int) nn_getl (NN_CMSG_DATA (cmsg) + sizeof (size_t));
+        else
+            *index = -1;
+    }
+
+    return rc;
+}
+
+static int nn_global_sendmsg (int s, int ctx, const struct nn_msghdr *msghdr,
+    int flags)
 {
     int rc;
     size_t sz;
@@ -812,7 +1039,10 @@ int nn_sendmsg (int s, const struct nn_msghdr *msghdr, int flags)
     }
 
     /*  Send it further down the stack. */
-    rc = nn_sock_send (sock, &msg, flags);
+    if (ctx < 0)
+        rc = nn_sock_send (sock, &msg, flags);
+    else
+        rc = nn_sock_ctxsend (sock, ctx, &msg, flags);
     if (nn_slow (rc < 0)) {
 
         /*  If we are dealing with user-supplied buffer, detach it from
@@ -839,7 +1069,8 @@ fail:
     return -1;
 }
 
-int nn_recvmsg (int s, struct nn_msghdr *msghdr, int flags)
+static int nn_global_recvmsg (int s, int ctx, struct nn_msghdr *msghdr,
+    int flags)
 {
     int rc;
     struct nn_msg msg;
@@ -873,7 +1104,10 @@ int nn_recvmsg (int s, struct nn_msghdr *msghdr, int flags)
     }
 
     /*  Get a message. */
-    rc = nn_sock_recv (sock, &msg, flags);
+    if (ctx < 0)
+        rc = nn_sock_recv (sock, &msg, flags);
+    else
+        rc = nn_sock_ctxrecv (sock, ctx, &msg, flags);
     if (nn_slow (rc < 0)) {
         goto fail;
     }
@@ -1006,6 +1240,9 @@ uint64_t nn_get_statistic (int s, int statistic)
     case NN_STAT_ACCEPT_ERRORS:
         val = sock->statistics.bind_errors;
         break;
+    case NN_STAT_EVICTED_CONNECTIONS:
+        val = sock->statistics.evicted_connections;
+        break;
     case NN_STAT_MESSAGES_SENT:
         val = sock->statistics.messages_sent;
         break;
@@ -1027,9 +1264,54 @@ uint64_t nn_get_statistic (int s, int statistic)
     case NN_STAT_CURRENT_SND_PRIORITY:
         val = sock->statistics.current_snd_priority;
         break;
+    case NN_STAT_DROPPED_MESSAGES:
+        val = sock->statistics.dropped_messages;
+        break;
+    case NN_STAT_MAX_PIPE_DROPPED_MESSAGES:
+        val = sock->statistics.max_pipe_dropped_messages;
+        break;
+    case NN_STAT_HEDGED_REQUESTS:
+        val = sock->statistics.hedged_requests;
+        break;
+    case NN_STAT_HEDGES_WON:
+        val = sock->statistics.hedges_won;
+        break;
+    case NN_STAT_EXPIRED_REQUESTS:
+        val = sock->statistics.expired_requests;
+        break;
+    case NN_STAT_CACHE_HITS:
+        val = sock->statistics.cache_hits;
+        break;
+    case NN_STAT_CACHE_MISSES:
+        val = sock->statistics.cache_misses;
+        break;
     case NN_STAT_CURRENT_EP_ERRORS:
         val = sock->statistics.current_ep_errors;
         break;
+    case NN_STAT_CURRENT_BYTES_QUEUED:
+        val = sock->statistics.current_bytes_queued;
+        break;
+    case NN_STAT_MEMORY_CHUNKS:
+        val = nn_chunk_stat (NN_CHUNK_STAT_CHUNKS);
+        break;
+    case NN_STAT_MEMORY_BYTES:
+        val = nn_chunk_stat (NN_CHUNK_STAT_BYTES);
+        break;
+    case NN_STAT_MEMORY_PEAK_BYTES:
+        val = nn_chunk_stat (NN_CHUNK_STAT_PEAK);
+        break;
+    case NN_STAT_MEMORY_BUDGET:
+        val = nn_chunk_stat (NN_CHUNK_STAT_BUDGET);
+        break;
+    case NN_STAT_MEMORY_BYTES_64:
+    case NN_STAT_MEMORY_BYTES_256:
+    case NN_STAT_MEMORY_BYTES_1K:
+    case NN_STAT_MEMORY_BYTES_4K:
+    case NN_STAT_MEMORY_BYTES_64K:
+    case NN_STAT_MEMORY_BYTES_LARGE:
+        val = nn_chunk_stat (NN_CHUNK_STAT_CLASS +
+            (statistic - NN_STAT_MEMORY_BYTES_64));
+        break;
     default:
         val = (uint64_t)-1;
         errno = EINVAL;
@@ -58,7 +58,9 @@ void nn_pipebase_init (struct nn_pipebase *self,
     self->instate = NN_PIPEBASE_INSTATE_DEACTIVATED;
     self->outstate = NN_PIPEBASE_OUTSTATE_DEACTIVATED;
     self->sock = ep->sock;
+    self->ep = ep;
     memcpy (&self->options, &ep->options, sizeof (struct nn_ep_options));
+    self->caps = 0;
     nn_fsm_event_init (&self->in);
     nn_fsm_event_init (&self->out);
 }
@@ -159,6 +161,32 @@ void nn_pipebase_getopt (struct nn_pipebase *self, int level, int option,
     errnum_assert (rc == 0, -rc);
 }
 
+int nn_pipebase_localcaps (struct nn_pipebase *self)
+{
+    int caps;
+
+    caps = 0;
+    if (self->sock->socktype->flags & NN_SOCKTYPE_FLAG_SUBFWD)
+        caps |= NN_PIPEBASE_CAP_SUBFWD;
+    if (self->sock->socktype->flags & NN_SOCKTYPE_FLAG_CREDIT)
+        caps |= NN_PIPEBASE_CAP_CREDIT;
+    if (self->sock->socktype->flags & NN_SOCKTYPE_FLAG_DEADLINE)
+        caps |= NN_PIPEBASE_CAP_DEADLINE;
+    return caps;
+}
+
+void nn_pipebase_setcaps (struct nn_pipebase *self, int caps)
+{
+    nn_assert_state (self, NN_PIPEBASE_STATE_IDLE);
+    self->caps = caps & nn_pipebase_localcaps (self);
+}
+
+void nn_pipebase_stat_increment (struct nn_pipebase *self, int name,
+    int increment)
+{
+    nn_sock_stat_increment (self->sock, name, increment);
+}
+
 int nn_pipebase_ispeer (struct nn_pipebase *self, int socktype)
 {
     return nn_sock_ispeer (self->sock, socktype);
@@ -213,6 +241,18 @@ int nn_pipe_recv (struct nn_pipe *self, struct nn_msg *msg)
     return rc | NN_PIPEBASE_RELEASE;
 }
 
+int nn_pipe_close (struct nn_pipe *self)
+{
+    struct nn_pipebase *pipebase;
+
+    pipebase = (struct nn_pipebase*) self;
+    if (!pipebase->vfptr->close)
+        return -ENOTSUP;
+    pipebase->vfptr->close (pipebase);
+    nn_assert (pipebase->state != NN_PIPEBASE_STATE_ACTIVE);
+    return 0;
+}
+
 void nn_pipe_getopt (struct nn_pipe *self, int level, int option,
     void *optval, size_t *optvallen)
 {
@@ -222,3 +262,13 @@ void nn_pipe_getopt (struct nn_pipe *self, int level, int option,
     pipebase = (struct nn_pipebase*) self;
     nn_pipebase_getopt (pipebase, level, option, optval, optvallen);
 }
+
+int nn_pipe_caps (struct nn_pipe *self)
+{
+    return ((struct nn_pipebase*) self)->caps;
+}
+
+const char *nn_pipe_getaddr (struct nn_pipe *self)
+{
+    return nn_ep_getaddr (((struct nn_pipebase*) self)->ep);
+}
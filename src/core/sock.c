@@ -35,6 +35,7 @@
 #include "../utils/fast.h"
 #include "../utils/alloc.h"
 #include "../utils/msg.h"
+#include "../utils/chunk.h"
 
 #include <limits.h>
 
@@ -61,6 +62,10 @@
 static struct nn_optset *nn_sock_optset (struct nn_sock *self, int id);
 static int nn_sock_setopt_inner (struct nn_sock *self, int level,
     int option, const void *optval, size_t optvallen);
+static int nn_sock_ctxio (struct nn_sock *self, int ctx, struct nn_msg *msg,
+    int flags, int send);
+static int nn_sock_budget (struct nn_sock *self, int flags,
+    uint64_t deadline);
 static void nn_sock_onleave (struct nn_ctx *self);
 static void nn_sock_handler (struct nn_fsm *self, int src, int type,
     void *srcptr);
@@ -108,7 +113,10 @@ int nn_sock_init (struct nn_sock *self, const struct nn_socktype *socktype,
     }
     nn_sem_init (&self->termsem);
     nn_sem_init (&self->relesem);
+    rc = nn_condvar_init (&self->ctxcond);
     if (nn_slow (rc < 0)) {
+        nn_sem_term (&self->relesem);
+        nn_sem_term (&self->termsem);
         if (!(socktype->flags & NN_SOCKTYPE_FLAG_NORECV))
             nn_efd_term (&self->rcvfd);
         if (!(socktype->flags & NN_SOCKTYPE_FLAG_NOSEND))
@@ -116,6 +124,7 @@ int nn_sock_init (struct nn_sock *self, const struct nn_socktype *socktype,
         return rc;
     }
 
+    self->ctxgen = 0;
     self->holds = 1;   /*  Callers hold. */
     self->flags = 0;
     nn_list_init (&self->eps);
@@ -131,6 +140,8 @@ int nn_sock_init (struct nn_sock *self, const struct nn_socktype *socktype,
     self->reconnect_ivl = 100;
     self->reconnect_ivl_max = 0;
     self->maxttl = 8;
+    self->sndbudget = 0;
+    self->extensions = 0;
     self->ep_template.sndprio = 8;
     self->ep_template.rcvprio = 8;
     self->ep_template.ipv4only = 1;
@@ -225,6 +236,7 @@ int nn_sock_term (struct nn_sock *self)
 
     nn_fsm_stopped_noevent (&self->fsm);
     nn_fsm_term (&self->fsm);
+    nn_condvar_term (&self->ctxcond);
     nn_sem_term (&self->termsem);
     nn_list_term (&self->sdeps);
     nn_list_term (&self->eps);
@@ -361,6 +373,16 @@ static int nn_sock_setopt_inner (struct nn_sock *self, int level,
             return -EINVAL;
         self->maxttl = val;
         return 0;
+    case NN_SNDBUDGET:
+        if (val != 0 && val != 1)
+            return -EINVAL;
+        self->sndbudget = val;
+        return 0;
+    case NN_EXTENSIONS:
+        if (val != 0 && val != 1)
+            return -EINVAL;
+        self->extensions = val;
+        return 0;
     case NN_LINGER:
 	/*  Ignored, retained for compatibility. */
         return 0;
@@ -451,6 +473,12 @@ int nn_sock_getopt_inner (struct nn_sock *self, int level,
     case NN_MAXTTL:
         intval = self->maxttl;
         break;
+    case NN_SNDBUDGET:
+        intval = self->sndbudget;
+        break;
+    case NN_EXTENSIONS:
+        intval = self->extensions;
+        break;
     case NN_SNDFD:
         if (self->socktype->flags & NN_SOCKTYPE_FLAG_NOSEND)
             return -ENOPROTOOPT;
@@ -595,6 +623,13 @@ int nn_sock_send (struct nn_sock *self, struct nn_msg *msg, int flags)
             return -EBADF;
         }
 
+        /*  Wait for the process-wide memory budget, if needed. */
+        rc = nn_sock_budget (self, flags, deadline);
+        if (nn_slow (rc < 0)) {
+            nn_ctx_leave (&self->ctx);
+            return rc;
+        }
+
         /*  Try to send the message in a non-blocking way. */
         rc = self->sockbase->vfptr->send (self->sockbase, msg);
         if (nn_fast (rc == 0)) {
@@ -644,6 +679,217 @@ int nn_sock_send (struct nn_sock *self, struct nn_msg *msg, int flags)
     }
 }
 
+int nn_sock_ctxopen (struct nn_sock *self)
+{
+    int rc;
+
+    if (nn_slow (!self->sockbase->vfptr->ctxopen))
+        return -ENOTSUP;
+
+    nn_ctx_enter (&self->ctx);
+    if (nn_slow (self->state != NN_SOCK_STATE_ACTIVE &&
+          self->state != NN_SOCK_STATE_INIT))
+        rc = -EBADF;
+    else
+        rc = self->sockbase->vfptr->ctxopen (self->sockbase);
+    nn_ctx_leave (&self->ctx);
+
+    return rc;
+}
+
+int nn_sock_ctxclose (struct nn_sock *self, int ctx)
+{
+    int rc;
+
+    if (nn_slow (!self->sockbase->vfptr->ctxclose))
+        return -ENOTSUP;
+
+    nn_ctx_enter (&self->ctx);
+    if (nn_slow (self->state != NN_SOCK_STATE_ACTIVE &&
+          self->state != NN_SOCK_STATE_INIT))
+        rc = -EBADF;
+    else {
+        rc = self->sockbase->vfptr->ctxclose (self->sockbase, ctx);
+
+        /*  Let any thread blocked on the context find out it's gone. */
+        if (rc == 0)
+            nn_sock_ctxnotify (self);
+    }
+    nn_ctx_leave (&self->ctx);
+
+    return rc;
+}
+
+int nn_sock_ctxsend (struct nn_sock *self, int ctx, struct nn_msg *msg,
+    int flags)
+{
+    if (nn_slow (self->socktype->flags & NN_SOCKTYPE_FLAG_NOSEND))
+        return -ENOTSUP;
+    if (nn_slow (!self->sockbase->vfptr->ctxsend))
+        return -ENOTSUP;
+    return nn_sock_ctxio (self, ctx, msg, flags, 1);
+}
+
+int nn_sock_ctxrecv (struct nn_sock *self, int ctx, struct nn_msg *msg,
+    int flags)
+{
+    if (nn_slow (self->socktype->flags & NN_SOCKTYPE_FLAG_NORECV))
+        return -ENOTSUP;
+    if (nn_slow (!self->sockbase->vfptr->ctxrecv))
+        return -ENOTSUP;
+    return nn_sock_ctxio (self, ctx, msg, flags, 0);
+}
+
+int nn_sock_batch (struct nn_sock *self, struct nn_msg *msgs, int nmsgs,
+    int timeout)
+{
+    int rc;
+
+    if (nn_slow (!self->sockbase->vfptr->batch))
+        return -ENOTSUP;
+
+    nn_ctx_enter (&self->ctx);
+    if (nn_slow (self->state != NN_SOCK_STATE_ACTIVE &&
+          self->state != NN_SOCK_STATE_INIT))
+        rc = -EBADF;
+    else {
+        rc = nn_sock_budget (self, 0, self->sndtimeo < 0 ? (uint64_t) -1 :
+            nn_clock_ms () + self->sndtimeo);
+        if (nn_fast (rc == 0))
+            rc = self->sockbase->vfptr->batch (self->sockbase, msgs, nmsgs,
+                timeout);
+    }
+    nn_ctx_leave (&self->ctx);
+
+    return rc;
+}
+
+static int nn_sock_budget (struct nn_sock *self, int flags, uint64_t deadline)
+{
+    uint64_t now;
+    int timeout;
+
+    /*  Only the sockets that opted in are subject to the budget. Others,
+        e.g. the ones replying to requests or forwarding messages, may well
+        be the ones that free the memory. */
+    if (nn_fast (!self->sndbudget))
+        return 0;
+
+    while (nn_slow (nn_chunk_budget_exhausted ())) {
+
+        /*  Non-blocking send. */
+        if (flags & NN_DONTWAIT || self->sndtimeo == 0)
+            return -EAGAIN;
+
+        if (self->sndtimeo < 0)
+            timeout = -1;
+        else {
+            now = nn_clock_ms ();
+            if (now >= deadline)
+                return -ETIMEDOUT;
+            timeout = (int) (deadline - now);
+        }
+
+        /*  Wait till some memory is released. The socket may have been
+            closed in the meantime. */
+        nn_ctx_leave (&self->ctx);
+        nn_chunk_budget_wait (timeout);
+        nn_ctx_enter (&self->ctx);
+        if (nn_slow (self->state != NN_SOCK_STATE_ACTIVE &&
+              self->state != NN_SOCK_STATE_INIT))
+            return -EBADF;
+    }
+
+    return 0;
+}
+
+void nn_sock_ctxnotify (struct nn_sock *self)
+{
+    ++self->ctxgen;
+    nn_condvar_broadcast (&self->ctxcond);
+}
+
+static int nn_sock_ctxio (struct nn_sock *self, int ctx, struct nn_msg *msg,
+    int flags, int send)
+{
+    int rc;
+    int timeo;
+    uint64_t deadline;
+    uint64_t now;
+    int timeout;
+    uint32_t gen;
+
+    nn_ctx_enter (&self->ctx);
+
+    /*  Compute the deadline for SNDTIMEO or RCVTIMEO timer. */
+    timeo = send ? self->sndtimeo : self->rcvtimeo;
+    if (timeo < 0) {
+        deadline = -1;
+        timeout = -1;
+    }
+    else {
+        deadline = nn_clock_ms() + timeo;
+        timeout = timeo;
+    }
+
+    while (1) {
+
+        if (nn_slow (self->state != NN_SOCK_STATE_ACTIVE &&
+              self->state != NN_SOCK_STATE_INIT)) {
+            nn_ctx_leave (&self->ctx);
+            return -EBADF;
+        }
+
+        /*  Wait for the process-wide memory budget, if needed. */
+        if (send) {
+            rc = nn_sock_budget (self, flags, deadline);
+            if (nn_slow (rc < 0)) {
+                nn_ctx_leave (&self->ctx);
+                return rc;
+            }
+        }
+
+        /*  Try to do the operation in a non-blocking way. */
+        rc = send ?
+            self->sockbase->vfptr->ctxsend (self->sockbase, ctx, msg) :
+            self->sockbase->vfptr->ctxrecv (self->sockbase, ctx, msg);
+        if (nn_fast (rc != -EAGAIN)) {
+            nn_ctx_leave (&self->ctx);
+            return rc;
+        }
+        if (nn_fast (flags & NN_DONTWAIT)) {
+            nn_ctx_leave (&self->ctx);
+            return -EAGAIN;
+        }
+        if (nn_slow (timeout == 0)) {
+            nn_ctx_leave (&self->ctx);
+            return -ETIMEDOUT;
+        }
+
+        /*  The events queued in the meantime are processed when leaving
+            the context and they may well make the context ready. Wait only
+            if they didn't. The socket's efds can't be used here as they
+            reflect the state of the socket rather than of its contexts. */
+        gen = self->ctxgen;
+        nn_ctx_leave (&self->ctx);
+        nn_ctx_enter (&self->ctx);
+        if (gen == self->ctxgen) {
+            rc = nn_condvar_wait (&self->ctxcond, &self->ctx.sync, timeout);
+            if (nn_slow (rc == -ETIMEDOUT)) {
+                nn_ctx_leave (&self->ctx);
+                return -ETIMEDOUT;
+            }
+        }
+
+        /*  If needed, re-compute the timeout to reflect the time that have
+            already elapsed. */
+        if (timeo >= 0) {
+            now = nn_clock_ms();
+            timeout = (int) (now > deadline ? 0 : deadline - now);
+        }
+    }
+}
+
 int nn_sock_recv (struct nn_sock *self, struct nn_msg *msg, int flags)
 {
     int rc;
@@ -850,6 +1096,9 @@ static void nn_sock_shutdown (struct nn_fsm *self, int src, int type,
             nn_efd_stop (&sock->sndfd);
         }
 
+        /*  Same for the threads blocked on contexts. */
+        nn_sock_ctxnotify (sock);
+
         /*  Ask all the associated endpoints to stop. */
         it = nn_list_begin (&sock->eps);
         while (it != nn_list_end (&sock->eps)) {
@@ -1056,6 +1305,10 @@ void nn_sock_stat_increment (struct nn_sock *self, int name, int64_t increment)
             nn_assert (increment > 0);
             self->statistics.accept_errors += increment;
             break;
+        case NN_STAT_EVICTED_CONNECTIONS:
+            nn_assert (increment > 0);
+            self->statistics.evicted_connections += increment;
+            break;
         case NN_STAT_MESSAGES_SENT:
             nn_assert (increment > 0);
             self->statistics.messages_sent += increment;
@@ -1072,6 +1325,30 @@ void nn_sock_stat_increment (struct nn_sock *self, int name, int64_t increment)
             nn_assert (increment >= 0);
             self->statistics.bytes_received += increment;
             break;
+        case NN_STAT_DROPPED_MESSAGES:
+            nn_assert (increment > 0);
+            self->statistics.dropped_messages += increment;
+            break;
+        case NN_STAT_HEDGED_REQUESTS:
+            nn_assert (increment > 0);
+            self->statistics.hedged_requests += increment;
+            break;
+        case NN_STAT_HEDGES_WON:
+            nn_assert (increment > 0);
+            self->statistics.hedges_won += increment;
+            break;
+        case NN_STAT_EXPIRED_REQUESTS:
+            nn_assert (increment > 0);
+            self->statistics.expired_requests += increment;
+            break;
+        case NN_STAT_CACHE_HITS:
+            nn_assert (increment > 0);
+            self->statistics.cache_hits += increment;
+            break;
+        case NN_STAT_CACHE_MISSES:
+            nn_assert (increment > 0);
+            self->statistics.cache_misses += increment;
+            break;
 
         case NN_STAT_CURRENT_CONNECTIONS:
             nn_assert (increment > 0 ||
@@ -1096,6 +1373,24 @@ void nn_sock_stat_increment (struct nn_sock *self, int name, int64_t increment)
             nn_assert(increment < INT_MAX && increment > -INT_MAX);
             self->statistics.current_ep_errors += (int) increment;
             break;
+        case NN_STAT_CURRENT_BYTES_QUEUED:
+            nn_assert (increment > 0 ||
+                self->statistics.current_bytes_queued >=
+                (uint64_t) -increment);
+            self->statistics.current_bytes_queued += increment;
+            break;
+    }
+}
+
+void nn_sock_stat_set (struct nn_sock *self, int name, int64_t value)
+{
+    switch (name) {
+        case NN_STAT_MAX_PIPE_DROPPED_MESSAGES:
+            nn_assert (value >= 0 && value <= INT_MAX);
+            self->statistics.max_pipe_dropped_messages = (int) value;
+            break;
+        default:
+            nn_assert (0);
     }
 }
 
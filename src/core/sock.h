@@ -32,6 +32,7 @@
 
 #include "../utils/efd.h"
 #include "../utils/sem.h"
+#include "../utils/condvar.h"
 #include "../utils/list.h"
 
 struct nn_pipe;
@@ -59,6 +60,12 @@ struct nn_sock
     struct nn_sem termsem;
     struct nn_sem relesem;
 
+    /*  Threads blocked on contexts of the socket wait on 'ctxcond' with
+        the socket's context locked. 'ctxgen' is incremented each time
+        they should check their contexts again. */
+    nn_condvar_t ctxcond;
+    uint32_t ctxgen;
+
     /*  List of all endpoints associated with the socket. */
     struct nn_list eps;
 
@@ -80,6 +87,8 @@ struct nn_sock
     int reconnect_ivl;
     int reconnect_ivl_max;
     int maxttl;
+    int sndbudget;
+    int extensions;
 
     /*  Endpoint-specific options.  */
     struct nn_ep_options ep_template;
@@ -105,6 +114,8 @@ struct nn_sock
         uint64_t bind_errors;
         /*  Errors accepting connections at nn_bind()'ed endpoint  */
         uint64_t accept_errors;
+        /*  Connections closed by the protocol because the peer was too slow  */
+        uint64_t evicted_connections;
 
         /*  Messages sent  */
         uint64_t messages_sent;
@@ -114,6 +125,18 @@ struct nn_sock
         uint64_t bytes_sent;
         /*  Bytes recevied (sum length of data in messages received)  */
         uint64_t bytes_received;
+        /*  Messages the protocol dropped because the peer was too slow  */
+        uint64_t dropped_messages;
+        /*  Requests sent to a second peer because the reply was late  */
+        uint64_t hedged_requests;
+        /*  Hedged requests answered by the second peer first  */
+        uint64_t hedges_won;
+        /*  Requests dropped because their deadline has expired  */
+        uint64_t expired_requests;
+        /*  Requests answered from the reply cache  */
+        uint64_t cache_hits;
+        /*  Requests passed on because the reply was not cached  */
+        uint64_t cache_misses;
 
         /*****  Level-style values *****/
 
@@ -125,6 +148,10 @@ struct nn_sock
         int current_snd_priority;
         /*  Number of endpoints having last_errno set to non-zero value  */
         int current_ep_errors;
+        /*  Bytes of received messages buffered by transports  */
+        uint64_t current_bytes_queued;
+        /*  Messages dropped for the worst of the currently attached pipes  */
+        int max_pipe_dropped_messages;
 
     } statistics;
 
@@ -173,6 +200,24 @@ int nn_sock_send (struct nn_sock *self, struct nn_msg *msg, int flags);
 /*  Receive a message from the socket. */
 int nn_sock_recv (struct nn_sock *self, struct nn_msg *msg, int flags);
 
+/*  Open and close a context of the socket. */
+int nn_sock_ctxopen (struct nn_sock *self);
+int nn_sock_ctxclose (struct nn_sock *self, int ctx);
+
+/*  Send a message to the context / receive a message from the context. */
+int nn_sock_ctxsend (struct nn_sock *self, int ctx, struct nn_msg *msg,
+    int flags);
+int nn_sock_ctxrecv (struct nn_sock *self, int ctx, struct nn_msg *msg,
+    int flags);
+
+/*  Send a batch of requests. Returns ID of the context to receive
+    the replies from. */
+int nn_sock_batch (struct nn_sock *self, struct nn_msg *msgs, int nmsgs,
+    int timeout);
+
+/*  Wake up the threads blocked on contexts of the socket. */
+void nn_sock_ctxnotify (struct nn_sock *self);
+
 /*  Set a socket option. */
 int nn_sock_setopt (struct nn_sock *self, int level, int option,
     const void *optval, size_t optvallen);
@@ -193,6 +238,7 @@ void nn_sock_rm (struct nn_sock *self, struct nn_pipe *pipe);
 /*  Monitoring callbacks  */
 void nn_sock_report_error(struct nn_sock *self, struct nn_ep *ep,  int errnum);
 void nn_sock_stat_increment(struct nn_sock *self, int name, int64_t increment);
+void nn_sock_stat_set (struct nn_sock *self, int name, int64_t value);
 
 /*  Holds and releases. */
 int nn_sock_hold (struct nn_sock *self);
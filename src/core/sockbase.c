@@ -60,3 +60,23 @@ void nn_sockbase_stat_increment (struct nn_sockbase *self, int name,
 {
     nn_sock_stat_increment (self->sock, name, increment);
 }
+
+void nn_sockbase_stat_set (struct nn_sockbase *self, int name, int value)
+{
+    nn_sock_stat_set (self->sock, name, value);
+}
+
+void nn_sockbase_ctxnotify (struct nn_sockbase *self)
+{
+    nn_sock_ctxnotify (self->sock);
+}
+
+void nn_sockbase_fanout_begin (struct nn_sockbase *self)
+{
+    nn_ctx_fanout_begin (nn_sock_getctx (self->sock));
+}
+
+void nn_sockbase_fanout_end (struct nn_sockbase *self)
+{
+    nn_ctx_fanout_end (nn_sock_getctx (self->sock));
+}
@@ -115,17 +115,50 @@ static const struct nn_symbol_properties sym_value_names [] = {
     NN_SYM(NN_IPV4ONLY, SOCKET_OPTION, INT, BOOLEAN),
     NN_SYM(NN_SOCKET_NAME, SOCKET_OPTION, STR, NONE),
     NN_SYM(NN_MAXTTL, SOCKET_OPTION, INT, NONE),
+    NN_SYM(NN_SNDBUDGET, SOCKET_OPTION, INT, BOOLEAN),
+    NN_SYM(NN_EXTENSIONS, SOCKET_OPTION, INT, BOOLEAN),
 
     NN_SYM(NN_SUB_SUBSCRIBE, TRANSPORT_OPTION, STR, NONE),
     NN_SYM(NN_SUB_UNSUBSCRIBE, TRANSPORT_OPTION, STR, NONE),
+    NN_SYM(NN_SUB_TOPIC_DELIM, TRANSPORT_OPTION, INT, NONE),
+    NN_SYM(NN_SUB_TOPIC_LEN, TRANSPORT_OPTION, INT, BYTES),
+    NN_SYM(NN_PUB_TOPIC_DELIM, TRANSPORT_OPTION, INT, NONE),
+    NN_SYM(NN_PUB_TOPIC_LEN, TRANSPORT_OPTION, INT, BYTES),
+    NN_SYM(NN_PUB_LVC, TRANSPORT_OPTION, INT, BOOLEAN),
+    NN_SYM(NN_PUB_CONFLATE, TRANSPORT_OPTION, INT, BOOLEAN),
+    NN_SYM(NN_PUB_SLOW_POLICY, TRANSPORT_OPTION, INT, NONE),
+    NN_SYM(NN_PUB_SLOW_BACKLOG, TRANSPORT_OPTION, INT, MESSAGES),
+    NN_SYM(NN_PUB_SLOW_MAXDROPS, TRANSPORT_OPTION, INT, MESSAGES),
+    NN_SYM(NN_PUB_SLOW_MAXLAG, TRANSPORT_OPTION, INT, MILLISECONDS),
+    NN_SYM(NN_SUB_SUBSCRIBE_BULK, TRANSPORT_OPTION, STR, NONE),
+    NN_SYM(NN_PUB_LVC_SIZE, TRANSPORT_OPTION, INT, NONE),
     NN_SYM(NN_REQ_RESEND_IVL, TRANSPORT_OPTION, INT, MILLISECONDS),
+    NN_SYM(NN_REQ_HEDGE_IVL, TRANSPORT_OPTION, INT, MILLISECONDS),
+    NN_SYM(NN_REQ_HEDGE_PERCENTILE, TRANSPORT_OPTION, INT, NONE),
+    NN_SYM(NN_REQ_LB_STRATEGY, TRANSPORT_OPTION, INT, NONE),
+    NN_SYM(NN_REQ_LB_KEY_OFFSET, TRANSPORT_OPTION, INT, BYTES),
+    NN_SYM(NN_REQ_LB_KEY_LEN, TRANSPORT_OPTION, INT, BYTES),
+    NN_SYM(NN_REP_CACHE_SIZE, TRANSPORT_OPTION, INT, MESSAGES),
+    NN_SYM(NN_REP_CACHE_TTL, TRANSPORT_OPTION, INT, MILLISECONDS),
+    NN_SYM(NN_PUSH_LB_STRATEGY, TRANSPORT_OPTION, INT, NONE),
+    NN_SYM(NN_PUSH_LB_KEY_OFFSET, TRANSPORT_OPTION, INT, BYTES),
+    NN_SYM(NN_PUSH_LB_KEY_LEN, TRANSPORT_OPTION, INT, BYTES),
+    NN_SYM(NN_PULL_CREDITS, TRANSPORT_OPTION, INT, MESSAGES),
     NN_SYM(NN_SURVEYOR_DEADLINE, TRANSPORT_OPTION, INT, MILLISECONDS),
+    NN_SYM(NN_SURVEYOR_QUORUM, TRANSPORT_OPTION, INT, MESSAGES),
     NN_SYM(NN_TCP_NODELAY, TRANSPORT_OPTION, INT, BOOLEAN),
     NN_SYM(NN_WS_MSG_TYPE, TRANSPORT_OPTION, INT, NONE),
 
     NN_SYM(NN_DONTWAIT, FLAG, NONE, NONE),
     NN_SYM(NN_WS_MSG_TYPE_TEXT, FLAG, NONE, NONE),
     NN_SYM(NN_WS_MSG_TYPE_BINARY, FLAG, NONE, NONE),
+    NN_SYM(NN_PUB_SLOW_DROP_NEW, FLAG, NONE, NONE),
+    NN_SYM(NN_PUB_SLOW_DROP_OLDEST, FLAG, NONE, NONE),
+    NN_SYM(NN_LB_ROUND_ROBIN, FLAG, NONE, NONE),
+    NN_SYM(NN_LB_LEAST_OUTSTANDING, FLAG, NONE, NONE),
+    NN_SYM(NN_LB_EWMA, FLAG, NONE, NONE),
+    NN_SYM(NN_LB_P2C, FLAG, NONE, NONE),
+    NN_SYM(NN_LB_CONSISTENT_HASH, FLAG, NONE, NONE),
 
     NN_SYM(NN_POLLIN, EVENT, NONE, NONE),
     NN_SYM(NN_POLLOUT, EVENT, NONE, NONE),
@@ -170,6 +203,7 @@ static const struct nn_symbol_properties sym_value_names [] = {
     NN_SYM(NN_STAT_CONNECT_ERRORS, STATISTIC, INT, COUNTER),
     NN_SYM(NN_STAT_BIND_ERRORS, STATISTIC, INT, COUNTER),
     NN_SYM(NN_STAT_ACCEPT_ERRORS, STATISTIC, INT, COUNTER),
+    NN_SYM(NN_STAT_EVICTED_CONNECTIONS, STATISTIC, INT, COUNTER),
     NN_SYM(NN_STAT_MESSAGES_SENT, STATISTIC, INT, MESSAGES),
     NN_SYM(NN_STAT_MESSAGES_RECEIVED, STATISTIC, INT, MESSAGES),
     NN_SYM(NN_STAT_BYTES_SENT, STATISTIC, INT, BYTES),
@@ -177,7 +211,25 @@ static const struct nn_symbol_properties sym_value_names [] = {
     NN_SYM(NN_STAT_CURRENT_CONNECTIONS, STATISTIC, INT, NONE),
     NN_SYM(NN_STAT_INPROGRESS_CONNECTIONS, STATISTIC, INT, NONE),
     NN_SYM(NN_STAT_CURRENT_SND_PRIORITY, STATISTIC, INT, PRIORITY),
-    NN_SYM(NN_STAT_CURRENT_EP_ERRORS, STATISTIC, INT, NONE)
+    NN_SYM(NN_STAT_DROPPED_MESSAGES, STATISTIC, INT, MESSAGES),
+    NN_SYM(NN_STAT_MAX_PIPE_DROPPED_MESSAGES, STATISTIC, INT, MESSAGES),
+    NN_SYM(NN_STAT_HEDGED_REQUESTS, STATISTIC, INT, MESSAGES),
+    NN_SYM(NN_STAT_HEDGES_WON, STATISTIC, INT, MESSAGES),
+    NN_SYM(NN_STAT_EXPIRED_REQUESTS, STATISTIC, INT, MESSAGES),
+    NN_SYM(NN_STAT_CACHE_HITS, STATISTIC, INT, MESSAGES),
+    NN_SYM(NN_STAT_CACHE_MISSES, STATISTIC, INT, MESSAGES),
+    NN_SYM(NN_STAT_CURRENT_EP_ERRORS, STATISTIC, INT, NONE),
+    NN_SYM(NN_STAT_CURRENT_BYTES_QUEUED, STATISTIC, INT, BYTES),
+    NN_SYM(NN_STAT_MEMORY_CHUNKS, STATISTIC, INT, NONE),
+    NN_SYM(NN_STAT_MEMORY_BYTES, STATISTIC, INT, BYTES),
+    NN_SYM(NN_STAT_MEMORY_PEAK_BYTES, STATISTIC, INT, BYTES),
+    NN_SYM(NN_STAT_MEMORY_BUDGET, STATISTIC, INT, BYTES),
+    NN_SYM(NN_STAT_MEMORY_BYTES_64, STATISTIC, INT, BYTES),
+    NN_SYM(NN_STAT_MEMORY_BYTES_256, STATISTIC, INT, BYTES),
+    NN_SYM(NN_STAT_MEMORY_BYTES_1K, STATISTIC, INT, BYTES),
+    NN_SYM(NN_STAT_MEMORY_BYTES_4K, STATISTIC, INT, BYTES),
+    NN_SYM(NN_STAT_MEMORY_BYTES_64K, STATISTIC, INT, BYTES),
+    NN_SYM(NN_STAT_MEMORY_BYTES_LARGE, STATISTIC, INT, BYTES)
 };
 
 const int SYM_VALUE_NAMES_LEN = (sizeof (sym_value_names) /
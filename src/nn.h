@@ -335,13 +335,24 @@ NN_EXPORT  struct nn_cmsghdr *nn_cmsg_nxthdr_ (
 #define NN_SOCKET_NAME 15
 #define NN_RCVMAXSIZE 16
 #define NN_MAXTTL 17
+#define NN_SNDBUDGET 18
+#define NN_EXTENSIONS 19
 
 /*  Send/recv options.                                                        */
 #define NN_DONTWAIT 1
 
+/*  Load-balancing strategies (NN_REQ_LB_STRATEGY, NN_PUSH_LB_STRATEGY).      */
+#define NN_LB_ROUND_ROBIN 0
+#define NN_LB_LEAST_OUTSTANDING 1
+#define NN_LB_EWMA 2
+#define NN_LB_P2C 3
+#define NN_LB_CONSISTENT_HASH 4
+
 /*  Ancillary data.                                                           */
 #define PROTO_SP 1
 #define SP_HDR 1
+#define SP_KEY 2
+#define SP_DEADLINE 3
 
 NN_EXPORT int nn_socket (int domain, int protocol);
 NN_EXPORT int nn_close (int s);
@@ -357,6 +368,16 @@ NN_EXPORT int nn_recv (int s, void *buf, size_t len, int flags);
 NN_EXPORT int nn_sendmsg (int s, const struct nn_msghdr *msghdr, int flags);
 NN_EXPORT int nn_recvmsg (int s, struct nn_msghdr *msghdr, int flags);
 
+/******************************************************************************/
+/*  Contexts.                                                                 */
+/******************************************************************************/
+
+NN_EXPORT int nn_ctx_open (int s);
+NN_EXPORT int nn_ctx_close (int s, int c);
+NN_EXPORT int nn_ctx_send (int s, int c, const void *buf, size_t len,
+    int flags);
+NN_EXPORT int nn_ctx_recv (int s, int c, void *buf, size_t len, int flags);
+
 /******************************************************************************/
 /*  Socket mutliplexing support.                                              */
 /******************************************************************************/
@@ -390,10 +411,12 @@ NN_EXPORT int nn_device (int s1, int s2);
 #define NN_STAT_CONNECT_ERRORS          105
 #define NN_STAT_BIND_ERRORS             106
 #define NN_STAT_ACCEPT_ERRORS           107
+#define NN_STAT_EVICTED_CONNECTIONS     108
 
 #define NN_STAT_CURRENT_CONNECTIONS     201
 #define NN_STAT_INPROGRESS_CONNECTIONS  202
 #define NN_STAT_CURRENT_EP_ERRORS       203
+#define NN_STAT_CURRENT_BYTES_QUEUED    204
 
 /*  The socket-internal statistics  */
 #define NN_STAT_MESSAGES_SENT           301
@@ -402,6 +425,25 @@ NN_EXPORT int nn_device (int s1, int s2);
 #define NN_STAT_BYTES_RECEIVED          304
 /*  Protocol statistics  */
 #define	NN_STAT_CURRENT_SND_PRIORITY    401
+#define NN_STAT_DROPPED_MESSAGES        402
+#define NN_STAT_MAX_PIPE_DROPPED_MESSAGES 403
+#define NN_STAT_HEDGED_REQUESTS         404
+#define NN_STAT_HEDGES_WON              405
+#define NN_STAT_EXPIRED_REQUESTS        406
+#define NN_STAT_CACHE_HITS              407
+#define NN_STAT_CACHE_MISSES            408
+
+/*  Process-wide message memory statistics  */
+#define NN_STAT_MEMORY_CHUNKS           501
+#define NN_STAT_MEMORY_BYTES            502
+#define NN_STAT_MEMORY_PEAK_BYTES       503
+#define NN_STAT_MEMORY_BUDGET           504
+#define NN_STAT_MEMORY_BYTES_64         510
+#define NN_STAT_MEMORY_BYTES_256        511
+#define NN_STAT_MEMORY_BYTES_1K         512
+#define NN_STAT_MEMORY_BYTES_4K         513
+#define NN_STAT_MEMORY_BYTES_64K        514
+#define NN_STAT_MEMORY_BYTES_LARGE      515
 
 NN_EXPORT uint64_t nn_get_statistic (int s, int stat);
 
@@ -33,6 +33,12 @@ extern "C" {
 #define NN_PUSH (NN_PROTO_PIPELINE * 16 + 0)
 #define NN_PULL (NN_PROTO_PIPELINE * 16 + 1)
 
+#define NN_PUSH_LB_STRATEGY 1
+#define NN_PUSH_LB_KEY_OFFSET 2
+#define NN_PUSH_LB_KEY_LEN 3
+
+#define NN_PULL_CREDITS 1
+
 #ifdef __cplusplus
 }
 #endif
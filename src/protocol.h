@@ -50,6 +50,15 @@ struct nn_ctx;
     the messages passed with a single process. */
 #define NN_PIPE_PARSED 2
 
+/*  Capabilities negotiated with the peer, as returned by nn_pipe_caps().
+    The peer forwards subscriptions, respectively accepts forwarded
+    subscriptions. The peer grants, respectively obeys, message credits.
+    The requests exchanged with the peer are prefixed by the time left till
+    their deadline. */
+#define NN_PIPE_CAP_SUBFWD 1
+#define NN_PIPE_CAP_CREDIT 2
+#define NN_PIPE_CAP_DEADLINE 4
+
 /*  Events generated by the pipe. */
 #define NN_PIPE_IN 33987
 #define NN_PIPE_OUT 33988
@@ -70,10 +79,22 @@ int nn_pipe_send (struct nn_pipe *self, struct nn_msg *msg);
     the call. It will be initialised when the call succeeds. */
 int nn_pipe_recv (struct nn_pipe *self, struct nn_msg *msg);
 
+/*  Closes the underlying connection, e.g. to get rid of a misbehaving peer.
+    The pipe is removed from the socket (rm function of the protocol is
+    invoked) before this function returns. Returns -ENOTSUP if the transport
+    doesn't support closing individual connections. */
+int nn_pipe_close (struct nn_pipe *self);
+
 /*  Get option for pipe. Mostly useful for endpoint-specific options  */
 void nn_pipe_getopt (struct nn_pipe *self, int level, int option,
     void *optval, size_t *optvallen);
 
+/*  Returns capabilities negotiated with the peer (NN_PIPE_CAP_*).  */
+int nn_pipe_caps (struct nn_pipe *self);
+
+/*  Returns the address of the endpoint the pipe was created by. */
+const char *nn_pipe_getaddr (struct nn_pipe *self);
+
 
 /******************************************************************************/
 /*  Base class for all socket types.                                          */
@@ -124,6 +145,24 @@ struct nn_sockbase_vfptr {
     /*  Retrieve a protocol specific option. */
     int (*getopt) (struct nn_sockbase *self, int level, int option,
         void *optval, size_t *optvallen);
+
+    /*  Contexts, see nn_ctx_open(3). These are optional and can be NULL if
+        the socket type doesn't support contexts. 'ctxopen' returns ID of
+        the new context. 'ctxsend' and 'ctxrecv' work the same way as 'send'
+        and 'recv', except that they return -EBADF if there's no context
+        with the specified ID. */
+    int (*ctxopen) (struct nn_sockbase *self);
+    int (*ctxclose) (struct nn_sockbase *self, int ctx);
+    int (*ctxsend) (struct nn_sockbase *self, int ctx, struct nn_msg *msg);
+    int (*ctxrecv) (struct nn_sockbase *self, int ctx, struct nn_msg *msg);
+
+    /*  Batch of requests, see nn_req_batch(3). Optional, NULL if the socket
+        type doesn't support batches. Sends all 'nmsgs' messages and returns
+        ID of the context the replies are received from using 'ctxrecv'.
+        The messages are owned by the socket afterwards, unless an error is
+        returned. */
+    int (*batch) (struct nn_sockbase *self, struct nn_msg *msgs, int nmsgs,
+        int timeout);
 };
 
 struct nn_sockbase {
@@ -155,6 +194,22 @@ int nn_sockbase_getopt (struct nn_sockbase *self, int option,
 void nn_sockbase_stat_increment (struct nn_sockbase *self, int name,
     int increment);
 
+/*  Set the value of a statistic that the socket type computes itself,
+    such as a maximum. */
+void nn_sockbase_stat_set (struct nn_sockbase *self, int name, int value);
+
+/*  Call this function when a context may have become ready for sending or
+    receiving, so that the threads blocked on contexts of the socket check
+    them again. */
+void nn_sockbase_ctxnotify (struct nn_sockbase *self);
+
+/*  Network writes of the messages passed to nn_pipe_send in between these
+    two calls are done at once by nn_sockbase_fanout_end, spread over several
+    threads if there are many of them. Meant for sending the same message to
+    many pipes. */
+void nn_sockbase_fanout_begin (struct nn_sockbase *self);
+void nn_sockbase_fanout_end (struct nn_sockbase *self);
+
 /******************************************************************************/
 /*  The socktype class.                                                       */
 /******************************************************************************/
@@ -167,6 +222,18 @@ void nn_sockbase_stat_increment (struct nn_sockbase *self, int name,
 /*  Specifies that the socket type can be never used to send messages. */
 #define NN_SOCKTYPE_FLAG_NOSEND 2
 
+/*  Specifies that the socket type supports subscription forwarding (see
+    NN_PIPE_CAP_SUBFWD). */
+#define NN_SOCKTYPE_FLAG_SUBFWD 4
+
+/*  Specifies that the socket type supports credit-based flow control (see
+    NN_PIPE_CAP_CREDIT). */
+#define NN_SOCKTYPE_FLAG_CREDIT 8
+
+/*  Specifies that the socket type supports deadline propagation (see
+    NN_PIPE_CAP_DEADLINE). */
+#define NN_SOCKTYPE_FLAG_DEADLINE 16
+
 struct nn_socktype {
 
     /*  Domain and protocol IDs as specified in nn_socket() function. */
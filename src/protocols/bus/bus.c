@@ -54,6 +54,11 @@ static const struct nn_sockbase_vfptr nn_bus_sockbase_vfptr = {
     nn_bus_send,
     nn_bus_recv,
     NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
     NULL
 };
 
@@ -29,7 +29,7 @@
 struct nn_socktype nn_push_socktype = {
     AF_SP,
     NN_PUSH,
-    NN_SOCKTYPE_FLAG_NORECV,
+    NN_SOCKTYPE_FLAG_NORECV | NN_SOCKTYPE_FLAG_CREDIT,
     nn_xpush_create,
     nn_xpush_ispeer,
 };
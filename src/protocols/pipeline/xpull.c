@@ -30,17 +30,33 @@
 
 #include "../../utils/err.h"
 #include "../../utils/cont.h"
+#include "../../utils/wire.h"
 #include "../../utils/fast.h"
 #include "../../utils/alloc.h"
 #include "../../utils/attr.h"
 
 struct nn_xpull_data {
     struct nn_fq_data fq;
+    struct nn_pipe *pipe;
+
+    /*  Number of messages the peer may have in flight, 0 if the peer is
+        not limited. */
+    int window;
+
+    /*  Credits received messages have freed, not yet returned to the peer.
+        They are returned in batches to keep the number of grants low. */
+    uint32_t grant;
+
+    /*  1 if the pipe is writeable. */
+    int out;
 };
 
 struct nn_xpull {
     struct nn_sockbase sockbase;
     struct nn_fq fq;
+
+    /*  Value of NN_PULL_CREDITS option. */
+    int credits;
 };
 
 /*  Private functions. */
@@ -56,6 +72,11 @@ static void nn_xpull_in (struct nn_sockbase *self, struct nn_pipe *pipe);
 static void nn_xpull_out (struct nn_sockbase *self, struct nn_pipe *pipe);
 static int nn_xpull_events (struct nn_sockbase *self);
 static int nn_xpull_recv (struct nn_sockbase *self, struct nn_msg *msg);
+static int nn_xpull_setopt (struct nn_sockbase *self, int level, int option,
+    const void *optval, size_t optvallen);
+static int nn_xpull_getopt (struct nn_sockbase *self, int level, int option,
+    void *optval, size_t *optvallen);
+static void nn_xpull_grant (struct nn_xpull_data *data);
 static const struct nn_sockbase_vfptr nn_xpull_sockbase_vfptr = {
     NULL,
     nn_xpull_destroy,
@@ -66,6 +87,11 @@ static const struct nn_sockbase_vfptr nn_xpull_sockbase_vfptr = {
     nn_xpull_events,
     NULL,
     nn_xpull_recv,
+    nn_xpull_setopt,
+    nn_xpull_getopt,
+    NULL,
+    NULL,
+    NULL,
     NULL,
     NULL
 };
@@ -75,6 +101,7 @@ static void nn_xpull_init (struct nn_xpull *self,
 {
     nn_sockbase_init (&self->sockbase, vfptr, hint);
     nn_fq_init (&self->fq);
+    self->credits = 0;
 }
 
 static void nn_xpull_term (struct nn_xpull *self)
@@ -111,6 +138,18 @@ static int nn_xpull_add (struct nn_sockbase *self, struct nn_pipe *pipe)
     alloc_assert (data);
     nn_pipe_setdata (pipe, data);
     nn_fq_add (&xpull->fq, &data->fq, pipe, rcvprio);
+    data->pipe = pipe;
+    data->window = 0;
+    data->grant = 0;
+    data->out = 0;
+
+    /*  The peer waits for the initial grant before sending anything.
+        If the number of credits is not limited, tell it so. */
+    if (nn_pipe_caps (pipe) & NN_PIPE_CAP_CREDIT) {
+        data->window = xpull->credits;
+        data->grant = xpull->credits > 0 ?
+            (uint32_t) xpull->credits : NN_XPULL_UNLIMITED;
+    }
 
     return 0;
 }
@@ -138,10 +177,16 @@ static void nn_xpull_in (NN_UNUSED struct nn_sockbase *self,
 }
 
 static void nn_xpull_out (NN_UNUSED struct nn_sockbase *self,
-                          NN_UNUSED struct nn_pipe *pipe)
+                          struct nn_pipe *pipe)
 {
+    struct nn_xpull_data *data;
+
     /*  We are not going to send any messages, so there's no point is
-        maintaining a list of pipes ready for sending. */
+        maintaining a list of pipes ready for sending. The pipe is used only
+        to grant credits to the peer. */
+    data = nn_pipe_getdata (pipe);
+    data->out = 1;
+    nn_xpull_grant (data);
 }
 
 static int nn_xpull_events (struct nn_sockbase *self)
@@ -153,12 +198,84 @@ static int nn_xpull_events (struct nn_sockbase *self)
 static int nn_xpull_recv (struct nn_sockbase *self, struct nn_msg *msg)
 {
     int rc;
+    struct nn_pipe *pipe;
+    struct nn_xpull_data *data;
 
     rc = nn_fq_recv (&nn_cont (self, struct nn_xpull, sockbase)->fq,
-         msg, NULL);
+         msg, &pipe);
+    if (nn_slow (rc < 0))
+        return rc;
+
+    /*  The message has been taken off the pipe. Let the peer send
+        another one. */
+    data = nn_pipe_getdata (pipe);
+    if (data->window > 0) {
+        ++data->grant;
+        nn_xpull_grant (data);
+    }
 
     /*  Discard NN_PIPEBASE_PARSED flag. */
-    return rc < 0 ? rc : 0;
+    return 0;
+}
+
+static int nn_xpull_setopt (struct nn_sockbase *self, int level, int option,
+    const void *optval, size_t optvallen)
+{
+    struct nn_xpull *xpull;
+
+    xpull = nn_cont (self, struct nn_xpull, sockbase);
+
+    if (level != NN_PULL || option != NN_PULL_CREDITS)
+        return -ENOPROTOOPT;
+
+    if (nn_slow (optvallen != sizeof (int)))
+        return -EINVAL;
+    if (nn_slow (*(int*) optval < 0))
+        return -EINVAL;
+
+    /*  The new number of credits applies to new connections only. */
+    xpull->credits = *(int*) optval;
+    return 0;
+}
+
+static int nn_xpull_getopt (struct nn_sockbase *self, int level, int option,
+    void *optval, size_t *optvallen)
+{
+    struct nn_xpull *xpull;
+
+    xpull = nn_cont (self, struct nn_xpull, sockbase);
+
+    if (level != NN_PULL || option != NN_PULL_CREDITS)
+        return -ENOPROTOOPT;
+
+    if (nn_slow (*optvallen < sizeof (int)))
+        return -EINVAL;
+    *(int*) optval = xpull->credits;
+    *optvallen = sizeof (int);
+    return 0;
+}
+
+static void nn_xpull_grant (struct nn_xpull_data *data)
+{
+    int rc;
+    struct nn_msg msg;
+
+    if (!data->out || data->grant == 0)
+        return;
+
+    /*  Return the credits once half of the window is used up. That way
+        the peer doesn't run dry while waiting for the grant. */
+    if (data->grant != NN_XPULL_UNLIMITED &&
+          data->grant < (uint32_t) (data->window + 1) / 2)
+        return;
+
+    nn_msg_init (&msg, sizeof (uint32_t));
+    nn_putl (nn_chunkref_data (&msg.body), data->grant);
+    data->grant = 0;
+    rc = nn_pipe_send (data->pipe, &msg);
+    errnum_assert (rc >= 0, -rc);
+    if (rc & NN_PIPE_RELEASE)
+        data->out = 0;
 }
 
 int nn_xpull_create (void *hint, struct nn_sockbase **sockbase)
@@ -181,7 +298,7 @@ int nn_xpull_ispeer (int socktype)
 struct nn_socktype nn_xpull_socktype = {
     AF_SP_RAW,
     NN_PULL,
-    NN_SOCKTYPE_FLAG_NOSEND,
+    NN_SOCKTYPE_FLAG_NOSEND | NN_SOCKTYPE_FLAG_CREDIT,
     nn_xpull_create,
     nn_xpull_ispeer,
 };
@@ -25,6 +25,12 @@
 
 #include "../../protocol.h"
 
+/*  With credit-based flow control, PULL socket sends credit grants to
+    the PUSH socket. Each grant is a 32-bit number of messages the PUSH
+    socket may send in addition to what it was granted so far. This value
+    lifts the limit altogether. */
+#define NN_XPULL_UNLIMITED 0xffffffff
+
 int nn_xpull_create (void *hint, struct nn_sockbase **sockbase);
 int nn_xpull_ispeer (int socktype);
 
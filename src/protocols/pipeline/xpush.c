@@ -22,6 +22,7 @@
 */
 
 #include "xpush.h"
+#include "xpull.h"
 
 #include "../../nn.h"
 #include "../../pipeline.h"
@@ -30,10 +31,13 @@
 
 #include "../../utils/err.h"
 #include "../../utils/cont.h"
+#include "../../utils/wire.h"
 #include "../../utils/fast.h"
 #include "../../utils/alloc.h"
 #include "../../utils/attr.h"
 
+#include <limits.h>
+
 struct nn_xpush_data {
     struct nn_lb_data lb;
 };
@@ -56,6 +60,10 @@ static void nn_xpush_in (struct nn_sockbase *self, struct nn_pipe *pipe);
 static void nn_xpush_out (struct nn_sockbase *self, struct nn_pipe *pipe);
 static int nn_xpush_events (struct nn_sockbase *self);
 static int nn_xpush_send (struct nn_sockbase *self, struct nn_msg *msg);
+static int nn_xpush_setopt (struct nn_sockbase *self, int level, int option,
+    const void *optval, size_t optvallen);
+static int nn_xpush_getopt (struct nn_sockbase *self, int level, int option,
+    void *optval, size_t *optvallen);
 static const struct nn_sockbase_vfptr nn_xpush_sockbase_vfptr = {
     NULL,
     nn_xpush_destroy,
@@ -66,6 +74,11 @@ static const struct nn_sockbase_vfptr nn_xpush_sockbase_vfptr = {
     nn_xpush_events,
     nn_xpush_send,
     NULL,
+    nn_xpush_setopt,
+    nn_xpush_getopt,
+    NULL,
+    NULL,
+    NULL,
     NULL,
     NULL
 };
@@ -112,6 +125,10 @@ static int nn_xpush_add (struct nn_sockbase *self, struct nn_pipe *pipe)
     nn_pipe_setdata (pipe, data);
     nn_lb_add (&xpush->lb, &data->lb, pipe, sndprio);
 
+    /*  If the peer does flow control, wait till it grants some credit. */
+    if (nn_pipe_caps (pipe) & NN_PIPE_CAP_CREDIT)
+        nn_lb_limit (&xpush->lb, &data->lb);
+
     return 0;
 }
 
@@ -129,11 +146,34 @@ static void nn_xpush_rm (struct nn_sockbase *self, struct nn_pipe *pipe)
         nn_lb_get_priority (&xpush->lb));
 }
 
-static void nn_xpush_in (NN_UNUSED struct nn_sockbase *self,
-    NN_UNUSED struct nn_pipe *pipe)
+static void nn_xpush_in (struct nn_sockbase *self, struct nn_pipe *pipe)
 {
+    int rc;
+    uint32_t credits;
+    struct nn_xpush *xpush;
+    struct nn_xpush_data *data;
+    struct nn_msg msg;
+
     /*  We are not going to receive any messages, so there's no need to store
-        the list of inbound pipes. */
+        the list of inbound pipes. The only thing the peer sends is credit. */
+    if (!(nn_pipe_caps (pipe) & NN_PIPE_CAP_CREDIT))
+        return;
+
+    xpush = nn_cont (self, struct nn_xpush, sockbase);
+    data = nn_pipe_getdata (pipe);
+    while (1) {
+        rc = nn_pipe_recv (pipe, &msg);
+        errnum_assert (rc >= 0, -rc);
+        if (nn_fast (nn_chunkref_size (&msg.body) == sizeof (uint32_t))) {
+            credits = nn_getl (nn_chunkref_data (&msg.body));
+            nn_lb_credit (&xpush->lb, &data->lb,
+                credits == NN_XPULL_UNLIMITED ? -1 :
+                (credits > INT_MAX ? INT_MAX : (int) credits));
+        }
+        nn_msg_term (&msg);
+        if (rc & NN_PIPE_RELEASE)
+            break;
+    }
 }
 
 static void nn_xpush_out (struct nn_sockbase *self, struct nn_pipe *pipe)
@@ -160,6 +200,65 @@ static int nn_xpush_send (struct nn_sockbase *self, struct nn_msg *msg)
         msg, NULL);
 }
 
+static int nn_xpush_setopt (struct nn_sockbase *self, int level, int option,
+    const void *optval, size_t optvallen)
+{
+    int val;
+    struct nn_xpush *xpush;
+
+    xpush = nn_cont (self, struct nn_xpush, sockbase);
+
+    if (level != NN_PUSH)
+        return -ENOPROTOOPT;
+    if (option != NN_PUSH_LB_STRATEGY && option != NN_PUSH_LB_KEY_OFFSET &&
+          option != NN_PUSH_LB_KEY_LEN)
+        return -ENOPROTOOPT;
+
+    if (nn_slow (optvallen != sizeof (int)))
+        return -EINVAL;
+    val = *(int*) optval;
+
+    switch (option) {
+    case NN_PUSH_LB_STRATEGY:
+        return nn_lb_set_strategy (&xpush->lb, val);
+    case NN_PUSH_LB_KEY_OFFSET:
+        if (nn_slow (val < 0))
+            return -EINVAL;
+        xpush->lb.keyoff = val;
+        return 0;
+    default:
+        xpush->lb.keylen = val < 0 ? -1 : val;
+        return 0;
+    }
+}
+
+static int nn_xpush_getopt (struct nn_sockbase *self, int level, int option,
+    void *optval, size_t *optvallen)
+{
+    int val;
+    struct nn_xpush *xpush;
+
+    xpush = nn_cont (self, struct nn_xpush, sockbase);
+
+    if (level != NN_PUSH)
+        return -ENOPROTOOPT;
+
+    if (option == NN_PUSH_LB_STRATEGY)
+        val = nn_lb_get_strategy (&xpush->lb);
+    else if (option == NN_PUSH_LB_KEY_OFFSET)
+        val = xpush->lb.keyoff;
+    else if (option == NN_PUSH_LB_KEY_LEN)
+        val = xpush->lb.keylen;
+    else
+        return -ENOPROTOOPT;
+
+    if (nn_slow (*optvallen < sizeof (int)))
+        return -EINVAL;
+    *(int*) optval = val;
+    *optvallen = sizeof (int);
+    return 0;
+}
+
 int nn_xpush_create (void *hint, struct nn_sockbase **sockbase)
 {
     struct nn_xpush *self;
@@ -180,7 +279,7 @@ int nn_xpush_ispeer (int socktype)
 struct nn_socktype nn_xpush_socktype = {
     AF_SP_RAW,
     NN_PUSH,
-    NN_SOCKTYPE_FLAG_NORECV,
+    NN_SOCKTYPE_FLAG_NORECV | NN_SOCKTYPE_FLAG_CREDIT,
     nn_xpush_create,
     nn_xpush_ispeer,
 };
@@ -0,0 +1,448 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#include "ctrie.h"
+
+#include "../../utils/alloc.h"
+#include "../../utils/fast.h"
+#include "../../utils/err.h"
+#include "../../utils/wire.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+struct nn_ctrie_str {
+    const uint8_t *data;
+    size_t size;
+};
+
+/*  Strings [lo, hi) of the sorted array that share the first 'depth'
+    bytes, i.e. the strings a node of the trie is built from. */
+struct nn_ctrie_range {
+    size_t lo;
+    size_t hi;
+    size_t depth;
+};
+
+/*  Position of the depth-first traversal in nn_ctrie_walk. */
+struct nn_ctrie_pos {
+    uint32_t node;
+    uint32_t edge;
+    size_t depth;
+};
+
+/*  Private functions. */
+static int nn_ctrie_cmp (const void *a, const void *b);
+static void *nn_ctrie_grow (void *ptr, size_t *capacity, size_t needed,
+    size_t elemsize);
+static void nn_ctrie_reserve (struct nn_ctrie *self, size_t *capacity,
+    size_t needed);
+static uint32_t nn_ctrie_child (struct nn_ctrie *self, uint32_t node,
+    uint8_t c);
+static int nn_ctrie_isterminal (struct nn_ctrie *self, uint32_t node);
+
+void nn_ctrie_init (struct nn_ctrie *self)
+{
+    self->nodes = 0;
+    self->first = NULL;
+    self->labels = NULL;
+    self->prefixes = NULL;
+    self->terminal = NULL;
+    self->pool = NULL;
+    self->poolsz = 0;
+    self->count = 0;
+    self->maxlen = 0;
+}
+
+void nn_ctrie_term (struct nn_ctrie *self)
+{
+    nn_free (self->first);
+    nn_free (self->labels);
+    nn_free (self->prefixes);
+    nn_free (self->terminal);
+    nn_free (self->pool);
+}
+
+int nn_ctrie_build (struct nn_ctrie *self, const uint8_t *buf, size_t len)
+{
+    size_t pos;
+    size_t sz;
+    size_t n;
+    size_t i;
+    size_t j;
+    uint8_t c;
+    uint32_t node;
+    struct nn_ctrie_str *strs;
+    struct nn_ctrie_range *queue;
+    struct nn_ctrie_range r;
+    size_t head;
+    size_t tail;
+    size_t qcap;
+    size_t ncap;
+    size_t pcap;
+    size_t common;
+
+    /*  Check the format before touching the existing content. */
+    n = 0;
+    for (pos = 0; pos != len; pos += 2 + sz) {
+        if (len - pos < 2)
+            return -EINVAL;
+        sz = nn_gets (buf + pos);
+        if (len - pos - 2 < sz)
+            return -EINVAL;
+        ++n;
+    }
+
+    nn_ctrie_term (self);
+    nn_ctrie_init (self);
+    if (!n)
+        return 0;
+
+    /*  Sort the strings and drop the duplicates. */
+    strs = nn_alloc (n * sizeof (struct nn_ctrie_str), "compact trie strings");
+    alloc_assert (strs);
+    pos = 0;
+    for (i = 0; i != n; ++i) {
+        strs [i].size = nn_gets (buf + pos);
+        strs [i].data = buf + pos + 2;
+        pos += 2 + strs [i].size;
+    }
+    qsort (strs, n, sizeof (struct nn_ctrie_str), nn_ctrie_cmp);
+    j = 0;
+    for (i = 0; i != n; ++i) {
+        if (j && nn_ctrie_cmp (&strs [j - 1], &strs [i]) == 0)
+            continue;
+        strs [j++] = strs [i];
+        if (strs [i].size > self->maxlen)
+            self->maxlen = strs [i].size;
+    }
+    n = j;
+    self->count = n;
+
+    /*  Create the nodes in breadth-first order. The queue holds the ranges
+        of the nodes created but not processed yet, so node 'node' is
+        always at the head of the queue. */
+    qcap = 0;
+    ncap = 0;
+    pcap = 0;
+    queue = NULL;
+    head = 0;
+    tail = 0;
+    queue = nn_ctrie_grow (queue, &qcap, 1, sizeof (struct nn_ctrie_range));
+    queue [tail].lo = 0;
+    queue [tail].hi = n;
+    queue [tail].depth = 0;
+    ++tail;
+    nn_ctrie_reserve (self, &ncap, 2);
+    self->nodes = 1;
+    for (node = 0; node != self->nodes; ++node) {
+        r = queue [head++];
+        self->first [node] = self->nodes - 1;
+        self->prefixes [node] = 0;
+
+        /*  As the strings are sorted, the characters shared by all the
+            strings of the range are those shared by the first and the last
+            one. */
+        common = strs [r.lo].size < strs [r.hi - 1].size ?
+            strs [r.lo].size : strs [r.hi - 1].size;
+        for (sz = r.depth; sz != common &&
+              strs [r.lo].data [sz] == strs [r.hi - 1].data [sz]; ++sz)
+            ;
+        sz -= r.depth;
+        if (sz) {
+            self->pool = nn_ctrie_grow (self->pool, &pcap,
+                self->poolsz + 2 + sz, 1);
+            nn_assert (self->poolsz < UINT32_MAX);
+            self->prefixes [node] = (uint32_t) self->poolsz + 1;
+            nn_puts (self->pool + self->poolsz, (uint16_t) sz);
+            memcpy (self->pool + self->poolsz + 2,
+                strs [r.lo].data + r.depth, sz);
+            self->poolsz += 2 + sz;
+            r.depth += sz;
+        }
+
+        /*  The string ending in this node, if any, comes first. */
+        if (strs [r.lo].size == r.depth) {
+            self->terminal [node / 8] |= 1 << (node % 8);
+            ++r.lo;
+        }
+        if (r.lo == r.hi)
+            continue;
+
+        /*  Add a child for each distinct next character. */
+        if (head > qcap / 2) {
+            memmove (queue, queue + head,
+                (tail - head) * sizeof (struct nn_ctrie_range));
+            tail -= head;
+            head = 0;
+        }
+        while (r.lo != r.hi) {
+            c = strs [r.lo].data [r.depth];
+            for (j = r.lo + 1; j != r.hi && strs [j].data [r.depth] == c; ++j)
+                ;
+            queue = nn_ctrie_grow (queue, &qcap, tail + 1,
+                sizeof (struct nn_ctrie_range));
+            queue [tail].lo = r.lo;
+            queue [tail].hi = j;
+            queue [tail].depth = r.depth + 1;
+            ++tail;
+            nn_assert (self->nodes < UINT32_MAX - 1);
+            nn_ctrie_reserve (self, &ncap, self->nodes + 2);
+            self->labels [self->nodes - 1] = c;
+            ++self->nodes;
+            r.lo = j;
+        }
+    }
+    self->first [self->nodes] = self->nodes - 1;
+    nn_free (queue);
+    nn_free (strs);
+
+    /*  Give back the unused capacity. */
+    self->first = nn_realloc (self->first,
+        (self->nodes + 1) * sizeof (uint32_t));
+    alloc_assert (self->first);
+    self->labels = nn_realloc (self->labels, self->nodes);
+    alloc_assert (self->labels);
+    self->prefixes = nn_realloc (self->prefixes,
+        self->nodes * sizeof (uint32_t));
+    alloc_assert (self->prefixes);
+    self->terminal = nn_realloc (self->terminal, (self->nodes + 7) / 8);
+    alloc_assert (self->terminal);
+    if (self->pool) {
+        self->pool = nn_realloc (self->pool, self->poolsz);
+        alloc_assert (self->pool);
+    }
+
+    return 0;
+}
+
+int nn_ctrie_match (struct nn_ctrie *self, const uint8_t *data, size_t size)
+{
+    uint32_t node;
+    const uint8_t *prefix;
+    size_t len;
+
+    if (!self->nodes)
+        return 0;
+
+    node = 0;
+    while (1) {
+        if (self->prefixes [node]) {
+            prefix = self->pool + self->prefixes [node] - 1;
+            len = nn_gets (prefix);
+            if (len > size || memcmp (prefix + 2, data, len) != 0)
+                return 0;
+            data += len;
+            size -= len;
+        }
+
+        /*  A subscription ending here is a prefix of the string. */
+        if (nn_ctrie_isterminal (self, node))
+            return 1;
+
+        if (!size)
+            return 0;
+        node = nn_ctrie_child (self, node, *data);
+        if (!node)
+            return 0;
+        ++data;
+        --size;
+    }
+}
+
+int nn_ctrie_has (struct nn_ctrie *self, const uint8_t *data, size_t size)
+{
+    uint32_t node;
+    const uint8_t *prefix;
+    size_t len;
+
+    if (!self->nodes)
+        return 0;
+
+    node = 0;
+    while (1) {
+        if (self->prefixes [node]) {
+            prefix = self->pool + self->prefixes [node] - 1;
+            len = nn_gets (prefix);
+            if (len > size || memcmp (prefix + 2, data, len) != 0)
+                return 0;
+            data += len;
+            size -= len;
+        }
+        if (!size)
+            return nn_ctrie_isterminal (self, node);
+        node = nn_ctrie_child (self, node, *data);
+        if (!node)
+            return 0;
+        ++data;
+        --size;
+    }
+}
+
+void nn_ctrie_walk (struct nn_ctrie *self,
+    void (*fn) (void *arg, const uint8_t *data, size_t size), void *arg)
+{
+    struct nn_ctrie_pos *stack;
+    size_t sp;
+    uint8_t *buf;
+    size_t depth;
+    uint32_t node;
+    uint32_t edge;
+    const uint8_t *prefix;
+    size_t len;
+
+    if (!self->nodes)
+        return;
+
+    /*  Each node on the path from the root adds at least one character,
+        except for the root itself. */
+    stack = nn_alloc ((self->maxlen + 1) * sizeof (struct nn_ctrie_pos),
+        "compact trie walk");
+    alloc_assert (stack);
+    buf = nn_alloc (self->maxlen + 1, "compact trie walk");
+    alloc_assert (buf);
+
+    node = 0;
+    depth = 0;
+    sp = 0;
+    while (1) {
+
+        /*  Report the string represented by the node. It precedes all
+            the strings in the subtree. */
+        if (self->prefixes [node]) {
+            prefix = self->pool + self->prefixes [node] - 1;
+            len = nn_gets (prefix);
+            memcpy (buf + depth, prefix + 2, len);
+            depth += len;
+        }
+        if (nn_ctrie_isterminal (self, node))
+            fn (arg, buf, depth);
+        stack [sp].node = node;
+        stack [sp].edge = self->first [node];
+        stack [sp].depth = depth;
+
+        /*  Proceed to the next unvisited child, going up as needed. */
+        while (1) {
+            node = stack [sp].node;
+            edge = stack [sp].edge;
+            if (edge != self->first [node + 1])
+                break;
+            if (!sp)
+                goto done;
+            --sp;
+        }
+        ++stack [sp].edge;
+        depth = stack [sp].depth;
+        buf [depth] = self->labels [edge];
+        node = edge + 1;
+        ++depth;
+        ++sp;
+    }
+
+done:
+    nn_free (buf);
+    nn_free (stack);
+}
+
+size_t nn_ctrie_size (struct nn_ctrie *self)
+{
+    if (!self->nodes)
+        return sizeof (struct nn_ctrie);
+    return sizeof (struct nn_ctrie) +
+        (self->nodes + 1) * sizeof (uint32_t) + self->nodes +
+        self->nodes * sizeof (uint32_t) + (self->nodes + 7) / 8 +
+        self->poolsz;
+}
+
+static int nn_ctrie_cmp (const void *a, const void *b)
+{
+    const struct nn_ctrie_str *x;
+    const struct nn_ctrie_str *y;
+    int rc;
+
+    x = a;
+    y = b;
+    rc = memcmp (x->data, y->data, x->size < y->size ? x->size : y->size);
+    if (rc)
+        return rc;
+    return x->size < y->size ? -1 : (x->size > y->size ? 1 : 0);
+}
+
+static void *nn_ctrie_grow (void *ptr, size_t *capacity, size_t needed,
+    size_t elemsize)
+{
+    if (nn_fast (needed <= *capacity))
+        return ptr;
+    if (!*capacity)
+        *capacity = 64;
+    while (*capacity < needed)
+        *capacity *= 2;
+    ptr = ptr ? nn_realloc (ptr, *capacity * elemsize) :
+        nn_alloc (*capacity * elemsize, "compact trie");
+    alloc_assert (ptr);
+    return ptr;
+}
+
+static void nn_ctrie_reserve (struct nn_ctrie *self, size_t *capacity,
+    size_t needed)
+{
+    size_t oldcap;
+    size_t cap;
+
+    /*  All the per-node arrays have the same capacity. New bytes of the
+        terminal bitmap have to be cleared. */
+    if (nn_fast (needed <= *capacity))
+        return;
+    oldcap = *capacity;
+    self->first = nn_ctrie_grow (self->first, capacity, needed,
+        sizeof (uint32_t));
+    cap = oldcap;
+    self->labels = nn_ctrie_grow (self->labels, &cap, needed, 1);
+    cap = oldcap;
+    self->prefixes = nn_ctrie_grow (self->prefixes, &cap, needed,
+        sizeof (uint32_t));
+    cap = oldcap / 8;
+    self->terminal = nn_ctrie_grow (self->terminal, &cap,
+        *capacity / 8, 1);
+    memset (self->terminal + oldcap / 8, 0, (*capacity - oldcap) / 8);
+}
+
+static uint32_t nn_ctrie_child (struct nn_ctrie *self, uint32_t node,
+    uint8_t c)
+{
+    uint32_t lo;
+    uint32_t hi;
+    const uint8_t *p;
+
+    /*  Returns zero, i.e. the root, if there's no such child. A node has
+        at most 256 edges, memchr scans them faster than a binary search
+        would find the right one. */
+    lo = self->first [node];
+    hi = self->first [node + 1];
+    p = memchr (self->labels + lo, c, hi - lo);
+    return p ? (uint32_t) (p - self->labels) + 1 : 0;
+}
+
+static int nn_ctrie_isterminal (struct nn_ctrie *self, uint32_t node)
+{
+    return self->terminal [node / 8] & (1 << (node % 8)) ? 1 : 0;
+}
@@ -0,0 +1,99 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#ifndef NN_CTRIE_INCLUDED
+#define NN_CTRIE_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*  Compact trie. Unlike nn_trie it can't be modified once built, which
+    allows for a much denser representation: nodes are numbered in
+    breadth-first order so that the children of a node are consecutive,
+    and each node costs a few bytes of flat arrays instead of a full node
+    header with a pointer per child. Sequences of characters without
+    branching, such as the rest of the string once a node covers a single
+    one, are stored in a shared pool of bytes rather than as chains of
+    nodes. It's meant for large sets of subscriptions that are replaced
+    as a whole. */
+
+struct nn_ctrie {
+
+    /*  Number of nodes. Zero if the trie is empty. Node 0 is the root. */
+    uint32_t nodes;
+
+    /*  Edges leading from node i are [first [i], first [i + 1]). The array
+        has nodes + 1 elements. The child node at the end of edge e is
+        node e + 1. */
+    uint32_t *first;
+
+    /*  Character of each edge. Edges leading from a node are sorted. */
+    uint8_t *labels;
+
+    /*  For each node, either zero or one plus the offset of the node's
+        prefix in 'pool'. The prefix is stored as a 16-bit length in network
+        byte order followed by the bytes. The characters of the prefix
+        follow the character of the edge leading to the node and precede
+        the characters of the edges leading from it. */
+    uint32_t *prefixes;
+
+    /*  Bitmap of nodes that represent a subscribed string, i.e. the string
+        ends after the node's prefix. */
+    uint8_t *terminal;
+
+    uint8_t *pool;
+    size_t poolsz;
+
+    /*  Number of strings in the trie and the length of the longest one. */
+    size_t count;
+    size_t maxlen;
+};
+
+/*  Initialise an empty trie. */
+void nn_ctrie_init (struct nn_ctrie *self);
+
+/*  Release all the resources associated with the trie. */
+void nn_ctrie_term (struct nn_ctrie *self);
+
+/*  Replaces the content of the trie by the strings in the buffer. Each
+    string is stored as a 16-bit length in network byte order followed by
+    the bytes of the string. Duplicates are ignored. Returns -EINVAL if the
+    buffer is malformed, in which case the trie is left unchanged. */
+int nn_ctrie_build (struct nn_ctrie *self, const uint8_t *buf, size_t len);
+
+/*  Returns 1 if any of the strings in the trie is a prefix of the supplied
+    string, 0 otherwise. */
+int nn_ctrie_match (struct nn_ctrie *self, const uint8_t *data, size_t size);
+
+/*  Returns 1 if the string is in the trie, 0 otherwise. */
+int nn_ctrie_has (struct nn_ctrie *self, const uint8_t *data, size_t size);
+
+/*  Invokes 'fn' once for each string in the trie, in lexicographic order.
+    The string passed to the callback is valid only for the duration of
+    the call. */
+void nn_ctrie_walk (struct nn_ctrie *self,
+    void (*fn) (void *arg, const uint8_t *data, size_t size), void *arg);
+
+/*  Returns the number of bytes of memory used by the trie. */
+size_t nn_ctrie_size (struct nn_ctrie *self);
+
+#endif
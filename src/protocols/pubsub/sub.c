@@ -28,7 +28,7 @@
 struct nn_socktype nn_sub_socktype = {
     AF_SP,
     NN_SUB,
-    NN_SOCKTYPE_FLAG_NOSEND,
+    NN_SOCKTYPE_FLAG_NOSEND | NN_SOCKTYPE_FLAG_SUBFWD,
     nn_xsub_create,
     nn_xsub_ispeer,
 };
@@ -0,0 +1,233 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#include "topics.h"
+
+#include "../../utils/alloc.h"
+#include "../../utils/fast.h"
+#include "../../utils/err.h"
+
+#include <string.h>
+
+/*  Initial size of the table. */
+#define NN_TOPICS_MIN_SLOTS 16
+
+/*  Private functions. */
+static uint32_t nn_topics_hash (const uint8_t *data, size_t size);
+static struct nn_topics_entry *nn_topics_find (struct nn_topics *self,
+    const uint8_t *data, size_t size, uint32_t hash);
+static void nn_topics_resize (struct nn_topics *self, uint32_t slots);
+
+void nn_topics_init (struct nn_topics *self)
+{
+    self->slots = 0;
+    self->count = 0;
+    self->table = NULL;
+}
+
+void nn_topics_term (struct nn_topics *self)
+{
+    uint32_t i;
+
+    for (i = 0; i != self->slots; ++i)
+        if (self->table [i].hash)
+            nn_free (self->table [i].data);
+    if (self->table)
+        nn_free (self->table);
+}
+
+int nn_topics_subscribe (struct nn_topics *self, const uint8_t *data,
+    size_t size)
+{
+    uint32_t hash;
+    struct nn_topics_entry *entry;
+
+    hash = nn_topics_hash (data, size);
+    entry = nn_topics_find (self, data, size, hash);
+    if (entry && entry->hash) {
+        ++entry->refcount;
+        return 0;
+    }
+
+    /*  Keep the load factor at or below one half. */
+    if ((self->count + 1) * 2 > self->slots) {
+        nn_topics_resize (self, self->slots ? self->slots * 2 :
+            NN_TOPICS_MIN_SLOTS);
+        entry = nn_topics_find (self, data, size, hash);
+    }
+
+    entry->hash = hash;
+    entry->refcount = 1;
+    entry->size = size;
+    entry->val = NULL;
+    entry->data = nn_alloc (size ? size : 1, "topic");
+    alloc_assert (entry->data);
+    memcpy (entry->data, data, size);
+    ++self->count;
+
+    return 1;
+}
+
+int nn_topics_unsubscribe (struct nn_topics *self, const uint8_t *data,
+    size_t size)
+{
+    uint32_t mask;
+    uint32_t i;
+    uint32_t j;
+    uint32_t home;
+    struct nn_topics_entry *entry;
+
+    entry = nn_topics_find (self, data, size, nn_topics_hash (data, size));
+    if (!entry || !entry->hash)
+        return -EINVAL;
+
+    if (--entry->refcount)
+        return 0;
+
+    nn_free (entry->data);
+    --self->count;
+
+    /*  Shift the following entries of the cluster back, so that no entry
+        is separated from its home slot by an empty one. This way there's
+        no need for tombstones. */
+    mask = self->slots - 1;
+    i = (uint32_t) (entry - self->table);
+    j = i;
+    while (1) {
+        j = (j + 1) & mask;
+        if (!self->table [j].hash)
+            break;
+        home = self->table [j].hash & mask;
+        if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+            continue;
+        self->table [i] = self->table [j];
+        i = j;
+    }
+    self->table [i].hash = 0;
+
+    return 1;
+}
+
+int nn_topics_match (struct nn_topics *self, const uint8_t *data,
+    size_t size)
+{
+    struct nn_topics_entry *entry;
+
+    if (!self->count)
+        return 0;
+    entry = nn_topics_find (self, data, size, nn_topics_hash (data, size));
+    return entry->hash ? 1 : 0;
+}
+
+void **nn_topics_value (struct nn_topics *self, const uint8_t *data,
+    size_t size)
+{
+    struct nn_topics_entry *entry;
+
+    if (!self->count)
+        return NULL;
+    entry = nn_topics_find (self, data, size, nn_topics_hash (data, size));
+    return entry->hash ? &entry->val : NULL;
+}
+
+size_t nn_topics_key (int delim, size_t len, const uint8_t *data,
+    size_t size)
+{
+    const uint8_t *pos;
+
+    if (delim >= 0) {
+        pos = memchr (data, delim, size);
+        return pos ? (size_t) (pos - data) + 1 : 0;
+    }
+    return len && size >= len ? len : 0;
+}
+
+void nn_topics_walk (struct nn_topics *self,
+    void (*fn) (void *arg, const uint8_t *data, size_t size), void *arg)
+{
+    uint32_t i;
+
+    for (i = 0; i != self->slots; ++i)
+        if (self->table [i].hash)
+            fn (arg, self->table [i].data, self->table [i].size);
+}
+
+static uint32_t nn_topics_hash (const uint8_t *data, size_t size)
+{
+    uint32_t hash;
+
+    /*  32-bit FNV-1a. Zero is reserved for empty slots. */
+    hash = 2166136261u;
+    while (size--) {
+        hash ^= *data++;
+        hash *= 16777619u;
+    }
+    return hash ? hash : 1;
+}
+
+static struct nn_topics_entry *nn_topics_find (struct nn_topics *self,
+    const uint8_t *data, size_t size, uint32_t hash)
+{
+    uint32_t mask;
+    uint32_t i;
+    struct nn_topics_entry *entry;
+
+    /*  Returns either the entry holding the topic or the empty slot where
+        the topic would be inserted. */
+    if (nn_slow (!self->slots))
+        return NULL;
+    mask = self->slots - 1;
+    for (i = hash & mask; ; i = (i + 1) & mask) {
+        entry = &self->table [i];
+        if (!entry->hash)
+            return entry;
+        if (entry->hash == hash && entry->size == size &&
+              memcmp (entry->data, data, size) == 0)
+            return entry;
+    }
+}
+
+static void nn_topics_resize (struct nn_topics *self, uint32_t slots)
+{
+    uint32_t i;
+    uint32_t j;
+    struct nn_topics_entry *old;
+    uint32_t oldslots;
+
+    old = self->table;
+    oldslots = self->slots;
+    self->table = nn_alloc (slots * sizeof (struct nn_topics_entry),
+        "topics table");
+    alloc_assert (self->table);
+    memset (self->table, 0, slots * sizeof (struct nn_topics_entry));
+    self->slots = slots;
+
+    for (i = 0; i != oldslots; ++i) {
+        if (!old [i].hash)
+            continue;
+        for (j = old [i].hash & (slots - 1); self->table [j].hash;
+              j = (j + 1) & (slots - 1));
+        self->table [j] = old [i];
+    }
+    if (old)
+        nn_free (old);
+}
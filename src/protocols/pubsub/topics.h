@@ -0,0 +1,99 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#ifndef NN_TOPICS_INCLUDED
+#define NN_TOPICS_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*  Set of exact topics. It's an open-addressing hash table with linear
+    probing, used alongside the trie when the subscriptions are full topic
+    names rather than arbitrary prefixes. */
+
+struct nn_topics_entry {
+
+    /*  Hash of the topic. Zero marks an empty slot. */
+    uint32_t hash;
+
+    /*  Number of subscriptions to the topic. */
+    uint32_t refcount;
+
+    size_t size;
+    uint8_t *data;
+
+    /*  Value associated with the topic by the user of the set. */
+    void *val;
+};
+
+struct nn_topics {
+
+    /*  Number of slots in the table, always a power of two, or zero if
+        the table was not allocated yet. */
+    uint32_t slots;
+
+    /*  Number of topics in the table. */
+    uint32_t count;
+
+    struct nn_topics_entry *table;
+};
+
+/*  Initialise an empty set. */
+void nn_topics_init (struct nn_topics *self);
+
+/*  Release all the resources associated with the set. */
+void nn_topics_term (struct nn_topics *self);
+
+/*  Add the topic to the set. If the topic is not yet there, 1 is returned.
+    If it already exists, its reference count is incremented and 0 is
+    returned. */
+int nn_topics_subscribe (struct nn_topics *self, const uint8_t *data,
+    size_t size);
+
+/*  Remove the topic from the set. If the topic was actually removed, 1 is
+    returned. If reference count was decremented without falling to zero,
+    0 is returned. If there's no such topic, -EINVAL is returned. */
+int nn_topics_unsubscribe (struct nn_topics *self, const uint8_t *data,
+    size_t size);
+
+/*  Returns 1 if the topic is in the set, 0 otherwise. */
+int nn_topics_match (struct nn_topics *self, const uint8_t *data,
+    size_t size);
+
+/*  Returns pointer to the value associated with the topic, which is NULL
+    after the topic was added. If the topic is not in the set, NULL is
+    returned. */
+void **nn_topics_value (struct nn_topics *self, const uint8_t *data,
+    size_t size);
+
+/*  Returns length of the topic the message starts with. In delimiter mode
+    ('delim' is not negative), the topic is everything up to and including
+    the first delimiter, otherwise it's the first 'len' bytes. If there's no
+    topic in the message, or neither mode is enabled, zero is returned. */
+size_t nn_topics_key (int delim, size_t len, const uint8_t *data,
+    size_t size);
+
+/*  Invokes 'fn' once for each topic in the set. */
+void nn_topics_walk (struct nn_topics *self,
+    void (*fn) (void *arg, const uint8_t *data, size_t size), void *arg);
+
+#endif
@@ -31,20 +31,59 @@
 
 /*  Double check that the size of node structure is as small as
     we believe it to be. */
-CT_ASSERT (sizeof (struct nn_trie_node) == 24);
+CT_ASSERT (sizeof (struct nn_trie_node) == 32);
+
+/*  Size of the first block of nodes allocated by a trie. Subsequent blocks
+    double in size up to NN_TRIE_BLOCK_MAX. */
+#define NN_TRIE_BLOCK_MIN 512
+#define NN_TRIE_BLOCK_MAX 65536
+
+/*  For each sparse node type, top bits of those bytes of the child array
+    that are in use. */
+static const uint8_t nn_trie_sparse_masks [NN_TRIE_SPARSE_MAX + 1]
+    [NN_TRIE_SPARSE_MAX] = {
+    {0, 0, 0, 0, 0, 0, 0, 0},
+    {0x80, 0, 0, 0, 0, 0, 0, 0},
+    {0x80, 0x80, 0, 0, 0, 0, 0, 0},
+    {0x80, 0x80, 0x80, 0, 0, 0, 0, 0},
+    {0x80, 0x80, 0x80, 0x80, 0, 0, 0, 0},
+    {0x80, 0x80, 0x80, 0x80, 0x80, 0, 0, 0},
+    {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0, 0},
+    {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0},
+    {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80}
+};
+
+struct nn_trie_block {
+    struct nn_trie_block *next;
+
+    /*  Size of the block including the header. It also makes sure the nodes
+        following the header are properly aligned. */
+    size_t size;
+};
 
 /*  Forward declarations. */
-static struct nn_trie_node *nn_node_compact (struct nn_trie_node *self);
+static int nn_trie_class (int slots);
+static size_t nn_trie_class_size (int cls);
+static struct nn_trie_node *nn_trie_alloc_node (struct nn_trie *self,
+    int slots);
+static struct nn_trie_node *nn_trie_realloc_node (struct nn_trie *self,
+    struct nn_trie_node *node, int oldslots, int newslots);
+static void nn_trie_free_node (struct nn_trie *self,
+    struct nn_trie_node *node, int slots);
+static struct nn_trie_node *nn_node_compact (struct nn_trie *trie,
+    struct nn_trie_node *self);
 static int nn_node_check_prefix (struct nn_trie_node *self,
     const uint8_t *data, size_t size);
 static struct nn_trie_node **nn_node_child (struct nn_trie_node *self,
     int index);
 static struct nn_trie_node **nn_node_next (struct nn_trie_node *self,
     uint8_t c);
-static int nn_node_unsubscribe (struct nn_trie_node **self,
-    const uint8_t *data, size_t size);
-static void nn_node_term (struct nn_trie_node *self);
+static int nn_node_unsubscribe (struct nn_trie *trie,
+    struct nn_trie_node **self, const uint8_t *data, size_t size);
 static int nn_node_has_subscribers (struct nn_trie_node *self);
+static void nn_node_walk (struct nn_trie_node *self, uint8_t **buf,
+    size_t *cap, size_t len,
+    void (*fn) (void *arg, const uint8_t *data, size_t size), void *arg);
 static void nn_node_dump (struct nn_trie_node *self, int indent);
 static void nn_node_indent (int indent);
 static void nn_node_putchar (uint8_t c);
@@ -52,11 +91,123 @@ static void nn_node_putchar (uint8_t c);
 void nn_trie_init (struct nn_trie *self)
 {
     self->root = NULL;
+    self->blocks = NULL;
+    self->pos = NULL;
+    self->left = 0;
+    self->blocksize = NN_TRIE_BLOCK_MIN / 2;
+    memset (self->freelist, 0, sizeof (self->freelist));
 }
 
 void nn_trie_term (struct nn_trie *self)
 {
-    nn_node_term (self->root);
+    struct nn_trie_block *block;
+
+    /*  All the nodes live in the blocks, no need to traverse the trie. */
+    while (self->blocks) {
+        block = self->blocks;
+        self->blocks = block->next;
+        nn_free (block);
+    }
+    self->root = NULL;
+}
+
+size_t nn_trie_size (struct nn_trie *self)
+{
+    size_t size;
+    struct nn_trie_block *block;
+
+    size = sizeof (struct nn_trie);
+    for (block = self->blocks; block; block = block->next)
+        size += block->size;
+    return size;
+}
+
+static int nn_trie_class (int slots)
+{
+    int cls;
+
+    cls = 0;
+    while (slots > (cls ? 1 << (cls - 1) : 0))
+        ++cls;
+    nn_assert (cls < NN_TRIE_CLASSES);
+    return cls;
+}
+
+static size_t nn_trie_class_size (int cls)
+{
+    return sizeof (struct nn_trie_node) +
+        (cls ? 1 << (cls - 1) : 0) * sizeof (struct nn_trie_node*);
+}
+
+static struct nn_trie_node *nn_trie_alloc_node (struct nn_trie *self,
+    int slots)
+{
+    int cls;
+    size_t sz;
+    struct nn_trie_node *node;
+    struct nn_trie_block *block;
+
+    /*  Reuse a previously freed node of the same class, if possible. */
+    cls = nn_trie_class (slots);
+    if (self->freelist [cls]) {
+        node = self->freelist [cls];
+        self->freelist [cls] = *(void**) node;
+        goto done;
+    }
+
+    /*  Carve the node from the current block, allocating a new block if
+        there's not enough space left. The rest of the old block is
+        abandoned. */
+    sz = nn_trie_class_size (cls);
+    if (nn_slow (self->left < sz)) {
+        if (self->blocksize < NN_TRIE_BLOCK_MAX)
+            self->blocksize *= 2;
+        while (self->blocksize - sizeof (struct nn_trie_block) < sz)
+            self->blocksize *= 2;
+        block = nn_alloc (self->blocksize, "trie nodes");
+        alloc_assert (block);
+        block->next = self->blocks;
+        block->size = self->blocksize;
+        self->blocks = block;
+        self->pos = (uint8_t*) (block + 1);
+        self->left = self->blocksize - sizeof (struct nn_trie_block);
+    }
+    node = (struct nn_trie_node*) self->pos;
+    self->pos += sz;
+    self->left -= sz;
+
+done:
+    /*  Unused bytes of the sparse child array take part in the lookup
+        (see nn_node_next), keep them defined. */
+    memset (&node->u, 0, sizeof (node->u));
+    return node;
+}
+
+static struct nn_trie_node *nn_trie_realloc_node (struct nn_trie *self,
+    struct nn_trie_node *node, int oldslots, int newslots)
+{
+    struct nn_trie_node *newnode;
+
+    /*  Most of the resizing happens within the same size class. */
+    if (nn_trie_class (oldslots) == nn_trie_class (newslots))
+        return node;
+
+    newnode = nn_trie_alloc_node (self, newslots);
+    memcpy (newnode, node, sizeof (struct nn_trie_node) +
+        (oldslots < newslots ? oldslots : newslots) *
+        sizeof (struct nn_trie_node*));
+    nn_trie_free_node (self, node, oldslots);
+    return newnode;
+}
+
+static void nn_trie_free_node (struct nn_trie *self,
+    struct nn_trie_node *node, int slots)
+{
+    int cls;
+
+    cls = nn_trie_class (slots);
+    *(void**) node = self->freelist [cls];
+    self->freelist [cls] = node;
 }
 
 void nn_trie_dump (struct nn_trie *self)
@@ -134,25 +285,6 @@ void nn_node_putchar (uint8_t c)
         putchar (c);
 }
 
-void nn_node_term (struct nn_trie_node *self)
-{
-    int children;
-    int i;
-
-    /*  Trivial case of the recursive algorithm. */
-    if (!self)
-        return;
-
-    /*  Recursively destroy the child nodes. */
-    children = self->type <= NN_TRIE_SPARSE_MAX ?
-        self->type : (self->u.dense.max - self->u.dense.min + 1);
-    for (i = 0; i != children; ++i)
-        nn_node_term (*nn_node_child (self, i));
-
-    /*  Deallocate this node. */
-    nn_free (self);
-}
-
 int nn_node_check_prefix (struct nn_trie_node *self,
     const uint8_t *data, size_t size)
 {
@@ -160,6 +292,11 @@ int nn_node_check_prefix (struct nn_trie_node *self,
 
     int i;
 
+    /*  Fast path: the whole prefix matches. */
+    if (nn_fast (size >= self->prefix_len &&
+          memcmp (self->prefix, data, self->prefix_len) == 0))
+        return self->prefix_len;
+
     for (i = 0; i != self->prefix_len; ++i) {
         if (!size || self->prefix [i] != *data)
             return i;
@@ -182,16 +319,34 @@ struct nn_trie_node **nn_node_next (struct nn_trie_node *self, uint8_t c)
         If there is no such pointer, it returns NULL. */
 
     int i;
+    uint64_t children;
+    uint64_t mask;
 
     if (self->type == 0)
         return NULL;
 
-    /*  Sparse mode. */
-    if (self->type <= 8) {
+    /*  Sparse mode. All the children are compared with the character at
+        once: the bytes equal to 'c' become zero after the XOR and the
+        subsequent expression sets the top bit of each zero byte. The unused
+        bytes of the array are masked out. Byte ordering doesn't matter for
+        the result being zero or non-zero. */
+    if (self->type <= NN_TRIE_SPARSE_MAX) {
+        memcpy (&children, self->u.sparse.children, sizeof (children));
+        memcpy (&mask, nn_trie_sparse_masks [self->type], sizeof (mask));
+        children ^= 0x0101010101010101ULL * c;
+        if (!((children - 0x0101010101010101ULL) & ~children & mask))
+            return NULL;
+#if defined __GNUC__ && defined __BYTE_ORDER__ && \
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        i = __builtin_ctzll ((children - 0x0101010101010101ULL) &
+            ~children & mask) / 8;
+        return nn_node_child (self, i);
+#else
         for (i = 0; i != self->type; ++i)
             if (self->u.sparse.children [i] == c)
                 return nn_node_child (self, i);
         return NULL;
+#endif
     }
 
     /*  Dense mode. */
@@ -200,7 +355,8 @@ struct nn_trie_node **nn_node_next (struct nn_trie_node *self, uint8_t c)
     return nn_node_child (self, c - self->u.dense.min);
 }
 
-struct nn_trie_node *nn_node_compact (struct nn_trie_node *self)
+struct nn_trie_node *nn_node_compact (struct nn_trie *trie,
+    struct nn_trie_node *self)
 {
     /*  Tries to merge the node with the child node. Returns pointer to
         the compacted node. */
@@ -227,7 +383,7 @@ struct nn_trie_node *nn_node_compact (struct nn_trie_node *self)
     ch->prefix_len += self->prefix_len + 1;
 
     /*  Get rid of the obsolete parent node. */
-    nn_free (self);
+    nn_trie_free_node (trie, self, 1);
 
     /*  Return the new compacted node. */
     return ch;
@@ -286,9 +442,7 @@ int nn_trie_subscribe (struct nn_trie *self, const uint8_t *data, size_t size)
 step2:
 
     ch = *node;
-    *node = nn_alloc (sizeof (struct nn_trie_node) +
-        sizeof (struct nn_trie_node*), "trie node");
-    assert (*node);
+    *node = nn_trie_alloc_node (self, 1);
     (*node)->refcount = 0;
     (*node)->prefix_len = pos;
     (*node)->type = 1;
@@ -296,7 +450,7 @@ step2:
     (*node)->u.sparse.children [0] = ch->prefix [pos];
     ch->prefix_len -= (pos + 1);
     memmove (ch->prefix, ch->prefix + pos + 1, ch->prefix_len);
-    ch = nn_node_compact (ch);
+    ch = nn_node_compact (self, ch);
     *nn_node_child (*node, 0) = ch;
 
     /*  Step 3 -- Adjust the child array to accommodate the new character. */
@@ -309,9 +463,8 @@ step3:
 
     /*  If the new branch fits into sparse array... */
     if ((*node)->type < NN_TRIE_SPARSE_MAX) {
-        *node = nn_realloc (*node, sizeof (struct nn_trie_node) +
-            ((*node)->type + 1) * sizeof (struct nn_trie_node*));
-        assert (*node);
+        *node = nn_trie_realloc_node (self, *node, (*node)->type,
+            (*node)->type + 1);
         (*node)->u.sparse.children [(*node)->type] = *data;
         ++(*node)->type;
         node = nn_node_child (*node, (*node)->type - 1);
@@ -328,11 +481,10 @@ step3:
         if (c < (*node)->u.dense.min || c > (*node)->u.dense.max) {
             new_min = (*node)->u.dense.min < c ? (*node)->u.dense.min : c;
             new_max = (*node)->u.dense.max > c ? (*node)->u.dense.max : c;
-            *node = nn_realloc (*node, sizeof (struct nn_trie_node) +
-                (new_max - new_min + 1) * sizeof (struct nn_trie_node*));
-            assert (*node);
             old_children = (*node)->u.dense.max - (*node)->u.dense.min + 1;
             new_children = new_max - new_min + 1;
+            *node = nn_trie_realloc_node (self, *node, old_children,
+                new_children);
             if ((*node)->u.dense.min != new_min) {
                 inserted = (*node)->u.dense.min - new_min;
                 memmove (nn_node_child (*node, inserted),
@@ -373,13 +525,10 @@ step3:
 
         /*  Create a new mode, while keeping the old one for a while. */
         old_node = *node;
-        *node = (struct nn_trie_node*) nn_alloc (sizeof (struct nn_trie_node) +
-            (new_max - new_min + 1) * sizeof (struct nn_trie_node*),
-            "trie node");
-        assert (*node);
+        *node = nn_trie_alloc_node (self, new_max - new_min + 1);
 
         /*  Fill in the new node. */
-        (*node)->refcount = 0;
+        (*node)->refcount = old_node->refcount;
         (*node)->prefix_len = old_node->prefix_len;
         (*node)->type = NN_TRIE_DENSE_TYPE;
         memcpy ((*node)->prefix, old_node->prefix, old_node->prefix_len);
@@ -396,7 +545,7 @@ step3:
         --size;
 
         /*  Get rid of the obsolete old node. */
-        nn_free (old_node);
+        nn_trie_free_node (self, old_node, old_node->type);
     }
 
     /*  Step 4 -- Create new nodes for remaining part of the subscription. */
@@ -407,9 +556,7 @@ step4:
 
         /*  Create a new node to hold the next part of the subscription. */
         more_nodes = size > NN_TRIE_PREFIX_MAX;
-        *node = nn_alloc (sizeof (struct nn_trie_node) +
-            (more_nodes ? sizeof (struct nn_trie_node*) : 0), "trie node");
-        assert (*node);
+        *node = nn_trie_alloc_node (self, more_nodes ? 1 : 0);
 
         /*  Fill in the new node. */
         (*node)->refcount = 0;
@@ -461,6 +608,10 @@ int nn_trie_match (struct nn_trie *self, const uint8_t *data, size_t size)
         if (nn_node_has_subscribers (node))
             return 1;
 
+        /*  The string is exhausted before reaching any subscription. */
+        if (!size)
+            return 0;
+
         /*  Move to the next node. */
         tmp = nn_node_next (node, *data);
         node = tmp ? *tmp : NULL;
@@ -469,26 +620,99 @@ int nn_trie_match (struct nn_trie *self, const uint8_t *data, size_t size)
     }
 }
 
+void nn_trie_match_batch (struct nn_trie *self, int count,
+    const uint8_t **data, const size_t *size, int *results)
+{
+    int i;
+    int j;
+    int n;
+    int active;
+    int idx [NN_TRIE_BATCH];
+    struct nn_trie_node *nodes [NN_TRIE_BATCH];
+    const uint8_t *d [NN_TRIE_BATCH];
+    size_t s [NN_TRIE_BATCH];
+    struct nn_trie_node *node;
+    struct nn_trie_node **tmp;
+
+    for (i = 0; i != count; ++i)
+        results [i] = 0;
+    if (!self->root)
+        return;
+
+    /*  Up to NN_TRIE_BATCH strings are in progress at any time and each
+        of them is advanced by one node per round. The next node is
+        prefetched so that by the time the loop gets back to the string
+        it's hopefully already in the cache. When a string is done, its
+        place is taken by the next one. The steps are the same as in
+        nn_trie_match. */
+    n = 0;
+    active = 0;
+    while (1) {
+        while (active != NN_TRIE_BATCH && n != count) {
+            idx [active] = n;
+            nodes [active] = self->root;
+            d [active] = data [n];
+            s [active] = size [n];
+            ++active;
+            ++n;
+        }
+        if (!active)
+            return;
+        for (j = 0; j < active; ++j) {
+            node = nodes [j];
+            if (nn_node_check_prefix (node, d [j], s [j]) != node->prefix_len)
+                goto done;
+            d [j] += node->prefix_len;
+            s [j] -= node->prefix_len;
+            if (nn_node_has_subscribers (node)) {
+                results [idx [j]] = 1;
+                goto done;
+            }
+            if (!s [j])
+                goto done;
+            tmp = nn_node_next (node, *d [j]);
+            if (!tmp || !*tmp)
+                goto done;
+            ++d [j];
+            --s [j];
+            nodes [j] = *tmp;
+            nn_prefetch (*tmp);
+            continue;
+done:
+            /*  Move the last string in progress to this slot. */
+            --active;
+            idx [j] = idx [active];
+            nodes [j] = nodes [active];
+            d [j] = d [active];
+            s [j] = s [active];
+            --j;
+        }
+    }
+}
+
 int nn_trie_unsubscribe (struct nn_trie *self, const uint8_t *data, size_t size)
 {
-    return nn_node_unsubscribe (&self->root, data, size);
+    return nn_node_unsubscribe (self, &self->root, data, size);
 }
 
-static int nn_node_unsubscribe (struct nn_trie_node **self,
-    const uint8_t *data, size_t size)
+static int nn_node_unsubscribe (struct nn_trie *trie,
+    struct nn_trie_node **self, const uint8_t *data, size_t size)
 {
     int i;
     int j;
+    int rc;
     int index;
     int new_min;
+    int old_children;
     struct nn_trie_node **ch;
     struct nn_trie_node *new_node;
     struct nn_trie_node *ch2;
 
-    if (!size)
-        goto found;
+    if (nn_slow (!*self))
+        return -EINVAL;
 
-    /*  If prefix does not match the data, return. */
+    /*  If prefix does not match the data, return. This also covers the case
+        of the subscription ending in the middle of the prefix. */
     if (nn_node_check_prefix (*self, data, size) != (*self)->prefix_len)
         return 0;
 
@@ -507,8 +731,9 @@ static int nn_node_unsubscribe (struct nn_trie_node **self,
     /*  Recursive traversal of the trie happens here. If the subscription
         wasn't really removed, nothing have changed in the trie and
         no additional pruning is needed. */
-    if (nn_node_unsubscribe (ch, data + 1, size - 1) == 0)
-        return 0;
+    rc = nn_node_unsubscribe (trie, ch, data + 1, size - 1);
+    if (rc <= 0)
+        return rc;
 
     /*  Subscription removal is already done. Now we are going to compact
         the trie. However, if the following node remains in place, there's
@@ -535,20 +760,19 @@ static int nn_node_unsubscribe (struct nn_trie_node **self,
             nn_node_child (*self, index + 1),
             ((*self)->type - index - 1) * sizeof (struct nn_trie_node*));
         --(*self)->type;
-        *self = nn_realloc (*self, sizeof (struct nn_trie_node) +
-            ((*self)->type * sizeof (struct nn_trie_node*)));
-        assert (*self);
-        
+        *self = nn_trie_realloc_node (trie, *self, (*self)->type + 1,
+            (*self)->type);
+
         /*  If there are no more children and no refcount, we can delete
             the node altogether. */
         if (!(*self)->type && !nn_node_has_subscribers (*self)) {
-            nn_free (*self);
+            nn_trie_free_node (trie, *self, 0);
             *self = NULL;
             return 1;
         }
 
         /*  Try to merge the node with the following node. */
-        *self = nn_node_compact (*self);
+        *self = nn_node_compact (trie, *self);
 
         return 1;
     }
@@ -562,8 +786,8 @@ static int nn_node_unsubscribe (struct nn_trie_node **self,
         /*  If the removed item is the leftmost one, trim the array from
             the left side. */
         if (*data == (*self)->u.dense.min) {
-             for (i = 0; i != (*self)->u.dense.max - (*self)->u.dense.min + 1;
-                   ++i)
+             old_children = (*self)->u.dense.max - (*self)->u.dense.min + 1;
+             for (i = 0; i != old_children; ++i)
                  if (*nn_node_child (*self, i))
                      break;
              new_min = i + (*self)->u.dense.min;
@@ -572,25 +796,22 @@ static int nn_node_unsubscribe (struct nn_trie_node **self,
                  sizeof (struct nn_trie_node*));
              (*self)->u.dense.min = new_min;
              --(*self)->u.dense.nbr;
-             *self = nn_realloc (*self, sizeof (struct nn_trie_node) +
-                 ((*self)->u.dense.max - new_min + 1) *
-                 sizeof (struct nn_trie_node*));
-             assert (*self);
+             *self = nn_trie_realloc_node (trie, *self, old_children,
+                 (*self)->u.dense.max - new_min + 1);
              return 1;
         }
 
         /*  If the removed item is the rightmost one, trim the array from
             the right side. */
         if (*data == (*self)->u.dense.max) {
+             old_children = (*self)->u.dense.max - (*self)->u.dense.min + 1;
              for (i = (*self)->u.dense.max - (*self)->u.dense.min; i != 0; --i)
                  if (*nn_node_child (*self, i))
                      break;
              (*self)->u.dense.max = i + (*self)->u.dense.min;
              --(*self)->u.dense.nbr;
-             *self = nn_realloc (*self, sizeof (struct nn_trie_node) +
-                 ((*self)->u.dense.max - (*self)->u.dense.min + 1) *
-                 sizeof (struct nn_trie_node*));
-             assert (*self);
+             *self = nn_trie_realloc_node (trie, *self, old_children,
+                 (*self)->u.dense.max - (*self)->u.dense.min + 1);
              return 1;
         }
 
@@ -601,10 +822,8 @@ static int nn_node_unsubscribe (struct nn_trie_node **self,
 
     /*  Convert dense array into sparse array. */
     {
-        new_node = nn_alloc (sizeof (struct nn_trie_node) +
-            NN_TRIE_SPARSE_MAX * sizeof (struct nn_trie_node*), "trie node");
-        assert (new_node);
-        new_node->refcount = 0;
+        new_node = nn_trie_alloc_node (trie, NN_TRIE_SPARSE_MAX);
+        new_node->refcount = (*self)->refcount;
         new_node->prefix_len = (*self)->prefix_len;
         memcpy (new_node->prefix, (*self)->prefix, new_node->prefix_len);
         new_node->type = NN_TRIE_SPARSE_MAX;
@@ -619,7 +838,8 @@ static int nn_node_unsubscribe (struct nn_trie_node **self,
             }
         }
         assert (j == NN_TRIE_SPARSE_MAX);
-        nn_free (*self);
+        nn_trie_free_node (trie, *self,
+            (*self)->u.dense.max - (*self)->u.dense.min + 1);
         *self = new_node;
         return 1;
     }
@@ -641,19 +861,70 @@ found:
 
         /*  If there are no children, we can delete the node altogether. */
         if (!(*self)->type) {
-            nn_free (*self);
+            nn_trie_free_node (trie, *self, 0);
             *self = NULL;
             return 1;
         }
 
         /*  Try to merge the node with the following node. */
-        *self = nn_node_compact (*self);
+        *self = nn_node_compact (trie, *self);
         return 1;
     }
 
     return 0;
 }
 
+void nn_trie_walk (struct nn_trie *self,
+    void (*fn) (void *arg, const uint8_t *data, size_t size), void *arg)
+{
+    uint8_t *buf;
+    size_t cap;
+
+    if (!self->root)
+        return;
+
+    cap = 64;
+    buf = nn_alloc (cap, "trie walk buffer");
+    alloc_assert (buf);
+    nn_node_walk (self->root, &buf, &cap, 0, fn, arg);
+    nn_free (buf);
+}
+
+static void nn_node_walk (struct nn_trie_node *self, uint8_t **buf,
+    size_t *cap, size_t len,
+    void (*fn) (void *arg, const uint8_t *data, size_t size), void *arg)
+{
+    int i;
+    int children;
+    struct nn_trie_node *child;
+
+    /*  Make sure there's enough space for the prefix and one more character
+        identifying the child node. */
+    if (nn_slow (len + self->prefix_len + 1 > *cap)) {
+        *cap *= 2;
+        *buf = nn_realloc (*buf, *cap);
+        alloc_assert (*buf);
+    }
+
+    /*  The string represented by this node is the string of the parent node
+        followed by the prefix. */
+    memcpy (*buf + len, self->prefix, self->prefix_len);
+    len += self->prefix_len;
+    if (nn_node_has_subscribers (self))
+        fn (arg, *buf, len);
+
+    children = self->type <= NN_TRIE_SPARSE_MAX ? self->type :
+        self->u.dense.max - self->u.dense.min + 1;
+    for (i = 0; i != children; ++i) {
+        child = *nn_node_child (self, i);
+        if (!child)
+            continue;
+        (*buf) [len] = self->type <= NN_TRIE_SPARSE_MAX ?
+            self->u.sparse.children [i] : (uint8_t) (self->u.dense.min + i);
+        nn_node_walk (child, buf, cap, len + 1, fn, arg);
+    }
+}
+
 int nn_node_has_subscribers (struct nn_trie_node *node)
 {
     /*  Returns 1 when there are no subscribers associated with the node. */
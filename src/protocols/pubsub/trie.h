@@ -28,8 +28,9 @@
 
 /*  This class implements highly memory-efficient patricia trie. */
 
-/* Maximum length of the prefix. */
-#define NN_TRIE_PREFIX_MAX 10
+/* Maximum length of the prefix. Chosen so that the node header fills
+   32 bytes, i.e. two headers per cache line. */
+#define NN_TRIE_PREFIX_MAX 18
 
 /* Maximum number of children in the sparse mode. */
 #define NN_TRIE_SPARSE_MAX 8
@@ -84,11 +85,29 @@ struct nn_trie_node
 };
 /*  The structure is followed by the array of pointers to children. */
 
+/*  Nodes are allocated in size classes according to the number of child
+    pointers they can hold: 0, 1, 2, 4, ... 256. */
+#define NN_TRIE_CLASSES 10
+
+/*  Maximum number of strings nn_trie_match_batch works on simultaneously. */
+#define NN_TRIE_BATCH 8
+
+struct nn_trie_block;
+
 struct nn_trie {
 
     /*  The root node of the trie (representing the empty subscription). */
     struct nn_trie_node *root;
 
+    /*  Nodes are carved out of larger blocks owned by the trie rather than
+        allocated individually, so that the nodes of a single trie are close
+        to each other in memory. Blocks are released only when the trie is
+        terminated; freed nodes are kept on per-class free lists. */
+    struct nn_trie_block *blocks;
+    uint8_t *pos;
+    size_t left;
+    size_t blocksize;
+    void *freelist [NN_TRIE_CLASSES];
 };
 
 /*  Initialise an empty trie. */
@@ -112,6 +131,22 @@ int nn_trie_unsubscribe (struct nn_trie *self, const uint8_t *data,
     it returns 0. */
 int nn_trie_match (struct nn_trie *self, const uint8_t *data, size_t size);
 
+/*  Checks 'count' strings at once and stores 1 or 0 to the corresponding
+    element of 'results'. The strings are matched in an interleaved manner,
+    so that the memory accesses needed by one of them are overlapped with
+    the work on the others. */
+void nn_trie_match_batch (struct nn_trie *self, int count,
+    const uint8_t **data, const size_t *size, int *results);
+
+/*  Invokes 'fn' once for each string subscribed to in the trie, regardless
+    of its reference count. The string passed to the callback is valid only
+    for the duration of the call. */
+void nn_trie_walk (struct nn_trie *self,
+    void (*fn) (void *arg, const uint8_t *data, size_t size), void *arg);
+
+/*  Returns the number of bytes of memory used by the trie. */
+size_t nn_trie_size (struct nn_trie *self);
+
 /*  Debugging interface. */
 void nn_trie_dump (struct nn_trie *self);
 
@@ -22,6 +22,8 @@
 */
 
 #include "xpub.h"
+#include "trie.h"
+#include "topics.h"
 
 #include "../../nn.h"
 #include "../../pubsub.h"
@@ -33,11 +35,72 @@
 #include "../../utils/fast.h"
 #include "../../utils/alloc.h"
 #include "../../utils/attr.h"
+#include "../../utils/list.h"
+#include "../../utils/clock.h"
 
 #include <stddef.h>
+#include <string.h>
+
+/*  The most recent message sent to a topic. The entries are kept in the
+    order of their last update, so the stalest one is evicted first. */
+struct nn_xpub_lvc {
+    struct nn_list_item item;
+    struct nn_msg msg;
+
+    /*  Length of the topic, which is the beginning of the message. */
+    size_t topic;
+};
+
+/*  Message waiting for the pipe to become writable. There's at most one
+    per topic, newer messages replace the older ones. Messages kept by the
+    drop-oldest policy have no topic and are not indexed. */
+struct nn_xpub_pending {
+    struct nn_list_item item;
+
+    /*  Length of the topic, which is the beginning of the message, or zero
+        if the message is in the backlog of the drop-oldest policy. */
+    size_t topic;
+
+    /*  If set, the message is taken from the last-value cache only when
+        it's being sent, so that the pipe gets the latest one even if the
+        topic was updated in the meantime. Otherwise the message is stored
+        in 'msg'. */
+    struct nn_xpub_lvc *lvc;
+    struct nn_msg msg;
+};
 
 struct nn_xpub_data {
     struct nn_dist_data item;
+
+    /*  If the subscriber forwards its subscriptions, only messages matching
+        this trie are sent to it. Otherwise it gets all the messages and
+        the trie is unused. */
+    int filtered;
+    struct nn_trie trie;
+
+    /*  Cached and conflated messages yet to be sent to this pipe, in the
+        order of their topics' arrival, and the same indexed by topic. */
+    struct nn_list pending;
+    struct nn_topics pendindex;
+
+    /*  Number of pending messages without a topic. */
+    int backlog;
+
+    /*  Messages dropped for this pipe since it was attached, and since it
+        last caught up. */
+    int drops;
+    int slowdrops;
+
+    /*  When the pipe first failed to get a message since it last caught up,
+        or zero. */
+    uint64_t since;
+
+    /*  1 if the pipe is to be disconnected, -1 if it should have been but
+        the transport doesn't support that. */
+    int evict;
+
+    /*  Member of nn_xpub::pipes list. */
+    struct nn_list_item pipe;
 };
 
 struct nn_xpub {
@@ -47,12 +110,68 @@ struct nn_xpub {
 
     /*  Distributor. */
     struct nn_dist outpipes;
+
+    /*  All the attached pipes, whether ready for sending or not. */
+    struct nn_list pipes;
+
+    /*  Number of pipes with subscription forwarding enabled. As long as there
+        are none, messages are sent to all the pipes without matching. */
+    int filtered;
+
+    /*  How to find the topic of a message. Same as on the SUB socket, the
+        topic either ends with 'topic_delim' or has 'topic_len' bytes. */
+    int topic_delim;
+    size_t topic_len;
+
+    /*  Last-value cache. If enabled, the latest message of each topic is
+        kept and replayed to the subscribers that connect later on. At most
+        'lvcsize' topics are cached. */
+    int lvc;
+    int lvcsize;
+    int lvccount;
+    struct nn_topics lvcindex;
+    struct nn_list lvcs;
+
+    /*  If set, pipes that can't accept a message keep the latest one per
+        topic instead of dropping them all. */
+    int conflate;
+
+    /*  What to do with the messages a pipe can't accept (NN_PUB_SLOW_*
+        constants) and how many of them to keep with NN_PUB_SLOW_DROP_OLDEST.
+        The pipe is disconnected once it loses more than 'maxdrops' messages
+        in a row or stays behind for more than 'maxlag' milliseconds. Negative
+        values mean no limit. */
+    int policy;
+    int backlog;
+    int maxdrops;
+    int maxlag;
+
+    /*  Set if some of the pipes are to be disconnected. */
+    int evict;
+
+    /*  The highest 'drops' value among the attached pipes. */
+    int worst;
 };
 
 /*  Private functions. */
 static void nn_xpub_init (struct nn_xpub *self,
     const struct nn_sockbase_vfptr *vfptr, void *hint);
 static void nn_xpub_term (struct nn_xpub *self);
+static void nn_xpub_cache (struct nn_xpub *self, struct nn_msg *msg);
+static void nn_xpub_cache_rm (struct nn_xpub *self, struct nn_xpub_lvc *lvc);
+static void nn_xpub_cache_clear (struct nn_xpub *self);
+static void nn_xpub_blocked (struct nn_xpub *self, struct nn_msg *msg);
+static void nn_xpub_conflate (struct nn_xpub_data *data, struct nn_msg *msg,
+    size_t len);
+static void nn_xpub_dropped (struct nn_xpub *self, struct nn_xpub_data *data);
+static void nn_xpub_evict (struct nn_xpub *self);
+static void nn_xpub_replay_subscribe (struct nn_xpub *self,
+    struct nn_xpub_data *data, const uint8_t *topic, size_t size);
+static struct nn_xpub_pending *nn_xpub_pending_add (
+    struct nn_xpub_data *data, const uint8_t *topic, size_t size);
+static void nn_xpub_pending_rm (struct nn_xpub_data *data,
+    struct nn_xpub_pending *pending);
+static void nn_xpub_flush (struct nn_xpub *self, struct nn_xpub_data *data);
 
 /*  Implementation of nn_sockbase's virtual functions. */
 static void nn_xpub_destroy (struct nn_sockbase *self);
@@ -62,6 +181,12 @@ static void nn_xpub_in (struct nn_sockbase *self, struct nn_pipe *pipe);
 static void nn_xpub_out (struct nn_sockbase *self, struct nn_pipe *pipe);
 static int nn_xpub_events (struct nn_sockbase *self);
 static int nn_xpub_send (struct nn_sockbase *self, struct nn_msg *msg);
+static int nn_xpub_setopt (struct nn_sockbase *self, int level, int option,
+    const void *optval, size_t optvallen);
+static int nn_xpub_getopt (struct nn_sockbase *self, int level, int option,
+    void *optval, size_t *optvallen);
+static int nn_xpub_filter (struct nn_dist_data *item, struct nn_msg *msg,
+    void *arg);
 static const struct nn_sockbase_vfptr nn_xpub_sockbase_vfptr = {
     NULL,
     nn_xpub_destroy,
@@ -72,6 +197,11 @@ static const struct nn_sockbase_vfptr nn_xpub_sockbase_vfptr = {
     nn_xpub_events,
     nn_xpub_send,
     NULL,
+    nn_xpub_setopt,
+    nn_xpub_getopt,
+    NULL,
+    NULL,
+    NULL,
     NULL,
     NULL
 };
@@ -81,10 +211,30 @@ static void nn_xpub_init (struct nn_xpub *self,
 {
     nn_sockbase_init (&self->sockbase, vfptr, hint);
     nn_dist_init (&self->outpipes);
+    nn_list_init (&self->pipes);
+    self->filtered = 0;
+    self->topic_delim = -1;
+    self->topic_len = 0;
+    self->lvc = 0;
+    self->lvcsize = 1024;
+    self->lvccount = 0;
+    nn_topics_init (&self->lvcindex);
+    nn_list_init (&self->lvcs);
+    self->conflate = 0;
+    self->policy = NN_PUB_SLOW_DROP_NEW;
+    self->backlog = 64;
+    self->maxdrops = -1;
+    self->maxlag = -1;
+    self->evict = 0;
+    self->worst = 0;
 }
 
 static void nn_xpub_term (struct nn_xpub *self)
 {
+    nn_xpub_cache_clear (self);
+    nn_list_term (&self->lvcs);
+    nn_topics_term (&self->lvcindex);
+    nn_list_term (&self->pipes);
     nn_dist_term (&self->outpipes);
     nn_sockbase_term (&self->sockbase);
 }
@@ -103,14 +253,44 @@ static int nn_xpub_add (struct nn_sockbase *self, struct nn_pipe *pipe)
 {
     struct nn_xpub *xpub;
     struct nn_xpub_data *data;
+    struct nn_list_item *it;
+    struct nn_xpub_lvc *lvc;
+    struct nn_xpub_pending *pending;
 
     xpub = nn_cont (self, struct nn_xpub, sockbase);
 
     data = nn_alloc (sizeof (struct nn_xpub_data), "pipe data (pub)");
     alloc_assert (data);
+    data->filtered = nn_pipe_caps (pipe) & NN_PIPE_CAP_SUBFWD ? 1 : 0;
+    nn_trie_init (&data->trie);
+    if (data->filtered)
+        ++xpub->filtered;
     nn_dist_add (&xpub->outpipes, &data->item, pipe);
+    nn_list_init (&data->pending);
+    nn_topics_init (&data->pendindex);
+    data->backlog = 0;
+    data->drops = 0;
+    data->slowdrops = 0;
+    data->since = 0;
+    data->evict = 0;
+    nn_list_item_init (&data->pipe);
+    nn_list_insert (&xpub->pipes, &data->pipe, nn_list_end (&xpub->pipes));
     nn_pipe_setdata (pipe, data);
 
+    /*  A subscriber that doesn't forward its subscriptions gets the whole
+        cache. Otherwise the cached messages are replayed as the matching
+        subscriptions arrive. Either way, they are sent once the pipe
+        becomes writable. */
+    if (!data->filtered) {
+        for (it = nn_list_begin (&xpub->lvcs); it != nn_list_end (&xpub->lvcs);
+              it = nn_list_next (&xpub->lvcs, it)) {
+            lvc = nn_cont (it, struct nn_xpub_lvc, item);
+            pending = nn_xpub_pending_add (data,
+                nn_chunkref_data (&lvc->msg.body), lvc->topic);
+            pending->lvc = lvc;
+        }
+    }
+
     return 0;
 }
 
@@ -118,20 +298,74 @@ static void nn_xpub_rm (struct nn_sockbase *self, struct nn_pipe *pipe)
 {
     struct nn_xpub *xpub;
     struct nn_xpub_data *data;
+    struct nn_list_item *it;
+    struct nn_xpub_data *other;
 
     xpub = nn_cont (self, struct nn_xpub, sockbase);
     data = nn_pipe_getdata (pipe);
 
+    while (!nn_list_empty (&data->pending))
+        nn_xpub_pending_rm (data, nn_cont (nn_list_begin (&data->pending),
+            struct nn_xpub_pending, item));
+    nn_topics_term (&data->pendindex);
+    nn_list_term (&data->pending);
+    nn_list_erase (&xpub->pipes, &data->pipe);
+    nn_list_item_term (&data->pipe);
     nn_dist_rm (&xpub->outpipes, &data->item);
+    if (data->filtered)
+        --xpub->filtered;
+    nn_trie_term (&data->trie);
+
+    /*  If this was the worst of the subscribers, find the next one. */
+    if (data->drops && data->drops == xpub->worst) {
+        xpub->worst = 0;
+        for (it = nn_list_begin (&xpub->pipes);
+              it != nn_list_end (&xpub->pipes);
+              it = nn_list_next (&xpub->pipes, it)) {
+            other = nn_cont (it, struct nn_xpub_data, pipe);
+            if (other->drops > xpub->worst)
+                xpub->worst = other->drops;
+        }
+        nn_sockbase_stat_set (&xpub->sockbase,
+            NN_STAT_MAX_PIPE_DROPPED_MESSAGES, xpub->worst);
+    }
 
     nn_free (data);
 }
 
-static void nn_xpub_in (NN_UNUSED struct nn_sockbase *self,
-                       NN_UNUSED struct nn_pipe *pipe)
+static void nn_xpub_in (struct nn_sockbase *self, struct nn_pipe *pipe)
 {
-    /*  We shouldn't get any messages from subscribers. */
-    nn_assert (0);
+    int rc;
+    struct nn_xpub *xpub;
+    struct nn_xpub_data *data;
+    struct nn_msg msg;
+    uint8_t *body;
+    size_t size;
+
+    xpub = nn_cont (self, struct nn_xpub, sockbase);
+    data = nn_pipe_getdata (pipe);
+
+    /*  The only messages subscribers send are forwarded subscriptions. */
+    while (1) {
+        rc = nn_pipe_recv (pipe, &msg);
+        errnum_assert (rc >= 0, -rc);
+        body = nn_chunkref_data (&msg.body);
+        size = nn_chunkref_size (&msg.body);
+        if (nn_fast (data->filtered && size >= 1)) {
+            if (body [0] == NN_XPUB_SUBSCRIBE) {
+                if (!nn_list_empty (&xpub->lvcs))
+                    nn_xpub_replay_subscribe (xpub, data, body + 1, size - 1);
+                nn_trie_subscribe (&data->trie, body + 1, size - 1);
+            }
+            else if (body [0] == NN_XPUB_UNSUBSCRIBE)
+                nn_trie_unsubscribe (&data->trie, body + 1, size - 1);
+        }
+        nn_msg_term (&msg);
+        if (rc & NN_PIPE_RELEASE)
+            break;
+    }
+
+    nn_xpub_flush (xpub, data);
 }
 
 static void nn_xpub_out (struct nn_sockbase *self, struct nn_pipe *pipe)
@@ -143,6 +377,13 @@ static void nn_xpub_out (struct nn_sockbase *self, struct nn_pipe *pipe)
     data = nn_pipe_getdata (pipe);
 
     nn_dist_out (&xpub->outpipes, &data->item);
+    nn_xpub_flush (xpub, data);
+
+    /*  The pipe has caught up. */
+    if (nn_list_empty (&data->pending)) {
+        data->slowdrops = 0;
+        data->since = 0;
+    }
 }
 
 static int nn_xpub_events (NN_UNUSED struct nn_sockbase *self)
@@ -152,8 +393,482 @@ static int nn_xpub_events (NN_UNUSED struct nn_sockbase *self)
 
 static int nn_xpub_send (struct nn_sockbase *self, struct nn_msg *msg)
 {
-    return nn_dist_send (&nn_cont (self, struct nn_xpub, sockbase)->outpipes,
-        msg, NULL);
+    int rc;
+    struct nn_xpub *xpub;
+
+    xpub = nn_cont (self, struct nn_xpub, sockbase);
+
+    if (xpub->lvc)
+        nn_xpub_cache (xpub, msg);
+
+    /*  Pipes that can't accept the message have to be dealt with before
+        the distributor takes the ownership of it. */
+    if (nn_slow (!nn_list_empty (nn_dist_blocked (&xpub->outpipes))))
+        nn_xpub_blocked (xpub, msg);
+
+    /*  With many subscribers, the writes to the network are shared among
+        several threads. */
+    nn_sockbase_fanout_begin (&xpub->sockbase);
+    if (nn_fast (!xpub->filtered))
+        rc = nn_dist_send (&xpub->outpipes, msg, NULL);
+    else
+        rc = nn_dist_send_filtered (&xpub->outpipes, msg,
+            nn_xpub_filter, NULL);
+    nn_sockbase_fanout_end (&xpub->sockbase);
+
+    if (nn_slow (xpub->evict))
+        nn_xpub_evict (xpub);
+
+    return rc;
+}
+
+static int nn_xpub_setopt (struct nn_sockbase *self, int level, int option,
+        const void *optval, size_t optvallen)
+{
+    int val;
+    struct nn_xpub *xpub;
+
+    xpub = nn_cont (self, struct nn_xpub, sockbase);
+
+    if (level != NN_PUB)
+        return -ENOPROTOOPT;
+
+    if ((option < NN_PUB_TOPIC_DELIM || option > NN_PUB_SLOW_MAXLAG) &&
+          option != NN_PUB_LVC_SIZE)
+        return -ENOPROTOOPT;
+
+    if (optvallen != sizeof (int))
+        return -EINVAL;
+    val = *(int*) optval;
+
+    /*  The new limits apply to messages sent from now on. */
+    switch (option) {
+    case NN_PUB_SLOW_POLICY:
+        if (val != NN_PUB_SLOW_DROP_NEW && val != NN_PUB_SLOW_DROP_OLDEST)
+            return -EINVAL;
+        xpub->policy = val;
+        return 0;
+    case NN_PUB_SLOW_BACKLOG:
+        if (val < 1)
+            return -EINVAL;
+        xpub->backlog = val;
+        return 0;
+    case NN_PUB_SLOW_MAXDROPS:
+        xpub->maxdrops = val < 0 ? -1 : val;
+        return 0;
+    case NN_PUB_SLOW_MAXLAG:
+        xpub->maxlag = val < 0 ? -1 : val;
+        return 0;
+    case NN_PUB_LVC_SIZE:
+        if (val < 1)
+            return -EINVAL;
+        xpub->lvcsize = val;
+        while (xpub->lvccount > xpub->lvcsize)
+            nn_xpub_cache_rm (xpub, nn_cont (nn_list_begin (&xpub->lvcs),
+                struct nn_xpub_lvc, item));
+        return 0;
+    }
+
+    /*  Cached messages would not be found under the new topics, so the
+        topic mode can't be changed while there are any. */
+    if (option == NN_PUB_TOPIC_DELIM) {
+        if (val < -1 || val > 255 || (val >= 0 && xpub->topic_len) ||
+              !nn_list_empty (&xpub->lvcs))
+            return -EINVAL;
+        xpub->topic_delim = val;
+        return 0;
+    }
+
+    if (option == NN_PUB_TOPIC_LEN) {
+        if (val < 0 || (val > 0 && xpub->topic_delim >= 0) ||
+              !nn_list_empty (&xpub->lvcs))
+            return -EINVAL;
+        xpub->topic_len = (size_t) val;
+        return 0;
+    }
+
+    /*  Messages already conflated are still delivered after conflation is
+        disabled. */
+    if (option == NN_PUB_CONFLATE) {
+        xpub->conflate = val ? 1 : 0;
+        return 0;
+    }
+
+    /*  Disabling the cache drops all the cached messages. */
+    xpub->lvc = val ? 1 : 0;
+    if (!xpub->lvc)
+        nn_xpub_cache_clear (xpub);
+    return 0;
+}
+
+static int nn_xpub_getopt (struct nn_sockbase *self, int level, int option,
+        void *optval, size_t *optvallen)
+{
+    int val;
+    struct nn_xpub *xpub;
+
+    xpub = nn_cont (self, struct nn_xpub, sockbase);
+
+    if (level != NN_PUB)
+        return -ENOPROTOOPT;
+
+    if (option == NN_PUB_TOPIC_DELIM)
+        val = xpub->topic_delim;
+    else if (option == NN_PUB_TOPIC_LEN)
+        val = (int) xpub->topic_len;
+    else if (option == NN_PUB_LVC)
+        val = xpub->lvc;
+    else if (option == NN_PUB_LVC_SIZE)
+        val = xpub->lvcsize;
+    else if (option == NN_PUB_CONFLATE)
+        val = xpub->conflate;
+    else if (option == NN_PUB_SLOW_POLICY)
+        val = xpub->policy;
+    else if (option == NN_PUB_SLOW_BACKLOG)
+        val = xpub->backlog;
+    else if (option == NN_PUB_SLOW_MAXDROPS)
+        val = xpub->maxdrops;
+    else if (option == NN_PUB_SLOW_MAXLAG)
+        val = xpub->maxlag;
+    else
+        return -ENOPROTOOPT;
+
+    if (nn_slow (*optvallen < sizeof (int)))
+        return -EINVAL;
+    *(int*) optval = val;
+    *optvallen = sizeof (int);
+    return 0;
+}
+
+static int nn_xpub_filter (struct nn_dist_data *item, struct nn_msg *msg,
+    NN_UNUSED void *arg)
+{
+    struct nn_xpub_data *data;
+
+    data = nn_cont (item, struct nn_xpub_data, item);
+    if (!data->filtered)
+        return 1;
+    return nn_trie_match (&data->trie, nn_chunkref_data (&msg->body),
+        nn_chunkref_size (&msg->body));
+}
+
+static void nn_xpub_cache (struct nn_xpub *self, struct nn_msg *msg)
+{
+    uint8_t *body;
+    size_t size;
+    size_t len;
+    void **val;
+    struct nn_xpub_lvc *lvc;
+
+    body = nn_chunkref_data (&msg->body);
+    size = nn_chunkref_size (&msg->body);
+    len = nn_topics_key (self->topic_delim, self->topic_len, body, size);
+
+    /*  Messages without a topic are not cached. */
+    if (!len)
+        return;
+
+    val = nn_topics_value (&self->lvcindex, body, len);
+    if (!val) {
+        nn_topics_subscribe (&self->lvcindex, body, len);
+        val = nn_topics_value (&self->lvcindex, body, len);
+        lvc = nn_alloc (sizeof (struct nn_xpub_lvc), "last value (pub)");
+        alloc_assert (lvc);
+        lvc->topic = len;
+        nn_list_item_init (&lvc->item);
+        *val = lvc;
+        ++self->lvccount;
+    }
+    else {
+        lvc = *val;
+        nn_msg_term (&lvc->msg);
+        nn_list_erase (&self->lvcs, &lvc->item);
+    }
+    nn_list_insert (&self->lvcs, &lvc->item, nn_list_end (&self->lvcs));
+
+    /*  The copy shares the message body with the copies being sent. */
+    nn_msg_cp (&lvc->msg, msg);
+
+    /*  Make room by evicting the topic that wasn't updated for the longest
+        time. */
+    if (self->lvccount > self->lvcsize)
+        nn_xpub_cache_rm (self, nn_cont (nn_list_begin (&self->lvcs),
+            struct nn_xpub_lvc, item));
+}
+
+static void nn_xpub_cache_rm (struct nn_xpub *self, struct nn_xpub_lvc *lvc)
+{
+    int rc;
+    uint8_t *body;
+    void **val;
+    struct nn_list_item *it;
+    struct nn_xpub_data *data;
+    struct nn_xpub_pending *pending;
+
+    /*  Pending messages that refer to the entry get their own copy. */
+    body = nn_chunkref_data (&lvc->msg.body);
+    for (it = nn_list_begin (&self->pipes); it != nn_list_end (&self->pipes);
+          it = nn_list_next (&self->pipes, it)) {
+        data = nn_cont (it, struct nn_xpub_data, pipe);
+        val = nn_topics_value (&data->pendindex, body, lvc->topic);
+        if (!val)
+            continue;
+        pending = *val;
+        if (pending->lvc == lvc) {
+            nn_msg_cp (&pending->msg, &lvc->msg);
+            pending->lvc = NULL;
+        }
+    }
+
+    rc = nn_topics_unsubscribe (&self->lvcindex, body, lvc->topic);
+    errnum_assert (rc == 1, -rc);
+    nn_list_erase (&self->lvcs, &lvc->item);
+    nn_list_item_term (&lvc->item);
+    nn_msg_term (&lvc->msg);
+    nn_free (lvc);
+    --self->lvccount;
+}
+
+static void nn_xpub_cache_clear (struct nn_xpub *self)
+{
+    while (!nn_list_empty (&self->lvcs))
+        nn_xpub_cache_rm (self, nn_cont (nn_list_begin (&self->lvcs),
+            struct nn_xpub_lvc, item));
+}
+
+static void nn_xpub_blocked (struct nn_xpub *self, struct nn_msg *msg)
+{
+    uint8_t *body;
+    size_t size;
+    size_t key;
+    size_t len;
+    uint64_t now;
+    void **val;
+    struct nn_list *blocked;
+    struct nn_list_item *it;
+    struct nn_list_item *it2;
+    struct nn_xpub_data *data;
+    struct nn_xpub_pending *pending;
+
+    body = nn_chunkref_data (&msg->body);
+    size = nn_chunkref_size (&msg->body);
+    key = self->conflate || self->lvc ?
+        nn_topics_key (self->topic_delim, self->topic_len, body, size) : 0;
+    len = self->conflate ? key : 0;
+    now = 0;
+
+    /*  Pipes ready for sending get the message from the distributor. The
+        blocked ones, unless they are not interested in it anyway, get it
+        conflated, queued or dropped. Messages without a topic can't be
+        conflated. */
+    blocked = nn_dist_blocked (&self->outpipes);
+    for (it = nn_list_begin (blocked); it != nn_list_end (blocked);
+          it = nn_list_next (blocked, it)) {
+        data = nn_cont (nn_cont (it, struct nn_dist_data, item),
+            struct nn_xpub_data, item);
+        if (data->filtered && !nn_trie_match (&data->trie, body, size))
+            continue;
+
+        if (len)
+            nn_xpub_conflate (data, msg, len);
+        else if (self->policy == NN_PUB_SLOW_DROP_OLDEST) {
+
+            /*  If the cached message of the topic is yet to be replayed to
+                the pipe, it's this very message now. Don't send it twice. */
+            if (key) {
+                val = nn_topics_value (&data->pendindex, body, key);
+                if (val && ((struct nn_xpub_pending*) *val)->lvc)
+                    nn_xpub_pending_rm (data, *val);
+            }
+
+            if (data->backlog >= self->backlog) {
+                it2 = nn_list_begin (&data->pending);
+                while (nn_cont (it2, struct nn_xpub_pending, item)->topic)
+                    it2 = nn_list_next (&data->pending, it2);
+                nn_xpub_pending_rm (data,
+                    nn_cont (it2, struct nn_xpub_pending, item));
+                nn_xpub_dropped (self, data);
+            }
+            pending = nn_xpub_pending_add (data, NULL, 0);
+            nn_msg_cp (&pending->msg, msg);
+        }
+        else
+            nn_xpub_dropped (self, data);
+
+        /*  Check for how long the pipe has been behind. */
+        if (self->maxlag >= 0 && data->evict == 0) {
+            if (!now)
+                now = nn_clock_ms ();
+            if (!data->since)
+                data->since = now;
+            else if (now - data->since > (uint64_t) self->maxlag) {
+                data->evict = 1;
+                self->evict = 1;
+            }
+        }
+    }
+}
+
+static void nn_xpub_conflate (struct nn_xpub_data *data, struct nn_msg *msg,
+    size_t len)
+{
+    void **val;
+    struct nn_xpub_pending *pending;
+    uint8_t *body;
+
+    body = nn_chunkref_data (&msg->body);
+    val = nn_topics_value (&data->pendindex, body, len);
+    if (!val)
+        pending = nn_xpub_pending_add (data, body, len);
+    else {
+        pending = *val;
+
+        /*  The cache already has this very message. */
+        if (pending->lvc)
+            return;
+        nn_msg_term (&pending->msg);
+    }
+    nn_msg_cp (&pending->msg, msg);
+}
+
+static void nn_xpub_dropped (struct nn_xpub *self, struct nn_xpub_data *data)
+{
+    ++data->drops;
+    ++data->slowdrops;
+    nn_sockbase_stat_increment (&self->sockbase, NN_STAT_DROPPED_MESSAGES, 1);
+    if (data->drops > self->worst) {
+        self->worst = data->drops;
+        nn_sockbase_stat_set (&self->sockbase,
+            NN_STAT_MAX_PIPE_DROPPED_MESSAGES, self->worst);
+    }
+    if (self->maxdrops >= 0 && data->slowdrops > self->maxdrops &&
+          data->evict == 0) {
+        data->evict = 1;
+        self->evict = 1;
+    }
+}
+
+static void nn_xpub_evict (struct nn_xpub *self)
+{
+    int rc;
+    struct nn_list *blocked;
+    struct nn_list_item *it;
+    struct nn_list_item *next;
+    struct nn_xpub_data *data;
+
+    /*  Closing the pipe removes it from the socket, nothing else changes. */
+    self->evict = 0;
+    blocked = nn_dist_blocked (&self->outpipes);
+    it = nn_list_begin (blocked);
+    while (it != nn_list_end (blocked)) {
+        next = nn_list_next (blocked, it);
+        data = nn_cont (nn_cont (it, struct nn_dist_data, item),
+            struct nn_xpub_data, item);
+        if (data->evict == 1) {
+            rc = nn_pipe_close (data->item.pipe);
+            if (rc == 0)
+                nn_sockbase_stat_increment (&self->sockbase,
+                    NN_STAT_EVICTED_CONNECTIONS, 1);
+            else {
+                errnum_assert (rc == -ENOTSUP, -rc);
+                data->evict = -1;
+            }
+        }
+        it = next;
+    }
+}
+
+static void nn_xpub_replay_subscribe (struct nn_xpub *self,
+    struct nn_xpub_data *data, const uint8_t *topic, size_t size)
+{
+    struct nn_list_item *it;
+    struct nn_xpub_lvc *lvc;
+    struct nn_xpub_pending *pending;
+    uint8_t *body;
+    size_t bodysz;
+
+    /*  Replay the cached messages matching the new subscription, except
+        those the subscriber has already got thanks to its other
+        subscriptions or those already waiting to be sent. */
+    for (it = nn_list_begin (&self->lvcs); it != nn_list_end (&self->lvcs);
+          it = nn_list_next (&self->lvcs, it)) {
+        lvc = nn_cont (it, struct nn_xpub_lvc, item);
+        body = nn_chunkref_data (&lvc->msg.body);
+        bodysz = nn_chunkref_size (&lvc->msg.body);
+        if (bodysz < size || memcmp (body, topic, size) != 0)
+            continue;
+        if (nn_trie_match (&data->trie, body, bodysz))
+            continue;
+        if (nn_topics_value (&data->pendindex, body, lvc->topic))
+            continue;
+        pending = nn_xpub_pending_add (data, body, lvc->topic);
+        pending->lvc = lvc;
+    }
+}
+
+static struct nn_xpub_pending *nn_xpub_pending_add (
+    struct nn_xpub_data *data, const uint8_t *topic, size_t size)
+{
+    struct nn_xpub_pending *pending;
+
+    pending = nn_alloc (sizeof (struct nn_xpub_pending), "pending (pub)");
+    alloc_assert (pending);
+    pending->topic = size;
+    pending->lvc = NULL;
+    nn_list_item_init (&pending->item);
+    nn_list_insert (&data->pending, &pending->item,
+        nn_list_end (&data->pending));
+    if (!size) {
+        ++data->backlog;
+        return pending;
+    }
+    nn_topics_subscribe (&data->pendindex, topic, size);
+    *nn_topics_value (&data->pendindex, topic, size) = pending;
+    return pending;
+}
+
+static void nn_xpub_pending_rm (struct nn_xpub_data *data,
+    struct nn_xpub_pending *pending)
+{
+    struct nn_msg *msg;
+    int rc;
+
+    if (pending->topic) {
+        msg = pending->lvc ? &pending->lvc->msg : &pending->msg;
+        rc = nn_topics_unsubscribe (&data->pendindex,
+            nn_chunkref_data (&msg->body), pending->topic);
+        errnum_assert (rc == 1, -rc);
+    }
+    else
+        --data->backlog;
+    nn_list_erase (&data->pending, &pending->item);
+    nn_list_item_term (&pending->item);
+    if (!pending->lvc)
+        nn_msg_term (&pending->msg);
+    nn_free (pending);
+}
+
+static void nn_xpub_flush (struct nn_xpub *self, struct nn_xpub_data *data)
+{
+    int rc;
+    struct nn_xpub_pending *pending;
+    struct nn_msg msg;
+
+    while (!nn_list_empty (&data->pending)) {
+        pending = nn_cont (nn_list_begin (&data->pending),
+            struct nn_xpub_pending, item);
+        if (pending->lvc)
+            nn_msg_cp (&msg, &pending->lvc->msg);
+        else
+            nn_msg_cp (&msg, &pending->msg);
+        rc = nn_dist_send_one (&self->outpipes, &data->item, &msg);
+        if (rc == -EAGAIN) {
+            nn_msg_term (&msg);
+            return;
+        }
+        errnum_assert (rc == 0, -rc);
+        nn_xpub_pending_rm (data, pending);
+    }
 }
 
 int nn_xpub_create (void *hint, struct nn_sockbase **sockbase)
@@ -176,7 +891,7 @@ int nn_xpub_ispeer (int socktype)
 struct nn_socktype nn_xpub_socktype = {
     AF_SP_RAW,
     NN_PUB,
-    NN_SOCKTYPE_FLAG_NORECV,
+    NN_SOCKTYPE_FLAG_NORECV | NN_SOCKTYPE_FLAG_SUBFWD,
     nn_xpub_create,
     nn_xpub_ispeer,
 };
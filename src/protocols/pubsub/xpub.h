@@ -25,6 +25,12 @@
 
 #include "../../protocol.h"
 
+/*  Subscription forwarding. The subscriber sends one control message per
+    subscription change; the first byte of the body is the command and
+    the rest of the body is the topic. */
+#define NN_XPUB_UNSUBSCRIBE 0
+#define NN_XPUB_SUBSCRIBE 1
+
 int nn_xpub_create (void *hint, struct nn_sockbase **sockbase);
 int nn_xpub_ispeer (int socktype);
 
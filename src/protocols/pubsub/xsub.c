@@ -23,33 +23,121 @@
 */
 
 #include "xsub.h"
+#include "xpub.h"
 #include "trie.h"
+#include "ctrie.h"
+#include "topics.h"
 
 #include "../../nn.h"
 #include "../../pubsub.h"
 
-#include "../utils/fq.h"
+#include "../utils/priolist.h"
 
 #include "../../utils/err.h"
 #include "../../utils/cont.h"
 #include "../../utils/fast.h"
 #include "../../utils/alloc.h"
 #include "../../utils/attr.h"
+#include "../../utils/list.h"
+
+#include <string.h>
+
+/*  Maximum number of messages taken from a pipe and matched at once. */
+#define NN_XSUB_BATCH 16
+
+/*  Argument of nn_xsub_forward_diff. */
+struct nn_xsub_diff {
+    struct nn_xsub *xsub;
+    struct nn_ctrie *other;
+    uint8_t cmd;
+};
+
+/*  Subscription change waiting to be forwarded to the publisher. */
+struct nn_xsub_ctl {
+    struct nn_list_item item;
+    struct nn_msg msg;
+};
 
 struct nn_xsub_data {
-    struct nn_fq_data fq;
+    struct nn_priolist_data priodata;
+    struct nn_pipe *pipe;
+
+    /*  Set while the pipe may have more messages to receive. */
+    int in;
+
+    /*  Messages that matched the subscriptions, waiting to be received by
+        the user. Non-matching messages are dropped as soon as the pipe
+        reports them, without waking up the user. When the pipe has a
+        backlog, up to NN_XSUB_BATCH messages are taken from it and matched
+        in a single pass over the trie. */
+    struct nn_msg msgs [NN_XSUB_BATCH];
+    int head;
+    int count;
+
+    /*  Value of nn_xsub::unsubs when 'msgs' were matched. */
+    uint32_t gen;
+
+    /*  Set if the publisher accepts forwarded subscriptions. */
+    int fwd;
+
+    /*  Set if the pipe is ready for sending. */
+    int out;
+
+    /*  Control messages not yet sent to the publisher. */
+    struct nn_list pending;
+
+    /*  Member of nn_xsub::fwdpipes list. */
+    struct nn_list_item item;
 };
 
 struct nn_xsub {
     struct nn_sockbase sockbase;
-    struct nn_fq fq;
+    struct nn_priolist priolist;
     struct nn_trie trie;
+
+    /*  Subscriptions that name a complete topic are kept in a hash table
+        rather than in the trie. A topic is complete either if it ends with
+        'topic_delim' or if its length is 'topic_len'. Both are disabled
+        by default. */
+    struct nn_topics topics;
+    int topic_delim;
+    size_t topic_len;
+
+    /*  Subscriptions set by NN_SUB_SUBSCRIBE_BULK. They are kept apart
+        from the above and replaced only as a whole. */
+    struct nn_ctrie bulk;
+
+    /*  Number of active subscriptions, not counting the bulk ones. */
+    size_t subs;
+
+    /*  Incremented on each unsubscription, so that already matched messages
+        can be checked again before they are handed to the user. */
+    uint32_t unsubs;
+
+    /*  Pipes the subscription changes are forwarded to. */
+    struct nn_list fwdpipes;
 };
 
 /*  Private functions. */
 static void nn_xsub_init (struct nn_xsub *self,
     const struct nn_sockbase_vfptr *vfptr, void *hint);
 static void nn_xsub_term (struct nn_xsub *self);
+static void nn_xsub_forward (struct nn_xsub *self, uint8_t cmd,
+    const void *topic, size_t size);
+static void nn_xsub_forward_diff (void *arg, const uint8_t *data,
+    size_t size);
+static void nn_xsub_queue (struct nn_xsub_data *data, uint8_t cmd,
+    const void *topic, size_t size);
+static void nn_xsub_queue_subscribe (void *arg, const uint8_t *data,
+    size_t size);
+static void nn_xsub_flush (struct nn_xsub_data *data);
+static void nn_xsub_prefetch (struct nn_xsub *self,
+    struct nn_xsub_data *data);
+static int nn_xsub_isexact (struct nn_xsub *self, const uint8_t *data,
+    size_t size);
+static int nn_xsub_match (struct nn_xsub *self, struct nn_msg *msg);
+static int nn_xsub_match_topic (struct nn_xsub *self, const uint8_t *data,
+    size_t size);
 
 /*  Implementation of nn_sockbase's virtual functions. */
 static void nn_xsub_destroy (struct nn_sockbase *self);
@@ -61,6 +149,8 @@ static int nn_xsub_events (struct nn_sockbase *self);
 static int nn_xsub_recv (struct nn_sockbase *self, struct nn_msg *msg);
 static int nn_xsub_setopt (struct nn_sockbase *self, int level, int option,
     const void *optval, size_t optvallen);
+static int nn_xsub_getopt (struct nn_sockbase *self, int level, int option,
+    void *optval, size_t *optvallen);
 static const struct nn_sockbase_vfptr nn_xsub_sockbase_vfptr = {
     NULL,
     nn_xsub_destroy,
@@ -72,6 +162,11 @@ static const struct nn_sockbase_vfptr nn_xsub_sockbase_vfptr = {
     NULL,
     nn_xsub_recv,
     nn_xsub_setopt,
+    nn_xsub_getopt,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
     NULL
 };
 
@@ -79,14 +174,24 @@ static void nn_xsub_init (struct nn_xsub *self,
     const struct nn_sockbase_vfptr *vfptr, void *hint)
 {
     nn_sockbase_init (&self->sockbase, vfptr, hint);
-    nn_fq_init (&self->fq);
+    nn_priolist_init (&self->priolist);
     nn_trie_init (&self->trie);
+    nn_topics_init (&self->topics);
+    nn_ctrie_init (&self->bulk);
+    self->topic_delim = -1;
+    self->topic_len = 0;
+    self->subs = 0;
+    self->unsubs = 0;
+    nn_list_init (&self->fwdpipes);
 }
 
 static void nn_xsub_term (struct nn_xsub *self)
 {
+    nn_list_term (&self->fwdpipes);
+    nn_ctrie_term (&self->bulk);
+    nn_topics_term (&self->topics);
     nn_trie_term (&self->trie);
-    nn_fq_term (&self->fq);
+    nn_priolist_term (&self->priolist);
     nn_sockbase_term (&self->sockbase);
 }
 
@@ -117,7 +222,26 @@ static int nn_xsub_add (struct nn_sockbase *self, struct nn_pipe *pipe)
     data = nn_alloc (sizeof (struct nn_xsub_data), "pipe data (sub)");
     alloc_assert (data);
     nn_pipe_setdata (pipe, data);
-    nn_fq_add (&xsub->fq, &data->fq, pipe, rcvprio);
+    nn_priolist_add (&xsub->priolist, &data->priodata, pipe, rcvprio);
+    data->in = 0;
+    data->head = 0;
+    data->count = 0;
+    data->gen = 0;
+
+    /*  If the publisher does the filtering, tell it about all the existing
+        subscriptions. They will be sent once the pipe becomes writable. */
+    data->pipe = pipe;
+    data->fwd = nn_pipe_caps (pipe) & NN_PIPE_CAP_SUBFWD ? 1 : 0;
+    data->out = 0;
+    nn_list_init (&data->pending);
+    nn_list_item_init (&data->item);
+    if (data->fwd) {
+        nn_list_insert (&xsub->fwdpipes, &data->item,
+            nn_list_end (&xsub->fwdpipes));
+        nn_trie_walk (&xsub->trie, nn_xsub_queue_subscribe, data);
+        nn_topics_walk (&xsub->topics, nn_xsub_queue_subscribe, data);
+        nn_ctrie_walk (&xsub->bulk, nn_xsub_queue_subscribe, data);
+    }
 
     return 0;
 }
@@ -126,10 +250,28 @@ static void nn_xsub_rm (struct nn_sockbase *self, struct nn_pipe *pipe)
 {
     struct nn_xsub *xsub;
     struct nn_xsub_data *data;
+    struct nn_xsub_ctl *ctl;
 
     xsub = nn_cont (self, struct nn_xsub, sockbase);
     data = nn_pipe_getdata (pipe);
-    nn_fq_rm (&xsub->fq, &data->fq);
+    nn_priolist_rm (&xsub->priolist, &data->priodata);
+    while (data->count) {
+        nn_msg_term (&data->msgs [data->head]);
+        ++data->head;
+        --data->count;
+    }
+    if (data->fwd)
+        nn_list_erase (&xsub->fwdpipes, &data->item);
+    nn_list_item_term (&data->item);
+    while (!nn_list_empty (&data->pending)) {
+        ctl = nn_cont (nn_list_begin (&data->pending),
+            struct nn_xsub_ctl, item);
+        nn_list_erase (&data->pending, &ctl->item);
+        nn_list_item_term (&ctl->item);
+        nn_msg_term (&ctl->msg);
+        nn_free (ctl);
+    }
+    nn_list_term (&data->pending);
     nn_free (data);
 }
 
@@ -140,20 +282,36 @@ static void nn_xsub_in (struct nn_sockbase *self, struct nn_pipe *pipe)
 
     xsub = nn_cont (self, struct nn_xsub, sockbase);
     data = nn_pipe_getdata (pipe);
-    nn_fq_in (&xsub->fq, &data->fq);
+    data->in = 1;
+
+    /*  This runs in the worker thread. Messages that don't match any
+        subscription are dropped here and the user is only notified once
+        there's something to receive. If there are still messages from
+        the previous batch, the pipe is already active and the new ones
+        will be taken once those are received. */
+    if (data->count)
+        return;
+    nn_xsub_prefetch (xsub, data);
+    if (data->count)
+        nn_priolist_activate (&xsub->priolist, &data->priodata);
 }
 
 static void nn_xsub_out (NN_UNUSED struct nn_sockbase *self,
-    NN_UNUSED struct nn_pipe *pipe)
+    struct nn_pipe *pipe)
 {
-    /*  We are not going to send any messages until subscription forwarding
-        is implemented, so there's no point is maintaining a list of pipes
-        ready for sending. */
+    struct nn_xsub_data *data;
+
+    /*  User messages are never sent, the pipe is used only to forward
+        subscriptions to the publisher. */
+    data = nn_pipe_getdata (pipe);
+    data->out = 1;
+    nn_xsub_flush (data);
 }
 
 static int nn_xsub_events (struct nn_sockbase *self)
 {
-    return nn_fq_can_recv (&nn_cont (self, struct nn_xsub, sockbase)->fq) ?
+    return nn_priolist_is_active (
+        &nn_cont (self, struct nn_xsub, sockbase)->priolist) ?
         NN_SOCKBASE_EVENT_IN : 0;
 }
 
@@ -161,33 +319,140 @@ static int nn_xsub_recv (struct nn_sockbase *self, struct nn_msg *msg)
 {
     int rc;
     struct nn_xsub *xsub;
+    struct nn_pipe *pipe;
+    struct nn_xsub_data *data;
 
     xsub = nn_cont (self, struct nn_xsub, sockbase);
 
     /*  Loop while a matching message is found or when there are no more
         messages to receive. */
     while (1) {
-        rc = nn_fq_recv (&xsub->fq, msg, NULL);
-        if (nn_slow (rc == -EAGAIN))
+        pipe = nn_priolist_getpipe (&xsub->priolist);
+        if (nn_slow (!pipe))
             return -EAGAIN;
-        errnum_assert (rc >= 0, -rc);
-        rc = nn_trie_match (&xsub->trie, nn_chunkref_data (&msg->body),
-            nn_chunkref_size (&msg->body));
-        if (rc == 0) {
-            nn_msg_term (msg);
-            continue;
-        }
-        if (rc == 1)
+        data = nn_pipe_getdata (pipe);
+        nn_assert (data->count);
+        nn_msg_mv (msg, &data->msgs [data->head]);
+        ++data->head;
+        --data->count;
+
+        /*  The message was matched before the user unsubscribed. */
+        rc = 1;
+        if (nn_slow (data->gen != xsub->unsubs))
+            rc = nn_xsub_match (xsub, msg);
+
+        /*  Get the next matching messages from the pipe, if any. */
+        if (!data->count)
+            nn_xsub_prefetch (xsub, data);
+        nn_priolist_advance (&xsub->priolist, !data->count);
+
+        if (nn_fast (rc == 1))
             return 0;
-        errnum_assert (0, -rc);
+        nn_msg_term (msg);
+    }
+}
+
+static void nn_xsub_prefetch (struct nn_xsub *self, struct nn_xsub_data *data)
+{
+    int rc;
+    int i;
+    int n;
+    const uint8_t *bodies [NN_XSUB_BATCH];
+    size_t sizes [NN_XSUB_BATCH];
+    int results [NN_XSUB_BATCH];
+
+    while (data->in && !data->count) {
+        data->head = 0;
+
+        /*  Take whatever is available from the pipe, up to the batch size.
+            Stream transports release the pipe after every message, so
+            they mostly end up with a single message here. */
+        for (n = 0; n != NN_XSUB_BATCH && data->in; ++n) {
+            rc = nn_pipe_recv (data->pipe, &data->msgs [n]);
+            errnum_assert (rc >= 0, -rc);
+            if (rc & NN_PIPE_RELEASE)
+                data->in = 0;
+        }
+
+        if (n == 1)
+            results [0] = nn_xsub_match (self, &data->msgs [0]);
+        else {
+            for (i = 0; i != n; ++i) {
+                bodies [i] = nn_chunkref_data (&data->msgs [i].body);
+                sizes [i] = nn_chunkref_size (&data->msgs [i].body);
+            }
+            nn_trie_match_batch (&self->trie, n, bodies, sizes, results);
+            if (self->topics.count)
+                for (i = 0; i != n; ++i)
+                    if (!results [i])
+                        results [i] = nn_xsub_match_topic (self,
+                            bodies [i], sizes [i]);
+            if (self->bulk.nodes)
+                for (i = 0; i != n; ++i)
+                    if (!results [i])
+                        results [i] = nn_ctrie_match (&self->bulk,
+                            bodies [i], sizes [i]);
+        }
+
+        /*  Keep the matching messages, preserving their order. */
+        for (i = 0; i != n; ++i) {
+            if (!results [i]) {
+                nn_msg_term (&data->msgs [i]);
+                continue;
+            }
+            if (i != data->count)
+                nn_msg_mv (&data->msgs [data->count], &data->msgs [i]);
+            ++data->count;
+        }
+        data->gen = self->unsubs;
     }
 }
 
+static int nn_xsub_isexact (struct nn_xsub *self, const uint8_t *data,
+    size_t size)
+{
+    /*  The subscription has to be a topic on its own. In delimiter mode
+        a subscription with the delimiter in the middle can still match
+        messages only as a prefix. */
+    return size && nn_topics_key (self->topic_delim, self->topic_len,
+        data, size) == size ? 1 : 0;
+}
+
+static int nn_xsub_match (struct nn_xsub *self, struct nn_msg *msg)
+{
+    const uint8_t *data;
+    size_t size;
+
+    data = nn_chunkref_data (&msg->body);
+    size = nn_chunkref_size (&msg->body);
+
+    if (self->topics.count && nn_xsub_match_topic (self, data, size))
+        return 1;
+    if (nn_trie_match (&self->trie, data, size))
+        return 1;
+    return self->bulk.nodes ? nn_ctrie_match (&self->bulk, data, size) : 0;
+}
+
+static int nn_xsub_match_topic (struct nn_xsub *self, const uint8_t *data,
+    size_t size)
+{
+    size_t len;
+
+    /*  A complete topic subscription is a prefix of the message only if
+        it's equal to the message's own topic, so a single hash lookup
+        replaces walking the trie for all of them. */
+    len = nn_topics_key (self->topic_delim, self->topic_len, data, size);
+    return len && nn_topics_match (&self->topics, data, len) ? 1 : 0;
+}
+
 static int nn_xsub_setopt (struct nn_sockbase *self, int level, int option,
         const void *optval, size_t optvallen)
 {
     int rc;
+    int val;
     struct nn_xsub *xsub;
+    struct nn_ctrie bulk;
+    struct nn_xsub_diff diff;
 
     xsub = nn_cont (self, struct nn_xsub, sockbase);
 
@@ -195,22 +460,187 @@ static int nn_xsub_setopt (struct nn_sockbase *self, int level, int option,
         return -ENOPROTOOPT;
 
     if (option == NN_SUB_SUBSCRIBE) {
-        rc = nn_trie_subscribe (&xsub->trie, optval, optvallen);
-        if (rc >= 0)
+        if (nn_xsub_isexact (xsub, optval, optvallen))
+            rc = nn_topics_subscribe (&xsub->topics, optval, optvallen);
+        else
+            rc = nn_trie_subscribe (&xsub->trie, optval, optvallen);
+        if (rc == 1)
+            nn_xsub_forward (xsub, NN_XPUB_SUBSCRIBE, optval, optvallen);
+        if (rc >= 0) {
+            ++xsub->subs;
             return 0;
+        }
         return rc;
     }
 
     if (option == NN_SUB_UNSUBSCRIBE) {
-        rc = nn_trie_unsubscribe (&xsub->trie, optval, optvallen);
-        if (rc >= 0)
+        if (nn_xsub_isexact (xsub, optval, optvallen))
+            rc = nn_topics_unsubscribe (&xsub->topics, optval, optvallen);
+        else
+            rc = nn_trie_unsubscribe (&xsub->trie, optval, optvallen);
+        if (rc == 1) {
+            ++xsub->unsubs;
+            nn_xsub_forward (xsub, NN_XPUB_UNSUBSCRIBE, optval, optvallen);
+        }
+        if (rc >= 0) {
+            --xsub->subs;
             return 0;
+        }
         return rc;
     }
 
+    if (option == NN_SUB_SUBSCRIBE_BULK) {
+        nn_ctrie_init (&bulk);
+        rc = nn_ctrie_build (&bulk, optval, optvallen);
+        if (nn_slow (rc < 0)) {
+            nn_ctrie_term (&bulk);
+            return rc;
+        }
+
+        /*  The publisher is told only about the difference between the old
+            and the new set. It keeps a reference count per topic, so
+            a topic subscribed to both individually and in bulk stays
+            subscribed when removed from either. */
+        if (!nn_list_empty (&xsub->fwdpipes)) {
+            diff.xsub = xsub;
+            diff.other = &xsub->bulk;
+            diff.cmd = NN_XPUB_SUBSCRIBE;
+            nn_ctrie_walk (&bulk, nn_xsub_forward_diff, &diff);
+            diff.other = &bulk;
+            diff.cmd = NN_XPUB_UNSUBSCRIBE;
+            nn_ctrie_walk (&xsub->bulk, nn_xsub_forward_diff, &diff);
+        }
+
+        if (xsub->bulk.nodes)
+            ++xsub->unsubs;
+        nn_ctrie_term (&xsub->bulk);
+        xsub->bulk = bulk;
+        return 0;
+    }
+
+    if (option == NN_SUB_TOPIC_DELIM || option == NN_SUB_TOPIC_LEN) {
+        if (optvallen != sizeof (int))
+            return -EINVAL;
+        val = *(int*) optval;
+
+        /*  Existing subscriptions would have to be moved between the trie
+            and the hash table, so the mode can be changed only before
+            subscribing. Only one of the modes can be used at a time. */
+        if (xsub->subs)
+            return -EINVAL;
+        if (option == NN_SUB_TOPIC_DELIM) {
+            if (val < -1 || val > 255 || (val >= 0 && xsub->topic_len))
+                return -EINVAL;
+            xsub->topic_delim = val;
+        }
+        else {
+            if (val < 0 || (val > 0 && xsub->topic_delim >= 0))
+                return -EINVAL;
+            xsub->topic_len = (size_t) val;
+        }
+        return 0;
+    }
+
     return -ENOPROTOOPT;
 }
 
+static int nn_xsub_getopt (struct nn_sockbase *self, int level, int option,
+        void *optval, size_t *optvallen)
+{
+    struct nn_xsub *xsub;
+
+    xsub = nn_cont (self, struct nn_xsub, sockbase);
+
+    if (level != NN_SUB)
+        return -ENOPROTOOPT;
+
+    if (option == NN_SUB_TOPIC_DELIM) {
+        if (nn_slow (*optvallen < sizeof (int)))
+            return -EINVAL;
+        *(int*) optval = xsub->topic_delim;
+        *optvallen = sizeof (int);
+        return 0;
+    }
+
+    if (option == NN_SUB_TOPIC_LEN) {
+        if (nn_slow (*optvallen < sizeof (int)))
+            return -EINVAL;
+        *(int*) optval = (int) xsub->topic_len;
+        *optvallen = sizeof (int);
+        return 0;
+    }
+
+    return -ENOPROTOOPT;
+}
+
+static void nn_xsub_forward (struct nn_xsub *self, uint8_t cmd,
+    const void *topic, size_t size)
+{
+    struct nn_list_item *it;
+    struct nn_xsub_data *data;
+
+    /*  Only the first subscription to a topic and the last unsubscription
+        from it are forwarded, so the publisher never sees duplicates. */
+    for (it = nn_list_begin (&self->fwdpipes);
+          it != nn_list_end (&self->fwdpipes);
+          it = nn_list_next (&self->fwdpipes, it)) {
+        data = nn_cont (it, struct nn_xsub_data, item);
+        nn_xsub_queue (data, cmd, topic, size);
+        nn_xsub_flush (data);
+    }
+}
+
+static void nn_xsub_forward_diff (void *arg, const uint8_t *data,
+    size_t size)
+{
+    struct nn_xsub_diff *diff;
+
+    diff = (struct nn_xsub_diff*) arg;
+    if (!nn_ctrie_has (diff->other, data, size))
+        nn_xsub_forward (diff->xsub, diff->cmd, data, size);
+}
+
+static void nn_xsub_queue (struct nn_xsub_data *data, uint8_t cmd,
+    const void *topic, size_t size)
+{
+    struct nn_xsub_ctl *ctl;
+    uint8_t *body;
+
+    ctl = nn_alloc (sizeof (struct nn_xsub_ctl), "subscription (sub)");
+    alloc_assert (ctl);
+    nn_msg_init (&ctl->msg, size + 1);
+    body = nn_chunkref_data (&ctl->msg.body);
+    body [0] = cmd;
+    if (size)
+        memcpy (body + 1, topic, size);
+    nn_list_item_init (&ctl->item);
+    nn_list_insert (&data->pending, &ctl->item, nn_list_end (&data->pending));
+}
+
+static void nn_xsub_queue_subscribe (void *arg, const uint8_t *data,
+    size_t size)
+{
+    nn_xsub_queue ((struct nn_xsub_data*) arg, NN_XPUB_SUBSCRIBE, data, size);
+}
+
+static void nn_xsub_flush (struct nn_xsub_data *data)
+{
+    int rc;
+    struct nn_xsub_ctl *ctl;
+
+    while (data->out && !nn_list_empty (&data->pending)) {
+        ctl = nn_cont (nn_list_begin (&data->pending),
+            struct nn_xsub_ctl, item);
+        nn_list_erase (&data->pending, &ctl->item);
+        nn_list_item_term (&ctl->item);
+        rc = nn_pipe_send (data->pipe, &ctl->msg);
+        errnum_assert (rc >= 0, -rc);
+        nn_free (ctl);
+        if (rc & NN_PIPE_RELEASE)
+            data->out = 0;
+    }
+}
+
 int nn_xsub_create (void *hint, struct nn_sockbase **sockbase)
 {
     struct nn_xsub *self;
@@ -231,7 +661,7 @@ int nn_xsub_ispeer (int socktype)
 struct nn_socktype nn_xsub_socktype = {
     AF_SP_RAW,
     NN_SUB,
-    NN_SOCKTYPE_FLAG_NOSEND,
+    NN_SOCKTYPE_FLAG_NOSEND | NN_SOCKTYPE_FLAG_SUBFWD,
     nn_xsub_create,
     nn_xsub_ispeer,
 };
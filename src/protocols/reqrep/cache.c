@@ -0,0 +1,228 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#include "cache.h"
+
+#include "../../utils/alloc.h"
+#include "../../utils/clock.h"
+#include "../../utils/cont.h"
+#include "../../utils/err.h"
+#include "../../utils/fast.h"
+
+#include <string.h>
+
+/*  Private functions. */
+static uint32_t nn_cache_hash (struct nn_chunkref *key);
+static struct nn_cache_item *nn_cache_find (struct nn_hash *hash,
+    struct nn_chunkref *key, uint32_t *hashval);
+static void nn_cache_rm (struct nn_hash *hash, struct nn_list *list,
+    struct nn_cache_item *item);
+
+void nn_cache_init (struct nn_cache *self)
+{
+    self->size = 0;
+    self->ttl = 1000;
+    nn_hash_init (&self->replies);
+    nn_list_init (&self->lru);
+    nn_hash_init (&self->pending);
+    nn_list_init (&self->pendlist);
+}
+
+void nn_cache_term (struct nn_cache *self)
+{
+    nn_cache_resize (self, 0);
+    nn_list_term (&self->pendlist);
+    nn_hash_term (&self->pending);
+    nn_list_term (&self->lru);
+    nn_hash_term (&self->replies);
+}
+
+void nn_cache_resize (struct nn_cache *self, int size)
+{
+    nn_assert (size >= 0);
+
+    self->size = size;
+    while (self->replies.items > (uint32_t) size)
+        nn_cache_rm (&self->replies, &self->lru, nn_cont (
+            nn_list_begin (&self->lru), struct nn_cache_item, item));
+    while (self->pending.items > (uint32_t) size)
+        nn_cache_rm (&self->pending, &self->pendlist, nn_cont (
+            nn_list_begin (&self->pendlist), struct nn_cache_item, item));
+}
+
+int nn_cache_get (struct nn_cache *self, struct nn_chunkref *request,
+    struct nn_chunkref *reply)
+{
+    uint32_t hashval;
+    struct nn_cache_item *item;
+
+    item = nn_cache_find (&self->replies, request, &hashval);
+    if (!item)
+        return 0;
+
+    /*  Stale replies are of no use to anyone. */
+    if (self->ttl >= 0 &&
+          nn_clock_ms () - item->stored >= (uint64_t) self->ttl) {
+        nn_cache_rm (&self->replies, &self->lru, item);
+        return 0;
+    }
+
+    /*  Mark the reply as the most recently used one. */
+    nn_list_erase (&self->lru, &item->item);
+    nn_list_insert (&self->lru, &item->item, nn_list_end (&self->lru));
+
+    nn_chunkref_cp (reply, &item->val);
+    return 1;
+}
+
+void nn_cache_pend (struct nn_cache *self, struct nn_chunkref *backtrace,
+    struct nn_chunkref *request)
+{
+    uint32_t hashval;
+    struct nn_cache_item *item;
+    struct nn_hash_item *old;
+
+    if (nn_slow (self->size == 0))
+        return;
+
+    /*  Make room for the request. On a hash collision the older request
+        is forgotten. */
+    hashval = nn_cache_hash (backtrace);
+    old = nn_hash_get (&self->pending, hashval);
+    if (old)
+        nn_cache_rm (&self->pending, &self->pendlist,
+            nn_cont (old, struct nn_cache_item, hitem));
+    if (self->pending.items >= (uint32_t) self->size)
+        nn_cache_rm (&self->pending, &self->pendlist, nn_cont (
+            nn_list_begin (&self->pendlist), struct nn_cache_item, item));
+
+    item = nn_alloc (sizeof (struct nn_cache_item), "cache item");
+    alloc_assert (item);
+    nn_hash_item_init (&item->hitem);
+    nn_list_item_init (&item->item);
+    nn_chunkref_cp (&item->key, backtrace);
+
+    /*  The application is free to modify the request it has received,
+        so the key has to be a private copy. */
+    nn_chunkref_init (&item->val, nn_chunkref_size (request));
+    memcpy (nn_chunkref_data (&item->val), nn_chunkref_data (request),
+        nn_chunkref_size (request));
+    item->stored = 0;
+
+    nn_hash_insert (&self->pending, hashval, &item->hitem);
+    nn_list_insert (&self->pendlist, &item->item,
+        nn_list_end (&self->pendlist));
+}
+
+void nn_cache_put (struct nn_cache *self, struct nn_chunkref *backtrace,
+    struct nn_chunkref *reply, size_t offset)
+{
+    uint32_t hashval;
+    struct nn_cache_item *item;
+    struct nn_hash_item *old;
+
+    if (nn_slow (self->size == 0))
+        return;
+
+    item = nn_cache_find (&self->pending, backtrace, &hashval);
+    if (!item)
+        return;
+    nn_hash_erase (&self->pending, &item->hitem);
+    nn_list_erase (&self->pendlist, &item->item);
+
+    /*  Turn the pending request into the cached reply. */
+    nn_chunkref_term (&item->key);
+    nn_chunkref_mv (&item->key, &item->val);
+    if (offset == 0)
+        nn_chunkref_cp (&item->val, reply);
+    else {
+        nn_assert (offset <= nn_chunkref_size (reply));
+        nn_chunkref_init (&item->val, nn_chunkref_size (reply) - offset);
+        memcpy (nn_chunkref_data (&item->val),
+            ((uint8_t*) nn_chunkref_data (reply)) + offset,
+            nn_chunkref_size (reply) - offset);
+    }
+    item->stored = nn_clock_ms ();
+
+    /*  Replace the older reply with the same hash, if any, or make room by
+        evicting the least recently used one. */
+    hashval = nn_cache_hash (&item->key);
+    old = nn_hash_get (&self->replies, hashval);
+    if (old)
+        nn_cache_rm (&self->replies, &self->lru,
+            nn_cont (old, struct nn_cache_item, hitem));
+    if (self->replies.items >= (uint32_t) self->size)
+        nn_cache_rm (&self->replies, &self->lru, nn_cont (
+            nn_list_begin (&self->lru), struct nn_cache_item, item));
+
+    nn_hash_insert (&self->replies, hashval, &item->hitem);
+    nn_list_insert (&self->lru, &item->item, nn_list_end (&self->lru));
+}
+
+static uint32_t nn_cache_hash (struct nn_chunkref *key)
+{
+    uint32_t hash;
+    const uint8_t *data;
+    size_t size;
+
+    /*  32-bit FNV-1a. */
+    data = nn_chunkref_data (key);
+    size = nn_chunkref_size (key);
+    hash = 2166136261u;
+    while (size--) {
+        hash ^= *data++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static struct nn_cache_item *nn_cache_find (struct nn_hash *hash,
+    struct nn_chunkref *key, uint32_t *hashval)
+{
+    struct nn_hash_item *hitem;
+    struct nn_cache_item *item;
+
+    *hashval = nn_cache_hash (key);
+    hitem = nn_hash_get (hash, *hashval);
+    if (!hitem)
+        return NULL;
+    item = nn_cont (hitem, struct nn_cache_item, hitem);
+
+    /*  Different keys with the same hash don't match. */
+    if (nn_chunkref_size (&item->key) != nn_chunkref_size (key) ||
+          memcmp (nn_chunkref_data (&item->key), nn_chunkref_data (key),
+          nn_chunkref_size (key)) != 0)
+        return NULL;
+    return item;
+}
+
+static void nn_cache_rm (struct nn_hash *hash, struct nn_list *list,
+    struct nn_cache_item *item)
+{
+    nn_hash_erase (hash, &item->hitem);
+    nn_list_erase (list, &item->item);
+    nn_hash_item_term (&item->hitem);
+    nn_list_item_term (&item->item);
+    nn_chunkref_term (&item->key);
+    nn_chunkref_term (&item->val);
+    nn_free (item);
+}
@@ -0,0 +1,99 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#ifndef NN_CACHE_INCLUDED
+#define NN_CACHE_INCLUDED
+
+#include "../../utils/chunkref.h"
+#include "../../utils/hash.h"
+#include "../../utils/list.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*  Bounded LRU cache of replies, keyed by the body of the request. Replies
+    are matched to the requests by the backtrace, so the cache has to be told
+    about each request it missed, see nn_cache_pend. */
+
+struct nn_cache_item {
+
+    /*  Keyed by the hash of 'key'. */
+    struct nn_hash_item hitem;
+
+    /*  Position in the LRU list or in the list of pending requests. */
+    struct nn_list_item item;
+
+    /*  Body of the request for a cached reply, backtrace for a pending
+        request. */
+    struct nn_chunkref key;
+
+    /*  The reply, or the body of the pending request. */
+    struct nn_chunkref val;
+
+    /*  When the reply was stored, in milliseconds. */
+    uint64_t stored;
+};
+
+struct nn_cache {
+
+    /*  Maximum number of cached replies. Zero means the cache is disabled. */
+    int size;
+
+    /*  How long the replies are valid, in milliseconds. Negative value means
+        they don't expire. */
+    int ttl;
+
+    /*  Cached replies, the least recently used first. */
+    struct nn_hash replies;
+    struct nn_list lru;
+
+    /*  Requests waiting for the reply, the oldest first. There are at most
+        'size' of them, older ones are forgotten. */
+    struct nn_hash pending;
+    struct nn_list pendlist;
+};
+
+/*  Initialise a disabled cache. */
+void nn_cache_init (struct nn_cache *self);
+
+/*  Release all the resources associated with the cache. */
+void nn_cache_term (struct nn_cache *self);
+
+/*  Change the maximum number of cached replies, evicting the least recently
+    used ones if needed. */
+void nn_cache_resize (struct nn_cache *self, int size);
+
+/*  If there's a valid reply to the request in the cache, initialises 'reply'
+    to it and returns 1. Returns 0 otherwise. */
+int nn_cache_get (struct nn_cache *self, struct nn_chunkref *request,
+    struct nn_chunkref *reply);
+
+/*  Remember the request with the given backtrace as waiting for the reply. */
+void nn_cache_pend (struct nn_cache *self, struct nn_chunkref *backtrace,
+    struct nn_chunkref *request);
+
+/*  If the reply with the given backtrace belongs to a pending request, store
+    the reply in the cache. The reply starts 'offset' bytes into 'reply'. */
+void nn_cache_put (struct nn_cache *self, struct nn_chunkref *backtrace,
+    struct nn_chunkref *reply, size_t offset);
+
+#endif
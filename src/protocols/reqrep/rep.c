@@ -41,27 +41,54 @@ static const struct nn_sockbase_vfptr nn_rep_sockbase_vfptr = {
     NULL,
     nn_rep_destroy,
     nn_xrep_add,
-    nn_xrep_rm,
-    nn_xrep_in,
-    nn_xrep_out,
+    nn_rep_rm,
+    nn_rep_in,
+    nn_rep_out,
     nn_rep_events,
     nn_rep_send,
     nn_rep_recv,
-    NULL,
+    nn_xrep_setopt,
+    nn_xrep_getopt,
+    nn_rep_ctxopen,
+    nn_rep_ctxclose,
+    nn_rep_ctxsend,
+    nn_rep_ctxrecv,
     NULL
 };
 
+static void nn_rep_ctx_init (struct nn_rep_ctx *self);
+static void nn_rep_ctx_term (struct nn_rep_ctx *self);
+static int nn_rep_ctx_send (struct nn_rep *rep, struct nn_rep_ctx *ctx,
+    struct nn_msg *msg);
+static int nn_rep_ctx_recv (struct nn_rep *rep, struct nn_rep_ctx *ctx,
+    struct nn_msg *msg);
+
 void nn_rep_init (struct nn_rep *self,
     const struct nn_sockbase_vfptr *vfptr, void *hint)
 {
     nn_xrep_init (&self->xrep, vfptr, hint);
-    self->flags = 0;
+    nn_rep_ctx_init (&self->ctx);
+    nn_hash_init (&self->ctxs);
+    nn_list_init (&self->ctxlist);
+    self->nextctx = 0;
 }
 
 void nn_rep_term (struct nn_rep *self)
 {
-    if (self->flags & NN_REP_INPROGRESS)
-        nn_chunkref_term (&self->backtrace);
+    struct nn_rep_ctx *ctx;
+
+    /*  Close the contexts left open by the user. */
+    while (!nn_list_empty (&self->ctxlist)) {
+        ctx = nn_cont (nn_list_begin (&self->ctxlist), struct nn_rep_ctx,
+            item);
+        nn_hash_erase (&self->ctxs, &ctx->hitem);
+        nn_list_erase (&self->ctxlist, &ctx->item);
+        nn_rep_ctx_term (ctx);
+        nn_free (ctx);
+    }
+    nn_list_term (&self->ctxlist);
+    nn_hash_term (&self->ctxs);
+    nn_rep_ctx_term (&self->ctx);
     nn_xrep_term (&self->xrep);
 }
 
@@ -82,27 +109,179 @@ int nn_rep_events (struct nn_sockbase *self)
 
     rep = nn_cont (self, struct nn_rep, xrep.sockbase);
     events = nn_xrep_events (&rep->xrep.sockbase);
-    if (!(rep->flags & NN_REP_INPROGRESS))
+    if (!(rep->ctx.flags & NN_REP_INPROGRESS))
         events &= ~NN_SOCKBASE_EVENT_OUT;
     return events;
 }
 
+void nn_rep_rm (struct nn_sockbase *self, struct nn_pipe *pipe)
+{
+    struct nn_rep *rep;
+
+    rep = nn_cont (self, struct nn_rep, xrep.sockbase);
+
+    nn_xrep_rm (&rep->xrep.sockbase, pipe);
+
+    /*  Threads waiting for the requester to accept a reply won't get one,
+        they have to drop the reply instead. */
+    if (!nn_list_empty (&rep->ctxlist))
+        nn_sockbase_ctxnotify (&rep->xrep.sockbase);
+}
+
+void nn_rep_in (struct nn_sockbase *self, struct nn_pipe *pipe)
+{
+    struct nn_rep *rep;
+
+    rep = nn_cont (self, struct nn_rep, xrep.sockbase);
+
+    nn_xrep_in (&rep->xrep.sockbase, pipe);
+
+    /*  There may be threads waiting for a request on the contexts. */
+    if (!nn_list_empty (&rep->ctxlist))
+        nn_sockbase_ctxnotify (&rep->xrep.sockbase);
+}
+
+void nn_rep_out (struct nn_sockbase *self, struct nn_pipe *pipe)
+{
+    struct nn_rep *rep;
+
+    rep = nn_cont (self, struct nn_rep, xrep.sockbase);
+
+    nn_xrep_out (&rep->xrep.sockbase, pipe);
+
+    /*  There may be threads waiting to send a reply on the contexts. */
+    if (!nn_list_empty (&rep->ctxlist))
+        nn_sockbase_ctxnotify (&rep->xrep.sockbase);
+}
+
 int nn_rep_send (struct nn_sockbase *self, struct nn_msg *msg)
 {
-    int rc;
     struct nn_rep *rep;
 
     rep = nn_cont (self, struct nn_rep, xrep.sockbase);
 
+    return nn_rep_ctx_send (rep, &rep->ctx, msg);
+}
+
+int nn_rep_recv (struct nn_sockbase *self, struct nn_msg *msg)
+{
+    struct nn_rep *rep;
+
+    rep = nn_cont (self, struct nn_rep, xrep.sockbase);
+
+    return nn_rep_ctx_recv (rep, &rep->ctx, msg);
+}
+
+int nn_rep_ctxopen (struct nn_sockbase *self)
+{
+    struct nn_rep *rep;
+    struct nn_rep_ctx *ctx;
+    int id;
+
+    rep = nn_cont (self, struct nn_rep, xrep.sockbase);
+
+    /*  Find an unused context ID. */
+    id = rep->nextctx;
+    while (nn_hash_get (&rep->ctxs, (uint32_t) id) != NULL)
+        id = (id + 1) & 0x7fffffff;
+    rep->nextctx = (id + 1) & 0x7fffffff;
+
+    ctx = nn_alloc (sizeof (struct nn_rep_ctx), "reply context");
+    alloc_assert (ctx);
+    nn_rep_ctx_init (ctx);
+    nn_hash_insert (&rep->ctxs, (uint32_t) id, &ctx->hitem);
+    nn_list_insert (&rep->ctxlist, &ctx->item, nn_list_end (&rep->ctxlist));
+
+    return id;
+}
+
+int nn_rep_ctxclose (struct nn_sockbase *self, int ctx)
+{
+    struct nn_rep *rep;
+    struct nn_hash_item *item;
+    struct nn_rep_ctx *c;
+
+    rep = nn_cont (self, struct nn_rep, xrep.sockbase);
+
+    item = nn_hash_get (&rep->ctxs, (uint32_t) ctx);
+    if (nn_slow (!item))
+        return -EBADF;
+    c = nn_cont (item, struct nn_rep_ctx, hitem);
+
+    /*  The request being processed by the context, if any, is dropped. */
+    nn_hash_erase (&rep->ctxs, &c->hitem);
+    nn_list_erase (&rep->ctxlist, &c->item);
+    nn_rep_ctx_term (c);
+    nn_free (c);
+
+    return 0;
+}
+
+int nn_rep_ctxsend (struct nn_sockbase *self, int ctx, struct nn_msg *msg)
+{
+    struct nn_rep *rep;
+    struct nn_hash_item *item;
+
+    rep = nn_cont (self, struct nn_rep, xrep.sockbase);
+
+    item = nn_hash_get (&rep->ctxs, (uint32_t) ctx);
+    if (nn_slow (!item))
+        return -EBADF;
+
+    return nn_rep_ctx_send (rep, nn_cont (item, struct nn_rep_ctx, hitem),
+        msg);
+}
+
+int nn_rep_ctxrecv (struct nn_sockbase *self, int ctx, struct nn_msg *msg)
+{
+    struct nn_rep *rep;
+    struct nn_hash_item *item;
+
+    rep = nn_cont (self, struct nn_rep, xrep.sockbase);
+
+    item = nn_hash_get (&rep->ctxs, (uint32_t) ctx);
+    if (nn_slow (!item))
+        return -EBADF;
+
+    return nn_rep_ctx_recv (rep, nn_cont (item, struct nn_rep_ctx, hitem),
+        msg);
+}
+
+static void nn_rep_ctx_init (struct nn_rep_ctx *self)
+{
+    nn_hash_item_init (&self->hitem);
+    nn_list_item_init (&self->item);
+    self->flags = 0;
+}
+
+static void nn_rep_ctx_term (struct nn_rep_ctx *self)
+{
+    if (self->flags & NN_REP_INPROGRESS)
+        nn_chunkref_term (&self->backtrace);
+    nn_list_item_term (&self->item);
+    nn_hash_item_term (&self->hitem);
+}
+
+static int nn_rep_ctx_send (struct nn_rep *rep, struct nn_rep_ctx *ctx,
+    struct nn_msg *msg)
+{
+    int rc;
+
     /*  If no request was received, there's nowhere to send the reply to. */
-    if (nn_slow (!(rep->flags & NN_REP_INPROGRESS)))
+    if (nn_slow (!(ctx->flags & NN_REP_INPROGRESS)))
         return -EFSM;
 
+    /*  The socket itself drops the reply if the requester is not ready to
+        accept it. As many contexts may reply at once, which is quite likely
+        to hit the pushback, contexts wait for the requester instead. */
+    if (ctx != &rep->ctx && nn_xrep_pushback (&rep->xrep, &ctx->backtrace))
+        return -EAGAIN;
+
     /*  Move the stored backtrace into the message header. */
     nn_assert (nn_chunkref_size (&msg->sphdr) == 0);
     nn_chunkref_term (&msg->sphdr);
-    nn_chunkref_mv (&msg->sphdr, &rep->backtrace);
-    rep->flags &= ~NN_REP_INPROGRESS;
+    nn_chunkref_mv (&msg->sphdr, &ctx->backtrace);
+    ctx->flags &= ~NN_REP_INPROGRESS;
 
     /*  Send the reply. If it cannot be sent because of pushback,
         drop it silently. */
@@ -112,17 +291,15 @@ int nn_rep_send (struct nn_sockbase *self, struct nn_msg *msg)
     return 0;
 }
 
-int nn_rep_recv (struct nn_sockbase *self, struct nn_msg *msg)
+static int nn_rep_ctx_recv (struct nn_rep *rep, struct nn_rep_ctx *ctx,
+    struct nn_msg *msg)
 {
     int rc;
-    struct nn_rep *rep;
-
-    rep = nn_cont (self, struct nn_rep, xrep.sockbase);
 
     /*  If a request is already being processed, cancel it. */
-    if (nn_slow (rep->flags & NN_REP_INPROGRESS)) {
-        nn_chunkref_term (&rep->backtrace);
-        rep->flags &= ~NN_REP_INPROGRESS;
+    if (nn_slow (ctx->flags & NN_REP_INPROGRESS)) {
+        nn_chunkref_term (&ctx->backtrace);
+        ctx->flags &= ~NN_REP_INPROGRESS;
     }
 
     /*  Receive the request. */
@@ -132,9 +309,9 @@ int nn_rep_recv (struct nn_sockbase *self, struct nn_msg *msg)
     errnum_assert (rc == 0, -rc);
 
     /*  Store the backtrace. */
-    nn_chunkref_mv (&rep->backtrace, &msg->sphdr);
+    nn_chunkref_mv (&ctx->backtrace, &msg->sphdr);
     nn_chunkref_init (&msg->sphdr, 0);
-    rep->flags |= NN_REP_INPROGRESS;
+    ctx->flags |= NN_REP_INPROGRESS;
 
     return 0;
 }
@@ -154,7 +331,7 @@ static int nn_rep_create (void *hint, struct nn_sockbase **sockbase)
 struct nn_socktype nn_rep_socktype = {
     AF_SP,
     NN_REP,
-    0,
+    NN_SOCKTYPE_FLAG_DEADLINE,
     nn_rep_create,
     nn_xrep_ispeer,
 };
@@ -26,12 +26,36 @@
 #include "../../protocol.h"
 #include "xrep.h"
 
-struct nn_rep {
-    struct nn_xrep xrep;
+#include "../../utils/hash.h"
+#include "../../utils/list.h"
+
+/*  The request being processed, either by the socket itself or by one of its
+    contexts. */
+struct nn_rep_ctx {
+
+    /*  Member of nn_rep::ctxs, keyed by the context ID, and of
+        nn_rep::ctxlist. Unused for the socket's own request. */
+    struct nn_hash_item hitem;
+    struct nn_list_item item;
+
     uint32_t flags;
+
+    /*  Backtrace of the request, stored till the reply is sent. */
     struct nn_chunkref backtrace;
 };
 
+struct nn_rep {
+    struct nn_xrep xrep;
+    struct nn_rep_ctx ctx;
+
+    /*  Open contexts. */
+    struct nn_hash ctxs;
+    struct nn_list ctxlist;
+
+    /*  ID to try for the next context. */
+    int nextctx;
+};
+
 /*  Some users may want to extend the REP protocol similar to how REP extends XREP.
     Expose these methods to improve extensibility. */
 void nn_rep_init (struct nn_rep *self,
@@ -43,5 +67,12 @@ void nn_rep_destroy (struct nn_sockbase *self);
 int nn_rep_events (struct nn_sockbase *self);
 int nn_rep_send (struct nn_sockbase *self, struct nn_msg *msg);
 int nn_rep_recv (struct nn_sockbase *self, struct nn_msg *msg);
+void nn_rep_rm (struct nn_sockbase *self, struct nn_pipe *pipe);
+void nn_rep_in (struct nn_sockbase *self, struct nn_pipe *pipe);
+void nn_rep_out (struct nn_sockbase *self, struct nn_pipe *pipe);
+int nn_rep_ctxopen (struct nn_sockbase *self);
+int nn_rep_ctxclose (struct nn_sockbase *self, int ctx);
+int nn_rep_ctxsend (struct nn_sockbase *self, int ctx, struct nn_msg *msg);
+int nn_rep_ctxrecv (struct nn_sockbase *self, int ctx, struct nn_msg *msg);
 
 #endif
@@ -36,8 +36,10 @@
 #include "../../utils/random.h"
 #include "../../utils/wire.h"
 #include "../../utils/attr.h"
+#include "../../utils/clock.h"
 
 #include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
 
 /*  Default re-send interval is 1 minute. */
@@ -52,6 +54,7 @@
 #define NN_REQ_STATE_STOPPING_TIMER 7
 #define NN_REQ_STATE_DONE 8
 #define NN_REQ_STATE_STOPPING 9
+#define NN_REQ_STATE_HEDGING 10
 
 #define NN_REQ_ACTION_START 1
 #define NN_REQ_ACTION_IN 2
@@ -61,6 +64,9 @@
 #define NN_REQ_ACTION_PIPE_RM 6
 
 #define NN_REQ_SRC_RESEND_TIMER 1
+#define NN_REQ_SRC_CTX 2
+
+#define NN_REQ_CTX_STOPPED 1
 
 static const struct nn_sockbase_vfptr nn_req_sockbase_vfptr = {
     nn_req_stop,
@@ -73,41 +79,78 @@ static const struct nn_sockbase_vfptr nn_req_sockbase_vfptr = {
     nn_req_csend,
     nn_req_crecv,
     nn_req_setopt,
-    nn_req_getopt
+    nn_req_getopt,
+    nn_req_ctxopen,
+    nn_req_ctxclose,
+    nn_req_ctxsend,
+    nn_req_ctxrecv,
+    nn_req_sendbatch
 };
 
+static int nn_req_task_inprogress (struct nn_task *task);
+static int nn_req_task_send (struct nn_task *task, struct nn_msg *msg);
+static int nn_req_task_recv (struct nn_task *task, struct nn_msg *msg);
+static void nn_req_task_rm (struct nn_task *task, struct nn_pipe *pipe);
+static void nn_req_task_release (struct nn_task *task, int latency);
+static void nn_req_task_stamp (struct nn_task *task, struct nn_msg *msg,
+    int ivl);
+static int nn_req_hedge_delay (struct nn_req *self);
+static void nn_req_record_latency (struct nn_req *self, int latency);
+static int nn_req_cmp_latency (const void *a, const void *b);
+static int nn_req_ctx_newid (struct nn_req *self);
+static struct nn_task *nn_req_ctx_new (struct nn_req *self, int id,
+    nn_fsm_fn handler);
+static void nn_req_ctx_stop (struct nn_req *self, struct nn_task *task);
+static void nn_req_ctx_destroy (struct nn_req *self, struct nn_task *task);
+static void nn_req_ctx_shutdown (struct nn_fsm *self, int src, int type,
+    void *srcptr);
+static int nn_req_batch_next (struct nn_task *batch, struct nn_msg *msg);
+static void nn_req_batch_expire (struct nn_req *self, struct nn_task *batch);
+static void nn_req_batch_handler (struct nn_fsm *self, int src, int type,
+    void *srcptr);
+
 void nn_req_init (struct nn_req *self,
     const struct nn_sockbase_vfptr *vfptr, void *hint)
 {
     nn_xreq_init (&self->xreq, vfptr, hint);
-    nn_fsm_init_root (&self->fsm, nn_req_handler, nn_req_shutdown,
+
+    /*  Requests are considered in flight till the reply arrives. */
+    self->xreq.lb.replies = 1;
+
+    nn_fsm_init_root (&self->task.fsm, nn_req_handler, nn_req_shutdown,
         nn_sockbase_getctx (&self->xreq.sockbase));
-    self->state = NN_REQ_STATE_IDLE;
+    self->task.state = NN_REQ_STATE_IDLE;
 
     /*  Start assigning request IDs beginning with a random number. This way
         there should be no key clashes even if the executable is re-started. */
     nn_random_generate (&self->lastid, sizeof (self->lastid));
 
-    self->task.sent_to = NULL;
-
-    nn_msg_init (&self->task.request, 0);
-    nn_msg_init (&self->task.reply, 0);
-    nn_timer_init (&self->task.timer, NN_REQ_SRC_RESEND_TIMER, &self->fsm);
     self->resend_ivl = NN_REQ_DEFAULT_RESEND_IVL;
-
-    nn_task_init (&self->task, self->lastid);
+    self->hedge_ivl = -1;
+    self->hedge_percentile = 0;
+    self->nlatencies = 0;
+    self->latencypos = 0;
+    self->hedge_delay = -1;
+
+    nn_task_init (&self->task, self, -1, NN_REQ_SRC_RESEND_TIMER);
+    nn_hash_init (&self->tasks);
+    nn_list_init (&self->delayed);
+    nn_hash_init (&self->ctxs);
+    nn_list_init (&self->ctxlist);
+    self->nextctx = 0;
 
     /*  Start the state machine. */
-    nn_fsm_start (&self->fsm);
+    nn_fsm_start (&self->task.fsm);
 }
 
 void nn_req_term (struct nn_req *self)
 {
-    nn_timer_term (&self->task.timer);
+    nn_list_term (&self->ctxlist);
+    nn_hash_term (&self->ctxs);
+    nn_list_term (&self->delayed);
+    nn_hash_term (&self->tasks);
     nn_task_term (&self->task);
-    nn_msg_term (&self->task.reply);
-    nn_msg_term (&self->task.request);
-    nn_fsm_term (&self->fsm);
+    nn_fsm_term (&self->task.fsm);
     nn_xreq_term (&self->xreq);
 }
 
@@ -117,7 +160,7 @@ void nn_req_stop (struct nn_sockbase *self)
 
     req = nn_cont (self, struct nn_req, xreq.sockbase);
 
-    nn_fsm_stop (&req->fsm);
+    nn_fsm_stop (&req->task.fsm);
 }
 
 void nn_req_destroy (struct nn_sockbase *self)
@@ -131,18 +174,28 @@ void nn_req_destroy (struct nn_sockbase *self)
 }
 
 int nn_req_inprogress (struct nn_req *self)
+{
+    return nn_req_task_inprogress (&self->task);
+}
+
+static int nn_req_task_inprogress (struct nn_task *task)
 {
     /*  Return 1 if there's a request submitted. 0 otherwise. */
-    return self->state == NN_REQ_STATE_IDLE ||
-        self->state == NN_REQ_STATE_PASSIVE ||
-        self->state == NN_REQ_STATE_STOPPING ? 0 : 1;
+    return task->state == NN_REQ_STATE_IDLE ||
+        task->state == NN_REQ_STATE_PASSIVE ||
+        task->state == NN_REQ_STATE_STOPPING ? 0 : 1;
 }
 
 void nn_req_in (struct nn_sockbase *self, struct nn_pipe *pipe)
 {
     int rc;
     struct nn_req *req;
+    struct nn_msg msg;
     uint32_t reqid;
+    struct nn_hash_item *item;
+    struct nn_task *task;
+    struct nn_pipe *from;
+    int latency;
 
     req = nn_cont (self, struct nn_req, xreq.sockbase);
 
@@ -152,61 +205,94 @@ void nn_req_in (struct nn_sockbase *self, struct nn_pipe *pipe)
     while (1) {
 
         /*  Get new reply. */
-        rc = nn_xreq_recv (&req->xreq.sockbase, &req->task.reply);
+        rc = nn_xreq_recv_from (&req->xreq.sockbase, &msg, &from);
         if (nn_slow (rc == -EAGAIN))
             return;
         errnum_assert (rc == 0, -rc);
 
-        /*  No request was sent. Getting a reply doesn't make sense. */
-        if (nn_slow (!nn_req_inprogress (req))) {
-            nn_msg_term (&req->task.reply);
-            continue;
-        }
-
         /*  Ignore malformed replies. */
-        if (nn_slow (nn_chunkref_size (&req->task.reply.sphdr) !=
-              sizeof (uint32_t))) {
-            nn_msg_term (&req->task.reply);
+        if (nn_slow (nn_chunkref_size (&msg.sphdr) != sizeof (uint32_t))) {
+            nn_msg_term (&msg);
             continue;
         }
 
-        /*  Ignore replies with incorrect request IDs. */
-        reqid = nn_getl (nn_chunkref_data (&req->task.reply.sphdr));
+        /*  Ignore replies with incorrect request IDs. Find the task the reply
+            belongs to otherwise. If no request was sent, there's no task
+            waiting for the reply and getting it doesn't make sense. */
+        reqid = nn_getl (nn_chunkref_data (&msg.sphdr));
         if (nn_slow (!(reqid & 0x80000000))) {
-            nn_msg_term (&req->task.reply);
+            nn_msg_term (&msg);
             continue;
         }
-        if (nn_slow (reqid != (req->task.id | 0x80000000))) {
-            nn_msg_term (&req->task.reply);
+        item = nn_hash_get (&req->tasks, reqid);
+        if (nn_slow (!item)) {
+            nn_msg_term (&msg);
             continue;
         }
+        task = nn_cont (item, struct nn_task, iditem);
 
-        /*  Trim the request ID. */
-        nn_chunkref_term (&req->task.reply.sphdr);
-        nn_chunkref_init (&req->task.reply.sphdr, 0);
-
-        /*  TODO: Deallocate the request here? */
+        /*  Reply to a request that is being re-sent at the moment. The reply
+            to the re-sent request will be accepted instead. */
+        if (nn_slow (task->state != NN_REQ_STATE_ACTIVE &&
+              task->state != NN_REQ_STATE_HEDGING)) {
+            nn_msg_term (&msg);
+            continue;
+        }
 
-        /*  Notify the state machine. */
-        if (req->state == NN_REQ_STATE_ACTIVE)
-            nn_fsm_action (&req->fsm, NN_REQ_ACTION_IN);
+        /*  The first reply wins. If the request was hedged, the reply from
+            the other peer won't find the task anymore and will be dropped. */
+        if (nn_slow (task->hedged_to != NULL && from == task->hedged_to))
+            nn_sockbase_stat_increment (&req->xreq.sockbase,
+                NN_STAT_HEDGES_WON, 1);
+        latency = -1;
+        if (req->hedge_percentile > 0 ||
+              nn_lb_get_strategy (&req->xreq.lb) != NN_LB_ROUND_ROBIN) {
+            latency = (int) (nn_clock_ms () - task->sent_at);
+            if (req->hedge_percentile > 0)
+                nn_req_record_latency (req, latency);
+        }
+        nn_req_task_release (task, latency);
 
-        return;
+        /*  Trim the request ID. */
+        nn_chunkref_term (&msg.sphdr);
+        nn_chunkref_init (&msg.sphdr, 0);
+
+        /*  Store the reply and notify the state machine. There may be more
+            replies for other tasks in the pipe so keep reading. */
+        nn_hash_erase (&req->tasks, &task->iditem);
+        nn_msg_term (&task->reply);
+        nn_msg_mv (&task->reply, &msg);
+        nn_fsm_action (&task->fsm, NN_REQ_ACTION_IN);
     }
 }
 
 void nn_req_out (struct nn_sockbase *self, struct nn_pipe *pipe)
 {
+    int hashed;
     struct nn_req *req;
+    struct nn_task *task;
+    struct nn_list_item *it;
+    struct nn_list_item *next;
 
     req = nn_cont (self, struct nn_req, xreq.sockbase);
 
     /*  Add the pipe to the underlying raw socket. */
     nn_xreq_out (&req->xreq.sockbase, pipe);
 
-    /*  Notify the state machine. */
-    if (req->state == NN_REQ_STATE_DELAYED)
-        nn_fsm_action (&req->fsm, NN_REQ_ACTION_OUT);
+    /*  Notify the state machines waiting for a pipe, in the order they've
+        started waiting, until the pipe is full again. With consistent
+        hashing, each request waits for the pipe its key maps to, so one
+        that still can't be sent doesn't hold back the others. */
+    hashed = nn_lb_get_strategy (&req->xreq.lb) == NN_LB_CONSISTENT_HASH;
+    it = nn_list_begin (&req->delayed);
+    while (it != nn_list_end (&req->delayed)) {
+        next = nn_list_next (&req->delayed, it);
+        task = nn_cont (it, struct nn_task, delayeditem);
+        nn_fsm_action (&task->fsm, NN_REQ_ACTION_OUT);
+        if (task->state == NN_REQ_STATE_DELAYED && !hashed)
+            break;
+        it = next;
+    }
 }
 
 int nn_req_events (struct nn_sockbase *self)
@@ -220,8 +306,9 @@ int nn_req_events (struct nn_sockbase *self)
         another one is being processed cancels the old one. */
     rc = NN_SOCKBASE_EVENT_OUT;
 
-    /*  In DONE state the reply is stored in 'reply' field. */
-    if (req->state == NN_REQ_STATE_DONE)
+    /*  In DONE state the reply is stored in 'reply' field. The contexts
+        are not reflected here, see nn_sockbase_ctxnotify. */
+    if (req->task.state == NN_REQ_STATE_DONE)
         rc |= NN_SOCKBASE_EVENT_IN;
 
     return rc;
@@ -233,49 +320,334 @@ int nn_req_csend (struct nn_sockbase *self, struct nn_msg *msg)
 
     req = nn_cont (self, struct nn_req, xreq.sockbase);
 
+    return nn_req_task_send (&req->task, msg);
+}
+
+int nn_req_crecv (struct nn_sockbase *self, struct nn_msg *msg)
+{
+    struct nn_req *req;
+
+    req = nn_cont (self, struct nn_req, xreq.sockbase);
+
+    return nn_req_task_recv (&req->task, msg);
+}
+
+static int nn_req_task_send (struct nn_task *task, struct nn_msg *msg)
+{
+    struct nn_req *req;
+
+    req = task->req;
+
+    /*  The reply to the previous request, if any, won't be accepted
+        anymore. */
+    if (nn_list_item_isinlist (&task->iditem.list))
+        nn_hash_erase (&req->tasks, &task->iditem);
+
     /*  Generate new request ID for the new request and put it into message
         header. The most important bit is set to 1 to indicate that this is
-        the bottom of the backtrace stack. */
-    ++req->task.id;
+        the bottom of the backtrace stack. The IDs are shared by all the
+        tasks of the socket, so skip any ID still in use by another task. */
+    do {
+        task->id = (++req->lastid) | 0x80000000;
+    } while (nn_slow (nn_hash_get (&req->tasks, task->id) != NULL));
+    nn_hash_insert (&req->tasks, task->id, &task->iditem);
     nn_assert (nn_chunkref_size (&msg->sphdr) == 0);
     nn_chunkref_term (&msg->sphdr);
     nn_chunkref_init (&msg->sphdr, 4);
-    nn_putl (nn_chunkref_data (&msg->sphdr), req->task.id | 0x80000000);
+    nn_putl (nn_chunkref_data (&msg->sphdr), task->id);
 
     /*  Store the message so that it can be re-sent if there's no reply. */
-    nn_msg_term (&req->task.request);
-    nn_msg_mv (&req->task.request, msg);
+    nn_msg_term (&task->request);
+    nn_msg_mv (&task->request, msg);
+
+    /*  Drop the reply to the previous request if it wasn't retrieved. */
+    nn_msg_term (&task->reply);
+    nn_msg_init (&task->reply, 0);
 
     /*  Notify the state machine. */
-    nn_fsm_action (&req->fsm, NN_REQ_ACTION_SENT);
+    nn_fsm_action (&task->fsm, NN_REQ_ACTION_SENT);
 
     return 0;
 }
 
-int nn_req_crecv (struct nn_sockbase *self, struct nn_msg *msg)
+static int nn_req_task_recv (struct nn_task *task, struct nn_msg *msg)
 {
-    struct nn_req *req;
-
-    req = nn_cont (self, struct nn_req, xreq.sockbase);
-
     /*  No request was sent. Waiting for a reply doesn't make sense. */
-    if (nn_slow (!nn_req_inprogress (req)))
+    if (nn_slow (!nn_req_task_inprogress (task)))
         return -EFSM;
 
     /*  If reply was not yet recieved, wait further. */
-    if (nn_slow (req->state != NN_REQ_STATE_DONE))
+    if (nn_slow (task->state != NN_REQ_STATE_DONE))
         return -EAGAIN;
 
     /*  If the reply was already received, just pass it to the caller. */
-    nn_msg_mv (msg, &req->task.reply);
-    nn_msg_init (&req->task.reply, 0);
+    nn_msg_mv (msg, &task->reply);
+    nn_msg_init (&task->reply, 0);
 
     /*  Notify the state machine. */
-    nn_fsm_action (&req->fsm, NN_REQ_ACTION_RECEIVED);
+    nn_fsm_action (&task->fsm, NN_REQ_ACTION_RECEIVED);
 
     return 0;
 }
 
+int nn_req_ctxopen (struct nn_sockbase *self)
+{
+    struct nn_req *req;
+    struct nn_task *task;
+    int id;
+
+    req = nn_cont (self, struct nn_req, xreq.sockbase);
+
+    id = nn_req_ctx_newid (req);
+    task = nn_req_ctx_new (req, id, nn_req_handler);
+    nn_hash_insert (&req->ctxs, (uint32_t) id, &task->ctxitem);
+    nn_fsm_start (&task->fsm);
+
+    return id;
+}
+
+int nn_req_sendbatch (struct nn_sockbase *self, struct nn_msg *msgs,
+    int nmsgs, int timeout)
+{
+    int rc;
+    struct nn_req *req;
+    struct nn_task *batch;
+    struct nn_task *task;
+    int id;
+    int i;
+
+    req = nn_cont (self, struct nn_req, xreq.sockbase);
+
+    /*  The batch is a context the replies are received from. */
+    id = nn_req_ctx_newid (req);
+    batch = nn_req_ctx_new (req, id, nn_req_batch_handler);
+    batch->isbatch = 1;
+    batch->pending = nmsgs;
+    nn_hash_insert (&req->ctxs, (uint32_t) id, &batch->ctxitem);
+    nn_fsm_start (&batch->fsm);
+    if (timeout >= 0) {
+        batch->deadline = nn_clock_ms () + timeout;
+        nn_timer_start (&batch->timer, timeout);
+    }
+
+    /*  Each request is processed by a task of its own, the same way as
+        a request sent from a context, so it's spread over the peers by
+        the load balancer and re-sent if the reply doesn't arrive in time.
+        Unlike contexts, these tasks can't be addressed by the user. */
+    for (i = 0; i != nmsgs; ++i) {
+        task = nn_req_ctx_new (req, id, nn_req_handler);
+        task->batch = batch;
+        task->batchidx = i;
+        nn_fsm_start (&task->fsm);
+        rc = nn_req_task_send (task, &msgs [i]);
+        errnum_assert (rc == 0, -rc);
+    }
+
+    return id;
+}
+
+int nn_req_ctxclose (struct nn_sockbase *self, int ctx)
+{
+    struct nn_req *req;
+    struct nn_hash_item *item;
+
+    req = nn_cont (self, struct nn_req, xreq.sockbase);
+
+    item = nn_hash_get (&req->ctxs, (uint32_t) ctx);
+    if (nn_slow (!item))
+        return -EBADF;
+    nn_req_ctx_stop (req, nn_cont (item, struct nn_task, ctxitem));
+
+    return 0;
+}
+
+int nn_req_ctxsend (struct nn_sockbase *self, int ctx, struct nn_msg *msg)
+{
+    struct nn_req *req;
+    struct nn_hash_item *item;
+    struct nn_task *task;
+
+    req = nn_cont (self, struct nn_req, xreq.sockbase);
+
+    item = nn_hash_get (&req->ctxs, (uint32_t) ctx);
+    if (nn_slow (!item))
+        return -EBADF;
+    task = nn_cont (item, struct nn_task, ctxitem);
+
+    /*  All the requests of a batch are sent when it's created. */
+    if (nn_slow (task->isbatch))
+        return -EFSM;
+
+    return nn_req_task_send (task, msg);
+}
+
+int nn_req_ctxrecv (struct nn_sockbase *self, int ctx, struct nn_msg *msg)
+{
+    struct nn_req *req;
+    struct nn_hash_item *item;
+    struct nn_task *task;
+
+    req = nn_cont (self, struct nn_req, xreq.sockbase);
+
+    item = nn_hash_get (&req->ctxs, (uint32_t) ctx);
+    if (nn_slow (!item))
+        return -EBADF;
+    task = nn_cont (item, struct nn_task, ctxitem);
+
+    if (task->isbatch)
+        return nn_req_batch_next (task, msg);
+
+    return nn_req_task_recv (task, msg);
+}
+
+static int nn_req_ctx_newid (struct nn_req *self)
+{
+    int id;
+
+    /*  Find an unused context ID. */
+    id = self->nextctx;
+    while (nn_hash_get (&self->ctxs, (uint32_t) id) != NULL)
+        id = (id + 1) & 0x7fffffff;
+    self->nextctx = (id + 1) & 0x7fffffff;
+
+    return id;
+}
+
+static struct nn_task *nn_req_ctx_new (struct nn_req *self, int id,
+    nn_fsm_fn handler)
+{
+    struct nn_task *task;
+
+    /*  The context is a task with a state machine of its own. It's owned
+        by the root state machine of the socket. */
+    task = nn_alloc (sizeof (struct nn_task), "request context");
+    alloc_assert (task);
+    nn_fsm_init (&task->fsm, handler, nn_req_ctx_shutdown,
+        NN_REQ_SRC_CTX, task, &self->task.fsm);
+    task->state = NN_REQ_STATE_IDLE;
+    nn_task_init (task, self, id, NN_REQ_SRC_RESEND_TIMER);
+    nn_list_insert (&self->ctxlist, &task->item,
+        nn_list_end (&self->ctxlist));
+
+    return task;
+}
+
+static void nn_req_ctx_stop (struct nn_req *self, struct nn_task *task)
+{
+    struct nn_list_item *it;
+    struct nn_task *member;
+
+    /*  Abandon the requests of a batch along with the batch itself. */
+    if (task->isbatch) {
+        for (it = nn_list_begin (&self->ctxlist);
+              it != nn_list_end (&self->ctxlist);
+              it = nn_list_next (&self->ctxlist, it)) {
+            member = nn_cont (it, struct nn_task, item);
+            if (member->batch == task)
+                nn_req_ctx_stop (self, member);
+        }
+    }
+    if (task->batch) {
+        if (nn_list_item_isinlist (&task->doneitem))
+            nn_list_erase (&task->batch->done, &task->doneitem);
+        task->batch = NULL;
+    }
+
+    /*  Make the context unreachable. Any reply that arrives later on
+        is dropped as stale. */
+    if (nn_list_item_isinlist (&task->ctxitem.list))
+        nn_hash_erase (&self->ctxs, &task->ctxitem);
+    if (nn_list_item_isinlist (&task->iditem.list))
+        nn_hash_erase (&self->tasks, &task->iditem);
+    if (nn_list_item_isinlist (&task->delayeditem))
+        nn_list_erase (&self->delayed, &task->delayeditem);
+    nn_req_task_release (task, -1);
+
+    nn_fsm_stop (&task->fsm);
+}
+
+static void nn_req_ctx_destroy (struct nn_req *self, struct nn_task *task)
+{
+    nn_list_erase (&self->ctxlist, &task->item);
+    nn_task_term (task);
+    nn_fsm_term (&task->fsm);
+    nn_free (task);
+}
+
+static void nn_req_ctx_shutdown (struct nn_fsm *self, int src, int type,
+    NN_UNUSED void *srcptr)
+{
+    struct nn_task *task;
+
+    task = nn_cont (self, struct nn_task, fsm);
+
+    if (nn_slow (src == NN_FSM_ACTION && type == NN_FSM_STOP)) {
+        nn_timer_stop (&task->timer);
+        task->state = NN_REQ_STATE_STOPPING;
+    }
+    if (nn_slow (task->state == NN_REQ_STATE_STOPPING)) {
+        if (!nn_timer_isidle (&task->timer))
+            return;
+        task->state = NN_REQ_STATE_IDLE;
+        nn_fsm_stopped (&task->fsm, NN_REQ_CTX_STOPPED);
+        return;
+    }
+
+    nn_fsm_bad_state (task->state, src, type);
+}
+
+static int nn_req_batch_next (struct nn_task *batch, struct nn_msg *msg)
+{
+    struct nn_task *task;
+
+    /*  Pass the replies to the user in the order they've arrived. The index
+        of the request is passed in the SP header. The task of the request
+        is not needed any more. */
+    if (!nn_list_empty (&batch->done)) {
+        task = nn_cont (nn_list_begin (&batch->done), struct nn_task,
+            doneitem);
+        nn_msg_mv (msg, &task->reply);
+        nn_msg_init (&task->reply, 0);
+        nn_chunkref_term (&msg->sphdr);
+        nn_chunkref_init (&msg->sphdr, sizeof (uint32_t));
+        nn_putl (nn_chunkref_data (&msg->sphdr), (uint32_t) task->batchidx);
+        --batch->pending;
+        nn_req_ctx_stop (batch->req, task);
+        return 0;
+    }
+
+    /*  All the replies were already retrieved. */
+    if (nn_slow (batch->pending == 0))
+        return -EFSM;
+
+    /*  The replies that didn't arrive before the deadline never will. */
+    if (nn_slow (batch->state != NN_REQ_STATE_ACTIVE))
+        return -ETIMEDOUT;
+
+    return -EAGAIN;
+}
+
+static void nn_req_batch_expire (struct nn_req *self, struct nn_task *batch)
+{
+    struct nn_list_item *it;
+    struct nn_task *task;
+
+    /*  Abandon the requests still waiting for the reply. The replies that
+        have already arrived can still be retrieved. */
+    for (it = nn_list_begin (&self->ctxlist);
+          it != nn_list_end (&self->ctxlist);
+          it = nn_list_next (&self->ctxlist, it)) {
+        task = nn_cont (it, struct nn_task, item);
+        if (task->batch == batch &&
+              task->state != NN_REQ_STATE_STOPPING_TIMER &&
+              task->state != NN_REQ_STATE_DONE)
+            nn_req_ctx_stop (self, task);
+    }
+
+    /*  Let the threads waiting for a reply know. */
+    nn_sockbase_ctxnotify (&self->xreq.sockbase);
+}
+
 int nn_req_setopt (struct nn_sockbase *self, int level, int option,
         const void *optval, size_t optvallen)
 {
@@ -293,7 +665,28 @@ int nn_req_setopt (struct nn_sockbase *self, int level, int option,
         return 0;
     }
 
-    return -ENOPROTOOPT;
+    if (option == NN_REQ_HEDGE_IVL) {
+        if (nn_slow (optvallen != sizeof (int)))
+            return -EINVAL;
+        req->hedge_ivl = *(int*) optval < 0 ? -1 : *(int*) optval;
+        return 0;
+    }
+
+    if (option == NN_REQ_HEDGE_PERCENTILE) {
+        if (nn_slow (optvallen != sizeof (int)))
+            return -EINVAL;
+        if (nn_slow (*(int*) optval < 0 || *(int*) optval > 100))
+            return -EINVAL;
+        req->hedge_percentile = *(int*) optval;
+
+        /*  Start collecting the latencies afresh. */
+        req->nlatencies = 0;
+        req->latencypos = 0;
+        req->hedge_delay = -1;
+        return 0;
+    }
+
+    return nn_xreq_setopt (self, level, option, optval, optvallen);
 }
 
 int nn_req_getopt (struct nn_sockbase *self, int level, int option,
@@ -314,40 +707,83 @@ int nn_req_getopt (struct nn_sockbase *self, int level, int option,
         return 0;
     }
 
-    return -ENOPROTOOPT;
+    if (option == NN_REQ_HEDGE_IVL) {
+        if (nn_slow (*optvallen < sizeof (int)))
+            return -EINVAL;
+        *(int*) optval = req->hedge_ivl;
+        *optvallen = sizeof (int);
+        return 0;
+    }
+
+    if (option == NN_REQ_HEDGE_PERCENTILE) {
+        if (nn_slow (*optvallen < sizeof (int)))
+            return -EINVAL;
+        *(int*) optval = req->hedge_percentile;
+        *optvallen = sizeof (int);
+        return 0;
+    }
+
+    return nn_xreq_getopt (self, level, option, optval, optvallen);
 }
 
 void nn_req_shutdown (struct nn_fsm *self, int src, int type,
-    NN_UNUSED void *srcptr)
+    void *srcptr)
 {
+    struct nn_task *task;
     struct nn_req *req;
+    struct nn_list_item *it;
 
-    req = nn_cont (self, struct nn_req, fsm);
+    task = nn_cont (self, struct nn_task, fsm);
+    req = task->req;
 
     if (nn_slow (src == NN_FSM_ACTION && type == NN_FSM_STOP)) {
-        nn_timer_stop (&req->task.timer);
-        req->state = NN_REQ_STATE_STOPPING;
+        if (nn_list_item_isinlist (&task->iditem.list))
+            nn_hash_erase (&req->tasks, &task->iditem);
+        if (nn_list_item_isinlist (&task->delayeditem))
+            nn_list_erase (&req->delayed, &task->delayeditem);
+        nn_timer_stop (&task->timer);
+
+        /*  Stop the contexts that are still open. */
+        for (it = nn_list_begin (&req->ctxlist);
+              it != nn_list_end (&req->ctxlist);
+              it = nn_list_next (&req->ctxlist, it)) {
+            task = nn_cont (it, struct nn_task, item);
+            if (nn_list_item_isinlist (&task->ctxitem.list))
+                nn_req_ctx_stop (req, task);
+        }
+        req->task.state = NN_REQ_STATE_STOPPING;
     }
-    if (nn_slow (req->state == NN_REQ_STATE_STOPPING)) {
-        if (!nn_timer_isidle (&req->task.timer))
+    if (nn_slow (src == NN_REQ_SRC_CTX && type == NN_REQ_CTX_STOPPED))
+        nn_req_ctx_destroy (req, (struct nn_task*) srcptr);
+    if (nn_slow (req->task.state == NN_REQ_STATE_STOPPING)) {
+        if (!nn_timer_isidle (&req->task.timer) ||
+              !nn_list_empty (&req->ctxlist))
             return;
-        req->state = NN_REQ_STATE_IDLE;
-        nn_fsm_stopped_noevent (&req->fsm);
+        req->task.state = NN_REQ_STATE_IDLE;
+        nn_fsm_stopped_noevent (&req->task.fsm);
         nn_sockbase_stopped (&req->xreq.sockbase);
         return;
     }
 
-    nn_fsm_bad_state(req->state, src, type);
+    nn_fsm_bad_state (req->task.state, src, type);
 }
 
 void nn_req_handler (struct nn_fsm *self, int src, int type,
-    NN_UNUSED void *srcptr)
+    void *srcptr)
 {
-    struct nn_req *req;
+    struct nn_task *task;
 
-    req = nn_cont (self, struct nn_req, fsm);
+    task = nn_cont (self, struct nn_task, fsm);
 
-    switch (req->state) {
+    /*  A closed context has stopped. This can only happen in the root
+        state machine, which owns the contexts. */
+    if (nn_slow (src == NN_REQ_SRC_CTX)) {
+        nn_assert (type == NN_REQ_CTX_STOPPED);
+        nn_req_ctx_destroy (task->req, (struct nn_task*) srcptr);
+        return;
+    }
+
+    switch (task->state) {
 
 /******************************************************************************/
 /*  IDLE state.                                                               */
@@ -360,14 +796,14 @@ void nn_req_handler (struct nn_fsm *self, int src, int type,
         case NN_FSM_ACTION:
             switch (type) {
             case NN_FSM_START:
-                req->state = NN_REQ_STATE_PASSIVE;
+                task->state = NN_REQ_STATE_PASSIVE;
                 return;
             default:
-                nn_fsm_bad_action (req->state, src, type);
+                nn_fsm_bad_action (task->state, src, type);
             }
 
         default:
-            nn_fsm_bad_source (req->state, src, type);
+            nn_fsm_bad_source (task->state, src, type);
         }
 
 /******************************************************************************/
@@ -380,14 +816,14 @@ void nn_req_handler (struct nn_fsm *self, int src, int type,
         case NN_FSM_ACTION:
             switch (type) {
             case NN_REQ_ACTION_SENT:
-                nn_req_action_send (req, 1);
+                nn_req_action_send (task);
                 return;
             default:
-                nn_fsm_bad_action (req->state, src, type);
+                nn_fsm_bad_action (task->state, src, type);
             }
 
         default:
-            nn_fsm_bad_source (req->state, src, type);
+            nn_fsm_bad_source (task->state, src, type);
         }
 
 /******************************************************************************/
@@ -402,16 +838,19 @@ void nn_req_handler (struct nn_fsm *self, int src, int type,
         case NN_FSM_ACTION:
             switch (type) {
             case NN_REQ_ACTION_OUT:
-                nn_req_action_send (req, 0);
+                nn_req_action_send (task);
                 return;
             case NN_REQ_ACTION_SENT:
+
+                /*  The new request replaces the old one which was not sent
+                    yet. */
                 return;
             default:
-                nn_fsm_bad_action (req->state, src, type);
+                nn_fsm_bad_action (task->state, src, type);
             }
 
         default:
-            nn_fsm_bad_source (req->state, src, type);
+            nn_fsm_bad_source (task->state, src, type);
         }
 
 /******************************************************************************/
@@ -426,45 +865,95 @@ void nn_req_handler (struct nn_fsm *self, int src, int type,
             case NN_REQ_ACTION_IN:
 
                 /*  Reply arrived. */
-                nn_timer_stop (&req->task.timer);
-                req->task.sent_to = NULL;
-                req->state = NN_REQ_STATE_STOPPING_TIMER;
+                nn_timer_stop (&task->timer);
+                nn_req_task_release (task, -1);
+                task->state = NN_REQ_STATE_STOPPING_TIMER;
                 return;
 
             case NN_REQ_ACTION_SENT:
 
                 /*  New request was sent while the old one was still being
                     processed. Cancel the old request first. */
-                nn_timer_stop (&req->task.timer);
-                req->task.sent_to = NULL;
-                req->state = NN_REQ_STATE_CANCELLING;
+                nn_timer_stop (&task->timer);
+                nn_req_task_release (task, -1);
+                task->state = NN_REQ_STATE_CANCELLING;
                 return;
 
             case NN_REQ_ACTION_PIPE_RM:
                 /*  Pipe that we sent request to is removed  */
-                nn_timer_stop (&req->task.timer);
-                req->task.sent_to = NULL;
+                nn_timer_stop (&task->timer);
+                task->sent_to = NULL;
                 /*  Pretend we timed out so request resent immediately  */
-                req->state = NN_REQ_STATE_TIMED_OUT;
+                task->state = NN_REQ_STATE_TIMED_OUT;
                 return;
 
             default:
-                nn_fsm_bad_action (req->state, src, type);
+                nn_fsm_bad_action (task->state, src, type);
             }
 
         case NN_REQ_SRC_RESEND_TIMER:
             switch (type) {
             case NN_TIMER_TIMEOUT:
-                nn_timer_stop (&req->task.timer);
-                req->task.sent_to = NULL;
-                req->state = NN_REQ_STATE_TIMED_OUT;
+
+                /*  Reply is late. Send a copy of the request to another
+                    peer once the timer is stopped. */
+                if (task->hedge_pending) {
+                    nn_timer_stop (&task->timer);
+                    task->state = NN_REQ_STATE_HEDGING;
+                    return;
+                }
+
+                nn_timer_stop (&task->timer);
+                nn_req_task_release (task,
+                    (int) (nn_clock_ms () - task->sent_at));
+                task->state = NN_REQ_STATE_TIMED_OUT;
                 return;
             default:
-                nn_fsm_bad_action (req->state, src, type);
+                nn_fsm_bad_action (task->state, src, type);
             }
 
         default:
-            nn_fsm_bad_source (req->state, src, type);
+            nn_fsm_bad_source (task->state, src, type);
+        }
+
+/******************************************************************************/
+/*  HEDGING state.                                                            */
+/*  Reply didn't arrive within the hedging delay. Stopping the timer.         */
+/*  Afterwards, we'll send a copy of the request to another peer. Reply to    */
+/*  the original request is still accepted in the meantime.                   */
+/******************************************************************************/
+    case NN_REQ_STATE_HEDGING:
+        switch (src) {
+
+        case NN_REQ_SRC_RESEND_TIMER:
+            switch (type) {
+            case NN_TIMER_STOPPED:
+                nn_req_action_hedge (task);
+                return;
+            default:
+                nn_fsm_bad_action (task->state, src, type);
+            }
+
+        case NN_FSM_ACTION:
+            switch (type) {
+            case NN_REQ_ACTION_IN:
+                nn_req_task_release (task, -1);
+                task->state = NN_REQ_STATE_STOPPING_TIMER;
+                return;
+            case NN_REQ_ACTION_SENT:
+                nn_req_task_release (task, -1);
+                task->state = NN_REQ_STATE_CANCELLING;
+                return;
+            case NN_REQ_ACTION_PIPE_RM:
+                task->sent_to = NULL;
+                task->state = NN_REQ_STATE_TIMED_OUT;
+                return;
+            default:
+                nn_fsm_bad_action (task->state, src, type);
+            }
+
+        default:
+            nn_fsm_bad_source (task->state, src, type);
         }
 
 /******************************************************************************/
@@ -478,23 +967,23 @@ void nn_req_handler (struct nn_fsm *self, int src, int type,
         case NN_REQ_SRC_RESEND_TIMER:
             switch (type) {
             case NN_TIMER_STOPPED:
-                nn_req_action_send (req, 1);
+                nn_req_action_send (task);
                 return;
             default:
-                nn_fsm_bad_action (req->state, src, type);
+                nn_fsm_bad_action (task->state, src, type);
             }
 
         case NN_FSM_ACTION:
             switch (type) {
             case NN_REQ_ACTION_SENT:
-                req->state = NN_REQ_STATE_CANCELLING;
+                task->state = NN_REQ_STATE_CANCELLING;
                 return;
             default:
-                nn_fsm_bad_action (req->state, src, type);
+                nn_fsm_bad_action (task->state, src, type);
             }
 
         default:
-            nn_fsm_bad_source (req->state, src, type);
+            nn_fsm_bad_source (task->state, src, type);
         }
 
 /******************************************************************************/
@@ -511,11 +1000,11 @@ void nn_req_handler (struct nn_fsm *self, int src, int type,
             case NN_TIMER_STOPPED:
 
                 /*  Timer is stopped. Now we can send the delayed request. */
-                nn_req_action_send (req, 1);
+                nn_req_action_send (task);
                 return;
 
             default:
-                nn_fsm_bad_action (req->state, src, type);
+                nn_fsm_bad_action (task->state, src, type);
             }
 
         case NN_FSM_ACTION:
@@ -528,11 +1017,11 @@ void nn_req_handler (struct nn_fsm *self, int src, int type,
                  return;
 
              default:
-                 nn_fsm_bad_action (req->state, src, type);
+                 nn_fsm_bad_action (task->state, src, type);
              }
 
         default:
-            nn_fsm_bad_source (req->state, src, type);
+            nn_fsm_bad_source (task->state, src, type);
         }
 
 /******************************************************************************/
@@ -546,23 +1035,30 @@ void nn_req_handler (struct nn_fsm *self, int src, int type,
 
             switch (type) {
             case NN_TIMER_STOPPED:
-                req->state = NN_REQ_STATE_DONE;
+                task->state = NN_REQ_STATE_DONE;
+                if (task->batch)
+                    nn_list_insert (&task->batch->done, &task->doneitem,
+                        nn_list_end (&task->batch->done));
+
+                /*  Wake up the threads waiting for a reply on a context. */
+                if (task->ctxid >= 0)
+                    nn_sockbase_ctxnotify (&task->req->xreq.sockbase);
                 return;
             default:
-                nn_fsm_bad_action (req->state, src, type);
+                nn_fsm_bad_action (task->state, src, type);
             }
 
         case NN_FSM_ACTION:
             switch (type) {
             case NN_REQ_ACTION_SENT:
-                req->state = NN_REQ_STATE_CANCELLING;
+                task->state = NN_REQ_STATE_CANCELLING;
                 return;
             default:
-                nn_fsm_bad_action (req->state, src, type);
+                nn_fsm_bad_action (task->state, src, type);
             }
 
         default:
-            nn_fsm_bad_source (req->state, src, type);
+            nn_fsm_bad_source (task->state, src, type);
         }
 
 /******************************************************************************/
@@ -575,24 +1071,103 @@ void nn_req_handler (struct nn_fsm *self, int src, int type,
         case NN_FSM_ACTION:
              switch (type) {
              case NN_REQ_ACTION_RECEIVED:
-                 req->state = NN_REQ_STATE_PASSIVE;
+                 task->state = NN_REQ_STATE_PASSIVE;
                  return;
              case NN_REQ_ACTION_SENT:
-                 nn_req_action_send (req, 1);
+                 nn_req_action_send (task);
                  return;
              default:
-                 nn_fsm_bad_action (req->state, src, type);
+                 nn_fsm_bad_action (task->state, src, type);
              }
 
         default:
-            nn_fsm_bad_source (req->state, src, type);
+            nn_fsm_bad_source (task->state, src, type);
         }
 
 /******************************************************************************/
 /*  Invalid state.                                                            */
 /******************************************************************************/
     default:
-        nn_fsm_bad_state (req->state, src, type);
+        nn_fsm_bad_state (task->state, src, type);
+    }
+}
+
+static void nn_req_batch_handler (struct nn_fsm *self, int src, int type,
+    NN_UNUSED void *srcptr)
+{
+    struct nn_task *batch;
+
+    batch = nn_cont (self, struct nn_task, fsm);
+
+    switch (batch->state) {
+
+/******************************************************************************/
+/*  IDLE state.                                                               */
+/*  The batch was created recently. Pass straight to the ACTIVE state.        */
+/******************************************************************************/
+    case NN_REQ_STATE_IDLE:
+        switch (src) {
+
+        case NN_FSM_ACTION:
+            switch (type) {
+            case NN_FSM_START:
+                batch->state = NN_REQ_STATE_ACTIVE;
+                return;
+            default:
+                nn_fsm_bad_action (batch->state, src, type);
+            }
+
+        default:
+            nn_fsm_bad_source (batch->state, src, type);
+        }
+
+/******************************************************************************/
+/*  ACTIVE state.                                                             */
+/*  Requests of the batch are being processed. Waiting for the deadline.      */
+/******************************************************************************/
+    case NN_REQ_STATE_ACTIVE:
+        switch (src) {
+
+        case NN_REQ_SRC_RESEND_TIMER:
+            switch (type) {
+            case NN_TIMER_TIMEOUT:
+                nn_timer_stop (&batch->timer);
+                batch->state = NN_REQ_STATE_TIMED_OUT;
+                nn_req_batch_expire (batch->req, batch);
+                return;
+            default:
+                nn_fsm_bad_action (batch->state, src, type);
+            }
+
+        default:
+            nn_fsm_bad_source (batch->state, src, type);
+        }
+
+/******************************************************************************/
+/*  TIMED_OUT state.                                                          */
+/*  The deadline has expired. Stopping the timer.                             */
+/******************************************************************************/
+    case NN_REQ_STATE_TIMED_OUT:
+        switch (src) {
+
+        case NN_REQ_SRC_RESEND_TIMER:
+            switch (type) {
+            case NN_TIMER_STOPPED:
+                batch->state = NN_REQ_STATE_DONE;
+                return;
+            default:
+                nn_fsm_bad_action (batch->state, src, type);
+            }
+
+        default:
+            nn_fsm_bad_source (batch->state, src, type);
+        }
+
+/******************************************************************************/
+/*  Invalid state.                                                            */
+/******************************************************************************/
+    default:
+        nn_fsm_bad_state (batch->state, src, type);
     }
 }
 
@@ -600,22 +1175,29 @@ void nn_req_handler (struct nn_fsm *self, int src, int type,
 /*  State machine actions.                                                    */
 /******************************************************************************/
 
-void nn_req_action_send (struct nn_req *self, int allow_delay)
+void nn_req_action_send (struct nn_task *task)
 {
     int rc;
+    int delay;
+    struct nn_req *req;
     struct nn_msg msg;
     struct nn_pipe *to;
 
+    req = task->req;
+
     /*  Send the request. */
-    nn_msg_cp (&msg, &self->task.request);
-    rc = nn_xreq_send_to (&self->xreq.sockbase, &msg, &to);
+    nn_msg_cp (&msg, &task->request);
+    nn_req_task_stamp (task, &msg, req->resend_ivl);
+    rc = nn_xreq_send_to (&req->xreq.sockbase, &msg, &to);
 
     /*  If the request cannot be sent at the moment wait till
         new outbound pipe arrives. */
     if (nn_slow (rc == -EAGAIN)) {
-        nn_assert (allow_delay == 1);
         nn_msg_term (&msg);
-        self->state = NN_REQ_STATE_DELAYED;
+        if (!nn_list_item_isinlist (&task->delayeditem))
+            nn_list_insert (&req->delayed, &task->delayeditem,
+                nn_list_end (&req->delayed));
+        task->state = NN_REQ_STATE_DELAYED;
         return;
     }
 
@@ -623,10 +1205,20 @@ void nn_req_action_send (struct nn_req *self, int allow_delay)
         in case the request gets lost somewhere further out
         in the topology. */
     if (nn_fast (rc == 0)) {
-        nn_timer_start (&self->task.timer, self->resend_ivl);
+        if (nn_list_item_isinlist (&task->delayeditem))
+            nn_list_erase (&req->delayed, &task->delayeditem);
         nn_assert (to);
-        self->task.sent_to = to;
-        self->state = NN_REQ_STATE_ACTIVE;
+        task->sent_to = to;
+        task->hedged_to = NULL;
+        task->sent_at = nn_clock_ms ();
+
+        /*  If hedging is enabled, wake up early to send a copy of
+            the request to another peer. */
+        delay = nn_req_hedge_delay (req);
+        task->hedge_pending = delay >= 0 && delay < req->resend_ivl;
+        nn_timer_start (&task->timer,
+            task->hedge_pending ? delay : req->resend_ivl);
+        task->state = NN_REQ_STATE_ACTIVE;
         return;
     }
 
@@ -634,6 +1226,79 @@ void nn_req_action_send (struct nn_req *self, int allow_delay)
     errnum_assert (0, -rc);
 }
 
+void nn_req_action_hedge (struct nn_task *task)
+{
+    int rc;
+    struct nn_req *req;
+    struct nn_msg msg;
+    struct nn_pipe *to;
+    uint64_t elapsed;
+
+    req = task->req;
+    task->hedge_pending = 0;
+
+    /*  Send a copy of the request, with the same request ID, to a peer
+        other than the original one. If there's none available at
+        the moment, just keep waiting for the original reply. */
+    elapsed = nn_clock_ms () - task->sent_at;
+    nn_msg_cp (&msg, &task->request);
+    nn_req_task_stamp (task, &msg, elapsed >= (uint64_t) req->resend_ivl ?
+        0 : req->resend_ivl - (int) elapsed);
+    rc = nn_xreq_send_except (&req->xreq.sockbase, &msg, task->sent_to, &to);
+    if (nn_fast (rc == 0)) {
+        task->hedged_to = to;
+        nn_sockbase_stat_increment (&req->xreq.sockbase,
+            NN_STAT_HEDGED_REQUESTS, 1);
+    }
+    else {
+        errnum_assert (rc == -EAGAIN, -rc);
+        nn_msg_term (&msg);
+    }
+
+    /*  Wait for the rest of the re-send interval. */
+    nn_timer_start (&task->timer, elapsed >= (uint64_t) req->resend_ivl ?
+        0 : req->resend_ivl - (int) elapsed);
+    task->state = NN_REQ_STATE_ACTIVE;
+}
+
+static int nn_req_hedge_delay (struct nn_req *self)
+{
+    /*  Hedging is disabled. */
+    if (self->hedge_ivl < 0)
+        return -1;
+
+    /*  Use the fixed delay until enough latencies are known. */
+    if (self->hedge_percentile == 0 || self->hedge_delay < 0)
+        return self->hedge_ivl;
+
+    return self->hedge_delay;
+}
+
+static void nn_req_record_latency (struct nn_req *self, int latency)
+{
+    int sorted [NN_REQ_LATENCY_SAMPLES];
+    int i;
+
+    self->latencies [self->latencypos] = latency;
+    self->latencypos = (self->latencypos + 1) % NN_REQ_LATENCY_SAMPLES;
+    if (self->nlatencies < NN_REQ_LATENCY_SAMPLES)
+        ++self->nlatencies;
+
+    /*  Sorting the samples on each reply would be too expensive. Re-compute
+        the delay each time a quarter of the samples is replaced. */
+    if (self->latencypos % (NN_REQ_LATENCY_SAMPLES / 4) != 0)
+        return;
+    memcpy (sorted, self->latencies, self->nlatencies * sizeof (int));
+    qsort (sorted, self->nlatencies, sizeof (int), nn_req_cmp_latency);
+    i = (self->nlatencies * self->hedge_percentile + 99) / 100;
+    self->hedge_delay = sorted [i > 0 ? i - 1 : 0];
+}
+
+static int nn_req_cmp_latency (const void *a, const void *b)
+{
+    return *(const int*) a - *(const int*) b;
+}
+
 static int nn_req_create (void *hint, struct nn_sockbase **sockbase)
 {
     struct nn_req *self;
@@ -648,19 +1313,80 @@ static int nn_req_create (void *hint, struct nn_sockbase **sockbase)
 
 void nn_req_rm (struct nn_sockbase *self, struct nn_pipe *pipe) {
     struct nn_req *req;
+    struct nn_list_item *it;
+    struct nn_task *task;
 
     req = nn_cont (self, struct nn_req, xreq.sockbase);
 
     nn_xreq_rm (self, pipe);
-    if (nn_slow (pipe == req->task.sent_to)) {
-        nn_fsm_action (&req->fsm, NN_REQ_ACTION_PIPE_RM);
+    nn_req_task_rm (&req->task, pipe);
+
+    /*  Re-send the requests of the contexts as well. */
+    for (it = nn_list_begin (&req->ctxlist);
+          it != nn_list_end (&req->ctxlist);
+          it = nn_list_next (&req->ctxlist, it)) {
+        task = nn_cont (it, struct nn_task, item);
+        nn_req_task_rm (task, pipe);
+    }
+}
+
+static void nn_req_task_rm (struct nn_task *task, struct nn_pipe *pipe)
+{
+    /*  If the request was hedged, the other copy is still in flight. No need
+        to re-send it. */
+    if (nn_slow (pipe == task->hedged_to)) {
+        task->hedged_to = NULL;
+        return;
+    }
+    if (nn_slow (pipe == task->sent_to)) {
+        if (task->hedged_to) {
+            task->sent_to = task->hedged_to;
+            task->hedged_to = NULL;
+            return;
+        }
+        nn_fsm_action (&task->fsm, NN_REQ_ACTION_PIPE_RM);
+    }
+}
+
+static void nn_req_task_stamp (struct nn_task *task, struct nn_msg *msg,
+    int ivl)
+{
+    uint64_t now;
+    int deadline;
+
+    /*  The reply is of no use once the request is re-sent, or once
+        the deadline of the batch expires, whichever comes first. Let
+        the peer know, see SP_DEADLINE. */
+    deadline = ivl;
+    if (task->batch && task->batch->deadline) {
+        now = nn_clock_ms ();
+        if (task->batch->deadline <= now)
+            deadline = 0;
+        else if (task->batch->deadline - now < (uint64_t) deadline)
+            deadline = (int) (task->batch->deadline - now);
+    }
+    nn_msg_addcmsg (msg, PROTO_SP, SP_DEADLINE, &deadline, sizeof (deadline));
+}
+
+static void nn_req_task_release (struct nn_task *task, int latency)
+{
+    /*  Let the load balancer know that the request is not in flight
+        anymore. The original peer is charged with the time spent waiting
+        for it even if the hedged copy won. */
+    if (task->sent_to) {
+        nn_xreq_done (&task->req->xreq.sockbase, task->sent_to, latency);
+        task->sent_to = NULL;
+    }
+    if (task->hedged_to) {
+        nn_xreq_done (&task->req->xreq.sockbase, task->hedged_to, -1);
+        task->hedged_to = NULL;
     }
 }
 
 struct nn_socktype nn_req_socktype = {
     AF_SP,
     NN_REQ,
-    0,
+    NN_SOCKTYPE_FLAG_DEADLINE,
     nn_req_create,
     nn_xreq_ispeer,
 };
@@ -29,24 +29,52 @@
 
 #include "../../protocol.h"
 #include "../../aio/fsm.h"
+#include "../../utils/hash.h"
+#include "../../utils/list.h"
+
+/*  Number of the most recent reply latencies the hedging delay is computed
+    from. */
+#define NN_REQ_LATENCY_SAMPLES 64
 
 struct nn_req {
 
     /*  The base class. Raw REQ socket. */
     struct nn_xreq xreq;
 
-    /*  The state machine. */
-    struct nn_fsm fsm;
-    int state;
-
     /*  Last request ID assigned. */
     uint32_t lastid;
 
     /*  Protocol-specific socket options. */
     int resend_ivl;
+    int hedge_ivl;
+    int hedge_percentile;
 
-    /*  The request being processed. */
+    /*  Ring buffer of the latencies of the recent replies, in milliseconds.
+        The hedging delay is the percentile of these, updated every now and
+        then, so that it follows the changes of the latency. */
+    int latencies [NN_REQ_LATENCY_SAMPLES];
+    int nlatencies;
+    int latencypos;
+    int hedge_delay;
+
+    /*  The request being processed. Its state machine is the root state
+        machine of the socket. */
     struct nn_task task;
+
+    /*  Tasks waiting for reply, keyed by the request ID, so that replies
+        can be routed to the task that sent the request. */
+    struct nn_hash tasks;
+
+    /*  Tasks waiting for a pipe to send the request to. */
+    struct nn_list delayed;
+
+    /*  Open contexts, keyed by the context ID. The list also contains
+        the contexts that were closed but not yet stopped. */
+    struct nn_hash ctxs;
+    struct nn_list ctxlist;
+
+    /*  ID to try for the next context. */
+    int nextctx;
 };
 
 /*  Some users may want to extend the REQ protocol similar to how REQ extends XREQ.
@@ -59,7 +87,8 @@ void nn_req_handler (struct nn_fsm *self, int src, int type,
     void *srcptr);
 void nn_req_shutdown (struct nn_fsm *self, int src, int type,
     void *srcptr);
-void nn_req_action_send (struct nn_req *self, int allow_delay);
+void nn_req_action_send (struct nn_task *task);
+void nn_req_action_hedge (struct nn_task *task);
 
 /*  Implementation of nn_sockbase's virtual functions. */
 void nn_req_stop (struct nn_sockbase *self);
@@ -74,6 +103,12 @@ int nn_req_setopt (struct nn_sockbase *self, int level, int option,
     const void *optval, size_t optvallen);
 int nn_req_getopt (struct nn_sockbase *self, int level, int option,
     void *optval, size_t *optvallen);
+int nn_req_ctxopen (struct nn_sockbase *self);
+int nn_req_ctxclose (struct nn_sockbase *self, int ctx);
+int nn_req_ctxsend (struct nn_sockbase *self, int ctx, struct nn_msg *msg);
+int nn_req_ctxrecv (struct nn_sockbase *self, int ctx, struct nn_msg *msg);
+int nn_req_sendbatch (struct nn_sockbase *self, struct nn_msg *msgs,
+    int nmsgs, int timeout);
 int nn_req_csend (struct nn_sockbase *self, struct nn_msg *msg);
 int nn_req_crecv (struct nn_sockbase *self, struct nn_msg *msg);
 
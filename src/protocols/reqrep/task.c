@@ -22,14 +22,42 @@
 */
 
 #include "task.h"
-#include "../../utils/attr.h"
 
-void nn_task_init (struct nn_task *self, uint32_t id)
+void nn_task_init (struct nn_task *self, struct nn_req *req, int ctxid,
+    int timersrc)
 {
-    self->id = id;
+    self->req = req;
+    self->ctxid = ctxid;
+    nn_hash_item_init (&self->ctxitem);
+    nn_list_item_init (&self->item);
+    self->id = 0;
+    nn_hash_item_init (&self->iditem);
+    nn_list_item_init (&self->delayeditem);
+    nn_msg_init (&self->request, 0);
+    nn_msg_init (&self->reply, 0);
+    nn_timer_init (&self->timer, timersrc, &self->fsm);
+    self->sent_to = NULL;
+    self->hedged_to = NULL;
+    self->hedge_pending = 0;
+    self->sent_at = 0;
+    self->batch = NULL;
+    self->batchidx = -1;
+    nn_list_item_init (&self->doneitem);
+    self->isbatch = 0;
+    nn_list_init (&self->done);
+    self->pending = 0;
+    self->deadline = 0;
 }
 
-void nn_task_term (NN_UNUSED struct nn_task *self)
+void nn_task_term (struct nn_task *self)
 {
+    nn_list_term (&self->done);
+    nn_list_item_term (&self->doneitem);
+    nn_timer_term (&self->timer);
+    nn_msg_term (&self->reply);
+    nn_msg_term (&self->request);
+    nn_list_item_term (&self->delayeditem);
+    nn_hash_item_term (&self->iditem);
+    nn_list_item_term (&self->item);
+    nn_hash_item_term (&self->ctxitem);
 }
-
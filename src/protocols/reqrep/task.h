@@ -29,12 +29,38 @@
 #include "../../aio/fsm.h"
 #include "../../aio/timer.h"
 #include "../../utils/msg.h"
+#include "../../utils/hash.h"
+#include "../../utils/list.h"
+
+struct nn_req;
 
 struct nn_task {
 
+    /*  The state machine driving the request. The socket's own task uses
+        the root state machine of the socket, each context has a child
+        state machine of its own. */
+    struct nn_fsm fsm;
+    int state;
+
+    /*  The socket the task belongs to. */
+    struct nn_req *req;
+
+    /*  ID of the context, or -1 for the socket's own task. Contexts are
+        registered in nn_req::ctxs under this ID and listed in
+        nn_req::ctxlist. */
+    int ctxid;
+    struct nn_hash_item ctxitem;
+    struct nn_list_item item;
+
     /*  ID of the request being currently processed. Replies for different
-        requests are considered stale and simply dropped. */
+        requests are considered stale and simply dropped. While waiting for
+        the reply, the task is registered in nn_req::tasks under the ID. */
     uint32_t id;
+    struct nn_hash_item iditem;
+
+    /*  Member of nn_req::delayed list while waiting for a pipe to send
+        the request to. */
+    struct nn_list_item delayeditem;
 
     /*  Stored request, so that it can be re-sent if needed. */
     struct nn_msg request;
@@ -48,10 +74,40 @@ struct nn_task {
     /*  Pipe the current request has been sent to. This is an optimisation so
         that request can be re-sent immediately if the pipe disappears.  */
     struct nn_pipe *sent_to;
+
+    /*  Pipe a copy of the current request has been sent to because the reply
+        was late, NULL if none. See NN_REQ_HEDGE_IVL. */
+    struct nn_pipe *hedged_to;
+
+    /*  Set while the timer waits for the moment to hedge the request rather
+        than to re-send it. */
+    int hedge_pending;
+
+    /*  When the current request was sent, in milliseconds. */
+    uint64_t sent_at;
+
+    /*  Batch the request belongs to, see nn_req_batch(3), NULL if none, and
+        index of the request within the batch. Once the reply arrives,
+        the task is put to the batch's 'done' list. */
+    struct nn_task *batch;
+    int batchidx;
+    struct nn_list_item doneitem;
+
+    /*  Set if the task is a batch rather than a request. The batch keeps
+        the tasks whose replies have arrived but were not retrieved yet, in
+        the order they have arrived, and the number of requests that were
+        not retrieved yet. Its timer expires at the deadline of the batch,
+        'deadline' in milliseconds, zero if there's none. */
+    int isbatch;
+    struct nn_list done;
+    int pending;
+    uint64_t deadline;
 };
 
-void nn_task_init (struct nn_task *self, uint32_t id);
+/*  The task's state machine has to be initialised before calling this
+    function, as the resend timer is owned by it. */
+void nn_task_init (struct nn_task *self, struct nn_req *req, int ctxid,
+    int timersrc);
 void nn_task_term (struct nn_task *self);
 
 #endif
-
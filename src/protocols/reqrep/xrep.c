@@ -33,11 +33,15 @@
 #include "../../utils/random.h"
 #include "../../utils/wire.h"
 #include "../../utils/attr.h"
+#include "../../utils/clock.h"
 
+#include <limits.h>
 #include <string.h>
 
 /*  Private functions. */
 static void nn_xrep_destroy (struct nn_sockbase *self);
+static int nn_xrep_recv_one (struct nn_sockbase *self, struct nn_msg *msg);
+static void nn_xrep_cache (struct nn_xrep *self, struct nn_msg *msg);
 
 static const struct nn_sockbase_vfptr nn_xrep_sockbase_vfptr = {
     NULL,
@@ -49,6 +53,11 @@ static const struct nn_sockbase_vfptr nn_xrep_sockbase_vfptr = {
     nn_xrep_events,
     nn_xrep_send,
     nn_xrep_recv,
+    nn_xrep_setopt,
+    nn_xrep_getopt,
+    NULL,
+    NULL,
+    NULL,
     NULL,
     NULL
 };
@@ -64,10 +73,12 @@ void nn_xrep_init (struct nn_xrep *self, const struct nn_sockbase_vfptr *vfptr,
 
     nn_hash_init (&self->outpipes);
     nn_fq_init (&self->inpipes);
+    nn_cache_init (&self->cache);
 }
 
 void nn_xrep_term (struct nn_xrep *self)
 {
+    nn_cache_term (&self->cache);
     nn_fq_term (&self->inpipes);
     nn_hash_term (&self->outpipes);
     nn_sockbase_term (&self->sockbase);
@@ -102,6 +113,7 @@ int nn_xrep_add (struct nn_sockbase *self, struct nn_pipe *pipe)
     data->pipe = pipe;
     nn_hash_item_init (&data->outitem);
     data->flags = 0;
+    data->in_at = 0;
     nn_hash_insert (&xrep->outpipes, xrep->next_key & 0x7fffffff,
         &data->outitem);
     ++xrep->next_key;
@@ -134,6 +146,7 @@ void nn_xrep_in (struct nn_sockbase *self, struct nn_pipe *pipe)
     xrep = nn_cont (self, struct nn_xrep, sockbase);
     data = nn_pipe_getdata (pipe);
 
+    data->in_at = nn_clock_ms ();
     nn_fq_in (&xrep->inpipes, &data->initem);
 }
 
@@ -166,6 +179,10 @@ int nn_xrep_send (struct nn_sockbase *self, struct nn_msg *msg)
         return 0;
     }
 
+    /*  Cache the reply if the request was remembered by nn_xrep_recv. */
+    if (xrep->cache.size != 0)
+        nn_xrep_cache (xrep, msg);
+
     /*  Retrieve the destination peer ID. Trim it from the header. */
     key = nn_getl (nn_chunkref_data (&msg->sphdr));
     nn_chunkref_trim (&msg->sphdr, 4);
@@ -188,7 +205,140 @@ int nn_xrep_send (struct nn_sockbase *self, struct nn_msg *msg)
     return 0;
 }
 
+static void nn_xrep_cache (struct nn_xrep *self, struct nn_msg *msg)
+{
+    uint8_t *data;
+    size_t hdrsz;
+    size_t sz;
+    size_t i;
+    struct nn_chunkref backtrace;
+
+    /*  When the reply was passed on by a device, only the top of the
+        backtrace is in the header, the rest of it is at the beginning
+        of the body. */
+    hdrsz = nn_chunkref_size (&msg->sphdr);
+    data = nn_chunkref_data (&msg->body);
+    sz = nn_chunkref_size (&msg->body);
+    i = 0;
+    if (!(nn_getl ((uint8_t*) nn_chunkref_data (&msg->sphdr) + hdrsz -
+          sizeof (uint32_t)) & 0x80000000)) {
+        while (1) {
+            if (nn_slow (i + sizeof (uint32_t) > sz))
+                return;
+            i += sizeof (uint32_t);
+            if (nn_getl (data + i - sizeof (uint32_t)) & 0x80000000)
+                break;
+        }
+    }
+
+    nn_chunkref_init (&backtrace, hdrsz + i);
+    memcpy (nn_chunkref_data (&backtrace), nn_chunkref_data (&msg->sphdr),
+        hdrsz);
+    memcpy (((uint8_t*) nn_chunkref_data (&backtrace)) + hdrsz, data, i);
+    nn_cache_put (&self->cache, &backtrace, &msg->body, i);
+    nn_chunkref_term (&backtrace);
+}
+
+int nn_xrep_pushback (struct nn_xrep *self, struct nn_chunkref *backtrace)
+{
+    struct nn_xrep_data *data;
+
+    if (nn_slow (nn_chunkref_size (backtrace) < sizeof (uint32_t)))
+        return 0;
+    data = nn_cont (nn_hash_get (&self->outpipes,
+        nn_getl (nn_chunkref_data (backtrace))), struct nn_xrep_data, outitem);
+    return data && !(data->flags & NN_XREP_OUT) ? 1 : 0;
+}
+
 int nn_xrep_recv (struct nn_sockbase *self, struct nn_msg *msg)
+{
+    int rc;
+    struct nn_xrep *xrep;
+    struct nn_chunkref reply;
+
+    xrep = nn_cont (self, struct nn_xrep, sockbase);
+
+    while (1) {
+        rc = nn_xrep_recv_one (self, msg);
+        if (rc != 0 || xrep->cache.size == 0)
+            return rc;
+
+        /*  If the reply is not cached, pass the request to the user and
+            remember it so that the reply can be cached once it's sent.
+            Same if the requester is not ready to accept the reply, rather
+            than dropping it. */
+        if (nn_xrep_pushback (xrep, &msg->sphdr) ||
+              !nn_cache_get (&xrep->cache, &msg->body, &reply)) {
+            nn_sockbase_stat_increment (self, NN_STAT_CACHE_MISSES, 1);
+            nn_cache_pend (&xrep->cache, &msg->sphdr, &msg->body);
+            return 0;
+        }
+
+        /*  Otherwise answer the request straight away, using the request's
+            own backtrace, and go on with the next one. */
+        nn_sockbase_stat_increment (self, NN_STAT_CACHE_HITS, 1);
+        nn_chunkref_term (&msg->body);
+        nn_chunkref_mv (&msg->body, &reply);
+        nn_chunkref_term (&msg->hdrs);
+        nn_chunkref_init (&msg->hdrs, 0);
+        rc = nn_xrep_send (self, msg);
+        errnum_assert (rc == 0, -rc);
+    }
+}
+
+int nn_xrep_setopt (struct nn_sockbase *self, int level, int option,
+    const void *optval, size_t optvallen)
+{
+    int val;
+    struct nn_xrep *xrep;
+
+    xrep = nn_cont (self, struct nn_xrep, sockbase);
+
+    if (level != NN_REP)
+        return -ENOPROTOOPT;
+    if (option != NN_REP_CACHE_SIZE && option != NN_REP_CACHE_TTL)
+        return -ENOPROTOOPT;
+
+    if (nn_slow (optvallen != sizeof (int)))
+        return -EINVAL;
+    val = *(int*) optval;
+
+    if (option == NN_REP_CACHE_SIZE) {
+        if (nn_slow (val < 0))
+            return -EINVAL;
+        nn_cache_resize (&xrep->cache, val);
+        return 0;
+    }
+    xrep->cache.ttl = val < 0 ? -1 : val;
+    return 0;
+}
+
+int nn_xrep_getopt (struct nn_sockbase *self, int level, int option,
+    void *optval, size_t *optvallen)
+{
+    int val;
+    struct nn_xrep *xrep;
+
+    xrep = nn_cont (self, struct nn_xrep, sockbase);
+
+    if (level != NN_REP)
+        return -ENOPROTOOPT;
+
+    if (option == NN_REP_CACHE_SIZE)
+        val = xrep->cache.size;
+    else if (option == NN_REP_CACHE_TTL)
+        val = xrep->cache.ttl;
+    else
+        return -ENOPROTOOPT;
+
+    if (nn_slow (*optvallen < sizeof (int)))
+        return -EINVAL;
+    *(int*) optval = val;
+    *optvallen = sizeof (int);
+    return 0;
+}
+
+static int nn_xrep_recv_one (struct nn_sockbase *self, struct nn_msg *msg)
 {
     int rc;
     struct nn_xrep *xrep;
@@ -199,12 +349,43 @@ int nn_xrep_recv (struct nn_sockbase *self, struct nn_msg *msg)
     size_t sz;
     struct nn_chunkref ref;
     struct nn_xrep_data *pipedata;
+    struct nn_chunkref *stamp;
+    uint32_t left;
+    uint64_t now;
+    int deadline;
 
     xrep = nn_cont (self, struct nn_xrep, sockbase);
 
     rc = nn_fq_recv (&xrep->inpipes, msg, &pipe);
     if (nn_slow (rc < 0))
         return rc;
+    pipedata = nn_pipe_getdata (pipe);
+
+    /*  Peers supporting deadlines put the time left till the deadline of
+        the request, if any, in front of the SP header. Subtract the time
+        the request has spent waiting here and drop it if it's too late
+        to process it. Any further message already waiting in the pipe is
+        considered to have arrived now. */
+    left = 0;
+    if (nn_pipe_caps (pipe) & NN_PIPE_CAP_DEADLINE) {
+        stamp = rc & NN_PIPE_PARSED ? &msg->sphdr : &msg->body;
+        if (nn_slow (nn_chunkref_size (stamp) < sizeof (uint32_t))) {
+            nn_msg_term (msg);
+            return -EAGAIN;
+        }
+        left = nn_getl (nn_chunkref_data (stamp));
+        nn_chunkref_trim (stamp, sizeof (uint32_t));
+        now = nn_clock_ms ();
+        if (left != 0 && (uint64_t) left <= now - pipedata->in_at) {
+            nn_sockbase_stat_increment (self, NN_STAT_EXPIRED_REQUESTS, 1);
+            pipedata->in_at = now;
+            nn_msg_term (msg);
+            return -EAGAIN;
+        }
+        if (left != 0)
+            left -= (uint32_t) (now - pipedata->in_at);
+        pipedata->in_at = now;
+    }
 
     if (!(rc & NN_PIPE_PARSED)) {
 
@@ -246,8 +427,14 @@ int nn_xrep_recv (struct nn_sockbase *self, struct nn_msg *msg)
         nn_chunkref_trim (&msg->body, i * sizeof (uint32_t));
     }
 
+    /*  Pass the deadline on, see SP_DEADLINE. */
+    if (left != 0) {
+        deadline = left > INT_MAX ? INT_MAX : (int) left;
+        nn_msg_addcmsg (msg, PROTO_SP, SP_DEADLINE, &deadline,
+            sizeof (deadline));
+    }
+
     /*  Prepend the header by the pipe key. */
-    pipedata = nn_pipe_getdata (pipe);
     nn_chunkref_init (&ref,
         nn_chunkref_size (&msg->sphdr) + sizeof (uint32_t));
     nn_putl (nn_chunkref_data (&ref), pipedata->outitem.key);
@@ -279,7 +466,7 @@ int nn_xrep_ispeer (int socktype)
 struct nn_socktype nn_xrep_socktype = {
     AF_SP_RAW,
     NN_REP,
-    0,
+    NN_SOCKTYPE_FLAG_DEADLINE,
     nn_xrep_create,
     nn_xrep_ispeer,
 };
@@ -29,6 +29,8 @@
 
 #include "../utils/fq.h"
 
+#include "cache.h"
+
 #include <stddef.h>
 
 #define NN_XREP_OUT 1
@@ -38,6 +40,10 @@ struct nn_xrep_data {
     struct nn_hash_item outitem;
     struct nn_fq_data initem;
     uint32_t flags;
+
+    /*  When the message waiting in the pipe arrived, in milliseconds. It's
+        subtracted from the time left till the deadline of the request. */
+    uint64_t in_at;
 };
 
 struct nn_xrep {
@@ -52,6 +58,9 @@ struct nn_xrep {
 
     /*  Fair-queuer to get messages from. */
     struct nn_fq inpipes;
+
+    /*  Replies to recent requests, see NN_REP_CACHE_SIZE. */
+    struct nn_cache cache;
 };
 
 void nn_xrep_init (struct nn_xrep *self, const struct nn_sockbase_vfptr *vfptr,
@@ -65,6 +74,15 @@ void nn_xrep_out (struct nn_sockbase *self, struct nn_pipe *pipe);
 int nn_xrep_events (struct nn_sockbase *self);
 int nn_xrep_send (struct nn_sockbase *self, struct nn_msg *msg);
 int nn_xrep_recv (struct nn_sockbase *self, struct nn_msg *msg);
+int nn_xrep_setopt (struct nn_sockbase *self, int level, int option,
+    const void *optval, size_t optvallen);
+int nn_xrep_getopt (struct nn_sockbase *self, int level, int option,
+    void *optval, size_t *optvallen);
+
+/*  Returns 1 if the peer identified by the backtrace is connected, but not
+    ready to accept a message at the moment, so that nn_xrep_send would drop
+    the message. Returns 0 otherwise. */
+int nn_xrep_pushback (struct nn_xrep *self, struct nn_chunkref *backtrace);
 
 int nn_xrep_ispeer (int socktype);
 
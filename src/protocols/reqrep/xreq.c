@@ -50,6 +50,11 @@ static const struct nn_sockbase_vfptr nn_xreq_sockbase_vfptr = {
     nn_xreq_events,
     nn_xreq_send,
     nn_xreq_recv,
+    nn_xreq_setopt,
+    nn_xreq_getopt,
+    NULL,
+    NULL,
+    NULL,
     NULL,
     NULL
 };
@@ -60,6 +65,9 @@ void nn_xreq_init (struct nn_xreq *self, const struct nn_sockbase_vfptr *vfptr,
     nn_sockbase_init (&self->sockbase, vfptr, hint);
     nn_lb_init (&self->lb);
     nn_fq_init (&self->fq);
+
+    /*  Let the peers know how long the requests are worth processing. */
+    self->lb.deadlines = 1;
 }
 
 void nn_xreq_term (struct nn_xreq *self)
@@ -163,11 +171,18 @@ int nn_xreq_send (struct nn_sockbase *self, struct nn_msg *msg)
 
 int nn_xreq_send_to (struct nn_sockbase *self, struct nn_msg *msg,
     struct nn_pipe **to)
+{
+    return nn_xreq_send_except (self, msg, NULL, to);
+}
+
+int nn_xreq_send_except (struct nn_sockbase *self, struct nn_msg *msg,
+    struct nn_pipe *except, struct nn_pipe **to)
 {
     int rc;
 
     /*  If request cannot be sent due to the pushback, drop it silenly. */
-    rc = nn_lb_send (&nn_cont (self, struct nn_xreq, sockbase)->lb, msg, to);
+    rc = nn_lb_send_except (&nn_cont (self, struct nn_xreq, sockbase)->lb,
+        msg, except, to);
     if (nn_slow (rc == -EAGAIN))
         return -EAGAIN;
     errnum_assert (rc >= 0, -rc);
@@ -176,10 +191,16 @@ int nn_xreq_send_to (struct nn_sockbase *self, struct nn_msg *msg,
 }
 
 int nn_xreq_recv (struct nn_sockbase *self, struct nn_msg *msg)
+{
+    return nn_xreq_recv_from (self, msg, NULL);
+}
+
+int nn_xreq_recv_from (struct nn_sockbase *self, struct nn_msg *msg,
+    struct nn_pipe **from)
 {
     int rc;
 
-    rc = nn_fq_recv (&nn_cont (self, struct nn_xreq, sockbase)->fq, msg, NULL);
+    rc = nn_fq_recv (&nn_cont (self, struct nn_xreq, sockbase)->fq, msg, from);
     if (rc == -EAGAIN)
         return -EAGAIN;
     errnum_assert (rc >= 0, -rc);
@@ -216,6 +237,76 @@ static int nn_xreq_create (void *hint, struct nn_sockbase **sockbase)
     return 0;
 }
 
+int nn_xreq_setopt (struct nn_sockbase *self, int level, int option,
+    const void *optval, size_t optvallen)
+{
+    int val;
+    struct nn_xreq *xreq;
+
+    xreq = nn_cont (self, struct nn_xreq, sockbase);
+
+    if (level != NN_REQ)
+        return -ENOPROTOOPT;
+    if (option != NN_REQ_LB_STRATEGY && option != NN_REQ_LB_KEY_OFFSET &&
+          option != NN_REQ_LB_KEY_LEN)
+        return -ENOPROTOOPT;
+
+    if (nn_slow (optvallen != sizeof (int)))
+        return -EINVAL;
+    val = *(int*) optval;
+
+    switch (option) {
+    case NN_REQ_LB_STRATEGY:
+        return nn_lb_set_strategy (&xreq->lb, val);
+    case NN_REQ_LB_KEY_OFFSET:
+        if (nn_slow (val < 0))
+            return -EINVAL;
+        xreq->lb.keyoff = val;
+        return 0;
+    default:
+        xreq->lb.keylen = val < 0 ? -1 : val;
+        return 0;
+    }
+}
+
+int nn_xreq_getopt (struct nn_sockbase *self, int level, int option,
+    void *optval, size_t *optvallen)
+{
+    int val;
+    struct nn_xreq *xreq;
+
+    xreq = nn_cont (self, struct nn_xreq, sockbase);
+
+    if (level != NN_REQ)
+        return -ENOPROTOOPT;
+
+    if (option == NN_REQ_LB_STRATEGY)
+        val = nn_lb_get_strategy (&xreq->lb);
+    else if (option == NN_REQ_LB_KEY_OFFSET)
+        val = xreq->lb.keyoff;
+    else if (option == NN_REQ_LB_KEY_LEN)
+        val = xreq->lb.keylen;
+    else
+        return -ENOPROTOOPT;
+
+    if (nn_slow (*optvallen < sizeof (int)))
+        return -EINVAL;
+    *(int*) optval = val;
+    *optvallen = sizeof (int);
+    return 0;
+}
+
+void nn_xreq_done (struct nn_sockbase *self, struct nn_pipe *pipe,
+    int latency)
+{
+    struct nn_xreq *xreq;
+    struct nn_xreq_data *data;
+
+    xreq = nn_cont (self, struct nn_xreq, sockbase);
+    data = nn_pipe_getdata (pipe);
+    nn_lb_done (&xreq->lb, &data->lb, latency);
+}
+
 int nn_xreq_ispeer (int socktype)
 {
     return socktype == NN_REP ? 1 : 0;
@@ -224,7 +315,7 @@ int nn_xreq_ispeer (int socktype)
 struct nn_socktype nn_xreq_socktype = {
     AF_SP_RAW,
     NN_REQ,
-    0,
+    NN_SOCKTYPE_FLAG_DEADLINE,
     nn_xreq_create,
     nn_xreq_ispeer,
 };
@@ -47,7 +47,21 @@ int nn_xreq_events (struct nn_sockbase *self);
 int nn_xreq_send (struct nn_sockbase *self, struct nn_msg *msg);
 int nn_xreq_send_to (struct nn_sockbase *self, struct nn_msg *msg,
     struct nn_pipe **to);
+int nn_xreq_send_except (struct nn_sockbase *self, struct nn_msg *msg,
+    struct nn_pipe *except, struct nn_pipe **to);
 int nn_xreq_recv (struct nn_sockbase *self, struct nn_msg *msg);
+int nn_xreq_recv_from (struct nn_sockbase *self, struct nn_msg *msg,
+    struct nn_pipe **from);
+int nn_xreq_setopt (struct nn_sockbase *self, int level, int option,
+    const void *optval, size_t optvallen);
+int nn_xreq_getopt (struct nn_sockbase *self, int level, int option,
+    void *optval, size_t *optvallen);
+
+/*  Reports that the request sent to the pipe has completed. Used by REQ
+    socket to let the load balancer know about the replies. See nn_lb_done
+    for the meaning of 'latency'. */
+void nn_xreq_done (struct nn_sockbase *self, struct nn_pipe *pipe,
+    int latency);
 
 int nn_xreq_ispeer (int socktype);
 
@@ -35,6 +35,8 @@
 #include "../../utils/wire.h"
 #include "../../utils/alloc.h"
 #include "../../utils/random.h"
+#include "../../utils/hash.h"
+#include "../../utils/list.h"
 #include "../../utils/attr.h"
 
 #include <string.h>
@@ -50,22 +52,41 @@
 
 #define NN_SURVEYOR_ACTION_START 1
 #define NN_SURVEYOR_ACTION_CANCEL 2
+#define NN_SURVEYOR_ACTION_DONE 3
 
 #define NN_SURVEYOR_SRC_DEADLINE_TIMER 1
+#define NN_SURVEYOR_SRC_CTX 2
+
+#define NN_SURVEYOR_CTX_STOPPED 1
 
 #define NN_SURVEYOR_TIMEDOUT 1
 
-struct nn_surveyor {
+struct nn_surveyor;
 
-    /*  The underlying raw SP socket. */
-    struct nn_xsurveyor xsurveyor;
+/*  A survey, either the socket's own one or the one of a context. */
+struct nn_survey {
 
-    /*  The state machine. */
+    /*  The state machine. The socket's own survey uses the root state
+        machine of the socket, each context has a child state machine
+        owned by the root one. */
     struct nn_fsm fsm;
     int state;
 
-    /*  Survey ID of the current survey. */
+    /*  The socket the survey belongs to. */
+    struct nn_surveyor *surveyor;
+
+    /*  ID of the context, -1 for the socket's own survey. */
+    int ctxid;
+
+    /*  Survey ID of the current survey. Member of nn_surveyor::surveys,
+        keyed by the survey ID, till the survey is over. */
     uint32_t surveyid;
+    struct nn_hash_item iditem;
+
+    /*  Member of nn_surveyor::ctxs, keyed by the context ID, and of
+        nn_surveyor::ctxlist. Unused for the socket's own survey. */
+    struct nn_hash_item ctxitem;
+    struct nn_list_item item;
 
     /*  Timer for timing out the survey. */
     struct nn_timer timer;
@@ -73,11 +94,51 @@ struct nn_surveyor {
     /*  When starting the survey, the message is temporarily stored here. */
     struct nn_msg tosend;
 
-    /*  Protocol-specific socket options. */
-    int deadline;
-
     /*  Flag if surveyor has timed out */
     int timedout;
+
+    /*  NN_SURVEYOR_QUORUM at the time the survey was started, the number of
+        respondents the survey was sent to and the number of responses
+        received so far. */
+    int quorum;
+    uint32_t respondents;
+    uint32_t responses;
+
+    /*  Responses picked up by the other surveys while looking for their
+        own ones, to be received by this survey. */
+    struct nn_list queue;
+};
+
+/*  Response waiting in nn_survey::queue. */
+struct nn_surveyor_response {
+    struct nn_list_item item;
+    struct nn_msg msg;
+};
+
+struct nn_surveyor {
+
+    /*  The underlying raw SP socket. */
+    struct nn_xsurveyor xsurveyor;
+
+    /*  The socket's own survey. Its state machine is the root one. */
+    struct nn_survey survey;
+
+    /*  Surveys in progress, keyed by the survey ID. */
+    struct nn_hash surveys;
+
+    /*  Survey ID of the last survey started. */
+    uint32_t surveyid;
+
+    /*  Open contexts. */
+    struct nn_hash ctxs;
+    struct nn_list ctxlist;
+
+    /*  ID to try for the next context. */
+    int nextctx;
+
+    /*  Protocol-specific socket options. */
+    int deadline;
+    int quorum;
 };
 
 /*  Private functions. */
@@ -88,12 +149,26 @@ static void nn_surveyor_handler (struct nn_fsm *self, int src, int type,
     void *srcptr);
 static void nn_surveyor_shutdown (struct nn_fsm *self, int src, int type,
     void *srcptr);
-static int nn_surveyor_inprogress (struct nn_surveyor *self);
-static void nn_surveyor_resend (struct nn_surveyor *self);
+static void nn_survey_init (struct nn_survey *self,
+    struct nn_surveyor *surveyor, int ctxid);
+static void nn_survey_term (struct nn_survey *self);
+static int nn_survey_inprogress (struct nn_survey *self);
+static int nn_survey_quorum (struct nn_survey *self);
+static void nn_survey_forget (struct nn_survey *self);
+static int nn_survey_send (struct nn_survey *self, struct nn_msg *msg);
+static int nn_survey_recv (struct nn_survey *self, struct nn_msg *msg);
+static void nn_survey_resend (struct nn_survey *self);
+static void nn_surveyor_ctx_stop (struct nn_surveyor *self,
+    struct nn_survey *survey);
+static void nn_surveyor_ctx_destroy (struct nn_surveyor *self,
+    struct nn_survey *survey);
+static void nn_surveyor_ctx_shutdown (struct nn_fsm *self, int src, int type,
+    void *srcptr);
 
 /*  Implementation of nn_sockbase's virtual functions. */
 static void nn_surveyor_stop (struct nn_sockbase *self);
 static void nn_surveyor_destroy (struct nn_sockbase *self);
+static void nn_surveyor_in (struct nn_sockbase *self, struct nn_pipe *pipe);
 static int nn_surveyor_events (struct nn_sockbase *self);
 static int nn_surveyor_send (struct nn_sockbase *self, struct nn_msg *msg);
 static int nn_surveyor_recv (struct nn_sockbase *self, struct nn_msg *msg);
@@ -101,46 +176,63 @@ static int nn_surveyor_setopt (struct nn_sockbase *self, int level, int option,
     const void *optval, size_t optvallen);
 static int nn_surveyor_getopt (struct nn_sockbase *self, int level, int option,
     void *optval, size_t *optvallen);
+static int nn_surveyor_ctxopen (struct nn_sockbase *self);
+static int nn_surveyor_ctxclose (struct nn_sockbase *self, int ctx);
+static int nn_surveyor_ctxsend (struct nn_sockbase *self, int ctx,
+    struct nn_msg *msg);
+static int nn_surveyor_ctxrecv (struct nn_sockbase *self, int ctx,
+    struct nn_msg *msg);
 static const struct nn_sockbase_vfptr nn_surveyor_sockbase_vfptr = {
     nn_surveyor_stop,
     nn_surveyor_destroy,
     nn_xsurveyor_add,
     nn_xsurveyor_rm,
-    nn_xsurveyor_in,
+    nn_surveyor_in,
     nn_xsurveyor_out,
     nn_surveyor_events,
     nn_surveyor_send,
     nn_surveyor_recv,
     nn_surveyor_setopt,
-    nn_surveyor_getopt
+    nn_surveyor_getopt,
+    nn_surveyor_ctxopen,
+    nn_surveyor_ctxclose,
+    nn_surveyor_ctxsend,
+    nn_surveyor_ctxrecv,
+    NULL
 };
 
 static void nn_surveyor_init (struct nn_surveyor *self,
     const struct nn_sockbase_vfptr *vfptr, void *hint)
 {
     nn_xsurveyor_init (&self->xsurveyor, vfptr, hint);
-    nn_fsm_init_root (&self->fsm, nn_surveyor_handler, nn_surveyor_shutdown,
-        nn_sockbase_getctx (&self->xsurveyor.sockbase));
-    self->state = NN_SURVEYOR_STATE_IDLE;
+    nn_fsm_init_root (&self->survey.fsm, nn_surveyor_handler,
+        nn_surveyor_shutdown, nn_sockbase_getctx (&self->xsurveyor.sockbase));
+    self->survey.state = NN_SURVEYOR_STATE_IDLE;
+    nn_survey_init (&self->survey, self, -1);
 
     /*  Start assigning survey IDs beginning with a random number. This way
         there should be no key clashes even if the executable is re-started. */
     nn_random_generate (&self->surveyid, sizeof (self->surveyid));
 
-    nn_timer_init (&self->timer, NN_SURVEYOR_SRC_DEADLINE_TIMER, &self->fsm);
-    nn_msg_init (&self->tosend, 0);
+    nn_hash_init (&self->surveys);
+    nn_hash_init (&self->ctxs);
+    nn_list_init (&self->ctxlist);
+    self->nextctx = 0;
     self->deadline = NN_SURVEYOR_DEFAULT_DEADLINE;
-    self->timedout = 0;
+    self->quorum = 0;
 
     /*  Start the state machine. */
-    nn_fsm_start (&self->fsm);
+    nn_fsm_start (&self->survey.fsm);
 }
 
 static void nn_surveyor_term (struct nn_surveyor *self)
 {
-    nn_msg_term (&self->tosend);
-    nn_timer_term (&self->timer);
-    nn_fsm_term (&self->fsm);
+    nn_survey_forget (&self->survey);
+    nn_list_term (&self->ctxlist);
+    nn_hash_term (&self->ctxs);
+    nn_hash_term (&self->surveys);
+    nn_survey_term (&self->survey);
+    nn_fsm_term (&self->survey.fsm);
     nn_xsurveyor_term (&self->xsurveyor);
 }
 
@@ -150,7 +242,7 @@ void nn_surveyor_stop (struct nn_sockbase *self)
 
     surveyor = nn_cont (self, struct nn_surveyor, xsurveyor.sockbase);
 
-    nn_fsm_stop (&surveyor->fsm);
+    nn_fsm_stop (&surveyor->survey.fsm);
 }
 
 void nn_surveyor_destroy (struct nn_sockbase *self)
@@ -163,7 +255,35 @@ void nn_surveyor_destroy (struct nn_sockbase *self)
     nn_free (surveyor);
 }
 
-static int nn_surveyor_inprogress (struct nn_surveyor *self)
+static void nn_survey_init (struct nn_survey *self,
+    struct nn_surveyor *surveyor, int ctxid)
+{
+    self->surveyor = surveyor;
+    self->ctxid = ctxid;
+    self->surveyid = 0;
+    nn_hash_item_init (&self->iditem);
+    nn_hash_item_init (&self->ctxitem);
+    nn_list_item_init (&self->item);
+    nn_timer_init (&self->timer, NN_SURVEYOR_SRC_DEADLINE_TIMER, &self->fsm);
+    nn_msg_init (&self->tosend, 0);
+    self->timedout = 0;
+    self->quorum = 0;
+    self->respondents = 0;
+    self->responses = 0;
+    nn_list_init (&self->queue);
+}
+
+static void nn_survey_term (struct nn_survey *self)
+{
+    nn_list_term (&self->queue);
+    nn_msg_term (&self->tosend);
+    nn_timer_term (&self->timer);
+    nn_list_item_term (&self->item);
+    nn_hash_item_term (&self->ctxitem);
+    nn_hash_item_term (&self->iditem);
+}
+
+static int nn_survey_inprogress (struct nn_survey *self)
 {
     /*  Return 1 if there's a survey going on. 0 otherwise. */
     return self->state == NN_SURVEYOR_STATE_IDLE ||
@@ -171,6 +291,48 @@ static int nn_surveyor_inprogress (struct nn_surveyor *self)
         self->state == NN_SURVEYOR_STATE_STOPPING ? 0 : 1;
 }
 
+static int nn_survey_quorum (struct nn_survey *self)
+{
+    /*  Return 1 if the survey can be finished without waiting for
+        the deadline. 0 otherwise. */
+    if (self->quorum == 0)
+        return 0;
+    if (self->responses >= self->respondents)
+        return 1;
+    return self->quorum > 0 && self->responses >= (uint32_t) self->quorum ?
+        1 : 0;
+}
+
+static void nn_survey_forget (struct nn_survey *self)
+{
+    struct nn_surveyor_response *response;
+
+    /*  Drop any further responses to the survey. */
+    if (nn_list_item_isinlist (&self->iditem.list))
+        nn_hash_erase (&self->surveyor->surveys, &self->iditem);
+    while (!nn_list_empty (&self->queue)) {
+        response = nn_cont (nn_list_begin (&self->queue),
+            struct nn_surveyor_response, item);
+        nn_list_erase (&self->queue, &response->item);
+        nn_list_item_term (&response->item);
+        nn_msg_term (&response->msg);
+        nn_free (response);
+    }
+}
+
+static void nn_surveyor_in (struct nn_sockbase *self, struct nn_pipe *pipe)
+{
+    struct nn_surveyor *surveyor;
+
+    surveyor = nn_cont (self, struct nn_surveyor, xsurveyor.sockbase);
+
+    nn_xsurveyor_in (&surveyor->xsurveyor.sockbase, pipe);
+
+    /*  There may be threads waiting for a response on the contexts. */
+    if (!nn_list_empty (&surveyor->ctxlist))
+        nn_sockbase_ctxnotify (&surveyor->xsurveyor.sockbase);
+}
+
 static int nn_surveyor_events (struct nn_sockbase *self)
 {
     int rc;
@@ -183,7 +345,12 @@ static int nn_surveyor_events (struct nn_sockbase *self)
 
     /*  If there's no survey going on we'll signal IN to interrupt polling
         when the survey expires. nn_recv() will return -EFSM afterwards. */
-    if (!nn_surveyor_inprogress (surveyor))
+    if (!nn_survey_inprogress (&surveyor->survey))
+        rc |= NN_SOCKBASE_EVENT_IN;
+
+    /*  Responses may have been picked up by the contexts on behalf of
+        the socket. */
+    if (!nn_list_empty (&surveyor->survey.queue))
         rc |= NN_SOCKBASE_EVENT_IN;
 
     return rc;
@@ -195,23 +362,54 @@ static int nn_surveyor_send (struct nn_sockbase *self, struct nn_msg *msg)
 
     surveyor = nn_cont (self, struct nn_surveyor, xsurveyor.sockbase);
 
-    /*  Generate new survey ID. */
-    ++surveyor->surveyid;
-    surveyor->surveyid |= 0x80000000;
+    return nn_survey_send (&surveyor->survey, msg);
+}
+
+static int nn_surveyor_recv (struct nn_sockbase *self, struct nn_msg *msg)
+{
+    struct nn_surveyor *surveyor;
+
+    surveyor = nn_cont (self, struct nn_surveyor, xsurveyor.sockbase);
+
+    return nn_survey_recv (&surveyor->survey, msg);
+}
+
+static int nn_survey_send (struct nn_survey *self, struct nn_msg *msg)
+{
+    struct nn_surveyor *surveyor;
+
+    surveyor = self->surveyor;
+
+    /*  Responses to the previous survey, if any, won't be accepted
+        anymore. */
+    nn_survey_forget (self);
+
+    /*  Generate new survey ID. The IDs are shared by all the surveys of
+        the socket, so skip any ID still in use by another survey. */
+    do {
+        ++surveyor->surveyid;
+        surveyor->surveyid |= 0x80000000;
+    } while (nn_slow (nn_hash_get (&surveyor->surveys,
+        surveyor->surveyid) != NULL));
+    self->surveyid = surveyor->surveyid;
+    nn_hash_insert (&surveyor->surveys, self->surveyid, &self->iditem);
+    self->quorum = surveyor->quorum;
+    self->respondents = 0;
+    self->responses = 0;
 
     /*  Tag the survey body with survey ID. */
     nn_assert (nn_chunkref_size (&msg->sphdr) == 0);
     nn_chunkref_term (&msg->sphdr);
     nn_chunkref_init (&msg->sphdr, 4);
-    nn_putl (nn_chunkref_data (&msg->sphdr), surveyor->surveyid);
+    nn_putl (nn_chunkref_data (&msg->sphdr), self->surveyid);
 
     /*  Store the survey, so that it can be sent later on. */
-    nn_msg_term (&surveyor->tosend);
-    nn_msg_mv (&surveyor->tosend, msg);
+    nn_msg_term (&self->tosend);
+    nn_msg_mv (&self->tosend, msg);
     nn_msg_init (msg, 0);
 
     /*  Cancel any ongoing survey, if any. */
-    if (nn_slow (nn_surveyor_inprogress (surveyor))) {
+    if (nn_slow (nn_survey_inprogress (self))) {
 
         /*  First check whether the survey can be sent at all. */
         if (!(nn_xsurveyor_events (&surveyor->xsurveyor.sockbase) &
@@ -219,34 +417,56 @@ static int nn_surveyor_send (struct nn_sockbase *self, struct nn_msg *msg)
             return -EAGAIN;
 
         /*  Cancel the current survey. */
-        nn_fsm_action (&surveyor->fsm, NN_SURVEYOR_ACTION_CANCEL);
+        nn_fsm_action (&self->fsm, NN_SURVEYOR_ACTION_CANCEL);
 
         return 0;
     }
 
     /*  Notify the state machine that the survey was started. */
-    nn_fsm_action (&surveyor->fsm, NN_SURVEYOR_ACTION_START);
+    nn_fsm_action (&self->fsm, NN_SURVEYOR_ACTION_START);
 
     return 0;
 }
 
-static int nn_surveyor_recv (struct nn_sockbase *self, struct nn_msg *msg)
+static int nn_survey_recv (struct nn_survey *self, struct nn_msg *msg)
 {
     int rc;
     struct nn_surveyor *surveyor;
+    struct nn_surveyor_response *response;
+    struct nn_hash_item *item;
+    struct nn_survey *other;
     uint32_t surveyid;
 
-    surveyor = nn_cont (self, struct nn_surveyor, xsurveyor.sockbase);
+    surveyor = self->surveyor;
 
     /*  If no survey is going on return EFSM error. */
-    if (nn_slow (!nn_surveyor_inprogress (surveyor))) {
-        if (surveyor->timedout == NN_SURVEYOR_TIMEDOUT) {
-            surveyor->timedout = 0;
+    if (nn_slow (!nn_survey_inprogress (self))) {
+        if (self->timedout == NN_SURVEYOR_TIMEDOUT) {
+            self->timedout = 0;
             return -ETIMEDOUT;
         } else
             return -EFSM;
     }
 
+    /*  Once enough responses are in, finish the survey without waiting
+        for the deadline. */
+    if (self->state == NN_SURVEYOR_STATE_ACTIVE && nn_survey_quorum (self)) {
+        nn_fsm_action (&self->fsm, NN_SURVEYOR_ACTION_DONE);
+        return -EAGAIN;
+    }
+
+    /*  Responses picked up by the other surveys go first. */
+    if (!nn_list_empty (&self->queue)) {
+        response = nn_cont (nn_list_begin (&self->queue),
+            struct nn_surveyor_response, item);
+        nn_list_erase (&self->queue, &response->item);
+        nn_list_item_term (&response->item);
+        nn_msg_mv (msg, &response->msg);
+        nn_free (response);
+        ++self->responses;
+        return 0;
+    }
+
     while (1) {
 
         /*  Get next response. */
@@ -256,22 +476,160 @@ static int nn_surveyor_recv (struct nn_sockbase *self, struct nn_msg *msg)
         errnum_assert (rc == 0, -rc);
 
         /*  Get the survey ID. Ignore any stale responses. */
-        /*  TODO: This should be done asynchronously! */
-        if (nn_slow (nn_chunkref_size (&msg->sphdr) != sizeof (uint32_t)))
+        if (nn_slow (nn_chunkref_size (&msg->sphdr) != sizeof (uint32_t))) {
+            nn_msg_term (msg);
             continue;
+        }
         surveyid = nn_getl (nn_chunkref_data (&msg->sphdr));
-        if (nn_slow (surveyid != surveyor->surveyid))
-            continue;
 
-        /*  Discard the header and return the message to the user. */
+        /*  Discard the header. */
         nn_chunkref_term (&msg->sphdr);
         nn_chunkref_init (&msg->sphdr, 0);
-        break;
+
+        if (nn_fast (surveyid == self->surveyid))
+            break;
+
+        /*  Hand the responses to the other surveys in progress over to
+            them, drop the rest. */
+        item = nn_hash_get (&surveyor->surveys, surveyid);
+        if (!item) {
+            nn_msg_term (msg);
+            continue;
+        }
+        other = nn_cont (item, struct nn_survey, iditem);
+        response = nn_alloc (sizeof (struct nn_surveyor_response),
+            "survey response");
+        alloc_assert (response);
+        nn_list_item_init (&response->item);
+        nn_msg_mv (&response->msg, msg);
+        nn_list_insert (&other->queue, &response->item,
+            nn_list_end (&other->queue));
+        if (other->ctxid >= 0)
+            nn_sockbase_ctxnotify (&surveyor->xsurveyor.sockbase);
     }
 
+    ++self->responses;
     return 0;
 }
 
+static int nn_surveyor_ctxopen (struct nn_sockbase *self)
+{
+    struct nn_surveyor *surveyor;
+    struct nn_survey *survey;
+    int id;
+
+    surveyor = nn_cont (self, struct nn_surveyor, xsurveyor.sockbase);
+
+    /*  Find an unused context ID. */
+    id = surveyor->nextctx;
+    while (nn_hash_get (&surveyor->ctxs, (uint32_t) id) != NULL)
+        id = (id + 1) & 0x7fffffff;
+    surveyor->nextctx = (id + 1) & 0x7fffffff;
+
+    /*  The context is a survey with a state machine of its own. It's owned
+        by the root state machine of the socket. */
+    survey = nn_alloc (sizeof (struct nn_survey), "survey context");
+    alloc_assert (survey);
+    nn_fsm_init (&survey->fsm, nn_surveyor_handler, nn_surveyor_ctx_shutdown,
+        NN_SURVEYOR_SRC_CTX, survey, &surveyor->survey.fsm);
+    survey->state = NN_SURVEYOR_STATE_IDLE;
+    nn_survey_init (survey, surveyor, id);
+    nn_hash_insert (&surveyor->ctxs, (uint32_t) id, &survey->ctxitem);
+    nn_list_insert (&surveyor->ctxlist, &survey->item,
+        nn_list_end (&surveyor->ctxlist));
+    nn_fsm_start (&survey->fsm);
+
+    return id;
+}
+
+static int nn_surveyor_ctxclose (struct nn_sockbase *self, int ctx)
+{
+    struct nn_surveyor *surveyor;
+    struct nn_hash_item *item;
+
+    surveyor = nn_cont (self, struct nn_surveyor, xsurveyor.sockbase);
+
+    item = nn_hash_get (&surveyor->ctxs, (uint32_t) ctx);
+    if (nn_slow (!item))
+        return -EBADF;
+    nn_surveyor_ctx_stop (surveyor, nn_cont (item, struct nn_survey,
+        ctxitem));
+
+    return 0;
+}
+
+static int nn_surveyor_ctxsend (struct nn_sockbase *self, int ctx,
+    struct nn_msg *msg)
+{
+    struct nn_surveyor *surveyor;
+    struct nn_hash_item *item;
+
+    surveyor = nn_cont (self, struct nn_surveyor, xsurveyor.sockbase);
+
+    item = nn_hash_get (&surveyor->ctxs, (uint32_t) ctx);
+    if (nn_slow (!item))
+        return -EBADF;
+
+    return nn_survey_send (nn_cont (item, struct nn_survey, ctxitem), msg);
+}
+
+static int nn_surveyor_ctxrecv (struct nn_sockbase *self, int ctx,
+    struct nn_msg *msg)
+{
+    struct nn_surveyor *surveyor;
+    struct nn_hash_item *item;
+
+    surveyor = nn_cont (self, struct nn_surveyor, xsurveyor.sockbase);
+
+    item = nn_hash_get (&surveyor->ctxs, (uint32_t) ctx);
+    if (nn_slow (!item))
+        return -EBADF;
+
+    return nn_survey_recv (nn_cont (item, struct nn_survey, ctxitem), msg);
+}
+
+static void nn_surveyor_ctx_stop (struct nn_surveyor *self,
+    struct nn_survey *survey)
+{
+    /*  Make the context unreachable. Any response that arrives later on
+        is dropped as stale. */
+    nn_hash_erase (&self->ctxs, &survey->ctxitem);
+    nn_survey_forget (survey);
+
+    nn_fsm_stop (&survey->fsm);
+}
+
+static void nn_surveyor_ctx_destroy (struct nn_surveyor *self,
+    struct nn_survey *survey)
+{
+    nn_list_erase (&self->ctxlist, &survey->item);
+    nn_survey_term (survey);
+    nn_fsm_term (&survey->fsm);
+    nn_free (survey);
+}
+
+static void nn_surveyor_ctx_shutdown (struct nn_fsm *self, int src, int type,
+    NN_UNUSED void *srcptr)
+{
+    struct nn_survey *survey;
+
+    survey = nn_cont (self, struct nn_survey, fsm);
+
+    if (nn_slow (src == NN_FSM_ACTION && type == NN_FSM_STOP)) {
+        nn_timer_stop (&survey->timer);
+        survey->state = NN_SURVEYOR_STATE_STOPPING;
+    }
+    if (nn_slow (survey->state == NN_SURVEYOR_STATE_STOPPING)) {
+        if (!nn_timer_isidle (&survey->timer))
+            return;
+        survey->state = NN_SURVEYOR_STATE_IDLE;
+        nn_fsm_stopped (&survey->fsm, NN_SURVEYOR_CTX_STOPPED);
+        return;
+    }
+
+    nn_fsm_bad_state (survey->state, src, type);
+}
+
 static int nn_surveyor_setopt (struct nn_sockbase *self, int level, int option,
     const void *optval, size_t optvallen)
 {
@@ -289,6 +647,13 @@ static int nn_surveyor_setopt (struct nn_sockbase *self, int level, int option,
         return 0;
     }
 
+    if (option == NN_SURVEYOR_QUORUM) {
+        if (nn_slow (optvallen != sizeof (int)))
+            return -EINVAL;
+        surveyor->quorum = *(int*) optval < 0 ? -1 : *(int*) optval;
+        return 0;
+    }
+
     return -ENOPROTOOPT;
 }
 
@@ -310,40 +675,72 @@ static int nn_surveyor_getopt (struct nn_sockbase *self, int level, int option,
         return 0;
     }
 
+    if (option == NN_SURVEYOR_QUORUM) {
+        if (nn_slow (*optvallen < sizeof (int)))
+            return -EINVAL;
+        *(int*) optval = surveyor->quorum;
+        *optvallen = sizeof (int);
+        return 0;
+    }
+
     return -ENOPROTOOPT;
 }
 
 static void nn_surveyor_shutdown (struct nn_fsm *self, int src, int type,
-    NN_UNUSED void *srcptr)
+    void *srcptr)
 {
     struct nn_surveyor *surveyor;
+    struct nn_list_item *it;
+    struct nn_survey *survey;
 
-    surveyor = nn_cont (self, struct nn_surveyor, fsm);
+    surveyor = nn_cont (self, struct nn_surveyor, survey.fsm);
 
     if (nn_slow (src== NN_FSM_ACTION && type == NN_FSM_STOP)) {
-        nn_timer_stop (&surveyor->timer);
-        surveyor->state = NN_SURVEYOR_STATE_STOPPING;
+        nn_timer_stop (&surveyor->survey.timer);
+
+        /*  Stop the contexts that are still open. */
+        for (it = nn_list_begin (&surveyor->ctxlist);
+              it != nn_list_end (&surveyor->ctxlist);
+              it = nn_list_next (&surveyor->ctxlist, it)) {
+            survey = nn_cont (it, struct nn_survey, item);
+            if (nn_list_item_isinlist (&survey->ctxitem.list))
+                nn_surveyor_ctx_stop (surveyor, survey);
+        }
+        surveyor->survey.state = NN_SURVEYOR_STATE_STOPPING;
     }
-    if (nn_slow (surveyor->state == NN_SURVEYOR_STATE_STOPPING)) {
-        if (!nn_timer_isidle (&surveyor->timer))
+    if (nn_slow (src == NN_SURVEYOR_SRC_CTX &&
+          type == NN_SURVEYOR_CTX_STOPPED))
+        nn_surveyor_ctx_destroy (surveyor, (struct nn_survey*) srcptr);
+    if (nn_slow (surveyor->survey.state == NN_SURVEYOR_STATE_STOPPING)) {
+        if (!nn_timer_isidle (&surveyor->survey.timer) ||
+              !nn_list_empty (&surveyor->ctxlist))
             return;
-        surveyor->state = NN_SURVEYOR_STATE_IDLE;
-        nn_fsm_stopped_noevent (&surveyor->fsm);
+        surveyor->survey.state = NN_SURVEYOR_STATE_IDLE;
+        nn_fsm_stopped_noevent (&surveyor->survey.fsm);
         nn_sockbase_stopped (&surveyor->xsurveyor.sockbase);
         return;
     }
 
-    nn_fsm_bad_state(surveyor->state, src, type);
+    nn_fsm_bad_state(surveyor->survey.state, src, type);
 }
 
 static void nn_surveyor_handler (struct nn_fsm *self, int src, int type,
-    NN_UNUSED void *srcptr)
+    void *srcptr)
 {
-    struct nn_surveyor *surveyor;
+    struct nn_survey *survey;
 
-    surveyor = nn_cont (self, struct nn_surveyor, fsm);
+    survey = nn_cont (self, struct nn_survey, fsm);
 
-    switch (surveyor->state) {
+    /*  A closed context has stopped. This can only happen in the root
+        state machine, which owns the contexts. */
+    if (nn_slow (src == NN_SURVEYOR_SRC_CTX)) {
+        nn_assert (type == NN_SURVEYOR_CTX_STOPPED);
+        nn_surveyor_ctx_destroy (survey->surveyor,
+            (struct nn_survey*) srcptr);
+        return;
+    }
+
+    switch (survey->state) {
 
 /******************************************************************************/
 /*  IDLE state.                                                               */
@@ -355,14 +752,14 @@ static void nn_surveyor_handler (struct nn_fsm *self, int src, int type,
         case NN_FSM_ACTION:
             switch (type) {
             case NN_FSM_START:
-                surveyor->state = NN_SURVEYOR_STATE_PASSIVE;
+                survey->state = NN_SURVEYOR_STATE_PASSIVE;
                 return;
             default:
-                nn_fsm_bad_action (surveyor->state, src, type);
+                nn_fsm_bad_action (survey->state, src, type);
             }
 
         default:
-            nn_fsm_bad_source (surveyor->state, src, type);
+            nn_fsm_bad_source (survey->state, src, type);
         }
 
 /******************************************************************************/
@@ -375,17 +772,17 @@ static void nn_surveyor_handler (struct nn_fsm *self, int src, int type,
         case NN_FSM_ACTION:
             switch (type) {
             case NN_SURVEYOR_ACTION_START:
-                nn_surveyor_resend (surveyor);
-                nn_timer_start (&surveyor->timer, surveyor->deadline);
-                surveyor->state = NN_SURVEYOR_STATE_ACTIVE;
+                nn_survey_resend (survey);
+                nn_timer_start (&survey->timer, survey->surveyor->deadline);
+                survey->state = NN_SURVEYOR_STATE_ACTIVE;
                 return;
 
             default:
-                nn_fsm_bad_action (surveyor->state, src, type);
+                nn_fsm_bad_action (survey->state, src, type);
             }
 
         default:
-            nn_fsm_bad_source (surveyor->state, src, type);
+            nn_fsm_bad_source (survey->state, src, type);
         }
 
 /******************************************************************************/
@@ -398,26 +795,31 @@ static void nn_surveyor_handler (struct nn_fsm *self, int src, int type,
         case NN_FSM_ACTION:
             switch (type) {
             case NN_SURVEYOR_ACTION_CANCEL:
-                nn_timer_stop (&surveyor->timer);
-                surveyor->state = NN_SURVEYOR_STATE_CANCELLING;
+                nn_timer_stop (&survey->timer);
+                survey->state = NN_SURVEYOR_STATE_CANCELLING;
+                return;
+            case NN_SURVEYOR_ACTION_DONE:
+                nn_timer_stop (&survey->timer);
+                survey->state = NN_SURVEYOR_STATE_STOPPING_TIMER;
+                survey->timedout = NN_SURVEYOR_TIMEDOUT;
                 return;
             default:
-                nn_fsm_bad_action (surveyor->state, src, type);
+                nn_fsm_bad_action (survey->state, src, type);
             }
 
         case NN_SURVEYOR_SRC_DEADLINE_TIMER:
             switch (type) {
             case NN_TIMER_TIMEOUT:
-                nn_timer_stop (&surveyor->timer);
-                surveyor->state = NN_SURVEYOR_STATE_STOPPING_TIMER;
-                surveyor->timedout = NN_SURVEYOR_TIMEDOUT;
+                nn_timer_stop (&survey->timer);
+                survey->state = NN_SURVEYOR_STATE_STOPPING_TIMER;
+                survey->timedout = NN_SURVEYOR_TIMEDOUT;
                 return;
             default:
-                nn_fsm_bad_action (surveyor->state, src, type);
+                nn_fsm_bad_action (survey->state, src, type);
             }
 
         default:
-            nn_fsm_bad_source (surveyor->state, src, type);
+            nn_fsm_bad_source (survey->state, src, type);
         }
 
 /******************************************************************************/
@@ -433,27 +835,28 @@ static void nn_surveyor_handler (struct nn_fsm *self, int src, int type,
             case NN_SURVEYOR_ACTION_CANCEL:
                 return;
             default:
-                nn_fsm_bad_action (surveyor->state, src, type);
+                nn_fsm_bad_action (survey->state, src, type);
             }
 
         case NN_SURVEYOR_SRC_DEADLINE_TIMER:
             switch (type) {
             case NN_TIMER_STOPPED:
-                nn_surveyor_resend (surveyor);
-                nn_timer_start (&surveyor->timer, surveyor->deadline);
-                surveyor->state = NN_SURVEYOR_STATE_ACTIVE;
+                nn_survey_resend (survey);
+                nn_timer_start (&survey->timer, survey->surveyor->deadline);
+                survey->state = NN_SURVEYOR_STATE_ACTIVE;
                 return;
             default:
-                nn_fsm_bad_action (surveyor->state, src, type);
+                nn_fsm_bad_action (survey->state, src, type);
             }
 
         default:
-            nn_fsm_bad_source (surveyor->state, src, type);
+            nn_fsm_bad_source (survey->state, src, type);
         }
 
 /******************************************************************************/
 /*  STOPPING_TIMER state.                                                     */
-/*  Survey timeout expired. Now we are stopping the timer.                    */
+/*  Survey timeout expired, or the quorum was reached. Now we are stopping    */
+/*  the timer.                                                                */
 /******************************************************************************/
     case NN_SURVEYOR_STATE_STOPPING_TIMER:
         switch (src) {
@@ -461,40 +864,50 @@ static void nn_surveyor_handler (struct nn_fsm *self, int src, int type,
         case NN_FSM_ACTION:
             switch (type) {
             case NN_SURVEYOR_ACTION_CANCEL:
-                surveyor->state = NN_SURVEYOR_STATE_CANCELLING;
+                survey->state = NN_SURVEYOR_STATE_CANCELLING;
                 return;
             default:
-                nn_fsm_bad_action (surveyor->state, src, type);
+                nn_fsm_bad_action (survey->state, src, type);
             }
 
         case NN_SURVEYOR_SRC_DEADLINE_TIMER:
             switch (type) {
             case NN_TIMER_STOPPED:
-                surveyor->state = NN_SURVEYOR_STATE_PASSIVE;
+                nn_survey_forget (survey);
+                survey->state = NN_SURVEYOR_STATE_PASSIVE;
+
+                /*  The thread waiting for a response on the context, if
+                    any, is to be told that the survey is over. */
+                if (survey->ctxid >= 0)
+                    nn_sockbase_ctxnotify (
+                        &survey->surveyor->xsurveyor.sockbase);
                 return;
             default:
-                nn_fsm_bad_action (surveyor->state, src, type);
+                nn_fsm_bad_action (survey->state, src, type);
             }
 
         default:
-            nn_fsm_bad_source (surveyor->state, src, type);
+            nn_fsm_bad_source (survey->state, src, type);
         }
 
 /******************************************************************************/
 /*  Invalid state.                                                            */
 /******************************************************************************/
     default:
-        nn_fsm_bad_state (surveyor->state, src, type);
+        nn_fsm_bad_state (survey->state, src, type);
     }
 }
 
-static void nn_surveyor_resend (struct nn_surveyor *self)
+static void nn_survey_resend (struct nn_survey *self)
 {
     int rc;
     struct nn_msg msg;
 
+    /*  The survey is sent to all the respondents ready to accept it. */
+    self->respondents = self->surveyor->xsurveyor.outpipes.count;
+
     nn_msg_cp (&msg, &self->tosend);
-    rc = nn_xsurveyor_send (&self->xsurveyor.sockbase, &msg);
+    rc = nn_xsurveyor_send (&self->surveyor->xsurveyor.sockbase, &msg);
     errnum_assert (rc == 0, -rc);
 }
 
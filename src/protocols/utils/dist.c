@@ -33,11 +33,13 @@ void nn_dist_init (struct nn_dist *self)
 {
     self->count = 0;
     nn_list_init (&self->pipes);
+    nn_list_init (&self->blocked);
 }
 
 void nn_dist_term (struct nn_dist *self)
 {
     nn_assert (self->count == 0);
+    nn_list_term (&self->blocked);
     nn_list_term (&self->pipes);
 }
 
@@ -45,35 +47,50 @@ void nn_dist_add (NN_UNUSED struct nn_dist *self,
     struct nn_dist_data *data, struct nn_pipe *pipe)
 {
     data->pipe = pipe;
+    data->selected = 0;
+    data->ready = 0;
     nn_list_item_init (&data->item);
 }
 
 void nn_dist_rm (struct nn_dist *self, struct nn_dist_data *data)
 {
-    if (nn_list_item_isinlist (&data->item)) {
+    if (data->ready) {
         --self->count;
         nn_list_erase (&self->pipes, &data->item);
     }
+    else if (nn_list_item_isinlist (&data->item))
+        nn_list_erase (&self->blocked, &data->item);
     nn_list_item_term (&data->item);
 }
 
 void nn_dist_out (struct nn_dist *self, struct nn_dist_data *data)
 {
+    nn_assert (!data->ready);
+    if (nn_list_item_isinlist (&data->item))
+        nn_list_erase (&self->blocked, &data->item);
     ++self->count;
+    data->ready = 1;
     nn_list_insert (&self->pipes, &data->item, nn_list_end (&self->pipes));
 }
 
+/*  The pipe was released by the transport. Park it in the blocked list. */
+static void nn_dist_release (struct nn_dist *self, struct nn_dist_data *data)
+{
+    --self->count;
+    data->ready = 0;
+    nn_list_erase (&self->pipes, &data->item);
+    nn_list_insert (&self->blocked, &data->item, nn_list_end (&self->blocked));
+}
+
 int nn_dist_send (struct nn_dist *self, struct nn_msg *msg,
     struct nn_pipe *exclude)
 {
     int rc;
     struct nn_list_item *it;
+    struct nn_list_item *next;
     struct nn_dist_data *data;
     struct nn_msg copy;
 
-    /*  TODO: We can optimise for the case when there's only one outbound
-        pipe here. No message copying is needed in such case. */
-
     /*  In the specific case when there are no outbound pipes. There's nowhere
         to send the message to. Deallocate it. */
     if (nn_slow (self->count) == 0) {
@@ -81,28 +98,116 @@ int nn_dist_send (struct nn_dist *self, struct nn_msg *msg,
         return 0;
     }
 
-    /*  Send the message to all the subscribers. */
-    nn_msg_bulkcopy_start (msg, self->count);
+    /*  Send the message to all the subscribers. All the copies share the same
+        chunks, which are treated as read-only from now on; the reference
+        counts are adjusted only once for the whole batch. The last pipe gets
+        the original message, thus, with a single subscriber there's no
+        reference counting at all. */
+    if (self->count > 1)
+        nn_msg_bulkcopy_start (msg, self->count - 1);
     it = nn_list_begin (&self->pipes);
     while (it != nn_list_end (&self->pipes)) {
        data = nn_cont (it, struct nn_dist_data, item);
-       nn_msg_bulkcopy_cp (&copy, msg);
+       next = nn_list_next (&self->pipes, it);
+       if (next == nn_list_end (&self->pipes))
+           nn_msg_mv (&copy, msg);
+       else
+           nn_msg_bulkcopy_cp (&copy, msg);
        if (nn_fast (data->pipe == exclude)) {
            nn_msg_term (&copy);
        }
        else {
            rc = nn_pipe_send (data->pipe, &copy);
            errnum_assert (rc >= 0, -rc);
-           if (rc & NN_PIPE_RELEASE) {
-               --self->count;
-               it = nn_list_erase (&self->pipes, it);
-               continue;
-           }
+           if (rc & NN_PIPE_RELEASE)
+               nn_dist_release (self, data);
        }
-       it = nn_list_next (&self->pipes, it);
+       it = next;
     }
-    nn_msg_term (msg);
 
     return 0;
 }
 
+int nn_dist_isready (struct nn_dist_data *data)
+{
+    return data->ready;
+}
+
+struct nn_list *nn_dist_blocked (struct nn_dist *self)
+{
+    return &self->blocked;
+}
+
+int nn_dist_send_one (struct nn_dist *self, struct nn_dist_data *data,
+    struct nn_msg *msg)
+{
+    int rc;
+
+    if (!nn_dist_isready (data))
+        return -EAGAIN;
+
+    rc = nn_pipe_send (data->pipe, msg);
+    errnum_assert (rc >= 0, -rc);
+    if (rc & NN_PIPE_RELEASE)
+        nn_dist_release (self, data);
+
+    return 0;
+}
+
+int nn_dist_send_filtered (struct nn_dist *self, struct nn_msg *msg,
+    int (*filter) (struct nn_dist_data *data, struct nn_msg *msg, void *arg),
+    void *arg)
+{
+    int rc;
+    uint32_t count;
+    struct nn_list_item *it;
+    struct nn_list_item *next;
+    struct nn_dist_data *data;
+    struct nn_dist_data *last;
+    struct nn_msg copy;
+
+    /*  Find out which pipes the message should be sent to. The number of
+        copies has to be known in advance to set the reference counts. */
+    count = 0;
+    last = NULL;
+    for (it = nn_list_begin (&self->pipes); it != nn_list_end (&self->pipes);
+          it = nn_list_next (&self->pipes, it)) {
+        data = nn_cont (it, struct nn_dist_data, item);
+        data->selected = filter (data, msg, arg) ? 1 : 0;
+        if (data->selected) {
+            ++count;
+            last = data;
+        }
+    }
+
+    /*  Nobody is interested in the message. */
+    if (count == 0) {
+        nn_msg_term (msg);
+        return 0;
+    }
+
+    /*  Same as in nn_dist_send, the last selected pipe gets the original. */
+    if (count > 1)
+        nn_msg_bulkcopy_start (msg, count - 1);
+    it = nn_list_begin (&self->pipes);
+    while (it != nn_list_end (&self->pipes)) {
+       data = nn_cont (it, struct nn_dist_data, item);
+       next = nn_list_next (&self->pipes, it);
+       if (data->selected) {
+           data->selected = 0;
+           if (data == last)
+               nn_msg_mv (&copy, msg);
+           else
+               nn_msg_bulkcopy_cp (&copy, msg);
+           rc = nn_pipe_send (data->pipe, &copy);
+           errnum_assert (rc >= 0, -rc);
+           if (rc & NN_PIPE_RELEASE)
+               nn_dist_release (self, data);
+           if (data == last)
+               break;
+       }
+       it = next;
+    }
+
+    return 0;
+}
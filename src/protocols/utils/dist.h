@@ -32,11 +32,22 @@
 struct nn_dist_data {
     struct nn_list_item item;
     struct nn_pipe *pipe;
+
+    /*  Scratch flag used by nn_dist_send_filtered. */
+    int selected;
+
+    /*  1 if the pipe is in the 'pipes' list, 0 if it is in the 'blocked'
+        list or in neither of them (not yet writable). */
+    int ready;
 };
 
 struct nn_dist {
     uint32_t count;
     struct nn_list pipes;
+
+    /*  Pipes that have been writable before but are currently pushing back.
+        Protocols can use this to apply a policy to slow peers. */
+    struct nn_list blocked;
 };
 
 void nn_dist_init (struct nn_dist *self);
@@ -52,4 +63,22 @@ void nn_dist_out (struct nn_dist *self, struct nn_dist_data *data);
 int nn_dist_send (struct nn_dist *self, struct nn_msg *msg,
     struct nn_pipe *exclude);
 
+/*  Returns 1 if the pipe is ready for sending, 0 otherwise. */
+int nn_dist_isready (struct nn_dist_data *data);
+
+/*  Returns the list of pipes that have been released by the transport and
+    are waiting to become writable again. The items are nn_dist_data. */
+struct nn_list *nn_dist_blocked (struct nn_dist *self);
+
+/*  Sends the message to the specified pipe only. If the pipe is not ready
+    for sending, -EAGAIN is returned and the message is left untouched. */
+int nn_dist_send_one (struct nn_dist *self, struct nn_dist_data *data,
+    struct nn_msg *msg);
+
+/*  Sends the message only to those attached pipes for which 'filter' returns
+    non-zero. The filter must not modify the message. */
+int nn_dist_send_filtered (struct nn_dist *self, struct nn_msg *msg,
+    int (*filter) (struct nn_dist_data *data, struct nn_msg *msg, void *arg),
+    void *arg);
+
 #endif
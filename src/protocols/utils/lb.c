@@ -20,42 +20,148 @@
     IN THE SOFTWARE.
 */
 
+
 #include "lb.h"
 
+#include "../../nn.h"
+
 #include "../../utils/err.h"
 #include "../../utils/cont.h"
+#include "../../utils/fast.h"
+#include "../../utils/alloc.h"
+#include "../../utils/attr.h"
+#include "../../utils/clock.h"
+#include "../../utils/random.h"
+#include "../../utils/wire.h"
 
 #include <stddef.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+
+/*  Latencies above this value (in milliseconds) are considered equal.
+    It keeps the moving average from overflowing. */
+#define NN_LB_MAX_LATENCY 1000000
+
+/*  With NN_LB_EWMA, the moving average of a pipe is halved for each this
+    many milliseconds without a new sample, so that pipes that got slow once
+    are tried again eventually. */
+#define NN_LB_EWMA_HALFLIFE 1000
+
+/*  Number of points each pipe has on the consistent hashing ring. */
+#define NN_LB_VNODES 64
+
+/*  Private functions. */
+static struct nn_priolist_data *nn_lb_choose (struct nn_lb *self,
+    struct nn_pipe *except);
+static uint64_t nn_lb_cost (struct nn_lb *self, struct nn_lb_data *data,
+    uint64_t now);
+static int nn_lb_ewma (struct nn_lb_data *data, uint64_t now);
+static uint32_t nn_lb_random (struct nn_lb *self);
+static struct nn_lb_data *nn_lb_lookup (struct nn_lb *self,
+    struct nn_msg *msg, struct nn_pipe *except);
+static uint32_t nn_lb_key (struct nn_lb *self, struct nn_msg *msg);
+static void nn_lb_stamp (struct nn_msg *msg);
+static void nn_lb_ring_add (struct nn_lb *self, struct nn_lb_data *data);
+static void nn_lb_ring_rm (struct nn_lb *self, struct nn_lb_data *data);
+static int nn_lb_cmp_vnode (const void *a, const void *b);
+static uint32_t nn_lb_hash (const uint8_t *data, size_t size);
+static uint32_t nn_lb_mix (uint32_t h);
 
 void nn_lb_init (struct nn_lb *self)
 {
     nn_priolist_init (&self->priolist);
+    self->strategy = NN_LB_ROUND_ROBIN;
+    self->replies = 0;
+    self->deadlines = 0;
+    nn_random_generate (&self->seed, sizeof (self->seed));
+    if (!self->seed)
+        self->seed = 1;
+    self->keyoff = 0;
+    self->keylen = -1;
+    nn_list_init (&self->pipes);
+    memset (self->npipes, 0, sizeof (self->npipes));
+    self->ring = NULL;
+    self->nvnodes = 0;
+    self->blocked = 0;
 }
 
 void nn_lb_term (struct nn_lb *self)
 {
+    if (self->ring)
+        nn_free (self->ring);
+    nn_list_term (&self->pipes);
     nn_priolist_term (&self->priolist);
 }
 
 void nn_lb_add (struct nn_lb *self, struct nn_lb_data *data,
     struct nn_pipe *pipe, int priority)
 {
+    const char *addr;
+    struct nn_list_item *it;
+    struct nn_lb_data *other;
+
     nn_priolist_add (&self->priolist, &data->priodata, pipe, priority);
+    data->outstanding = 0;
+    data->ewma = -1;
+    data->sampled_at = 0;
+    data->sent_at = 0;
+    data->credits = -1;
+    data->writeable = 0;
+
+    /*  Find the lowest ordinal not used by the other pipes created by
+        the same endpoint. */
+    addr = nn_pipe_getaddr (pipe);
+    data->addrhash = nn_lb_hash ((const uint8_t*) addr, strlen (addr));
+    data->ordinal = 0;
+    it = nn_list_begin (&self->pipes);
+    while (it != nn_list_end (&self->pipes)) {
+        other = nn_cont (it, struct nn_lb_data, item);
+        if (other->addrhash == data->addrhash &&
+              other->ordinal == data->ordinal) {
+            ++data->ordinal;
+            it = nn_list_begin (&self->pipes);
+            continue;
+        }
+        it = nn_list_next (&self->pipes, it);
+    }
+
+    nn_list_item_init (&data->item);
+    nn_list_insert (&self->pipes, &data->item, nn_list_end (&self->pipes));
+    ++self->npipes [priority - 1];
+    if (self->strategy == NN_LB_CONSISTENT_HASH)
+        nn_lb_ring_add (self, data);
 }
 
 void nn_lb_rm (struct nn_lb *self, struct nn_lb_data *data)
 {
+    if (self->strategy == NN_LB_CONSISTENT_HASH)
+        nn_lb_ring_rm (self, data);
+    --self->npipes [data->priodata.priority - 1];
+    nn_list_erase (&self->pipes, &data->item);
+    nn_list_item_term (&data->item);
     nn_priolist_rm (&self->priolist, &data->priodata);
+    self->blocked = 0;
 }
 
 void nn_lb_out (struct nn_lb *self, struct nn_lb_data *data)
 {
-    nn_priolist_activate (&self->priolist, &data->priodata);
+    /*  If nobody is going to report the completion, the message is done
+        once the pipe is able to accept a new one. */
+    if (!self->replies && data->outstanding > 0)
+        nn_lb_done (self, data,
+            data->sent_at ? (int) (nn_clock_ms () - data->sent_at) : -1);
+
+    data->writeable = 1;
+    if (data->credits != 0) {
+        nn_priolist_activate (&self->priolist, &data->priodata);
+        self->blocked = 0;
+    }
 }
 
 int nn_lb_can_send (struct nn_lb *self)
 {
-    return nn_priolist_is_active (&self->priolist);
+    return nn_priolist_is_active (&self->priolist) && !self->blocked;
 }
 
 int nn_lb_get_priority (struct nn_lb *self)
@@ -64,8 +170,16 @@ int nn_lb_get_priority (struct nn_lb *self)
 }
 
 int nn_lb_send (struct nn_lb *self, struct nn_msg *msg, struct nn_pipe **to)
+{
+    return nn_lb_send_except (self, msg, NULL, to);
+}
+
+int nn_lb_send_except (struct nn_lb *self, struct nn_msg *msg,
+    struct nn_pipe *except, struct nn_pipe **to)
 {
     int rc;
+    struct nn_priolist_data *priodata;
+    struct nn_lb_data *data;
     struct nn_pipe *pipe;
 
     /*  Pipe is NULL only when there are no avialable pipes. */
@@ -73,12 +187,71 @@ int nn_lb_send (struct nn_lb *self, struct nn_msg *msg, struct nn_pipe **to)
     if (nn_slow (!pipe))
         return -EAGAIN;
 
+    if (nn_fast (self->strategy == NN_LB_ROUND_ROBIN)) {
+
+        /*  Skip the excluded pipe. If it's the only pipe with the highest
+            priority available, don't fall back to lower priorities, same as
+            nn_lb_send wouldn't. */
+        if (nn_slow (pipe == except)) {
+            nn_priolist_advance (&self->priolist, 0);
+            pipe = nn_priolist_getpipe (&self->priolist);
+            if (pipe == except)
+                return -EAGAIN;
+        }
+        priodata = nn_priolist_getdata (&self->priolist);
+    }
+    else if (self->strategy == NN_LB_CONSISTENT_HASH) {
+
+        /*  The message has to go to the pipe its key maps to. If the pipe
+            is busy, wait for it rather than moving the key elsewhere. */
+        data = nn_lb_lookup (self, msg, except);
+        if (nn_slow (!data))
+            return -EAGAIN;
+        if (nn_slow (!nn_list_item_isinlist (&data->priodata.item))) {
+            self->blocked = 1;
+            return -EAGAIN;
+        }
+        priodata = &data->priodata;
+        nn_priolist_select (&self->priolist, priodata);
+        pipe = priodata->pipe;
+    }
+    else {
+
+        /*  Choose the least loaded pipe of the highest priority available
+            and make it the current one. */
+        priodata = nn_lb_choose (self, except);
+        if (nn_slow (!priodata))
+            return -EAGAIN;
+        nn_priolist_select (&self->priolist, priodata);
+        pipe = priodata->pipe;
+    }
+    data = nn_cont (priodata, struct nn_lb_data, priodata);
+
     /*  Send the messsage. */
+    if (self->deadlines && (nn_pipe_caps (pipe) & NN_PIPE_CAP_DEADLINE))
+        nn_lb_stamp (msg);
     rc = nn_pipe_send (pipe, msg);
     errnum_assert (rc >= 0, -rc);
 
-    /*  Move to the next pipe. */
-    nn_priolist_advance (&self->priolist, rc & NN_PIPE_RELEASE);
+    /*  Account for the message. If the pipe was able to accept it
+        straight away, there's nothing to wait for. */
+    if (rc & NN_PIPE_RELEASE)
+        data->writeable = 0;
+    if (data->credits > 0)
+        --data->credits;
+    ++data->outstanding;
+    if (!self->replies) {
+        if (!(rc & NN_PIPE_RELEASE))
+            nn_lb_done (self, data, 0);
+        else
+            data->sent_at = self->strategy == NN_LB_ROUND_ROBIN ?
+                0 : nn_clock_ms ();
+    }
+
+    /*  Move to the next pipe. The pipe that has run out of credit is
+        put aside as if it wasn't writeable. */
+    nn_priolist_advance (&self->priolist,
+        (rc & NN_PIPE_RELEASE) || data->credits == 0);
 
     if (to != NULL)
         *to = pipe;
@@ -86,3 +259,356 @@ int nn_lb_send (struct nn_lb *self, struct nn_msg *msg, struct nn_pipe **to)
     return rc & ~NN_PIPE_RELEASE;
 }
 
+int nn_lb_set_strategy (struct nn_lb *self, int strategy)
+{
+    struct nn_list_item *it;
+
+    switch (strategy) {
+    case NN_LB_ROUND_ROBIN:
+    case NN_LB_LEAST_OUTSTANDING:
+    case NN_LB_EWMA:
+    case NN_LB_P2C:
+    case NN_LB_CONSISTENT_HASH:
+        break;
+    default:
+        return -EINVAL;
+    }
+
+    /*  Build the ring when switching to consistent hashing, drop it when
+        switching away. */
+    if (strategy == NN_LB_CONSISTENT_HASH &&
+          self->strategy != NN_LB_CONSISTENT_HASH) {
+        for (it = nn_list_begin (&self->pipes);
+              it != nn_list_end (&self->pipes);
+              it = nn_list_next (&self->pipes, it))
+            nn_lb_ring_add (self, nn_cont (it, struct nn_lb_data, item));
+    }
+    if (strategy != NN_LB_CONSISTENT_HASH && self->ring) {
+        nn_free (self->ring);
+        self->ring = NULL;
+        self->nvnodes = 0;
+    }
+
+    self->strategy = strategy;
+    self->blocked = 0;
+    return 0;
+}
+
+int nn_lb_get_strategy (struct nn_lb *self)
+{
+    return self->strategy;
+}
+
+void nn_lb_limit (NN_UNUSED struct nn_lb *self, struct nn_lb_data *data)
+{
+    /*  Only to be done before the pipe becomes writeable. */
+    nn_assert (!nn_list_item_isinlist (&data->priodata.item));
+    data->credits = 0;
+}
+
+void nn_lb_credit (struct nn_lb *self, struct nn_lb_data *data, int credits)
+{
+    int wasblocked;
+
+    wasblocked = data->credits == 0;
+    if (credits < 0)
+        data->credits = -1;
+    else if (data->credits >= 0)
+        data->credits = credits > INT_MAX - data->credits ?
+            INT_MAX : data->credits + credits;
+
+    /*  The pipe was waiting for credit only. */
+    if (wasblocked && data->credits != 0 && data->writeable) {
+        nn_priolist_activate (&self->priolist, &data->priodata);
+        self->blocked = 0;
+    }
+}
+
+void nn_lb_done (struct nn_lb *self, struct nn_lb_data *data, int latency)
+{
+    uint64_t now;
+
+    nn_assert (data->outstanding > 0);
+    --data->outstanding;
+
+    if (latency < 0)
+        return;
+    if (latency > NN_LB_MAX_LATENCY)
+        latency = NN_LB_MAX_LATENCY;
+
+    /*  Catch up with the decay since the previous sample. */
+    if (self->strategy == NN_LB_EWMA) {
+        now = nn_clock_ms ();
+        data->ewma = nn_lb_ewma (data, now);
+        data->sampled_at = now;
+    }
+
+    /*  The first sample is taken as is. Afterwards, each new sample
+        contributes 1/8 to the average. */
+    if (data->ewma < 0)
+        data->ewma = latency * 16;
+    else
+        data->ewma += (latency * 16 - data->ewma) / 8;
+}
+
+static struct nn_priolist_data *nn_lb_choose (struct nn_lb *self,
+    struct nn_pipe *except)
+{
+    int count;
+    int i;
+    int j;
+    struct nn_priolist_data *it;
+    struct nn_priolist_data *best;
+    struct nn_priolist_data *other;
+    uint64_t cost;
+    uint64_t bestcost;
+    uint64_t now;
+
+    it = nn_priolist_getdata (&self->priolist);
+    now = self->strategy == NN_LB_EWMA ? nn_clock_ms () : 0;
+    count = nn_priolist_count (&self->priolist);
+
+    /*  Power of two choices. Pick two distinct pipes at random and use
+        the one with the shorter queue. */
+    if (self->strategy == NN_LB_P2C && count > 2) {
+        i = (int) (nn_lb_random (self) % (uint32_t) count);
+        j = (int) (nn_lb_random (self) % (uint32_t) (count - 1));
+        if (j >= i)
+            ++j;
+        best = NULL;
+        other = NULL;
+        for (; count; --count, --i, --j) {
+            if (i == 0)
+                best = it;
+            if (j == 0)
+                other = it;
+            it = nn_priolist_next (&self->priolist, it);
+        }
+        if (best->pipe == except)
+            return other;
+        if (other->pipe != except &&
+              nn_lb_cost (self, nn_cont (other, struct nn_lb_data, priodata),
+                  now) <
+              nn_lb_cost (self, nn_cont (best, struct nn_lb_data, priodata),
+                  now))
+            return other;
+        return best;
+    }
+
+    /*  Otherwise consider all the pipes, starting with the current one.
+        In case of a tie, the pipes are used in round-robin fashion. */
+    best = NULL;
+    bestcost = 0;
+    for (; count; --count, it = nn_priolist_next (&self->priolist, it)) {
+        if (it->pipe == except)
+            continue;
+        cost = nn_lb_cost (self, nn_cont (it, struct nn_lb_data, priodata),
+            now);
+        if (!best || cost < bestcost) {
+            best = it;
+            bestcost = cost;
+        }
+    }
+    return best;
+}
+
+static uint64_t nn_lb_cost (struct nn_lb *self, struct nn_lb_data *data,
+    uint64_t now)
+{
+    int avg;
+    uint64_t ewma;
+
+    if (self->strategy == NN_LB_LEAST_OUTSTANDING)
+        return (uint64_t) data->outstanding;
+
+    if (self->strategy == NN_LB_EWMA) {
+
+        /*  The average by itself would send everything to the fastest pipe
+            until it's overloaded. Scale it by the number of messages
+            in flight so that the load spreads as the queues grow. */
+        avg = nn_lb_ewma (data, now);
+        ewma = avg < 0 ? 0 : (uint64_t) avg;
+        return (ewma + 16) * (uint64_t) (data->outstanding + 1);
+    }
+
+    /*  NN_LB_P2C. Shorter queue wins, faster pipe in case of a tie. */
+    nn_assert (self->strategy == NN_LB_P2C);
+    ewma = data->ewma < 0 ? 0 : (uint64_t) data->ewma;
+    return ((uint64_t) data->outstanding << 32) | ewma;
+}
+
+static int nn_lb_ewma (struct nn_lb_data *data, uint64_t now)
+{
+    uint64_t halvings;
+
+    /*  Unknown average is kept as is. */
+    if (data->ewma <= 0)
+        return data->ewma;
+
+    halvings = now > data->sampled_at ?
+        (now - data->sampled_at) / NN_LB_EWMA_HALFLIFE : 0;
+    return halvings >= 31 ? 0 : data->ewma >> halvings;
+}
+
+static uint32_t nn_lb_random (struct nn_lb *self)
+{
+    /*  Xorshift generator. Cheap and good enough to pick the pipes. */
+    self->seed ^= self->seed << 13;
+    self->seed ^= self->seed >> 17;
+    self->seed ^= self->seed << 5;
+    return self->seed;
+}
+
+static struct nn_lb_data *nn_lb_lookup (struct nn_lb *self,
+    struct nn_msg *msg, struct nn_pipe *except)
+{
+    int priority;
+    uint32_t point;
+    int lo;
+    int hi;
+    int mid;
+    int i;
+    struct nn_lb_data *data;
+
+    /*  Only the pipes of the highest priority are on the ring, whether
+        they are active at the moment or not. */
+    for (priority = 1; priority <= NN_PRIOLIST_SLOTS; ++priority)
+        if (self->npipes [priority - 1])
+            break;
+
+    /*  Find the first point on the ring following the key. */
+    point = nn_lb_key (self, msg);
+    lo = 0;
+    hi = self->nvnodes;
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (self->ring [mid].point < point)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    /*  Walk the ring clockwise till a suitable pipe is found. */
+    for (i = 0; i != self->nvnodes; ++i) {
+        data = self->ring [(lo + i) % self->nvnodes].data;
+        if (data->priodata.priority == priority &&
+              data->priodata.pipe != except)
+            return data;
+    }
+    return NULL;
+}
+
+static void nn_lb_stamp (struct nn_msg *msg)
+{
+    int *deadline;
+    size_t size;
+    uint32_t left;
+    struct nn_chunkref ref;
+
+    /*  The peer expects the time left, in milliseconds, in front of the SP
+        header, zero meaning there's no deadline. A request that's already
+        late is left to the peer to drop. */
+    left = 0;
+    deadline = nn_msg_getcmsg (msg, PROTO_SP, SP_DEADLINE, &size);
+    if (deadline && size == sizeof (int))
+        left = *deadline > 0 ? (uint32_t) *deadline : 1;
+
+    nn_chunkref_init (&ref, sizeof (uint32_t) + nn_chunkref_size (&msg->sphdr));
+    nn_putl (nn_chunkref_data (&ref), left);
+    memcpy (((uint8_t*) nn_chunkref_data (&ref)) + sizeof (uint32_t),
+        nn_chunkref_data (&msg->sphdr), nn_chunkref_size (&msg->sphdr));
+    nn_chunkref_term (&msg->sphdr);
+    nn_chunkref_mv (&msg->sphdr, &ref);
+}
+
+static uint32_t nn_lb_key (struct nn_lb *self, struct nn_msg *msg)
+{
+    void *key;
+    size_t size;
+    size_t off;
+    size_t len;
+
+    /*  Key supplied by the user as ancillary data takes precedence. */
+    key = nn_msg_getcmsg (msg, PROTO_SP, SP_KEY, &size);
+    if (key)
+        return nn_lb_mix (nn_lb_hash (key, size));
+
+    /*  Otherwise use the configured range of the body. */
+    size = nn_chunkref_size (&msg->body);
+    off = (size_t) self->keyoff < size ? (size_t) self->keyoff : size;
+    len = size - off;
+    if (self->keylen >= 0 && (size_t) self->keylen < len)
+        len = (size_t) self->keylen;
+    return nn_lb_mix (nn_lb_hash (
+        ((const uint8_t*) nn_chunkref_data (&msg->body)) + off, len));
+}
+
+static void nn_lb_ring_add (struct nn_lb *self, struct nn_lb_data *data)
+{
+    int i;
+    size_t sz;
+
+    sz = (self->nvnodes + NN_LB_VNODES) * sizeof (struct nn_lb_vnode);
+    if (!self->ring)
+        self->ring = nn_alloc (sz, "consistent hashing ring");
+    else
+        self->ring = nn_realloc (self->ring, sz);
+    alloc_assert (self->ring);
+
+    for (i = 0; i != NN_LB_VNODES; ++i) {
+        self->ring [self->nvnodes].point = nn_lb_mix (data->addrhash +
+            0x9e3779b9u * (uint32_t) (data->ordinal * NN_LB_VNODES + i + 1));
+        self->ring [self->nvnodes].data = data;
+        ++self->nvnodes;
+    }
+    qsort (self->ring, self->nvnodes, sizeof (struct nn_lb_vnode),
+        nn_lb_cmp_vnode);
+}
+
+static void nn_lb_ring_rm (struct nn_lb *self, struct nn_lb_data *data)
+{
+    int i;
+    int j;
+
+    /*  Removing the points keeps the ring sorted. */
+    j = 0;
+    for (i = 0; i != self->nvnodes; ++i)
+        if (self->ring [i].data != data)
+            self->ring [j++] = self->ring [i];
+    self->nvnodes = j;
+}
+
+static int nn_lb_cmp_vnode (const void *a, const void *b)
+{
+    uint32_t pa;
+    uint32_t pb;
+
+    pa = ((const struct nn_lb_vnode*) a)->point;
+    pb = ((const struct nn_lb_vnode*) b)->point;
+    return pa < pb ? -1 : (pa > pb ? 1 : 0);
+}
+
+static uint32_t nn_lb_hash (const uint8_t *data, size_t size)
+{
+    uint32_t hash;
+
+    /*  32-bit FNV-1a. */
+    hash = 2166136261u;
+    while (size--) {
+        hash ^= *data++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t nn_lb_mix (uint32_t h)
+{
+    /*  FNV-1a doesn't spread short keys well enough over the ring.
+        Finish it off with MurmurHash3 finalizer. */
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
@@ -27,14 +27,92 @@
 
 #include "priolist.h"
 
-/*  A load balancer. Round-robins messages to a set of pipes. */
+#include "../../utils/list.h"
+
+#include <stdint.h>
+
+/*  A load balancer. Distributes messages to a set of pipes. By default,
+    messages are round-robined among the pipes of the highest priority
+    available. Alternatively, one of the NN_LB_* strategies can be used to
+    prefer the less loaded of those pipes. */
 
 struct nn_lb_data {
     struct nn_priolist_data priodata;
+
+    /*  Number of messages sent to the pipe that haven't completed yet. */
+    int outstanding;
+
+    /*  Moving average of the time it takes the messages to complete,
+        in 1/16 of a millisecond. -1 if unknown yet. */
+    int ewma;
+
+    /*  When the average was last updated. With NN_LB_EWMA it decays with
+        the time passed since. */
+    uint64_t sampled_at;
+
+    /*  When the last message was sent to the pipe. */
+    uint64_t sent_at;
+
+    /*  Identity of the pipe on the consistent hashing ring. Pipes created
+        by the same endpoint are told apart by the ordinal, the lowest one
+        not used by other such pipes. That way a peer replacing another one
+        takes over its keys. */
+    uint32_t addrhash;
+    int ordinal;
+
+    /*  All pipes, active or not, are kept in the load balancer's list. */
+    struct nn_list_item item;
+
+    /*  Number of messages the peer is willing to accept, -1 if there's
+        no limit. The pipe is active only if it's writeable and has
+        credit left. */
+    int credits;
+    int writeable;
+};
+
+/*  A point on the consistent hashing ring. */
+struct nn_lb_vnode {
+    uint32_t point;
+    struct nn_lb_data *data;
 };
 
 struct nn_lb {
     struct nn_priolist priolist;
+
+    /*  One of the NN_LB_* strategies. */
+    int strategy;
+
+    /*  If set, the owner reports completion of the messages using
+        nn_lb_done, e.g. when the reply arrives. Otherwise, the message
+        completes when the pipe becomes writeable again. */
+    int replies;
+
+    /*  If set, messages sent to the peers supporting NN_PIPE_CAP_DEADLINE
+        are prefixed by the time left till their deadline, taken from
+        the SP_DEADLINE ancillary data, see nn_lb_stamp. */
+    int deadlines;
+
+    /*  State of the pseudorandom generator for NN_LB_P2C. */
+    uint32_t seed;
+
+    /*  Range of the message body to hash with NN_LB_CONSISTENT_HASH.
+        Negative length means till the end of the body. SP_KEY ancillary
+        data, if present, is used instead. */
+    int keyoff;
+    int keylen;
+
+    /*  All the pipes and the number of them per priority. */
+    struct nn_list pipes;
+    int npipes [NN_PRIOLIST_SLOTS];
+
+    /*  The consistent hashing ring, sorted by the points. It's only
+        maintained with NN_LB_CONSISTENT_HASH. */
+    struct nn_lb_vnode *ring;
+    int nvnodes;
+
+    /*  Set when the pipe a key maps to is busy. Nothing can be sent till
+        one of the pipes becomes writeable again. */
+    int blocked;
 };
 
 void nn_lb_init (struct nn_lb *self);
@@ -47,4 +125,25 @@ int nn_lb_can_send (struct nn_lb *self);
 int nn_lb_get_priority (struct nn_lb *self);
 int nn_lb_send (struct nn_lb *self, struct nn_msg *msg, struct nn_pipe **to);
 
+/*  Sets the load-balancing strategy. Returns -EINVAL if the strategy
+    is unknown. */
+int nn_lb_set_strategy (struct nn_lb *self, int strategy);
+int nn_lb_get_strategy (struct nn_lb *self);
+
+/*  Credit-based flow control. nn_lb_limit stops sending messages to the pipe
+    till it's granted credits using nn_lb_credit. Negative number of credits
+    lifts the limit. */
+void nn_lb_limit (struct nn_lb *self, struct nn_lb_data *data);
+void nn_lb_credit (struct nn_lb *self, struct nn_lb_data *data, int credits);
+
+/*  Marks one message sent to the pipe as completed. 'latency' is the time
+    it took in milliseconds, or -1 if the message was abandoned, e.g. when
+    the request was cancelled. Only used when 'replies' is set. */
+void nn_lb_done (struct nn_lb *self, struct nn_lb_data *data, int latency);
+
+/*  Same as nn_lb_send, except that the message is never sent to the pipe
+    'except'. If there's no other pipe available, -EAGAIN is returned. */
+int nn_lb_send_except (struct nn_lb *self, struct nn_msg *msg,
+    struct nn_pipe *except, struct nn_pipe **to);
+
 #endif
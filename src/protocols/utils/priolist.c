@@ -36,6 +36,7 @@ void nn_priolist_init (struct nn_priolist *self)
 
     for (i = 0; i != NN_PRIOLIST_SLOTS; ++i) {
         nn_list_init (&self->slots [i].pipes);
+        self->slots [i].npipes = 0;
         self->slots [i].current = NULL;
     }
     self->current = -1;
@@ -71,6 +72,7 @@ void nn_priolist_rm (struct nn_priolist *self, struct nn_priolist_data *data)
     /*  If the pipe being removed is not current, we can simply erase it
         from the list. */
     slot = &self->slots [data->priority - 1];
+    --slot->npipes;
     if (slot->current != data) {
         nn_list_erase (&slot->pipes, &data->item);
         nn_list_item_term (&data->item);
@@ -107,6 +109,7 @@ void nn_priolist_activate (struct nn_priolist *self,
     struct nn_priolist_slot *slot;
 
     slot = &self->slots [data->priority - 1];
+    ++slot->npipes;
 
     /*  If there are already some elements in this slot, current pipe is not
         going to change. */
@@ -155,8 +158,10 @@ void nn_priolist_advance (struct nn_priolist *self, int release)
     slot = &self->slots [self->current - 1];
 
     /*  Move slot's current pointer to the next pipe. */
-    if (release)
+    if (release) {
         it = nn_list_erase (&slot->pipes, &slot->current->item);
+        --slot->npipes;
+    }
     else
         it = nn_list_next (&slot->pipes, &slot->current->item);
     if (!it)
@@ -175,6 +180,41 @@ void nn_priolist_advance (struct nn_priolist *self, int release)
     }
 }
 
+struct nn_priolist_data *nn_priolist_getdata (struct nn_priolist *self)
+{
+    if (nn_slow (self->current == -1))
+        return NULL;
+    return self->slots [self->current - 1].current;
+}
+
+struct nn_priolist_data *nn_priolist_next (struct nn_priolist *self,
+    struct nn_priolist_data *data)
+{
+    struct nn_priolist_slot *slot;
+    struct nn_list_item *it;
+
+    nn_assert (data->priority == self->current);
+    slot = &self->slots [self->current - 1];
+    it = nn_list_next (&slot->pipes, &data->item);
+    if (!it)
+        it = nn_list_begin (&slot->pipes);
+    return nn_cont (it, struct nn_priolist_data, item);
+}
+
+int nn_priolist_count (struct nn_priolist *self)
+{
+    if (nn_slow (self->current == -1))
+        return 0;
+    return self->slots [self->current - 1].npipes;
+}
+
+void nn_priolist_select (struct nn_priolist *self,
+    struct nn_priolist_data *data)
+{
+    nn_assert (data->priority == self->current);
+    self->slots [self->current - 1].current = data;
+}
+
 int nn_priolist_get_priority (struct nn_priolist *self) {
     return self->current;
 }
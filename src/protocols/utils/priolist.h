@@ -46,8 +46,9 @@ struct nn_priolist_data {
 
 struct nn_priolist_slot {
 
-    /*  The list of pipes on particular priority level. */
+    /*  The list of pipes on particular priority level, and its length. */
     struct nn_list pipes;
+    int npipes;
 
     /*  Pointer to the current pipe within the priority level. If there's no
         pipe available, the field is set to NULL. */
@@ -96,6 +97,24 @@ struct nn_pipe *nn_priolist_getpipe (struct nn_priolist *self);
     nn_priolist_activate function. */
 void nn_priolist_advance (struct nn_priolist *self, int release);
 
+/*  Returns the current pipe. If there's no pipe in the list, NULL is
+    returned. */
+struct nn_priolist_data *nn_priolist_getdata (struct nn_priolist *self);
+
+/*  Returns the pipe following 'data' among the pipes of the current priority,
+    wrapping over. Together with nn_priolist_getdata, it allows to go through
+    the pipes in the order they would be used in. */
+struct nn_priolist_data *nn_priolist_next (struct nn_priolist *self,
+    struct nn_priolist_data *data);
+
+/*  Returns the number of pipes of the current priority. */
+int nn_priolist_count (struct nn_priolist *self);
+
+/*  Makes the pipe current. It has to be one of the pipes of the current
+    priority. */
+void nn_priolist_select (struct nn_priolist *self,
+    struct nn_priolist_data *data);
+
 /*  Returns current priority. Used for statistics only  */
 int nn_priolist_get_priority (struct nn_priolist *self);
 
@@ -34,6 +34,23 @@ extern "C" {
 
 #define NN_SUB_SUBSCRIBE 1
 #define NN_SUB_UNSUBSCRIBE 2
+#define NN_SUB_TOPIC_DELIM 3
+#define NN_SUB_TOPIC_LEN 4
+
+#define NN_PUB_TOPIC_DELIM 5
+#define NN_PUB_TOPIC_LEN 6
+#define NN_PUB_LVC 7
+#define NN_PUB_CONFLATE 8
+#define NN_PUB_SLOW_POLICY 9
+#define NN_PUB_SLOW_BACKLOG 10
+#define NN_PUB_SLOW_MAXDROPS 11
+#define NN_PUB_SLOW_MAXLAG 12
+#define NN_SUB_SUBSCRIBE_BULK 13
+#define NN_PUB_LVC_SIZE 14
+
+/*  Values of NN_PUB_SLOW_POLICY option. */
+#define NN_PUB_SLOW_DROP_NEW 0
+#define NN_PUB_SLOW_DROP_OLDEST 1
 
 #ifdef __cplusplus
 }
@@ -36,6 +36,20 @@ extern "C" {
 #define NN_REP (NN_PROTO_REQREP * 16 + 1)
 
 #define NN_REQ_RESEND_IVL 1
+#define NN_REQ_HEDGE_IVL 2
+#define NN_REQ_HEDGE_PERCENTILE 3
+#define NN_REQ_LB_STRATEGY 4
+#define NN_REQ_LB_KEY_OFFSET 5
+#define NN_REQ_LB_KEY_LEN 6
+
+#define NN_REP_CACHE_SIZE 1
+#define NN_REP_CACHE_TTL 2
+
+/*  Batches of requests, see nn_req_batch(3). */
+NN_EXPORT int nn_req_batch (int s, const struct nn_iovec *reqs, int nreqs,
+    int timeout);
+NN_EXPORT int nn_req_batch_recv (int s, int b, void *buf, size_t len,
+    int *index, int flags);
 
 typedef union nn_req_handle {
     int i;
@@ -134,6 +134,17 @@ struct nn_pipebase;
     the messages passed with a single process. */
 #define NN_PIPEBASE_PARSED 2
 
+/*  Optional protocol capabilities the transport can negotiate with the peer.
+    Subscription forwarding: SUB sockets send their subscriptions upstream
+    and PUB sockets filter the messages before sending them.
+    Credit-based flow control: PULL sockets grant PUSH sockets the number
+    of messages they are willing to accept.
+    Deadline propagation: REQ sockets tell REP sockets how long they are
+    willing to wait for the reply. */
+#define NN_PIPEBASE_CAP_SUBFWD 1
+#define NN_PIPEBASE_CAP_CREDIT 2
+#define NN_PIPEBASE_CAP_DEADLINE 4
+
 struct nn_pipebase_vfptr {
 
     /*  Send a message to the network. The function can return either error
@@ -143,6 +154,11 @@ struct nn_pipebase_vfptr {
     /*  Receive a message from the network. The function can return either error
         (negative number) or any combination of the flags defined above. */
     int (*recv) (struct nn_pipebase *self, struct nn_msg *msg);
+
+    /*  Tear down the connection on behalf of the protocol. The pipe must be
+        stopped (nn_pipebase_stop) before the function returns. Can be NULL
+        if the transport doesn't support closing individual connections. */
+    void (*close) (struct nn_pipebase *self);
 };
 
 /*  Endpoint specific options. Same restrictions as for nn_pipebase apply  */
@@ -162,10 +178,12 @@ struct nn_pipebase {
     uint8_t instate;
     uint8_t outstate;
     struct nn_sock *sock;
+    struct nn_ep *ep;
     void *data;
     struct nn_fsm_event in;
     struct nn_fsm_event out;
     struct nn_ep_options options;
+    int caps;
 };
 
 /*  Initialise the pipe.  */
@@ -191,6 +209,21 @@ void nn_pipebase_sent (struct nn_pipebase *self);
 void nn_pipebase_getopt (struct nn_pipebase *self, int level, int option,
     void *optval, size_t *optvallen);
 
+/*  Returns the set of capabilities supported by the local socket. Transports
+    announce these to the peer during the connection handshake. Transports
+    that have to use reserved protocol fields to do so announce them only if
+    NN_EXTENSIONS socket option is set.  */
+int nn_pipebase_localcaps (struct nn_pipebase *self);
+
+/*  Sets the capabilities announced by the peer. Only the capabilities
+    supported by both sides are retained. Must be called before
+    nn_pipebase_start.  */
+void nn_pipebase_setcaps (struct nn_pipebase *self, int caps);
+
+/*  Increments statistics counters in the socket structure  */
+void nn_pipebase_stat_increment (struct nn_pipebase *self, int name,
+    int increment);
+
 /*  Returns 1 is the specified socket type is a valid peer for this socket,
     or 0 otherwise. */
 int nn_pipebase_ispeer (struct nn_pipebase *self, int socktype);
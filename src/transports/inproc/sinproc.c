@@ -59,7 +59,8 @@ static int nn_sinproc_send (struct nn_pipebase *self, struct nn_msg *msg);
 static int nn_sinproc_recv (struct nn_pipebase *self, struct nn_msg *msg);
 const struct nn_pipebase_vfptr nn_sinproc_pipebase_vfptr = {
     nn_sinproc_send,
-    nn_sinproc_recv
+    nn_sinproc_recv,
+    NULL
 };
 
 void nn_sinproc_init (struct nn_sinproc *self, int src,
@@ -74,6 +75,11 @@ void nn_sinproc_init (struct nn_sinproc *self, int src,
     self->flags = 0;
     self->peer = NULL;
     nn_pipebase_init (&self->pipebase, &nn_sinproc_pipebase_vfptr, ep);
+
+    /*  The peer lives in the same process, so it supports the same set
+        of capabilities as we do. */
+    nn_pipebase_setcaps (&self->pipebase,
+        nn_pipebase_localcaps (&self->pipebase));
     sz = sizeof (rcvbuf);
     nn_ep_getopt (ep, NN_SOL_SOCKET, NN_RCVBUF, &rcvbuf, &sz);
     nn_assert (sz == sizeof (rcvbuf));
@@ -94,6 +100,9 @@ void nn_sinproc_term (struct nn_sinproc *self)
     nn_fsm_event_term (&self->event_sent);
     nn_fsm_event_term (&self->event_connect);
     nn_msg_term (&self->msg);
+    if (self->msgqueue.mem > 0)
+        nn_pipebase_stat_increment (&self->pipebase,
+            NN_STAT_CURRENT_BYTES_QUEUED, - (int) self->msgqueue.mem);
     nn_msgqueue_term (&self->msgqueue);
     nn_pipebase_term (&self->pipebase);
     nn_fsm_term (&self->fsm);
@@ -150,17 +159,28 @@ static int nn_sinproc_send (struct nn_pipebase *self, struct nn_msg *msg)
     nn_assert_state (sinproc, NN_SINPROC_STATE_ACTIVE);
     nn_assert (!(sinproc->flags & NN_SINPROC_FLAG_SENDING));
 
-    nn_msg_init (&nmsg,
-        nn_chunkref_size (&msg->sphdr) +
-        nn_chunkref_size (&msg->body));
-    memcpy (nn_chunkref_data (&nmsg.body),
-        nn_chunkref_data (&msg->sphdr),
-        nn_chunkref_size (&msg->sphdr));
-    memcpy ((char *)nn_chunkref_data (&nmsg.body) +
-        nn_chunkref_size (&msg->sphdr),
-        nn_chunkref_data (&msg->body),
-        nn_chunkref_size (&msg->body));
-    nn_msg_term (msg);
+    /*  The peer expects SP header to be part of the body. If there's no
+        header, the body can be passed as is, possibly shared with other
+        pipes (e.g. by PUB socket). Otherwise, the header and the body have
+        to be merged into a new message. */
+    if (nn_chunkref_size (&msg->sphdr) == 0) {
+        nn_msg_mv (&nmsg, msg);
+        nn_chunkref_term (&nmsg.hdrs);
+        nn_chunkref_init (&nmsg.hdrs, 0);
+    }
+    else {
+        nn_msg_init (&nmsg,
+            nn_chunkref_size (&msg->sphdr) +
+            nn_chunkref_size (&msg->body));
+        memcpy (nn_chunkref_data (&nmsg.body),
+            nn_chunkref_data (&msg->sphdr),
+            nn_chunkref_size (&msg->sphdr));
+        memcpy ((char *)nn_chunkref_data (&nmsg.body) +
+            nn_chunkref_size (&msg->sphdr),
+            nn_chunkref_data (&msg->body),
+            nn_chunkref_size (&msg->body));
+        nn_msg_term (msg);
+    }
 
     /*  Expose the message to the peer. */
     nn_msg_term (&sinproc->msg);
@@ -178,6 +198,7 @@ static int nn_sinproc_send (struct nn_pipebase *self, struct nn_msg *msg)
 static int nn_sinproc_recv (struct nn_pipebase *self, struct nn_msg *msg)
 {
     int rc;
+    size_t mem;
     struct nn_sinproc *sinproc;
 
     sinproc = nn_cont (self, struct nn_sinproc, pipebase);
@@ -187,6 +208,7 @@ static int nn_sinproc_recv (struct nn_pipebase *self, struct nn_msg *msg)
         sinproc->state == NN_SINPROC_STATE_DISCONNECTED);
 
     /*  Move the message to the caller. */
+    mem = sinproc->msgqueue.mem;
     rc = nn_msgqueue_recv (&sinproc->msgqueue, msg);
     errnum_assert (rc == 0, -rc);
 
@@ -207,6 +229,10 @@ static int nn_sinproc_recv (struct nn_pipebase *self, struct nn_msg *msg)
         }
     }
 
+    nn_pipebase_stat_increment (&sinproc->pipebase,
+        NN_STAT_CURRENT_BYTES_QUEUED,
+        (int) sinproc->msgqueue.mem - (int) mem);
+
     if (!nn_msgqueue_empty (&sinproc->msgqueue))
        nn_pipebase_received (&sinproc->pipebase);
 
@@ -311,6 +337,7 @@ static void nn_sinproc_handler (struct nn_fsm *self, int src, int type,
     int rc;
     struct nn_sinproc *sinproc;
     int empty;
+    size_t mem;
 
     sinproc = nn_cont (self, struct nn_sinproc, fsm);
 
@@ -421,6 +448,7 @@ static void nn_sinproc_handler (struct nn_fsm *self, int src, int type,
             case NN_SINPROC_SENT:
 
                 empty = nn_msgqueue_empty (&sinproc->msgqueue);
+                mem = sinproc->msgqueue.mem;
 
                 /*  Push the message to the inbound message queue. */
                 rc = nn_msgqueue_send (&sinproc->msgqueue,
@@ -431,6 +459,9 @@ static void nn_sinproc_handler (struct nn_fsm *self, int src, int type,
                 }
                 errnum_assert (rc == 0, -rc);
                 nn_msg_init (&sinproc->peer->msg, 0);
+                nn_pipebase_stat_increment (&sinproc->pipebase,
+                    NN_STAT_CURRENT_BYTES_QUEUED,
+                    (int) sinproc->msgqueue.mem - (int) mem);
 
                 /*  Notify the user that there's a message to receive. */
                 if (empty)
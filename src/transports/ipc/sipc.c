@@ -58,9 +58,11 @@
 /*  Stream is a special type of pipe. Implementation of the virtual pipe API. */
 static int nn_sipc_send (struct nn_pipebase *self, struct nn_msg *msg);
 static int nn_sipc_recv (struct nn_pipebase *self, struct nn_msg *msg);
+static void nn_sipc_close (struct nn_pipebase *self);
 const struct nn_pipebase_vfptr nn_sipc_pipebase_vfptr = {
     nn_sipc_send,
-    nn_sipc_recv
+    nn_sipc_recv,
+    nn_sipc_close
 };
 
 /*  Private functions. */
@@ -175,6 +177,21 @@ static int nn_sipc_recv (struct nn_pipebase *self, struct nn_msg *msg)
     return 0;
 }
 
+static void nn_sipc_close (struct nn_pipebase *self)
+{
+    struct nn_sipc *sipc;
+
+    sipc = nn_cont (self, struct nn_sipc, pipebase);
+
+    nn_assert_state (sipc, NN_SIPC_STATE_ACTIVE);
+
+    /*  The protocol gave up on the peer. Drop the connection the same way
+        as if it had failed. */
+    nn_pipebase_stop (&sipc->pipebase);
+    sipc->state = NN_SIPC_STATE_DONE;
+    nn_fsm_raise (&sipc->fsm, &sipc->done, NN_SIPC_ERROR);
+}
+
 static void nn_sipc_shutdown (struct nn_fsm *self, int src, int type,
     NN_UNUSED void *srcptr)
 {
@@ -54,9 +54,11 @@
 /*  Stream is a special type of pipe. Implementation of the virtual pipe API. */
 static int nn_stcp_send (struct nn_pipebase *self, struct nn_msg *msg);
 static int nn_stcp_recv (struct nn_pipebase *self, struct nn_msg *msg);
+static void nn_stcp_close (struct nn_pipebase *self);
 const struct nn_pipebase_vfptr nn_stcp_pipebase_vfptr = {
     nn_stcp_send,
-    nn_stcp_recv
+    nn_stcp_recv,
+    nn_stcp_close
 };
 
 /*  Private functions. */
@@ -170,6 +172,21 @@ static int nn_stcp_recv (struct nn_pipebase *self, struct nn_msg *msg)
     return 0;
 }
 
+static void nn_stcp_close (struct nn_pipebase *self)
+{
+    struct nn_stcp *stcp;
+
+    stcp = nn_cont (self, struct nn_stcp, pipebase);
+
+    nn_assert_state (stcp, NN_STCP_STATE_ACTIVE);
+
+    /*  The protocol gave up on the peer. Drop the connection the same way
+        as if it had failed. */
+    nn_pipebase_stop (&stcp->pipebase);
+    stcp->state = NN_STCP_STATE_DONE;
+    nn_fsm_raise (&stcp->fsm, &stcp->done, NN_STCP_ERROR);
+}
+
 static void nn_stcp_shutdown (struct nn_fsm *self, int src, int type,
     NN_UNUSED void *srcptr)
 {
@@ -63,6 +63,7 @@ void nn_streamhdr_init (struct nn_streamhdr *self, int src,
     self->usock_owner.src = -1;
     self->usock_owner.fsm = NULL;
     self->pipebase = NULL;
+    self->caps = 0;
 }
 
 void nn_streamhdr_term (struct nn_streamhdr *self)
@@ -84,6 +85,7 @@ void nn_streamhdr_start (struct nn_streamhdr *self, struct nn_usock *usock,
 {
     size_t sz;
     int protocol;
+    int extensions;
 
     /*  Take ownership of the underlying socket. */
     nn_assert (self->usock == NULL && self->usock_owner.fsm == NULL);
@@ -98,9 +100,19 @@ void nn_streamhdr_start (struct nn_streamhdr *self, struct nn_usock *usock,
     nn_pipebase_getopt (pipebase, NN_SOL_SOCKET, NN_PROTOCOL, &protocol, &sz);
     nn_assert (sz == sizeof (protocol));
 
+    /*  The last two bytes of the header are reserved and must be zero.
+        Peers that don't check them can be announced the capabilities of
+        the socket there, but only if the user has explicitly allowed it. */
+    sz = sizeof (extensions);
+    nn_pipebase_getopt (pipebase, NN_SOL_SOCKET, NN_EXTENSIONS,
+        &extensions, &sz);
+    nn_assert (sz == sizeof (extensions));
+    self->caps = extensions ? nn_pipebase_localcaps (pipebase) : 0;
+
     /*  Compose the protocol header. */
     memcpy (self->protohdr, "\0SP\0\0\0\0\0", 8);
     nn_puts (self->protohdr + 4, (uint16_t) protocol);
+    nn_puts (self->protohdr + 6, (uint16_t) self->caps);
 
     /*  Launch the state machine. */
     nn_fsm_start (&self->fsm);
@@ -223,6 +235,8 @@ static void nn_streamhdr_handler (struct nn_fsm *self, int src, int type,
                 protocol = nn_gets (streamhdr->protohdr + 4);
                 if (!nn_pipebase_ispeer (streamhdr->pipebase, protocol))
                     goto invalidhdr;
+                nn_pipebase_setcaps (streamhdr->pipebase,
+                    nn_gets (streamhdr->protohdr + 6) & streamhdr->caps);
                 nn_timer_stop (&streamhdr->timer);
                 streamhdr->state = NN_STREAMHDR_STATE_STOPPING_TIMER_DONE;
                 return;
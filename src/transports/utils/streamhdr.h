@@ -57,6 +57,9 @@ struct nn_streamhdr {
     /*  Protocol header. */
     uint8_t protohdr [8];
 
+    /*  Capabilities announced to the peer. */
+    int caps;
+
     /*  Event fired when the state machine ends. */
     struct nn_fsm_event done;
 };
@@ -102,9 +102,11 @@
 /*  Stream is a special type of pipe. Implementation of the virtual pipe API. */
 static int nn_sws_send (struct nn_pipebase *self, struct nn_msg *msg);
 static int nn_sws_recv (struct nn_pipebase *self, struct nn_msg *msg);
+static void nn_sws_close (struct nn_pipebase *self);
 const struct nn_pipebase_vfptr nn_sws_pipebase_vfptr = {
     nn_sws_send,
-    nn_sws_recv
+    nn_sws_recv,
+    nn_sws_close
 };
 
 /*  Private functions. */
@@ -754,6 +756,16 @@ static void nn_sws_acknowledge_close_handshake (struct nn_sws *self)
     return;
 }
 
+static void nn_sws_close (struct nn_pipebase *self)
+{
+    struct nn_sws *sws;
+
+    sws = nn_cont (self, struct nn_sws, pipebase);
+
+    /*  The protocol gave up on the peer. */
+    nn_sws_fail_conn (sws, NN_SWS_CLOSE_ERR_POLICY, "Peer too slow");
+}
+
 static void nn_sws_fail_conn (struct nn_sws *self, int code, char *reason)
 {
     size_t reason_len;
@@ -78,3 +78,124 @@ uint32_t nn_atomic_dec (struct nn_atomic *self, uint32_t n)
 #endif
 }
 
+
+void nn_atomic64_init (struct nn_atomic64 *self, int64_t n)
+{
+    self->n = n;
+#if defined NN_ATOMIC_MUTEX
+    nn_mutex_init (&self->sync);
+#endif
+}
+
+void nn_atomic64_term (struct nn_atomic64 *self)
+{
+#if defined NN_ATOMIC_MUTEX
+    nn_mutex_term (&self->sync);
+#endif
+}
+
+int64_t nn_atomic64_add (struct nn_atomic64 *self, int64_t n)
+{
+#if defined NN_ATOMIC_WINAPI
+    return (int64_t) InterlockedExchangeAdd64 ((LONGLONG*) &self->n, n);
+#elif defined NN_ATOMIC_SOLARIS
+    return (int64_t) atomic_add_64_nv ((volatile uint64_t*) &self->n, n) - n;
+#elif defined NN_ATOMIC_GCC_BUILTINS
+    return __sync_fetch_and_add (&self->n, n);
+#elif defined NN_ATOMIC_MUTEX
+    int64_t res;
+    nn_mutex_lock (&self->sync);
+    res = self->n;
+    self->n += n;
+    nn_mutex_unlock (&self->sync);
+    return res;
+#else
+#error
+#endif
+}
+
+int64_t nn_atomic64_cas (struct nn_atomic64 *self, int64_t oldn, int64_t newn)
+{
+#if defined NN_ATOMIC_WINAPI
+    return (int64_t) InterlockedCompareExchange64 ((LONGLONG*) &self->n,
+        newn, oldn);
+#elif defined NN_ATOMIC_SOLARIS
+    return (int64_t) atomic_cas_64 ((volatile uint64_t*) &self->n,
+        (uint64_t) oldn, (uint64_t) newn);
+#elif defined NN_ATOMIC_GCC_BUILTINS
+    return __sync_val_compare_and_swap (&self->n, oldn, newn);
+#elif defined NN_ATOMIC_MUTEX
+    int64_t res;
+    nn_mutex_lock (&self->sync);
+    res = self->n;
+    if (res == oldn)
+        self->n = newn;
+    nn_mutex_unlock (&self->sync);
+    return res;
+#else
+#error
+#endif
+}
+
+void nn_atomic_ptr_init (struct nn_atomic_ptr *self, void *p)
+{
+    self->p = p;
+#if defined NN_ATOMIC_MUTEX
+    nn_mutex_init (&self->sync);
+#endif
+}
+
+void nn_atomic_ptr_term (struct nn_atomic_ptr *self)
+{
+#if defined NN_ATOMIC_MUTEX
+    nn_mutex_term (&self->sync);
+#endif
+}
+
+void *nn_atomic_ptr_cas (struct nn_atomic_ptr *self, void *oldp, void *newp)
+{
+#if defined NN_ATOMIC_WINAPI
+    return InterlockedCompareExchangePointer ((PVOID*) &self->p, newp, oldp);
+#elif defined NN_ATOMIC_SOLARIS
+    return atomic_cas_ptr (&self->p, oldp, newp);
+#elif defined NN_ATOMIC_GCC_BUILTINS
+    return __sync_val_compare_and_swap (&self->p, oldp, newp);
+#elif defined NN_ATOMIC_MUTEX
+    void *res;
+    nn_mutex_lock (&self->sync);
+    res = self->p;
+    if (res == oldp)
+        self->p = newp;
+    nn_mutex_unlock (&self->sync);
+    return res;
+#else
+#error
+#endif
+}
+
+void *nn_atomic_ptr_swap (struct nn_atomic_ptr *self, void *p)
+{
+#if defined NN_ATOMIC_WINAPI
+    return InterlockedExchangePointer ((PVOID*) &self->p, p);
+#elif defined NN_ATOMIC_SOLARIS
+    return atomic_swap_ptr (&self->p, p);
+#elif defined NN_ATOMIC_GCC_BUILTINS
+    void *res;
+
+    /*  __sync_lock_test_and_set is not a full exchange on all platforms,
+        so use a compare-and-swap loop instead. */
+    do {
+        res = self->p;
+    } while (__sync_val_compare_and_swap (&self->p, res, p) != res);
+    return res;
+#elif defined NN_ATOMIC_MUTEX
+    void *res;
+    nn_mutex_lock (&self->sync);
+    res = self->p;
+    self->p = p;
+    nn_mutex_unlock (&self->sync);
+    return res;
+#else
+#error
+#endif
+}
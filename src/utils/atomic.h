@@ -57,5 +57,48 @@ uint32_t nn_atomic_inc (struct nn_atomic *self, uint32_t n);
 /*  Atomically subtract n from the object, return old value of the object. */
 uint32_t nn_atomic_dec (struct nn_atomic *self, uint32_t n);
 
+/*  64-bit signed atomic counter. */
+struct nn_atomic64 {
+#if defined NN_ATOMIC_MUTEX
+    struct nn_mutex sync;
+#endif
+    volatile int64_t n;
+};
+
+/*  Initialise the object. Set it to value 'n'. */
+void nn_atomic64_init (struct nn_atomic64 *self, int64_t n);
+
+/*  Destroy the object. */
+void nn_atomic64_term (struct nn_atomic64 *self);
+
+/*  Atomically add n (which may be negative) to the object, return old value
+    of the object. */
+int64_t nn_atomic64_add (struct nn_atomic64 *self, int64_t n);
+
+/*  If the object is equal to 'oldn', replace it by 'newn'. Returns the value
+    the object had before the call. */
+int64_t nn_atomic64_cas (struct nn_atomic64 *self, int64_t oldn, int64_t newn);
+
+/*  Atomic pointer. Used to build lock-free lists. */
+struct nn_atomic_ptr {
+#if defined NN_ATOMIC_MUTEX
+    struct nn_mutex sync;
+#endif
+    void * volatile p;
+};
+
+/*  Initialise the object. Set it to value 'p'. */
+void nn_atomic_ptr_init (struct nn_atomic_ptr *self, void *p);
+
+/*  Destroy the object. */
+void nn_atomic_ptr_term (struct nn_atomic_ptr *self);
+
+/*  If the object is equal to 'oldp', replace it by 'newp'. Returns the value
+    the object had before the call. */
+void *nn_atomic_ptr_cas (struct nn_atomic_ptr *self, void *oldp, void *newp);
+
+/*  Atomically replace the object by 'p', return old value of the object. */
+void *nn_atomic_ptr_swap (struct nn_atomic_ptr *self, void *p);
+
 #endif
 
@@ -28,6 +28,9 @@
 #include "wire.h"
 #include "err.h"
 
+#include "mutex.h"
+#include "condvar.h"
+
 #include <string.h>
 
 #define NN_CHUNK_TAG 0xdeadcafe
@@ -56,11 +59,455 @@ static struct nn_chunk *nn_chunk_getptr (void *p);
 static void *nn_chunk_getdata (struct nn_chunk *c);
 static void nn_chunk_default_free (void *p);
 static size_t nn_chunk_hdrsize ();
+static int nn_chunk_thread_index (void);
+static void nn_chunk_account (size_t size, int64_t chunks, int64_t bytes);
+
+/*  Each thread gets a small integer identifier when it first uses the chunk
+    allocator. Per-thread state (statistics, caches) is spread by this number
+    so that threads don't contend for the same memory. */
+#if defined _MSC_VER
+#define NN_CHUNK_TLS __declspec(thread)
+#elif defined NN_HAVE_GCC_TLS
+#define NN_CHUNK_TLS __thread
+#endif
+
+#if defined NN_CHUNK_TLS && !defined NN_ATOMIC_MUTEX
+
+/*  Identifier of the thread plus one. Zero means that the thread hasn't been
+    assigned one yet. Lock-free atomics need no initialisation, so there's no
+    need to wait for nn_chunk_init(). */
+static NN_CHUNK_TLS int nn_chunk_thread_id;
+static struct nn_atomic nn_chunk_next_thread;
+
+static int nn_chunk_thread_index (void)
+{
+    if (nn_slow (!nn_chunk_thread_id))
+        nn_chunk_thread_id = (int) (nn_atomic_inc (&nn_chunk_next_thread, 1) &
+            0xffff) + 1;
+    return nn_chunk_thread_id - 1;
+}
+
+#else
+
+static int nn_chunk_thread_index (void)
+{
+    return 0;
+}
+
+#endif
+
+/*  Memory statistics. Counters are split into stripes, each thread updating
+    the stripe selected by its identifier, so that the accounting doesn't
+    bounce a single cache line between all the threads. Exact values are
+    obtained by summing up all the stripes. Additionally, stripes publish
+    their balance into a global approximate total once it exceeds
+    NN_CHUNK_STAT_BATCH bytes. The total is used to track peak usage. */
+
+#define NN_CHUNK_STRIPES 16
+#define NN_CHUNK_STAT_CLASSES 6
+#define NN_CHUNK_STAT_BATCH (64 * 1024)
+
+struct nn_chunk_stripe {
+    struct nn_atomic64 chunks;
+    struct nn_atomic64 bytes [NN_CHUNK_STAT_CLASSES];
+    struct nn_atomic64 pending;
+
+    /*  Make sure that two stripes never share a cache line. */
+    uint8_t padding [64];
+};
+
+/*  With the mutex-based fallback the counters would need initialisation
+    before the first chunk is allocated, which can't be guaranteed. Memory
+    statistics are not available on such platforms. */
+#if !defined NN_ATOMIC_MUTEX
+#define NN_CHUNK_STATS
+static struct nn_chunk_stripe nn_chunk_stripes [NN_CHUNK_STRIPES];
+static struct nn_atomic64 nn_chunk_total;
+static struct nn_atomic64 nn_chunk_peak;
+
+/*  Process-wide memory budget in bytes, zero meaning unlimited. Threads
+    waiting for memory to be released sleep on the condition variable, which
+    is signaled when a stripe publishes a total below the budget. */
+#define NN_CHUNK_BUDGET_IVL 100
+static volatile int64_t nn_chunk_budget;
+static struct nn_mutex nn_chunk_budget_sync;
+static struct nn_condvar nn_chunk_budget_cond;
+static volatile int nn_chunk_budget_waiters;
+#endif
+
+static void nn_chunk_account (size_t size, int64_t chunks, int64_t bytes)
+{
+#if defined NN_CHUNK_STATS
+    struct nn_chunk_stripe *stripe;
+    int cls;
+    int64_t pending;
+    int64_t total;
+    int64_t peak;
+
+    /*  Size classes: up to 64B, 256B, 1kB, 4kB, 64kB and larger. */
+    if (size <= 64)
+        cls = 0;
+    else if (size <= 256)
+        cls = 1;
+    else if (size <= 1024)
+        cls = 2;
+    else if (size <= 4096)
+        cls = 3;
+    else if (size <= 65536)
+        cls = 4;
+    else
+        cls = 5;
+
+    stripe = &nn_chunk_stripes [nn_chunk_thread_index () % NN_CHUNK_STRIPES];
+    nn_atomic64_add (&stripe->chunks, chunks);
+    nn_atomic64_add (&stripe->bytes [cls], bytes);
+    pending = nn_atomic64_add (&stripe->pending, bytes) + bytes;
+    if (nn_fast (pending < NN_CHUNK_STAT_BATCH &&
+          pending > -NN_CHUNK_STAT_BATCH))
+        return;
+
+    /*  Publish the balance of the stripe. */
+    nn_atomic64_add (&stripe->pending, -pending);
+    total = nn_atomic64_add (&nn_chunk_total, pending) + pending;
+    peak = nn_chunk_peak.n;
+    while (total > peak)
+        peak = nn_atomic64_cas (&nn_chunk_peak, peak, total);
+
+    /*  Wake up the threads waiting for the memory budget. */
+    if (nn_slow (nn_chunk_budget_waiters > 0 && total < nn_chunk_budget)) {
+        nn_mutex_lock (&nn_chunk_budget_sync);
+        nn_condvar_broadcast (&nn_chunk_budget_cond);
+        nn_mutex_unlock (&nn_chunk_budget_sync);
+    }
+#endif
+}
+
+uint64_t nn_chunk_stat (int name)
+{
+#if defined NN_CHUNK_STATS
+    int i;
+    int j;
+    int64_t val;
+    int64_t peak;
+
+    if (name == NN_CHUNK_STAT_BUDGET)
+        return (uint64_t) nn_chunk_budget;
+
+    val = 0;
+    for (i = 0; i != NN_CHUNK_STRIPES; ++i) {
+        switch (name) {
+        case NN_CHUNK_STAT_CHUNKS:
+            val += nn_chunk_stripes [i].chunks.n;
+            break;
+        case NN_CHUNK_STAT_BYTES:
+        case NN_CHUNK_STAT_PEAK:
+            for (j = 0; j != NN_CHUNK_STAT_CLASSES; ++j)
+                val += nn_chunk_stripes [i].bytes [j].n;
+            break;
+        default:
+            nn_assert (name >= NN_CHUNK_STAT_CLASS &&
+                name < NN_CHUNK_STAT_CLASS + NN_CHUNK_STAT_CLASSES);
+            val += nn_chunk_stripes [i].bytes [name - NN_CHUNK_STAT_CLASS].n;
+            break;
+        }
+    }
+
+    /*  The peak is tracked only with NN_CHUNK_STAT_BATCH granularity.
+        Make sure it's never lower than current usage. */
+    if (name == NN_CHUNK_STAT_PEAK) {
+        peak = nn_chunk_peak.n;
+        while (val > peak)
+            peak = nn_atomic64_cas (&nn_chunk_peak, peak, val);
+        val = val > peak ? val : peak;
+    }
+
+    /*  The stripes are read one by one, while other threads are running.
+        The sum may thus be slightly off, but never negative. */
+    return val > 0 ? (uint64_t) val : 0;
+#else
+    return 0;
+#endif
+}
+
+#if defined NN_CHUNK_CACHE
+
+/*  Small chunks are recycled rather than returned to the system allocator.
+    Each thread is mapped to one of NN_CHUNK_ARENAS arenas, each arena keeping
+    a free list per size class. A chunk released by a thread that belongs to
+    a different arena than the one the chunk was allocated from is pushed to
+    the owner's lock-free "remote" list. The owner takes the whole remote
+    list at once when its local list runs dry, keeps what fits into the cache
+    and releases the rest. That way producer/consumer pairs running in
+    different threads never contend for the same lock. */
+
+#define NN_CHUNK_ARENAS 16
+
+/*  Size classes are powers of two, from NN_CHUNK_CLASS_MIN to
+    NN_CHUNK_CLASS_MIN << (NN_CHUNK_CLASSES - 1) bytes of message data.
+    Larger chunks are not cached. */
+#define NN_CHUNK_CLASSES 7
+#define NN_CHUNK_CLASS_MIN 64
+#define NN_CHUNK_CLASS_MAX (NN_CHUNK_CLASS_MIN << (NN_CHUNK_CLASSES - 1))
+
+/*  Maximum amount of memory an arena keeps cached per size class. */
+#define NN_CHUNK_CACHE_BYTES (256 * 1024)
+#define NN_CHUNK_CACHE_BLOCKS 256
+
+/*  Header preceding every cached chunk. */
+struct nn_chunk_block {
+    struct nn_chunk_block *next;
+    int arena;
+    int cls;
+};
+
+struct nn_chunk_arena {
+    struct nn_mutex sync;
+    struct nn_chunk_block *local [NN_CHUNK_CLASSES];
+    int count [NN_CHUNK_CLASSES];
+    struct nn_atomic_ptr remote [NN_CHUNK_CLASSES];
+};
+
+static struct nn_chunk_arena nn_chunk_arenas [NN_CHUNK_ARENAS];
+static volatile int nn_chunk_cache_active;
+static struct nn_chunk *nn_chunk_cache_alloc (size_t size);
+static void nn_chunk_cache_free (void *p);
+static void nn_chunk_cache_flush (struct nn_chunk_block *block);
+
+/*  Maximum number of blocks an arena keeps in the local list of the size
+    class. */
+static int nn_chunk_cache_limit (int cls)
+{
+    int limit;
+
+    limit = NN_CHUNK_CACHE_BYTES / (NN_CHUNK_CLASS_MIN << cls);
+    return limit < NN_CHUNK_CACHE_BLOCKS ? limit : NN_CHUNK_CACHE_BLOCKS;
+}
+
+static void nn_chunk_cache_init (void)
+{
+    int i;
+    int j;
+
+    for (i = 0; i != NN_CHUNK_ARENAS; ++i) {
+        nn_mutex_init (&nn_chunk_arenas [i].sync);
+        for (j = 0; j != NN_CHUNK_CLASSES; ++j) {
+            nn_chunk_arenas [i].local [j] = NULL;
+            nn_chunk_arenas [i].count [j] = 0;
+            nn_atomic_ptr_init (&nn_chunk_arenas [i].remote [j], NULL);
+        }
+    }
+    nn_chunk_cache_active = 1;
+}
+
+static void nn_chunk_cache_term (void)
+{
+    int i;
+    int j;
+
+    /*  From now on, chunks are allocated and freed directly. */
+    nn_chunk_cache_active = 0;
+
+    for (i = 0; i != NN_CHUNK_ARENAS; ++i) {
+        for (j = 0; j != NN_CHUNK_CLASSES; ++j) {
+            nn_chunk_cache_flush (nn_chunk_arenas [i].local [j]);
+            nn_chunk_cache_flush (nn_atomic_ptr_swap (
+                &nn_chunk_arenas [i].remote [j], NULL));
+            nn_atomic_ptr_term (&nn_chunk_arenas [i].remote [j]);
+        }
+        nn_mutex_term (&nn_chunk_arenas [i].sync);
+    }
+}
+
+static struct nn_chunk *nn_chunk_cache_alloc (size_t size)
+{
+    int cls;
+    int arena;
+    struct nn_chunk_arena *a;
+    struct nn_chunk_block *block;
+    struct nn_chunk_block *it;
+    struct nn_chunk_block *excess;
+
+    if (nn_slow (!nn_chunk_cache_active || size > NN_CHUNK_CLASS_MAX))
+        return NULL;
+
+    /*  Find the smallest size class the chunk fits into. */
+    cls = 0;
+    while ((size_t) (NN_CHUNK_CLASS_MIN << cls) < size)
+        ++cls;
+
+    arena = nn_chunk_thread_index () % NN_CHUNK_ARENAS;
+    a = &nn_chunk_arenas [arena];
+
+    excess = NULL;
+    nn_mutex_lock (&a->sync);
+    if (nn_slow (!a->local [cls])) {
+
+        /*  The local list is empty. Grab the chunks released to this arena
+            by other threads. Keep only as many of them as the local list
+            is allowed to hold, the rest goes back to the allocator. */
+        a->local [cls] = nn_atomic_ptr_swap (&a->remote [cls], NULL);
+        for (it = a->local [cls]; it; it = it->next) {
+            ++a->count [cls];
+            if (a->count [cls] == nn_chunk_cache_limit (cls)) {
+                excess = it->next;
+                it->next = NULL;
+                break;
+            }
+        }
+    }
+    block = a->local [cls];
+    if (block) {
+        a->local [cls] = block->next;
+        --a->count [cls];
+    }
+    nn_mutex_unlock (&a->sync);
+    nn_chunk_cache_flush (excess);
+
+    /*  Nothing to recycle. Allocate a new block. */
+    if (!block) {
+        block = nn_alloc (sizeof (struct nn_chunk_block) +
+            nn_chunk_hdrsize () + (NN_CHUNK_CLASS_MIN << cls),
+            "message chunk");
+        if (nn_slow (!block))
+            return NULL;
+        block->arena = arena;
+        block->cls = cls;
+    }
+
+    return (struct nn_chunk*) (block + 1);
+}
+
+static void nn_chunk_cache_free (void *p)
+{
+    struct nn_chunk_block *block;
+    struct nn_chunk_arena *a;
+    struct nn_chunk_block *head;
+    int cls;
+
+    block = ((struct nn_chunk_block*) p) - 1;
+    cls = block->cls;
+
+    /*  The cache was already shut down. */
+    if (nn_slow (!nn_chunk_cache_active)) {
+        nn_free (block);
+        return;
+    }
+
+    a = &nn_chunk_arenas [block->arena];
+
+    /*  Chunk is released by the thread of the owner arena. Put it into
+        the local list, unless the arena caches too much memory already. */
+    if (block->arena == nn_chunk_thread_index () % NN_CHUNK_ARENAS) {
+        nn_mutex_lock (&a->sync);
+        if (a->count [cls] < nn_chunk_cache_limit (cls)) {
+            block->next = a->local [cls];
+            a->local [cls] = block;
+            ++a->count [cls];
+            block = NULL;
+        }
+        nn_mutex_unlock (&a->sync);
+        if (block)
+            nn_free (block);
+        return;
+    }
+
+    /*  Chunk is released by a different thread. Push it to the remote list
+        of the owner arena without touching its lock. Blocks are only ever
+        removed from the remote list all at once, so there's no ABA issue. */
+    do {
+        head = a->remote [cls].p;
+        block->next = head;
+    } while (nn_atomic_ptr_cas (&a->remote [cls], head, block) != head);
+}
+
+static void nn_chunk_cache_flush (struct nn_chunk_block *block)
+{
+    struct nn_chunk_block *next;
+
+    while (block) {
+        next = block->next;
+        nn_free (block);
+        block = next;
+    }
+}
+
+#endif
+
+void nn_chunk_init (void)
+{
+#if defined NN_CHUNK_STATS
+    nn_mutex_init (&nn_chunk_budget_sync);
+    nn_condvar_init (&nn_chunk_budget_cond);
+    nn_chunk_budget_waiters = 0;
+#endif
+#if defined NN_CHUNK_CACHE
+    nn_chunk_cache_init ();
+#endif
+}
+
+void nn_chunk_term (void)
+{
+#if defined NN_CHUNK_CACHE
+    nn_chunk_cache_term ();
+#endif
+#if defined NN_CHUNK_STATS
+    nn_assert (nn_chunk_budget_waiters == 0);
+    nn_condvar_term (&nn_chunk_budget_cond);
+    nn_mutex_term (&nn_chunk_budget_sync);
+#endif
+}
+
+void nn_chunk_set_budget (uint64_t budget)
+{
+#if defined NN_CHUNK_STATS
+    nn_chunk_budget = (int64_t) budget;
+#endif
+}
+
+int nn_chunk_budget_exhausted (void)
+{
+#if defined NN_CHUNK_STATS
+    int64_t budget;
+
+    budget = nn_chunk_budget;
+    if (nn_fast (budget == 0))
+        return 0;
+
+    /*  The approximate total is off by less than one batch per stripe.
+        Only if it's close to the budget, compute the exact value. */
+    if (nn_fast (nn_chunk_total.n + NN_CHUNK_STRIPES * NN_CHUNK_STAT_BATCH <
+          budget))
+        return 0;
+    return nn_chunk_stat (NN_CHUNK_STAT_BYTES) >= (uint64_t) budget;
+#else
+    return 0;
+#endif
+}
+
+void nn_chunk_budget_wait (int timeout)
+{
+#if defined NN_CHUNK_STATS
+    /*  Memory released by a thread shows up in the global total only once
+        its stripe publishes the balance. Thus, the wait is cut into short
+        intervals to re-check the exact value now and then. */
+    if (timeout < 0 || timeout > NN_CHUNK_BUDGET_IVL)
+        timeout = NN_CHUNK_BUDGET_IVL;
+
+    nn_mutex_lock (&nn_chunk_budget_sync);
+    ++nn_chunk_budget_waiters;
+    if (nn_chunk_budget_exhausted ())
+        (void) nn_condvar_wait (&nn_chunk_budget_cond, &nn_chunk_budget_sync,
+            timeout);
+    --nn_chunk_budget_waiters;
+    nn_mutex_unlock (&nn_chunk_budget_sync);
+#endif
+}
 
 int nn_chunk_alloc (size_t size, int type, void **result)
 {
     size_t sz;
     struct nn_chunk *self;
+    nn_chunk_free_fn ffn;
     const size_t hdrsz = nn_chunk_hdrsize ();
 
     /*  Compute total size to be allocated. Check for overflow. */
@@ -71,7 +518,15 @@ int nn_chunk_alloc (size_t size, int type, void **result)
     /*  Allocate the actual memory depending on the type. */
     switch (type) {
     case 0:
+#if defined NN_CHUNK_CACHE
+        self = nn_chunk_cache_alloc (size);
+        if (self) {
+            ffn = nn_chunk_cache_free;
+            break;
+        }
+#endif
         self = nn_alloc (sz, "message chunk");
+        ffn = nn_chunk_default_free;
         break;
     default:
         return -EINVAL;
@@ -82,7 +537,7 @@ int nn_chunk_alloc (size_t size, int type, void **result)
     /*  Fill in the chunk header. */
     nn_atomic_init (&self->refcount, 1);
     self->size = size;
-    self->ffn = nn_chunk_default_free;
+    self->ffn = ffn;
 
     /*  Fill in the size of the empty space between the chunk header
         and the message. */
@@ -91,6 +546,8 @@ int nn_chunk_alloc (size_t size, int type, void **result)
     /*  Fill in the tag. */
     nn_putl ((uint8_t*) ((((uint32_t*) (self + 1))) + 1), NN_CHUNK_TAG);
 
+    nn_chunk_account (size, 1, (int64_t) sz);
+
     *result = nn_chunk_getdata (self);
     return 0;
 }
@@ -102,13 +559,17 @@ int nn_chunk_realloc (size_t size, void **chunk)
     void *new_ptr;
     size_t hdr_size;
     size_t new_size;
+    size_t old_size;
     int rc;
 
     self = nn_chunk_getptr (*chunk);
 
     /*  Check if we only have one reference to this object, in that case we can
-        reallocate the memory chunk. */
-    if (self->refcount.n == 1) {
+        reallocate the memory chunk. Chunks that don't come directly from
+        nn_alloc (e.g. cached ones) or that were trimmed have to be copied
+        though. */
+    if (self->refcount.n == 1 && self->ffn == nn_chunk_default_free &&
+          nn_getl ((uint8_t*) *chunk - 2 * sizeof (uint32_t)) == 0) {
 
         /* Compute new size, check for overflow. */
         hdr_size = nn_chunk_hdrsize ();
@@ -117,10 +578,13 @@ int nn_chunk_realloc (size_t size, void **chunk)
             return -ENOMEM;
 
         /*  Reallocate memory chunk. */
+        old_size = self->size;
         new_chunk = nn_realloc (self, new_size);
         if (nn_slow (new_chunk == NULL))
             return -ENOMEM;
 
+        nn_chunk_account (old_size, -1, - (int64_t) (hdr_size + old_size));
+        nn_chunk_account (size, 1, (int64_t) new_size);
         new_chunk->size = size;
         *chunk = nn_chunk_getdata (new_chunk);
     }
@@ -135,9 +599,10 @@ int nn_chunk_realloc (size_t size, void **chunk)
             return rc;
         }
 
-        memcpy (new_ptr, nn_chunk_getdata (self), self->size);
+        memcpy (new_ptr, *chunk, size < nn_chunk_size (*chunk) ? size :
+            nn_chunk_size (*chunk));
+        nn_chunk_free (*chunk);
         *chunk = new_ptr;
-        nn_atomic_dec (&self->refcount, 1);
     }
 
     return 0;
@@ -146,6 +611,7 @@ int nn_chunk_realloc (size_t size, void **chunk)
 void nn_chunk_free (void *p)
 {
     struct nn_chunk *self;
+    size_t size;
 
     self = nn_chunk_getptr (p);
 
@@ -153,6 +619,11 @@ void nn_chunk_free (void *p)
         it drops to zero. */
     if (nn_atomic_dec (&self->refcount, 1) <= 1) {
 
+        /*  Account for the whole allocation, including the space trimmed
+            off the beginning of the chunk. */
+        size = self->size + nn_getl ((uint8_t*) p - 2 * sizeof (uint32_t));
+        nn_chunk_account (size, -1, - (int64_t) (nn_chunk_hdrsize () + size));
+
         /*  Mark chunk as deallocated. */
         nn_putl ((uint8_t*) (((uint32_t*) p) - 1), NN_CHUNK_TAG_DEALLOCATED);
 
@@ -174,6 +645,12 @@ void nn_chunk_addref (void *p, uint32_t n)
     nn_atomic_inc (&self->refcount, n);
 }
 
+int nn_chunk_isshared (void *p)
+{
+    /*  Only the holders of a reference can add more references, so once
+        the count drops to one it can't go up behind our back. */
+    return nn_chunk_getptr (p)->refcount.n > 1;
+}
 
 size_t nn_chunk_size (void *p)
 {
@@ -26,6 +26,34 @@
 #include <stddef.h>
 #include <stdint.h>
 
+/*  Initialise and terminate the chunk allocator. Chunks can be allocated and
+    freed outside of these calls, they just won't be cached. */
+void nn_chunk_init (void);
+void nn_chunk_term (void);
+
+/*  Process-wide memory statistics. NN_CHUNK_STAT_CLASS + i is the number of
+    bytes held by chunks in i-th size class (up to 64B, 256B, 1kB, 4kB, 64kB
+    and larger). */
+#define NN_CHUNK_STAT_CHUNKS 1
+#define NN_CHUNK_STAT_BYTES 2
+#define NN_CHUNK_STAT_PEAK 3
+#define NN_CHUNK_STAT_BUDGET 4
+#define NN_CHUNK_STAT_CLASS 10
+uint64_t nn_chunk_stat (int name);
+
+/*  Sets the process-wide limit on memory held by chunks. Zero means there's
+    no limit. The allocator itself doesn't enforce the limit, it's up to the
+    caller to check it using nn_chunk_budget_exhausted(). */
+void nn_chunk_set_budget (uint64_t budget);
+
+/*  Returns 1 if the memory held by chunks reached the budget, 0 otherwise. */
+int nn_chunk_budget_exhausted (void);
+
+/*  Waits for memory to be released, at most 'timeout' milliseconds (-1 means
+    no limit). May return early, the caller should re-check the budget. Must
+    be called only between nn_chunk_init() and nn_chunk_term(). */
+void nn_chunk_budget_wait (int timeout);
+
 /*  Allocates the chunk using the allocation mechanism specified by 'type'. */
 int nn_chunk_alloc (size_t size, int type, void **result);
 
@@ -39,6 +67,10 @@ void nn_chunk_free (void *p);
 /*  Increases the reference count of the chunk by 'n'. */
 void nn_chunk_addref (void *p, uint32_t n);
 
+/*  Returns 1 if the chunk may be referenced from more than one place. Such
+    chunk must not be modified. */
+int nn_chunk_isshared (void *p);
+
 /*  Returns size of the chunk buffer. */
 size_t nn_chunk_size (void *p);
 
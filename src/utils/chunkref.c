@@ -22,6 +22,7 @@
 
 #include "chunkref.h"
 #include "err.h"
+#include "fast.h"
 
 #include <string.h>
 
@@ -36,6 +37,9 @@ struct nn_chunkref_chunk {
     of the structure. */
 CT_ASSERT (NN_CHUNKREF_MAX < 255);
 
+/*  The value is used as a byte size of a union; keep it word-aligned. */
+CT_ASSERT (NN_CHUNKREF_MAX % sizeof (void*) == 0);
+
 /*  Check whether nn_chunkref_chunk fits into nn_chunkref. */
 CT_ASSERT (sizeof (struct nn_chunkref) >= sizeof (struct nn_chunkref_chunk));
 
@@ -83,6 +87,18 @@ void *nn_chunkref_getchunk (struct nn_chunkref *self)
     if (self->u.ref [0] == 0xff) {
         ch = (struct nn_chunkref_chunk*) self;
         self->u.ref [0] = 0;
+
+        /*  The caller is free to modify the chunk. If it is shared with other
+            messages (e.g. when fanned out to multiple inproc pipes), give it
+            a private copy instead. */
+        if (nn_slow (nn_chunk_isshared (ch->chunk))) {
+            rc = nn_chunk_alloc (nn_chunk_size (ch->chunk), 0, &chunk);
+            errno_assert (rc == 0);
+            memcpy (chunk, ch->chunk, nn_chunk_size (ch->chunk));
+            nn_chunk_free (ch->chunk);
+            return chunk;
+        }
+
         return ch->chunk;
     }
 
@@ -126,10 +142,26 @@ size_t nn_chunkref_size (struct nn_chunkref *self)
 
 void nn_chunkref_trim (struct nn_chunkref *self, size_t n)
 {
+    int rc;
     struct nn_chunkref_chunk *ch;
+    void *chunk;
 
     if (self->u.ref [0] == 0xff) {
         ch = (struct nn_chunkref_chunk*) self;
+
+        /*  Trimming modifies the chunk header. Shared chunks have to be
+            copied first. */
+        if (nn_slow (nn_chunk_isshared (ch->chunk))) {
+            nn_assert (nn_chunk_size (ch->chunk) >= n);
+            rc = nn_chunk_alloc (nn_chunk_size (ch->chunk) - n, 0, &chunk);
+            errno_assert (rc == 0);
+            memcpy (chunk, ((uint8_t*) ch->chunk) + n,
+                nn_chunk_size (ch->chunk) - n);
+            nn_chunk_free (ch->chunk);
+            ch->chunk = chunk;
+            return;
+        }
+
         ch->chunk = nn_chunk_trim (ch->chunk, n);
         return;
     }
@@ -23,7 +23,14 @@
 #ifndef NN_CHUNKREF_INCLUDED
 #define NN_CHUNKREF_INCLUDED
 
+/*  Messages shorter than this (including the size byte) are stored inside
+    the chunkref itself rather than in a separately allocated chunk. Every
+    nn_msg carries three chunkrefs, so raising the value trades memory per
+    queued message for fewer allocations. It can be set at build time, e.g.
+    via the NN_CHUNKREF_MAX CMake variable. */
+#ifndef NN_CHUNKREF_MAX
 #define NN_CHUNKREF_MAX 32
+#endif
 
 #include "chunk.h"
 
@@ -26,9 +26,11 @@
 #if defined __GNUC__ || defined __llvm__
 #define nn_fast(x) __builtin_expect ((x), 1)
 #define nn_slow(x) __builtin_expect ((x), 0)
+#define nn_prefetch(x) __builtin_prefetch ((x))
 #else
 #define nn_fast(x) (x)
 #define nn_slow(x) (x)
+#define nn_prefetch(x) ((void) 0)
 #endif
 
 #endif
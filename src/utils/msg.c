@@ -22,6 +22,8 @@
 
 #include "msg.h"
 
+#include "../nn.h"
+
 #include <string.h>
 
 void nn_msg_init (struct nn_msg *self, size_t size)
@@ -79,3 +81,47 @@ void nn_msg_replace_body (struct nn_msg *self, struct nn_chunkref new_body)
     self->body = new_body;
 }
 
+
+void *nn_msg_getcmsg (struct nn_msg *self, int level, int type, size_t *size)
+{
+    struct nn_msghdr hdr;
+    struct nn_cmsghdr *cmsg;
+
+    if (nn_chunkref_size (&self->hdrs) == 0)
+        return NULL;
+
+    memset (&hdr, 0, sizeof (hdr));
+    hdr.msg_control = nn_chunkref_data (&self->hdrs);
+    hdr.msg_controllen = nn_chunkref_size (&self->hdrs);
+    cmsg = NN_CMSG_FIRSTHDR (&hdr);
+    while (cmsg) {
+        if (cmsg->cmsg_level == level && cmsg->cmsg_type == type) {
+            *size = cmsg->cmsg_len - NN_CMSG_SPACE (0);
+            return NN_CMSG_DATA (cmsg);
+        }
+        cmsg = NN_CMSG_NXTHDR (&hdr, cmsg);
+    }
+
+    return NULL;
+}
+
+void nn_msg_addcmsg (struct nn_msg *self, int level, int type,
+    const void *data, size_t size)
+{
+    struct nn_chunkref ref;
+    struct nn_cmsghdr *cmsg;
+    size_t space;
+
+    space = NN_CMSG_SPACE (size);
+    nn_chunkref_init (&ref, space + nn_chunkref_size (&self->hdrs));
+    cmsg = nn_chunkref_data (&ref);
+    memset (cmsg, 0, space);
+    cmsg->cmsg_len = NN_CMSG_LEN (size);
+    cmsg->cmsg_level = level;
+    cmsg->cmsg_type = type;
+    memcpy (NN_CMSG_DATA (cmsg), data, size);
+    memcpy (((uint8_t*) cmsg) + space, nn_chunkref_data (&self->hdrs),
+        nn_chunkref_size (&self->hdrs));
+    nn_chunkref_term (&self->hdrs);
+    nn_chunkref_mv (&self->hdrs, &ref);
+}
@@ -72,5 +72,15 @@ void nn_msg_bulkcopy_cp (struct nn_msg *dst, struct nn_msg *src);
     that substantially rewrite or preprocess the userland message to be written. */
 void nn_msg_replace_body(struct nn_msg *self, struct nn_chunkref newBody);
 
+/*  Returns the data of the first ancillary property of the given level and
+    type in 'hdrs' and stores its size to 'size'. Returns NULL if there's
+    no such property. */
+void *nn_msg_getcmsg (struct nn_msg *self, int level, int type, size_t *size);
+
+/*  Adds an ancillary property to 'hdrs', in front of the existing ones, so
+    that it takes precedence over any older property of the same type. */
+void nn_msg_addcmsg (struct nn_msg *self, int level, int type,
+    const void *data, size_t size);
+
 #endif
 
@@ -0,0 +1,130 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#include "../src/nn.h"
+#include "../src/pair.h"
+#include "../src/reqrep.h"
+
+#include "testutil.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*  Test the process-wide memory budget. */
+
+#define SOCKET_ADDRESS "inproc://budget"
+#define MSG_SIZE 10000
+
+int main ()
+{
+    int rc;
+    int sb;
+    int sc;
+    int i;
+    int rcvbuf;
+    int timeo;
+    int val;
+    size_t sz;
+    int req;
+    int ctx;
+    char buf [MSG_SIZE];
+
+#if defined NN_HAVE_WINDOWS
+    rc = _putenv_s ("NN_MEMORY_BUDGET", "100000");
+#else
+    rc = setenv ("NN_MEMORY_BUDGET", "100000", 1);
+#endif
+    errno_assert (rc == 0);
+
+    sb = test_socket (AF_SP, NN_PAIR);
+    rcvbuf = 1024 * 1024;
+    test_setsockopt (sb, NN_SOL_SOCKET, NN_RCVBUF, &rcvbuf, sizeof (rcvbuf));
+    test_bind (sb, SOCKET_ADDRESS);
+    sc = test_socket (AF_SP, NN_PAIR);
+    sz = sizeof (val);
+    rc = nn_getsockopt (sc, NN_SOL_SOCKET, NN_SNDBUDGET, &val, &sz);
+    errno_assert (rc == 0);
+    nn_assert (val == 0);
+    val = 2;
+    rc = nn_setsockopt (sc, NN_SOL_SOCKET, NN_SNDBUDGET, &val, sizeof (val));
+    nn_assert (rc < 0 && nn_errno () == EINVAL);
+    val = 1;
+    test_setsockopt (sc, NN_SOL_SOCKET, NN_SNDBUDGET, &val, sizeof (val));
+    test_connect (sc, SOCKET_ADDRESS);
+
+    nn_assert (nn_get_statistic (sb, NN_STAT_MEMORY_BUDGET) == 100000);
+
+    /*  Fill in the budget. The receiver's buffer is large enough to hold
+        all the messages, so it's the budget that stops the sender. */
+    memset (buf, 'A', sizeof (buf));
+    for (i = 0; i != 100; ++i) {
+        rc = nn_send (sc, buf, sizeof (buf), NN_DONTWAIT);
+        if (rc < 0) {
+            errno_assert (nn_errno () == EAGAIN);
+            break;
+        }
+        nn_assert (rc == MSG_SIZE);
+    }
+    nn_assert (i > 5 && i <= 10);
+    nn_assert (nn_get_statistic (sb, NN_STAT_MEMORY_BYTES) >=
+        100000 - MSG_SIZE);
+
+    /*  Blocking send times out. Zero timeout means non-blocking send. */
+    timeo = 100;
+    test_setsockopt (sc, NN_SOL_SOCKET, NN_SNDTIMEO, &timeo, sizeof (timeo));
+    rc = nn_send (sc, buf, sizeof (buf), 0);
+    nn_assert (rc < 0 && nn_errno () == ETIMEDOUT);
+    timeo = 0;
+    test_setsockopt (sc, NN_SOL_SOCKET, NN_SNDTIMEO, &timeo, sizeof (timeo));
+    rc = nn_send (sc, buf, sizeof (buf), 0);
+    nn_assert (rc < 0 && nn_errno () == EAGAIN);
+
+    /*  Sockets that didn't opt in are not affected. */
+    rc = nn_send (sb, buf, sizeof (buf), NN_DONTWAIT);
+    errno_assert (rc == MSG_SIZE);
+    rc = nn_recv (sc, buf, sizeof (buf), 0);
+    errno_assert (rc == MSG_SIZE);
+
+    /*  Sends on contexts honour the budget as well. */
+    req = test_socket (AF_SP, NN_REQ);
+    test_setsockopt (req, NN_SOL_SOCKET, NN_SNDBUDGET, &val, sizeof (val));
+    ctx = nn_ctx_open (req);
+    errno_assert (ctx >= 0);
+    rc = nn_ctx_send (req, ctx, buf, sizeof (buf), NN_DONTWAIT);
+    nn_assert (rc < 0 && nn_errno () == EAGAIN);
+
+    /*  Once the receiver picks the messages up, sending works again. */
+    for (; i != 0; --i) {
+        rc = nn_recv (sb, buf, sizeof (buf), 0);
+        errno_assert (rc == MSG_SIZE);
+    }
+    test_send (sc, "ABC");
+    test_recv (sb, "ABC");
+    rc = nn_ctx_send (req, ctx, "ABC", 3, NN_DONTWAIT);
+    errno_assert (rc == 3);
+
+    test_close (req);
+    test_close (sc);
+    test_close (sb);
+
+    return 0;
+}
@@ -0,0 +1,162 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#ifndef NN_CHUNK_CACHE
+#define NN_CHUNK_CACHE
+#endif
+
+#include "../src/utils/chunk.c"
+#include "../src/utils/atomic.c"
+#include "../src/utils/wire.c"
+#include "../src/utils/mutex.c"
+#include "../src/utils/condvar.c"
+#include "../src/utils/thread.c"
+#include "../src/utils/alloc.c"
+#include "../src/utils/err.c"
+#include "../src/utils/attr.h"
+
+#include <string.h>
+
+/*  Chunks are allocated by a producer thread and freed by the main thread.
+    Chunks freed in one round are recycled by the producer in the next one. */
+
+#define ROUNDS 10
+#define MESSAGE_COUNT 10000
+
+static void *chunks [MESSAGE_COUNT];
+
+static size_t msgsize (int i)
+{
+    return (size_t) ((i * 37) % 5000);
+}
+
+static void producer (NN_UNUSED void *arg)
+{
+    int rc;
+    int i;
+
+    for (i = 0; i != MESSAGE_COUNT; ++i) {
+        rc = nn_chunk_alloc (msgsize (i), 0, &chunks [i]);
+        errnum_assert (rc == 0, -rc);
+        memset (chunks [i], i & 0xff, msgsize (i));
+    }
+}
+
+static void consumer (NN_UNUSED void *arg)
+{
+    int i;
+
+    for (i = 0; i != MESSAGE_COUNT; ++i)
+        nn_chunk_free (chunks [i]);
+}
+
+int main ()
+{
+    int rc;
+    int i;
+    int round;
+    int arena;
+    size_t j;
+    void *chunk;
+    void *chunk2;
+    struct nn_thread thread;
+
+    nn_alloc_init ();
+    nn_chunk_init ();
+
+    /*  Same-thread allocation and deallocation. */
+    for (i = 0; i != 1000; ++i) {
+        rc = nn_chunk_alloc (msgsize (i), 0, &chunk);
+        errnum_assert (rc == 0, -rc);
+        nn_assert (nn_chunk_size (chunk) == msgsize (i));
+        memset (chunk, 0xaa, msgsize (i));
+        nn_chunk_free (chunk);
+    }
+
+    /*  Shared chunks are released only when the last reference goes away. */
+    rc = nn_chunk_alloc (100, 0, &chunk);
+    errnum_assert (rc == 0, -rc);
+    nn_chunk_addref (chunk, 1);
+    nn_chunk_free (chunk);
+    nn_chunk_free (chunk);
+
+    /*  Reallocation of a cached chunk keeps the data. */
+    rc = nn_chunk_alloc (100, 0, &chunk);
+    errnum_assert (rc == 0, -rc);
+    memset (chunk, 0x55, 100);
+    chunk = nn_chunk_trim (chunk, 10);
+    rc = nn_chunk_realloc (3000, &chunk);
+    errnum_assert (rc == 0, -rc);
+    nn_assert (nn_chunk_size (chunk) == 3000);
+    for (j = 0; j != 90; ++j)
+        nn_assert (((uint8_t*) chunk) [j] == 0x55);
+
+    /*  Reallocation of a shared chunk creates a private copy. */
+    chunk2 = chunk;
+    nn_chunk_addref (chunk2, 1);
+    rc = nn_chunk_realloc (10, &chunk);
+    errnum_assert (rc == 0, -rc);
+    nn_assert (chunk != chunk2);
+    nn_assert (nn_chunk_size (chunk) == 10);
+    nn_assert (((uint8_t*) chunk) [9] == 0x55);
+    nn_chunk_free (chunk);
+    nn_chunk_free (chunk2);
+
+    /*  Chunks allocated in one thread and freed in another. */
+    for (round = 0; round != ROUNDS; ++round) {
+        nn_thread_init (&thread, producer, NULL);
+        nn_thread_term (&thread);
+        for (i = 0; i != MESSAGE_COUNT; ++i) {
+            nn_assert (nn_chunk_size (chunks [i]) == msgsize (i));
+            if (msgsize (i) > 0) {
+                nn_assert (((uint8_t*) chunks [i]) [0] == (i & 0xff));
+                nn_assert (((uint8_t*) chunks [i]) [msgsize (i) - 1] ==
+                    (i & 0xff));
+            }
+            nn_chunk_free (chunks [i]);
+        }
+    }
+
+    /*  A burst of chunks released by another thread is not kept in
+        the local cache beyond its limit. */
+    for (i = 0; i != MESSAGE_COUNT; ++i) {
+        rc = nn_chunk_alloc (100, 0, &chunks [i]);
+        errnum_assert (rc == 0, -rc);
+    }
+    nn_thread_init (&thread, consumer, NULL);
+    nn_thread_term (&thread);
+    rc = nn_chunk_alloc (100, 0, &chunk);
+    errnum_assert (rc == 0, -rc);
+    arena = nn_chunk_thread_index () % NN_CHUNK_ARENAS;
+    nn_assert (nn_chunk_arenas [arena].count [1] < nn_chunk_cache_limit (1));
+    nn_chunk_free (chunk);
+
+    /*  Chunks allocated before the termination of the cache can be freed
+        afterwards. */
+    rc = nn_chunk_alloc (100, 0, &chunk);
+    errnum_assert (rc == 0, -rc);
+    nn_chunk_term ();
+    nn_chunk_free (chunk);
+    nn_alloc_term ();
+
+    return 0;
+}
@@ -28,6 +28,8 @@
 
 #include "testutil.h"
 
+#include <string.h>
+
 int main (int argc, const char *argv[])
 {
     int rc;
@@ -41,13 +43,19 @@ int main (int argc, const char *argv[])
     unsigned char *data;
     void *buf;
     char socket_address[128];
+    int ivl;
+    int deadline;
+    int on;
 
+    on = 1;
     test_addr_from(socket_address, "tcp", "127.0.0.1",
             get_test_port(argc, argv));
     
     rep = test_socket (AF_SP_RAW, NN_REP);
+    test_setsockopt (rep, NN_SOL_SOCKET, NN_EXTENSIONS, &on, sizeof (on));
     test_bind (rep, socket_address);
     req = test_socket (AF_SP, NN_REQ);
+    test_setsockopt (req, NN_SOL_SOCKET, NN_EXTENSIONS, &on, sizeof (on));
     test_connect (req, socket_address);
 
     /* Test ancillary data in static buffer. */
@@ -108,6 +116,76 @@ int main (int argc, const char *argv[])
     nn_assert (rc == 3);
     test_recv (req, "ABC");
 
+    /* Test the deadline passed along with the request. */
+
+    ivl = 100;
+    test_setsockopt (req, NN_REQ, NN_REQ_RESEND_IVL, &ivl, sizeof (ivl));
+    test_send (req, "ABC");
+
+    iovec.iov_base = body;
+    iovec.iov_len = sizeof (body);
+    hdr.msg_iov = &iovec;
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = ctrl;
+    hdr.msg_controllen = sizeof (ctrl);
+    rc = nn_recvmsg (rep, &hdr, 0);
+    errno_assert (rc == 3);
+
+    cmsg = NN_CMSG_FIRSTHDR (&hdr);
+    while (1) {
+        nn_assert (cmsg);
+        if (cmsg->cmsg_level == PROTO_SP && cmsg->cmsg_type == SP_DEADLINE)
+            break;
+        cmsg = NN_CMSG_NXTHDR (&hdr, cmsg);
+    }
+    nn_assert (cmsg->cmsg_len == NN_CMSG_LEN (sizeof (int)));
+    memcpy (&deadline, NN_CMSG_DATA (cmsg), sizeof (deadline));
+    nn_assert (deadline > 0 && deadline <= ivl);
+
+    rc = nn_sendmsg (rep, &hdr, 0);
+    nn_assert (rc == 3);
+    test_recv (req, "ABC");
+
+    /* The request that has waited past its deadline is dropped. Its re-sent
+       copy is received instead. */
+
+    test_send (req, "DEF");
+    nn_sleep (150);
+    hdr.msg_controllen = sizeof (ctrl);
+    rc = nn_recvmsg (rep, &hdr, 0);
+    errno_assert (rc == 3);
+    nn_assert (memcmp (body, "DEF", 3) == 0);
+    nn_assert (nn_get_statistic (rep, NN_STAT_EXPIRED_REQUESTS) == 1);
+    rc = nn_sendmsg (rep, &hdr, 0);
+    nn_assert (rc == 3);
+    test_recv (req, "DEF");
+
+    test_close (req);
+    test_close (rep);
+
+    /* Without NN_EXTENSIONS on both ends, the deadline isn't passed over
+       TCP. */
+
+    rep = test_socket (AF_SP_RAW, NN_REP);
+    test_bind (rep, socket_address);
+    req = test_socket (AF_SP, NN_REQ);
+    test_setsockopt (req, NN_SOL_SOCKET, NN_EXTENSIONS, &on, sizeof (on));
+    test_setsockopt (req, NN_REQ, NN_REQ_RESEND_IVL, &ivl, sizeof (ivl));
+    test_connect (req, socket_address);
+    test_send (req, "ABC");
+
+    memset (ctrl, 0, sizeof (ctrl));
+    hdr.msg_controllen = sizeof (ctrl);
+    rc = nn_recvmsg (rep, &hdr, 0);
+    errno_assert (rc == 3);
+    for (cmsg = NN_CMSG_FIRSTHDR (&hdr); cmsg && cmsg->cmsg_len != 0;
+          cmsg = NN_CMSG_NXTHDR (&hdr, cmsg))
+        nn_assert (cmsg->cmsg_level != PROTO_SP ||
+            cmsg->cmsg_type != SP_DEADLINE);
+    rc = nn_sendmsg (rep, &hdr, 0);
+    nn_assert (rc == 3);
+    test_recv (req, "ABC");
+
     test_close (req);
     test_close (rep);
 
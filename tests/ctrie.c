@@ -0,0 +1,212 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#include "../src/protocols/pubsub/ctrie.c"
+#include "../src/utils/alloc.c"
+#include "../src/utils/err.c"
+#include "../src/utils/wire.c"
+
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_STRINGS 300
+#define TEST_MAXLEN 6
+
+/*  Strings of the random set, used as the reference. */
+static char strs [TEST_STRINGS][TEST_MAXLEN + 1];
+
+/*  State of the walk check. */
+static char last [TEST_MAXLEN + 1];
+static int walked;
+
+static size_t add (uint8_t *buf, size_t pos, const char *str)
+{
+    nn_puts (buf + pos, (uint16_t) strlen (str));
+    memcpy (buf + pos + 2, str, strlen (str));
+    return pos + 2 + strlen (str);
+}
+
+static void check_walk (void *arg, const uint8_t *data, size_t size)
+{
+    char str [TEST_MAXLEN + 1];
+    int i;
+
+    /*  Strings come in strictly increasing order and each is in the set. */
+    nn_assert (arg == NULL);
+    nn_assert (size <= TEST_MAXLEN);
+    memcpy (str, data, size);
+    str [size] = 0;
+    nn_assert (!walked || strcmp (last, str) < 0);
+    for (i = 0; i != TEST_STRINGS; ++i)
+        if (strcmp (strs [i], str) == 0)
+            break;
+    nn_assert (i != TEST_STRINGS);
+    strcpy (last, str);
+    ++walked;
+}
+
+int main ()
+{
+    int rc;
+    int i;
+    int j;
+    int len;
+    int expected;
+    int unique;
+    int total;
+    size_t pos;
+    uint32_t seed;
+    char probe [TEST_MAXLEN + 2];
+    uint8_t buf [TEST_STRINGS * (TEST_MAXLEN + 2)];
+    struct nn_ctrie ctrie;
+
+    /*  Try matching with an empty trie. */
+    nn_ctrie_init (&ctrie);
+    rc = nn_ctrie_match (&ctrie, (const uint8_t*) "ABC", 3);
+    nn_assert (rc == 0);
+    rc = nn_ctrie_has (&ctrie, (const uint8_t*) "", 0);
+    nn_assert (rc == 0);
+    rc = nn_ctrie_build (&ctrie, buf, 0);
+    nn_assert (rc == 0);
+    nn_assert (ctrie.count == 0);
+    rc = nn_ctrie_match (&ctrie, (const uint8_t*) "", 0);
+    nn_assert (rc == 0);
+    nn_ctrie_term (&ctrie);
+
+    /*  Malformed input leaves the trie intact. */
+    nn_ctrie_init (&ctrie);
+    pos = add (buf, 0, "ABC");
+    rc = nn_ctrie_build (&ctrie, buf, pos);
+    nn_assert (rc == 0);
+    rc = nn_ctrie_build (&ctrie, buf, pos - 1);
+    nn_assert (rc == -EINVAL);
+    buf [pos] = 0;
+    rc = nn_ctrie_build (&ctrie, buf, pos + 1);
+    nn_assert (rc == -EINVAL);
+    rc = nn_ctrie_match (&ctrie, (const uint8_t*) "ABCD", 4);
+    nn_assert (rc == 1);
+    nn_ctrie_term (&ctrie);
+
+    /*  Try "all" subscription along with some others. */
+    nn_ctrie_init (&ctrie);
+    pos = add (buf, 0, "XY");
+    pos = add (buf, pos, "");
+    pos = add (buf, pos, "XY");
+    rc = nn_ctrie_build (&ctrie, buf, pos);
+    nn_assert (rc == 0);
+    nn_assert (ctrie.count == 2);
+    rc = nn_ctrie_match (&ctrie, (const uint8_t*) "ABC", 3);
+    nn_assert (rc == 1);
+    rc = nn_ctrie_has (&ctrie, (const uint8_t*) "", 0);
+    nn_assert (rc == 1);
+    rc = nn_ctrie_has (&ctrie, (const uint8_t*) "XY", 2);
+    nn_assert (rc == 1);
+    rc = nn_ctrie_has (&ctrie, (const uint8_t*) "X", 1);
+    nn_assert (rc == 0);
+    nn_ctrie_term (&ctrie);
+
+    /*  Prefix matching, including tails and nodes with many children. */
+    nn_ctrie_init (&ctrie);
+    pos = add (buf, 0, "ABCDEF");
+    pos = add (buf, pos, "ABC");
+    pos = add (buf, pos, "ABX");
+    for (i = 0; i != 20; ++i) {
+        probe [0] = 'Z';
+        probe [1] = 'a' + i;
+        probe [2] = 0;
+        pos = add (buf, pos, probe);
+    }
+    rc = nn_ctrie_build (&ctrie, buf, pos);
+    nn_assert (rc == 0);
+    rc = nn_ctrie_match (&ctrie, (const uint8_t*) "ABCDE", 5);
+    nn_assert (rc == 1);
+    rc = nn_ctrie_match (&ctrie, (const uint8_t*) "ABXYZ", 5);
+    nn_assert (rc == 1);
+    rc = nn_ctrie_match (&ctrie, (const uint8_t*) "AB", 2);
+    nn_assert (rc == 0);
+    rc = nn_ctrie_match (&ctrie, (const uint8_t*) "Zq!", 3);
+    nn_assert (rc == 1);
+    rc = nn_ctrie_match (&ctrie, (const uint8_t*) "Zz", 2);
+    nn_assert (rc == 0);
+    rc = nn_ctrie_has (&ctrie, (const uint8_t*) "ABCDE", 5);
+    nn_assert (rc == 0);
+    rc = nn_ctrie_has (&ctrie, (const uint8_t*) "ABCDEF", 6);
+    nn_assert (rc == 1);
+    rc = nn_ctrie_has (&ctrie, (const uint8_t*) "ABCDEFG", 7);
+    nn_assert (rc == 0);
+    nn_ctrie_term (&ctrie);
+
+    /*  Random strings over a small alphabet, checked against a plain
+        array. Every string up to the maximum length plus one is probed. */
+    seed = 1;
+    pos = 0;
+    for (i = 0; i != TEST_STRINGS; ++i) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        len = 1 + seed % TEST_MAXLEN;
+        for (j = 0; j != len; ++j)
+            strs [i][j] = 'a' + (seed >> (8 + 2 * j)) % 3;
+        strs [i][len] = 0;
+        pos = add (buf, pos, strs [i]);
+    }
+    unique = 0;
+    for (i = 0; i != TEST_STRINGS; ++i) {
+        for (j = 0; j != i; ++j)
+            if (strcmp (strs [i], strs [j]) == 0)
+                break;
+        if (j == i)
+            ++unique;
+    }
+    nn_ctrie_init (&ctrie);
+    rc = nn_ctrie_build (&ctrie, buf, pos);
+    nn_assert (rc == 0);
+    nn_assert (ctrie.count == (size_t) unique);
+    for (len = 0, total = 1; len <= TEST_MAXLEN + 1; ++len, total *= 3) {
+        for (i = 0; i != total; ++i) {
+            seed = i;
+            for (j = 0; j != len; ++j) {
+                probe [j] = 'a' + seed % 3;
+                seed /= 3;
+            }
+            probe [len] = 0;
+            expected = 0;
+            for (j = 0; j != TEST_STRINGS; ++j)
+                if (strncmp (strs [j], probe, strlen (strs [j])) == 0)
+                    expected = 1;
+            rc = nn_ctrie_match (&ctrie, (const uint8_t*) probe, len);
+            nn_assert (rc == expected);
+            expected = 0;
+            for (j = 0; j != TEST_STRINGS; ++j)
+                if (strcmp (strs [j], probe) == 0)
+                    expected = 1;
+            rc = nn_ctrie_has (&ctrie, (const uint8_t*) probe, len);
+            nn_assert (rc == expected);
+        }
+    }
+    walked = 0;
+    nn_ctrie_walk (&ctrie, check_walk, NULL);
+    nn_assert (walked == unique);
+    nn_ctrie_term (&ctrie);
+
+    return 0;
+}
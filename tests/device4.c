@@ -38,9 +38,14 @@ void device4 (NN_UNUSED void *arg)
     int rc;
     int devf;
     int devg;
+    int cache_size;
 
-    /*  Intialise the device sockets. */
+    /*  Intialise the device sockets. Repeated requests are answered by
+        the device itself. */
     devf = test_socket (AF_SP_RAW, NN_REP);
+    cache_size = 16;
+    test_setsockopt (devf, NN_REP, NN_REP_CACHE_SIZE, &cache_size,
+        sizeof (cache_size));
     test_bind (devf, socket_address_f);
     devg = test_socket (AF_SP_RAW, NN_REQ);
     test_bind (devg, socket_address_g);
@@ -59,6 +64,7 @@ int main (int argc, const char *argv[])
     int endf;
     int endg;
     struct nn_thread thread4;
+    int timeo;
 
     int port = get_test_port(argc, argv);
 
@@ -87,6 +93,13 @@ int main (int argc, const char *argv[])
     test_send (endg, "REPLYXYZ");
     test_recv (endf, "REPLYXYZ");
 
+    /*  The same request is answered from the device's cache. */
+    test_send (endf, "XYZ");
+    test_recv (endf, "REPLYXYZ");
+    timeo = 100;
+    test_setsockopt (endg, NN_SOL_SOCKET, NN_RCVTIMEO, &timeo, sizeof (timeo));
+    test_drop (endg, ETIMEDOUT);
+
     /*  Clean up. */
     test_close (endg);
     test_close (endf);
@@ -0,0 +1,101 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#include "../src/nn.h"
+#include "../src/pubsub.h"
+
+#include "testutil.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*  Test sending messages to many subscribers with the writes spread over
+    the helper threads. */
+
+#define SUBSCRIBERS 100
+#define MESSAGES 50
+
+int main (int argc, const char *argv[])
+{
+    int rc;
+    int pub;
+    int subs [SUBSCRIBERS];
+    int timeo;
+    int i;
+    int j;
+    int val;
+    char socket_address [128];
+    char buf [32768];
+
+#if defined NN_HAVE_WINDOWS
+    rc = _putenv_s ("NN_FANOUT_THREADS", "3");
+#else
+    rc = setenv ("NN_FANOUT_THREADS", "3", 1);
+#endif
+    errno_assert (rc == 0);
+
+    test_addr_from (socket_address, "tcp", "127.0.0.1",
+        get_test_port (argc, argv));
+    pub = test_socket (AF_SP, NN_PUB);
+    test_bind (pub, socket_address);
+    for (i = 0; i != SUBSCRIBERS; ++i) {
+        subs [i] = test_socket (AF_SP, NN_SUB);
+        test_setsockopt (subs [i], NN_SUB, NN_SUB_SUBSCRIBE, "", 0);
+        timeo = 1000;
+        test_setsockopt (subs [i], NN_SOL_SOCKET, NN_RCVTIMEO, &timeo,
+            sizeof (timeo));
+        test_connect (subs [i], socket_address);
+    }
+
+    /*  Wait till all the subscribers are connected. */
+    for (i = 0; i != 100 &&
+          nn_get_statistic (pub, NN_STAT_CURRENT_CONNECTIONS) != SUBSCRIBERS;
+          ++i)
+        nn_sleep (10);
+    nn_assert (nn_get_statistic (pub, NN_STAT_CURRENT_CONNECTIONS) ==
+        SUBSCRIBERS);
+
+    /*  Every subscriber gets all the messages in order. Large messages
+        don't fit into the socket buffers at once, so the writes have to be
+        finished by the worker thread. */
+    memset (buf, 0, sizeof (buf));
+    for (i = 0; i != MESSAGES; ++i) {
+        memcpy (buf, &i, sizeof (i));
+        rc = nn_send (pub, buf, i % 10 == 9 ? sizeof (buf) : sizeof (i), 0);
+        errno_assert (rc >= 0);
+    }
+    for (i = 0; i != SUBSCRIBERS; ++i) {
+        for (j = 0; j != MESSAGES; ++j) {
+            rc = nn_recv (subs [i], buf, sizeof (buf), 0);
+            errno_assert (rc >= 0);
+            nn_assert (rc == (j % 10 == 9 ? (int) sizeof (buf) : 4));
+            memcpy (&val, buf, sizeof (val));
+            nn_assert (val == j);
+        }
+    }
+
+    for (i = 0; i != SUBSCRIBERS; ++i)
+        test_close (subs [i]);
+    test_close (pub);
+
+    return 0;
+}
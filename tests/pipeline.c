@@ -25,14 +25,117 @@
 #include "../src/pipeline.h"
 #include "testutil.h"
 
+#include <string.h>
+
 #define SOCKET_ADDRESS "inproc://a"
 
-int main ()
+#define NPULLS 3
+
+/*  Receives messages till the timeout. Returns the number of messages that
+    start with 'key'. Other messages are not expected. */
+static int recv_key (int sock, char key)
+{
+    int rc;
+    int count;
+    char buf [16];
+
+    for (count = 0; ; ++count) {
+        rc = nn_recv (sock, buf, sizeof (buf), 0);
+        if (rc < 0) {
+            nn_assert (nn_errno () == ETIMEDOUT);
+            return count;
+        }
+        nn_assert (rc > 0 && buf [0] == key);
+    }
+}
+
+/*  Returns the index of the only socket that gets the messages with 'key'. */
+static int find_key (int *socks, char key, int expected)
+{
+    int i;
+    int count;
+    int found;
+
+    found = -1;
+    for (i = 0; i != NPULLS; ++i) {
+        if (socks [i] < 0)
+            continue;
+        count = recv_key (socks [i], key);
+        if (count == 0)
+            continue;
+        nn_assert (found < 0 && count == expected);
+        found = i;
+    }
+    nn_assert (found >= 0);
+    return found;
+}
+
+/*  A busy peer gets no more messages than it has granted credits for. */
+static void test_credits (char *addr)
+{
+    int rc;
+    int i;
+    int opt;
+    int push1;
+    int pulls [2];
+
+    push1 = test_socket (AF_SP, NN_PUSH);
+    opt = 1;
+    test_setsockopt (push1, NN_SOL_SOCKET, NN_EXTENSIONS, &opt, sizeof (opt));
+    test_bind (push1, addr);
+    for (i = 0; i != 2; ++i) {
+        pulls [i] = test_socket (AF_SP, NN_PULL);
+        opt = 2;
+        test_setsockopt (pulls [i], NN_PULL, NN_PULL_CREDITS, &opt,
+            sizeof (opt));
+        opt = 100;
+        test_setsockopt (pulls [i], NN_SOL_SOCKET, NN_RCVTIMEO, &opt,
+            sizeof (opt));
+        opt = 1;
+        test_setsockopt (pulls [i], NN_SOL_SOCKET, NN_EXTENSIONS, &opt,
+            sizeof (opt));
+        test_connect (pulls [i], addr);
+    }
+    nn_sleep (100);
+
+    for (i = 0; i != 4; ++i)
+        test_send (push1, "ABC");
+    rc = nn_send (push1, "ABC", 3, NN_DONTWAIT);
+    nn_assert (rc < 0 && nn_errno () == EAGAIN);
+
+    /*  Only the peer that processes the messages gets the new ones. */
+    for (i = 0; i != 6; ++i) {
+        test_recv (pulls [1], "ABC");
+        test_send (push1, "ABC");
+    }
+    test_recv (pulls [1], "ABC");
+    test_recv (pulls [1], "ABC");
+    nn_assert (recv_key (pulls [0], 'A') == 2);
+
+    test_close (push1);
+    test_close (pulls [0]);
+    test_close (pulls [1]);
+}
+
+int main (int argc, const char *argv[])
 {
     int push1;
     int push2;
     int pull1;
     int pull2;
+    int strategy;
+    int rc;
+    int i;
+    int owner;
+    int timeo;
+    int keylen;
+    int credits;
+    int pulls [NPULLS];
+    char socket_address_tcp [128];
+    struct nn_msghdr hdr;
+    struct nn_iovec iov;
+    char control [NN_CMSG_SPACE (1)];
+    struct nn_cmsghdr *cmsg;
 
     /*  Test fan-out. */
 
@@ -53,6 +156,21 @@ int main ()
     test_recv (pull1, "ABC");
     test_recv (pull2, "DEF");
 
+    /*  Other load-balancing strategies spread the messages as well. */
+    strategy = -1;
+    rc = nn_setsockopt (push1, NN_PUSH, NN_PUSH_LB_STRATEGY, &strategy,
+        sizeof (strategy));
+    nn_assert (rc < 0 && nn_errno () == EINVAL);
+    strategy = NN_LB_P2C;
+    test_setsockopt (push1, NN_PUSH, NN_PUSH_LB_STRATEGY, &strategy,
+        sizeof (strategy));
+
+    test_send (push1, "ABC");
+    test_send (push1, "DEF");
+
+    test_recv (pull1, "ABC");
+    test_recv (pull2, "DEF");
+
     test_close (push1);
     test_close (pull1);
     test_close (pull2);
@@ -76,6 +194,89 @@ int main ()
     test_close (push1);
     test_close (push2);
 
+    /*  Test consistent hashing. Messages with the same key go to the same
+        peer. */
+
+    push1 = test_socket (AF_SP, NN_PUSH);
+    strategy = NN_LB_CONSISTENT_HASH;
+    test_setsockopt (push1, NN_PUSH, NN_PUSH_LB_STRATEGY, &strategy,
+        sizeof (strategy));
+    keylen = 1;
+    test_setsockopt (push1, NN_PUSH, NN_PUSH_LB_KEY_LEN, &keylen,
+        sizeof (keylen));
+    test_bind (push1, SOCKET_ADDRESS);
+    timeo = 100;
+    for (i = 0; i != NPULLS; ++i) {
+        pulls [i] = test_socket (AF_SP, NN_PULL);
+        test_setsockopt (pulls [i], NN_SOL_SOCKET, NN_RCVTIMEO, &timeo,
+            sizeof (timeo));
+        test_connect (pulls [i], SOCKET_ADDRESS);
+    }
+    nn_sleep (10);
+
+    for (i = 0; i != 5; ++i)
+        test_send (push1, "A");
+    owner = find_key (pulls, 'A', 5);
+
+    /*  The key supplied as ancillary data is used instead of the body. */
+    cmsg = (struct nn_cmsghdr*) control;
+    cmsg->cmsg_len = NN_CMSG_LEN (1);
+    cmsg->cmsg_level = PROTO_SP;
+    cmsg->cmsg_type = SP_KEY;
+    *NN_CMSG_DATA (cmsg) = 'A';
+    iov.iov_base = "BCD";
+    iov.iov_len = 3;
+    memset (&hdr, 0, sizeof (hdr));
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = control;
+    hdr.msg_controllen = sizeof (control);
+    rc = nn_sendmsg (push1, &hdr, 0);
+    errno_assert (rc == 3);
+    nn_assert (find_key (pulls, 'B', 1) == owner);
+
+    /*  When the peer goes away, its keys move to another one. */
+    test_close (pulls [owner]);
+    pulls [owner] = -1;
+    nn_sleep (10);
+    test_send (push1, "A");
+    nn_assert (find_key (pulls, 'A', 1) != owner);
+
+    /*  A new peer takes over the keys of the one it has replaced. */
+    pulls [owner] = test_socket (AF_SP, NN_PULL);
+    test_setsockopt (pulls [owner], NN_SOL_SOCKET, NN_RCVTIMEO, &timeo,
+        sizeof (timeo));
+    test_connect (pulls [owner], SOCKET_ADDRESS);
+    nn_sleep (10);
+    test_send (push1, "A");
+    nn_assert (find_key (pulls, 'A', 1) == owner);
+
+    test_close (push1);
+    for (i = 0; i != NPULLS; ++i)
+        test_close (pulls [i]);
+
+    /*  Test credit-based flow control. Over TCP, it's used only if both
+        peers allow the protocol extensions. */
+    test_credits (SOCKET_ADDRESS);
+    test_addr_from (socket_address_tcp, "tcp", "127.0.0.1",
+        get_test_port (argc, argv));
+    test_credits (socket_address_tcp);
+
+    push1 = test_socket (AF_SP, NN_PUSH);
+    test_bind (push1, socket_address_tcp);
+    pull1 = test_socket (AF_SP, NN_PULL);
+    credits = 2;
+    test_setsockopt (pull1, NN_PULL, NN_PULL_CREDITS, &credits,
+        sizeof (credits));
+    test_connect (pull1, socket_address_tcp);
+    nn_sleep (100);
+    for (i = 0; i != 4; ++i)
+        test_send (push1, "ABC");
+    for (i = 0; i != 4; ++i)
+        test_recv (pull1, "ABC");
+    test_close (push1);
+    test_close (pull1);
+
     return 0;
 }
 
@@ -25,17 +25,27 @@
 
 #include "testutil.h"
 
+#include <string.h>
+
 #define SOCKET_ADDRESS "inproc://a"
+#define SOCKET_ADDRESS_IPC "ipc://test-pubsub.ipc"
 
-int main ()
+int main (int argc, const char *argv[])
 {
     int rc;
     int pub1;
     int pub2;
     int sub1;
     int sub2;
+    int val;
+    int i;
+    int last [2];
+    int seen [100];
     char buf [8];
     size_t sz;
+    void *msg;
+    char socket_address_ws [128];
+    struct nn_pollfd pfd;
 
     pub1 = test_socket (AF_SP, NN_PUB);
     test_bind (pub1, SOCKET_ADDRESS);
@@ -58,6 +68,16 @@ int main ()
     test_recv (sub1, "0123456789012345678901234567890123456789");
     test_recv (sub2, "0123456789012345678901234567890123456789");
 
+    /*  Subscribers share the message body. Check that modifying a zero-copy
+        message received by one of them doesn't affect the other one. */
+    test_send (pub1, "0123456789012345678901234567890123456789");
+    rc = nn_recv (sub1, &msg, NN_MSG, 0);
+    errno_assert (rc == 40);
+    memset (msg, 'x', 40);
+    rc = nn_freemsg (msg);
+    errno_assert (rc == 0);
+    test_recv (sub2, "0123456789012345678901234567890123456789");
+
     test_close (pub1);
     test_close (sub1);
     test_close (sub2);
@@ -83,6 +103,555 @@ int main ()
     test_close (pub1);
     test_close (sub1);
 
+    /*  Check that subscriptions are forwarded to the publisher and that
+        non-matching messages are not sent to the subscriber at all. */
+
+    pub1 = test_socket (AF_SP, NN_PUB);
+    test_bind (pub1, SOCKET_ADDRESS);
+    sub1 = test_socket (AF_SP, NN_SUB);
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_SUBSCRIBE, "A", 1);
+    errno_assert (rc == 0);
+    test_connect (sub1, SOCKET_ADDRESS);
+    nn_sleep (10);
+
+    test_send (pub1, "B-filtered");
+    nn_sleep (10);
+    nn_assert (nn_get_statistic (sub1, NN_STAT_CURRENT_BYTES_QUEUED) == 0);
+    test_send (pub1, "A-delivered");
+    test_recv (sub1, "A-delivered");
+
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_SUBSCRIBE, "B", 1);
+    errno_assert (rc == 0);
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_UNSUBSCRIBE, "A", 1);
+    errno_assert (rc == 0);
+    nn_sleep (10);
+    test_send (pub1, "A-filtered");
+    nn_sleep (10);
+    nn_assert (nn_get_statistic (sub1, NN_STAT_CURRENT_BYTES_QUEUED) == 0);
+    test_send (pub1, "B-delivered");
+    test_recv (sub1, "B-delivered");
+
+    test_close (sub1);
+    test_close (pub1);
+
+    /*  Same over a stream transport, where forwarding is negotiated in
+        the protocol header. */
+
+    pub1 = test_socket (AF_SP, NN_PUB);
+    test_bind (pub1, SOCKET_ADDRESS_IPC);
+    sub1 = test_socket (AF_SP, NN_SUB);
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_SUBSCRIBE, "A", 1);
+    errno_assert (rc == 0);
+    test_connect (sub1, SOCKET_ADDRESS_IPC);
+    nn_sleep (100);
+
+    test_send (pub1, "B-filtered");
+    test_send (pub1, "A-delivered");
+    test_recv (sub1, "A-delivered");
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_SUBSCRIBE, "B", 1);
+    errno_assert (rc == 0);
+    nn_sleep (100);
+    test_send (pub1, "B-delivered");
+    test_recv (sub1, "B-delivered");
+
+    test_close (sub1);
+    test_close (pub1);
+
+    /*  Check replacing a set of subscriptions in bulk. Individual
+        subscriptions are not affected by it. */
+
+    pub1 = test_socket (AF_SP, NN_PUB);
+    test_bind (pub1, SOCKET_ADDRESS);
+    sub1 = test_socket (AF_SP, NN_SUB);
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_SUBSCRIBE, "C", 1);
+    errno_assert (rc == 0);
+    memcpy (buf, "\0\1A\0\1C", 6);
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_SUBSCRIBE_BULK, buf, 6);
+    errno_assert (rc == 0);
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_SUBSCRIBE_BULK, buf, 5);
+    nn_assert (rc == -1 && nn_errno () == EINVAL);
+    test_connect (sub1, SOCKET_ADDRESS);
+    nn_sleep (10);
+
+    test_send (pub1, "B-filtered");
+    test_send (pub1, "A-delivered");
+    test_recv (sub1, "A-delivered");
+
+    memcpy (buf, "\0\1B", 3);
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_SUBSCRIBE_BULK, buf, 3);
+    errno_assert (rc == 0);
+    nn_sleep (10);
+    test_send (pub1, "A-filtered");
+    nn_sleep (10);
+    nn_assert (nn_get_statistic (sub1, NN_STAT_CURRENT_BYTES_QUEUED) == 0);
+    test_send (pub1, "B-delivered");
+    test_recv (sub1, "B-delivered");
+    test_send (pub1, "C-delivered");
+    test_recv (sub1, "C-delivered");
+
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_SUBSCRIBE_BULK, buf, 0);
+    errno_assert (rc == 0);
+    nn_sleep (10);
+    test_send (pub1, "B-filtered");
+    test_send (pub1, "C-delivered");
+    test_recv (sub1, "C-delivered");
+
+    test_close (sub1);
+    test_close (pub1);
+
+    /*  WebSocket peers don't negotiate subscription forwarding, so all the
+        messages are sent to the subscriber. Check that non-matching ones
+        are dropped without signalling the socket as readable. */
+
+    test_addr_from (socket_address_ws, "ws", "127.0.0.1",
+        get_test_port (argc, argv));
+    pub1 = test_socket (AF_SP, NN_PUB);
+    test_bind (pub1, socket_address_ws);
+    sub1 = test_socket (AF_SP, NN_SUB);
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_SUBSCRIBE, "A", 1);
+    errno_assert (rc == 0);
+    test_connect (sub1, socket_address_ws);
+    nn_sleep (100);
+
+    test_send (pub1, "B-filtered");
+    pfd.fd = sub1;
+    pfd.events = NN_POLLIN;
+    pfd.revents = 0;
+    rc = nn_poll (&pfd, 1, 100);
+    errno_assert (rc == 0);
+    test_send (pub1, "A-delivered");
+    rc = nn_poll (&pfd, 1, 1000);
+    errno_assert (rc == 1);
+    test_recv (sub1, "A-delivered");
+
+    test_close (sub1);
+    test_close (pub1);
+
+    /*  Let a backlog build up in the subscriber. The queued messages are
+        filtered in batches, check that the right ones are delivered in
+        the original order. The subscriber binds, so that the publisher
+        doesn't filter the messages itself before the subscription is
+        forwarded. */
+
+    sub1 = test_socket (AF_SP, NN_SUB);
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_SUBSCRIBE, "A", 1);
+    errno_assert (rc == 0);
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_SUBSCRIBE, "C", 1);
+    errno_assert (rc == 0);
+    test_bind (sub1, SOCKET_ADDRESS);
+    pub1 = test_socket (AF_SP, NN_PUB);
+    test_connect (pub1, SOCKET_ADDRESS);
+    nn_sleep (10);
+
+    for (i = 0; i != 100; ++i) {
+        buf [0] = "ABC" [i % 3];
+        buf [1] = (char) i;
+        rc = nn_send (pub1, buf, 2, 0);
+        errno_assert (rc == 2);
+    }
+    nn_sleep (10);
+    for (i = 0; i != 100; ++i) {
+        if (i % 3 == 1)
+            continue;
+        rc = nn_recv (sub1, buf, sizeof (buf), 0);
+        errno_assert (rc == 2);
+        nn_assert (buf [0] == "ABC" [i % 3] && buf [1] == (char) i);
+    }
+
+    test_close (pub1);
+    test_close (sub1);
+
+    /*  Check the topic modes. Complete topics are matched using a hash
+        table, but the matching semantics must stay the same. */
+
+    pub1 = test_socket (AF_SP, NN_PUB);
+    test_bind (pub1, SOCKET_ADDRESS);
+    sub1 = test_socket (AF_SP, NN_SUB);
+    val = '|';
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_TOPIC_DELIM, &val, sizeof (val));
+    errno_assert (rc == 0);
+    val = 3;
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_TOPIC_LEN, &val, sizeof (val));
+    nn_assert (rc == -1 && nn_errno () == EINVAL);
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_SUBSCRIBE, "foo|", 4);
+    errno_assert (rc == 0);
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_SUBSCRIBE, "ba", 2);
+    errno_assert (rc == 0);
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_SUBSCRIBE, "x|y|", 4);
+    errno_assert (rc == 0);
+    val = -1;
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_TOPIC_DELIM, &val, sizeof (val));
+    nn_assert (rc == -1 && nn_errno () == EINVAL);
+    sz = sizeof (val);
+    rc = nn_getsockopt (sub1, NN_SUB, NN_SUB_TOPIC_DELIM, &val, &sz);
+    errno_assert (rc == 0);
+    nn_assert (sz == sizeof (val) && val == '|');
+    test_connect (sub1, SOCKET_ADDRESS);
+    nn_sleep (10);
+
+    test_send (pub1, "foobar|filtered");
+    test_send (pub1, "fo|filtered");
+    test_send (pub1, "foo|delivered");
+    test_recv (sub1, "foo|delivered");
+    test_send (pub1, "bar|delivered");
+    test_recv (sub1, "bar|delivered");
+    test_send (pub1, "x|y|delivered");
+    test_recv (sub1, "x|y|delivered");
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_UNSUBSCRIBE, "foo|", 4);
+    errno_assert (rc == 0);
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_UNSUBSCRIBE, "foo|", 4);
+    nn_assert (rc == -1 && nn_errno () == EINVAL);
+    nn_sleep (10);
+    test_send (pub1, "foo|filtered");
+    test_send (pub1, "baz|delivered");
+    test_recv (sub1, "baz|delivered");
+
+    test_close (sub1);
+
+    sub1 = test_socket (AF_SP, NN_SUB);
+    val = 3;
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_TOPIC_LEN, &val, sizeof (val));
+    errno_assert (rc == 0);
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_SUBSCRIBE, "abc", 3);
+    errno_assert (rc == 0);
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_SUBSCRIBE, "x", 1);
+    errno_assert (rc == 0);
+    test_connect (sub1, SOCKET_ADDRESS);
+    nn_sleep (10);
+
+    test_send (pub1, "ab");
+    test_send (pub1, "abd-filtered");
+    test_send (pub1, "abc-delivered");
+    test_recv (sub1, "abc-delivered");
+    test_send (pub1, "xyz-delivered");
+    test_recv (sub1, "xyz-delivered");
+
+    test_close (sub1);
+    test_close (pub1);
+
+    /*  Check that late subscribers get the latest message of each topic
+        from the last-value cache. */
+
+    pub1 = test_socket (AF_SP, NN_PUB);
+    val = 1;
+    rc = nn_setsockopt (pub1, NN_PUB, NN_PUB_LVC, &val, sizeof (val));
+    errno_assert (rc == 0);
+    val = '|';
+    rc = nn_setsockopt (pub1, NN_PUB, NN_PUB_TOPIC_DELIM, &val, sizeof (val));
+    errno_assert (rc == 0);
+    test_bind (pub1, SOCKET_ADDRESS);
+    test_send (pub1, "a|1");
+    test_send (pub1, "b|1");
+    test_send (pub1, "a|2");
+    test_send (pub1, "no topic");
+    val = -1;
+    rc = nn_setsockopt (pub1, NN_PUB, NN_PUB_TOPIC_DELIM, &val, sizeof (val));
+    nn_assert (rc == -1 && nn_errno () == EINVAL);
+
+    sub1 = test_socket (AF_SP, NN_SUB);
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_SUBSCRIBE, "a", 1);
+    errno_assert (rc == 0);
+    test_connect (sub1, SOCKET_ADDRESS);
+    test_recv (sub1, "a|2");
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_SUBSCRIBE, "", 0);
+    errno_assert (rc == 0);
+    test_recv (sub1, "b|1");
+    test_send (pub1, "a|3");
+    test_recv (sub1, "a|3");
+
+    /*  Subscribers that don't forward subscriptions get the whole cache
+        as soon as they connect, the least recently updated topic first. */
+    pub2 = test_socket (AF_SP, NN_PUB);
+    val = 1;
+    rc = nn_setsockopt (pub2, NN_PUB, NN_PUB_LVC, &val, sizeof (val));
+    errno_assert (rc == 0);
+    val = 2;
+    rc = nn_setsockopt (pub2, NN_PUB, NN_PUB_TOPIC_LEN, &val, sizeof (val));
+    errno_assert (rc == 0);
+    test_bind (pub2, socket_address_ws);
+    test_send (pub2, "a|1");
+    test_send (pub2, "b|1");
+    test_send (pub2, "a|2");
+    sub2 = test_socket (AF_SP, NN_SUB);
+    rc = nn_setsockopt (sub2, NN_SUB, NN_SUB_SUBSCRIBE, "", 0);
+    errno_assert (rc == 0);
+    test_connect (sub2, socket_address_ws);
+    test_recv (sub2, "b|1");
+    test_recv (sub2, "a|2");
+
+    test_close (sub2);
+    test_close (pub2);
+    test_close (sub1);
+    test_close (pub1);
+
+    /*  Check that the cache keeps only the most recently updated topics. */
+
+    pub1 = test_socket (AF_SP, NN_PUB);
+    sz = sizeof (val);
+    rc = nn_getsockopt (pub1, NN_PUB, NN_PUB_LVC_SIZE, &val, &sz);
+    errno_assert (rc == 0);
+    nn_assert (val == 1024);
+    val = 0;
+    rc = nn_setsockopt (pub1, NN_PUB, NN_PUB_LVC_SIZE, &val, sizeof (val));
+    nn_assert (rc == -1 && nn_errno () == EINVAL);
+    val = 2;
+    rc = nn_setsockopt (pub1, NN_PUB, NN_PUB_LVC_SIZE, &val, sizeof (val));
+    errno_assert (rc == 0);
+    val = 1;
+    rc = nn_setsockopt (pub1, NN_PUB, NN_PUB_LVC, &val, sizeof (val));
+    errno_assert (rc == 0);
+    val = '|';
+    rc = nn_setsockopt (pub1, NN_PUB, NN_PUB_TOPIC_DELIM, &val, sizeof (val));
+    errno_assert (rc == 0);
+    test_bind (pub1, SOCKET_ADDRESS);
+    test_send (pub1, "a|1");
+    test_send (pub1, "b|1");
+    test_send (pub1, "c|1");
+    test_send (pub1, "a|2");
+
+    sub1 = test_socket (AF_SP, NN_SUB);
+    val = 100;
+    rc = nn_setsockopt (sub1, NN_SOL_SOCKET, NN_RCVTIMEO, &val, sizeof (val));
+    errno_assert (rc == 0);
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_SUBSCRIBE, "", 0);
+    errno_assert (rc == 0);
+    test_connect (sub1, SOCKET_ADDRESS);
+    test_recv (sub1, "c|1");
+    test_recv (sub1, "a|2");
+    rc = nn_recv (sub1, buf, sizeof (buf), 0);
+    nn_assert (rc == -1 && nn_errno () == ETIMEDOUT);
+
+    /*  Lowering the limit evicts the excess topics. */
+    val = 1;
+    rc = nn_setsockopt (pub1, NN_PUB, NN_PUB_LVC_SIZE, &val, sizeof (val));
+    errno_assert (rc == 0);
+    sub2 = test_socket (AF_SP, NN_SUB);
+    val = 100;
+    rc = nn_setsockopt (sub2, NN_SOL_SOCKET, NN_RCVTIMEO, &val, sizeof (val));
+    errno_assert (rc == 0);
+    rc = nn_setsockopt (sub2, NN_SUB, NN_SUB_SUBSCRIBE, "", 0);
+    errno_assert (rc == 0);
+    test_connect (sub2, SOCKET_ADDRESS);
+    test_recv (sub2, "a|2");
+    rc = nn_recv (sub2, buf, sizeof (buf), 0);
+    nn_assert (rc == -1 && nn_errno () == ETIMEDOUT);
+
+    test_close (sub2);
+    test_close (sub1);
+    test_close (pub1);
+
+    /*  Check that a subscriber which falls behind while the cache is being
+        replayed to it gets each message only once. */
+
+    pub1 = test_socket (AF_SP, NN_PUB);
+    val = 1;
+    rc = nn_setsockopt (pub1, NN_PUB, NN_PUB_LVC, &val, sizeof (val));
+    errno_assert (rc == 0);
+    rc = nn_setsockopt (pub1, NN_PUB, NN_PUB_TOPIC_LEN, &val, sizeof (val));
+    errno_assert (rc == 0);
+    val = NN_PUB_SLOW_DROP_OLDEST;
+    rc = nn_setsockopt (pub1, NN_PUB, NN_PUB_SLOW_POLICY, &val, sizeof (val));
+    errno_assert (rc == 0);
+    val = 1000;
+    rc = nn_setsockopt (pub1, NN_PUB, NN_PUB_SLOW_BACKLOG, &val, sizeof (val));
+    errno_assert (rc == 0);
+    test_bind (pub1, SOCKET_ADDRESS);
+    for (i = 0; i != 100; ++i) {
+        buf [0] = (char) i;
+        val = 0;
+        memcpy (buf + 1, &val, sizeof (val));
+        rc = nn_send (pub1, buf, 1 + sizeof (val), 0);
+        errno_assert (rc == 1 + (int) sizeof (val));
+    }
+
+    sub1 = test_socket (AF_SP, NN_SUB);
+    val = 256;
+    rc = nn_setsockopt (sub1, NN_SOL_SOCKET, NN_RCVBUF, &val, sizeof (val));
+    errno_assert (rc == 0);
+    val = 100;
+    rc = nn_setsockopt (sub1, NN_SOL_SOCKET, NN_RCVTIMEO, &val, sizeof (val));
+    errno_assert (rc == 0);
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_SUBSCRIBE, "", 0);
+    errno_assert (rc == 0);
+    test_connect (sub1, SOCKET_ADDRESS);
+    nn_sleep (10);
+
+    for (i = 0; i != 100; ++i) {
+        buf [0] = (char) i;
+        val = 1;
+        memcpy (buf + 1, &val, sizeof (val));
+        rc = nn_send (pub1, buf, 1 + sizeof (val), 0);
+        errno_assert (rc == 1 + (int) sizeof (val));
+    }
+    for (i = 0; i != 100; ++i)
+        seen [i] = -1;
+    while (nn_recv (sub1, buf, sizeof (buf), 0) == 1 + sizeof (val)) {
+        memcpy (&val, buf + 1, sizeof (val));
+        nn_assert (val > seen [(int) buf [0]]);
+        seen [(int) buf [0]] = val;
+    }
+    nn_assert (nn_errno () == ETIMEDOUT);
+    for (i = 0; i != 100; ++i)
+        nn_assert (seen [i] == 1);
+
+    test_close (sub1);
+    test_close (pub1);
+
+    /*  Check that a subscriber which doesn't keep up gets the latest message
+        of each topic once it catches up. */
+
+    pub1 = test_socket (AF_SP, NN_PUB);
+    val = 1;
+    rc = nn_setsockopt (pub1, NN_PUB, NN_PUB_CONFLATE, &val, sizeof (val));
+    errno_assert (rc == 0);
+    val = '|';
+    rc = nn_setsockopt (pub1, NN_PUB, NN_PUB_TOPIC_DELIM, &val, sizeof (val));
+    errno_assert (rc == 0);
+    test_bind (pub1, SOCKET_ADDRESS);
+    sub1 = test_socket (AF_SP, NN_SUB);
+    val = 256;
+    rc = nn_setsockopt (sub1, NN_SOL_SOCKET, NN_RCVBUF, &val, sizeof (val));
+    errno_assert (rc == 0);
+    val = 1000;
+    rc = nn_setsockopt (sub1, NN_SOL_SOCKET, NN_RCVTIMEO, &val, sizeof (val));
+    errno_assert (rc == 0);
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_SUBSCRIBE, "", 0);
+    errno_assert (rc == 0);
+    test_connect (sub1, SOCKET_ADDRESS);
+    nn_sleep (10);
+
+    for (i = 0; i != 1000; ++i) {
+        buf [0] = "ab" [i % 2];
+        buf [1] = '|';
+        memcpy (buf + 2, &i, sizeof (i));
+        rc = nn_send (pub1, buf, 2 + sizeof (i), 0);
+        errno_assert (rc == 2 + (int) sizeof (i));
+    }
+    last [0] = -1;
+    last [1] = -1;
+    for (i = 0; last [0] != 998 || last [1] != 999; ++i) {
+        rc = nn_recv (sub1, buf, sizeof (buf), 0);
+        errno_assert (rc == 2 + (int) sizeof (i));
+        memcpy (&val, buf + 2, sizeof (val));
+        nn_assert (val > last [buf [0] - 'a']);
+        last [buf [0] - 'a'] = val;
+    }
+    nn_assert (i < 1000);
+
+    test_close (sub1);
+    test_close (pub1);
+
+    /*  Check that the messages a slow subscriber doesn't get are accounted
+        for. */
+
+    pub1 = test_socket (AF_SP, NN_PUB);
+    sz = sizeof (val);
+    rc = nn_getsockopt (pub1, NN_PUB, NN_PUB_SLOW_POLICY, &val, &sz);
+    errno_assert (rc == 0);
+    nn_assert (val == NN_PUB_SLOW_DROP_NEW);
+    val = 2;
+    rc = nn_setsockopt (pub1, NN_PUB, NN_PUB_SLOW_POLICY, &val, sizeof (val));
+    nn_assert (rc < 0 && nn_errno () == EINVAL);
+    test_bind (pub1, SOCKET_ADDRESS);
+    sub1 = test_socket (AF_SP, NN_SUB);
+    val = 256;
+    rc = nn_setsockopt (sub1, NN_SOL_SOCKET, NN_RCVBUF, &val, sizeof (val));
+    errno_assert (rc == 0);
+    val = 100;
+    rc = nn_setsockopt (sub1, NN_SOL_SOCKET, NN_RCVTIMEO, &val, sizeof (val));
+    errno_assert (rc == 0);
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_SUBSCRIBE, "", 0);
+    errno_assert (rc == 0);
+    test_connect (sub1, SOCKET_ADDRESS);
+    nn_sleep (10);
+
+    for (i = 0; i != 1000; ++i) {
+        rc = nn_send (pub1, &i, sizeof (i), 0);
+        errno_assert (rc == sizeof (i));
+    }
+    for (i = 0; nn_recv (sub1, &val, sizeof (val), 0) == sizeof (val); ++i)
+        ;
+    nn_assert (nn_errno () == ETIMEDOUT);
+    nn_assert (i > 0 && i < 1000);
+    nn_assert (nn_get_statistic (pub1, NN_STAT_DROPPED_MESSAGES) ==
+        (uint64_t) (1000 - i));
+    nn_assert (nn_get_statistic (pub1, NN_STAT_MAX_PIPE_DROPPED_MESSAGES) ==
+        (uint64_t) (1000 - i));
+
+    /*  Once the subscriber goes away, nobody is dropping messages. */
+    test_close (sub1);
+    nn_sleep (10);
+    nn_assert (nn_get_statistic (pub1, NN_STAT_MAX_PIPE_DROPPED_MESSAGES) == 0);
+    test_close (pub1);
+
+    /*  With drop-oldest policy the subscriber gets the latest messages. */
+
+    pub1 = test_socket (AF_SP, NN_PUB);
+    val = NN_PUB_SLOW_DROP_OLDEST;
+    rc = nn_setsockopt (pub1, NN_PUB, NN_PUB_SLOW_POLICY, &val, sizeof (val));
+    errno_assert (rc == 0);
+    val = 8;
+    rc = nn_setsockopt (pub1, NN_PUB, NN_PUB_SLOW_BACKLOG, &val, sizeof (val));
+    errno_assert (rc == 0);
+    test_bind (pub1, SOCKET_ADDRESS);
+    sub1 = test_socket (AF_SP, NN_SUB);
+    val = 256;
+    rc = nn_setsockopt (sub1, NN_SOL_SOCKET, NN_RCVBUF, &val, sizeof (val));
+    errno_assert (rc == 0);
+    val = 100;
+    rc = nn_setsockopt (sub1, NN_SOL_SOCKET, NN_RCVTIMEO, &val, sizeof (val));
+    errno_assert (rc == 0);
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_SUBSCRIBE, "", 0);
+    errno_assert (rc == 0);
+    test_connect (sub1, SOCKET_ADDRESS);
+    nn_sleep (10);
+
+    for (i = 0; i != 1000; ++i) {
+        rc = nn_send (pub1, &i, sizeof (i), 0);
+        errno_assert (rc == sizeof (i));
+    }
+    last [0] = -1;
+    for (i = 0; nn_recv (sub1, &val, sizeof (val), 0) == sizeof (val); ++i) {
+        nn_assert (val > last [0]);
+        last [0] = val;
+    }
+    nn_assert (nn_errno () == ETIMEDOUT);
+    nn_assert (last [0] == 999);
+    nn_assert (nn_get_statistic (pub1, NN_STAT_DROPPED_MESSAGES) ==
+        (uint64_t) (1000 - i));
+
+    test_close (sub1);
+    test_close (pub1);
+
+    /*  Check that a subscriber losing too many messages is disconnected. */
+
+    pub1 = test_socket (AF_SP, NN_PUB);
+    val = 0;
+    rc = nn_setsockopt (pub1, NN_PUB, NN_PUB_SLOW_MAXDROPS, &val, sizeof (val));
+    errno_assert (rc == 0);
+    test_bind (pub1, SOCKET_ADDRESS_IPC);
+    sub1 = test_socket (AF_SP, NN_SUB);
+    rc = nn_setsockopt (sub1, NN_SUB, NN_SUB_SUBSCRIBE, "", 0);
+    errno_assert (rc == 0);
+    test_connect (sub1, SOCKET_ADDRESS_IPC);
+    nn_sleep (100);
+
+    msg = nn_allocmsg (65536, 0);
+    alloc_assert (msg);
+    memset (msg, 0, 65536);
+    for (i = 0; i != 1000 &&
+          nn_get_statistic (pub1, NN_STAT_EVICTED_CONNECTIONS) == 0; ++i) {
+        rc = nn_send (pub1, msg, 65536, 0);
+        errno_assert (rc == 65536);
+    }
+    rc = nn_freemsg (msg);
+    errno_assert (rc == 0);
+    nn_assert (nn_get_statistic (pub1, NN_STAT_EVICTED_CONNECTIONS) == 1);
+    nn_assert (nn_get_statistic (pub1, NN_STAT_DROPPED_MESSAGES) == 1);
+
+    test_close (sub1);
+    test_close (pub1);
+
     return 0;
 }
 
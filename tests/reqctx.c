@@ -0,0 +1,545 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+
+#include "../src/nn.h"
+#include "../src/reqrep.h"
+#include "../src/pair.h"
+
+#include "testutil.h"
+#include "../src/utils/attr.h"
+#include "../src/utils/thread.c"
+#include "../src/utils/stopwatch.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*  Tests contexts of REQ and REP sockets. */
+
+#define SOCKET_ADDRESS "inproc://reqctx"
+#define SOCKET_ADDRESS_POOL "inproc://reqctx-pool"
+#define SOCKET_ADDRESS_LB "inproc://reqctx-lb"
+#define SOCKET_ADDRESS_BATCH "inproc://reqctx-batch"
+#define SOCKET_ADDRESS_GONE "inproc://reqctx-gone"
+
+#define NCTXS 100
+
+#define NWORKERS 4
+#define NREQUESTS 5
+
+#define NBATCH 8
+
+struct request {
+    void *body;
+    void *control;
+};
+
+int rep;
+int server;
+int requester;
+
+/*  Receives a request on the raw REP socket, keeping the backtrace. */
+static void recv_request (struct request *req)
+{
+    int rc;
+    struct nn_iovec iov;
+    struct nn_msghdr hdr;
+
+    iov.iov_base = &req->body;
+    iov.iov_len = NN_MSG;
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = &req->control;
+    hdr.msg_controllen = NN_MSG;
+    rc = nn_recvmsg (rep, &hdr, 0);
+    errno_assert (rc >= 0);
+}
+
+/*  Echoes the request back to the requester. */
+static void send_reply (struct request *req)
+{
+    int rc;
+    struct nn_iovec iov;
+    struct nn_msghdr hdr;
+
+    iov.iov_base = &req->body;
+    iov.iov_len = NN_MSG;
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = &req->control;
+    hdr.msg_controllen = NN_MSG;
+    rc = nn_sendmsg (rep, &hdr, 0);
+    errno_assert (rc >= 0);
+}
+
+void worker (NN_UNUSED void *arg)
+{
+    struct request req;
+
+    /*  Reply only after the main thread has blocked waiting for it. */
+    recv_request (&req);
+    nn_sleep (100);
+    send_reply (&req);
+}
+
+/*  Disconnects the requester while the main thread waits to reply. */
+void disconnect (NN_UNUSED void *arg)
+{
+    nn_sleep (100);
+    test_close (requester);
+}
+
+/*  Serves requests on a context of its own, taking longer to process
+    requests with lower numbers so that the replies are sent out of order. */
+void pool_worker (NN_UNUSED void *arg)
+{
+    int rc;
+    int i;
+    int ctx;
+    int num;
+    char buf [16];
+
+    ctx = nn_ctx_open (server);
+    errno_assert (ctx >= 0);
+    for (i = 0; i != NREQUESTS; ++i) {
+        rc = nn_ctx_recv (server, ctx, buf, sizeof (buf) - 1, 0);
+        errno_assert (rc > 0);
+        buf [rc] = 0;
+        num = atoi (buf);
+        nn_sleep ((NWORKERS * NREQUESTS - num) * 2);
+        rc = nn_ctx_send (server, ctx, buf, rc, 0);
+        errno_assert (rc >= 0);
+    }
+    rc = nn_ctx_close (server, ctx);
+    errno_assert (rc == 0);
+}
+
+int main ()
+{
+    int rc;
+    int i;
+    int j;
+    int req;
+    int sctx;
+    int ctxs [NCTXS];
+    struct request reqs [NCTXS];
+    char buf [16];
+    char expected [16];
+    int timeo;
+    struct nn_thread thread;
+    struct nn_thread workers [NWORKERS];
+    int client;
+    int pair;
+    int peer1;
+    int peer2;
+    int strategy;
+    size_t sz;
+    int batch;
+    int index;
+    struct nn_iovec iovs [NBATCH];
+    char bodies [NBATCH][16];
+    char request [256];
+    int peers [2];
+    char keys [2];
+    int keylen;
+    char reply [256];
+    struct nn_stopwatch stopwatch;
+    uint64_t elapsed;
+
+    rep = test_socket (AF_SP_RAW, NN_REP);
+    test_bind (rep, SOCKET_ADDRESS);
+    req = test_socket (AF_SP, NN_REQ);
+    test_connect (req, SOCKET_ADDRESS);
+
+    /*  Contexts get distinct IDs. */
+    for (i = 0; i != NCTXS; ++i) {
+        ctxs [i] = nn_ctx_open (req);
+        errno_assert (ctxs [i] >= 0);
+        if (i > 0)
+            nn_assert (ctxs [i] != ctxs [i - 1]);
+    }
+
+    /*  No request was sent on the context yet. */
+    rc = nn_ctx_recv (req, ctxs [0], buf, sizeof (buf), NN_DONTWAIT);
+    nn_assert (rc == -1 && nn_errno () == EFSM);
+
+    /*  Many requests in flight at once, along with the socket's own one.
+        Reply in reverse order and check that each reply gets to the context
+        that sent the request. */
+    for (i = 0; i != NCTXS; ++i) {
+        sprintf (buf, "%d", i);
+        rc = nn_ctx_send (req, ctxs [i], buf, strlen (buf), 0);
+        errno_assert (rc == (int) strlen (buf));
+    }
+    test_send (req, "DEFAULT");
+    for (i = 0; i != NCTXS; ++i)
+        recv_request (&reqs [i]);
+    rc = nn_ctx_recv (req, ctxs [0], buf, sizeof (buf), NN_DONTWAIT);
+    nn_assert (rc == -1 && nn_errno () == EAGAIN);
+    for (i = NCTXS - 1; i >= 0; --i)
+        send_reply (&reqs [i]);
+    for (i = 0; i != NCTXS; ++i) {
+        sprintf (expected, "%d", i);
+        rc = nn_ctx_recv (req, ctxs [i], buf, sizeof (buf), 0);
+        errno_assert (rc == (int) strlen (expected));
+        nn_assert (memcmp (buf, expected, rc) == 0);
+    }
+    rc = nn_ctx_recv (req, ctxs [0], buf, sizeof (buf), NN_DONTWAIT);
+    nn_assert (rc == -1 && nn_errno () == EFSM);
+    rc = nn_recv (req, buf, sizeof (buf), NN_DONTWAIT);
+    nn_assert (rc == -1 && nn_errno () == EAGAIN);
+    recv_request (&reqs [0]);
+    send_reply (&reqs [0]);
+    test_recv (req, "DEFAULT");
+
+    /*  Reply to a request that was superseded by a new one is dropped. */
+    rc = nn_ctx_send (req, ctxs [1], "OLD", 3, 0);
+    errno_assert (rc == 3);
+    recv_request (&reqs [0]);
+    rc = nn_ctx_send (req, ctxs [1], "NEW", 3, 0);
+    errno_assert (rc == 3);
+    recv_request (&reqs [1]);
+    send_reply (&reqs [0]);
+    send_reply (&reqs [1]);
+    rc = nn_ctx_recv (req, ctxs [1], buf, sizeof (buf), 0);
+    errno_assert (rc == 3);
+    nn_assert (memcmp (buf, "NEW", 3) == 0);
+
+    /*  Blocking receive on a context is woken up by the reply. */
+    nn_thread_init (&thread, worker, NULL);
+    rc = nn_ctx_send (req, ctxs [2], "ABC", 3, 0);
+    errno_assert (rc == 3);
+    rc = nn_ctx_recv (req, ctxs [2], buf, sizeof (buf), 0);
+    errno_assert (rc == 3);
+    nn_assert (memcmp (buf, "ABC", 3) == 0);
+    nn_thread_term (&thread);
+
+    /*  Receive timeout applies to contexts as well. */
+    timeo = 100;
+    test_setsockopt (req, NN_SOL_SOCKET, NN_RCVTIMEO, &timeo, sizeof (timeo));
+    rc = nn_ctx_send (req, ctxs [3], "ABC", 3, 0);
+    errno_assert (rc == 3);
+    rc = nn_ctx_recv (req, ctxs [3], buf, sizeof (buf), 0);
+    nn_assert (rc == -1 && nn_errno () == ETIMEDOUT);
+    recv_request (&reqs [0]);
+    nn_freemsg (reqs [0].body);
+    nn_freemsg (reqs [0].control);
+
+    /*  Closed contexts can't be used anymore, the others are unaffected.
+        Context with a request outstanding can be closed. */
+    rc = nn_ctx_close (req, ctxs [3]);
+    errno_assert (rc == 0);
+    rc = nn_ctx_close (req, ctxs [3]);
+    nn_assert (rc == -1 && nn_errno () == EBADF);
+    rc = nn_ctx_send (req, ctxs [3], "ABC", 3, 0);
+    nn_assert (rc == -1 && nn_errno () == EBADF);
+    rc = nn_ctx_recv (req, ctxs [3], buf, sizeof (buf), 0);
+    nn_assert (rc == -1 && nn_errno () == EBADF);
+    rc = nn_ctx_send (req, -1, "ABC", 3, 0);
+    nn_assert (rc == -1 && nn_errno () == EBADF);
+    rc = nn_ctx_send (req, ctxs [4], "ABC", 3, 0);
+    errno_assert (rc == 3);
+    recv_request (&reqs [0]);
+    send_reply (&reqs [0]);
+    rc = nn_ctx_recv (req, ctxs [4], buf, sizeof (buf), 0);
+    errno_assert (rc == 3);
+
+    /*  Socket types without contexts. */
+    pair = test_socket (AF_SP, NN_PAIR);
+    rc = nn_ctx_open (pair);
+    nn_assert (rc == -1 && nn_errno () == ENOTSUP);
+    test_close (pair);
+
+    /*  Closing the socket with open contexts and requests in flight. */
+    rc = nn_ctx_send (req, ctxs [5], "ABC", 3, 0);
+    errno_assert (rc == 3);
+    test_close (req);
+    test_close (rep);
+
+    /*  A pool of threads serving a single REP socket, each on a context of
+        its own. */
+    server = test_socket (AF_SP, NN_REP);
+    test_bind (server, SOCKET_ADDRESS_POOL);
+    client = test_socket (AF_SP, NN_REQ);
+    test_connect (client, SOCKET_ADDRESS_POOL);
+    for (i = 0; i != NWORKERS; ++i)
+        nn_thread_init (&workers [i], pool_worker, NULL);
+    for (i = 0; i != NWORKERS * NREQUESTS; ++i) {
+        ctxs [i] = nn_ctx_open (client);
+        errno_assert (ctxs [i] >= 0);
+        sprintf (buf, "%d", i);
+        rc = nn_ctx_send (client, ctxs [i], buf, strlen (buf), 0);
+        errno_assert (rc == (int) strlen (buf));
+    }
+    for (i = 0; i != NWORKERS * NREQUESTS; ++i) {
+        sprintf (expected, "%d", i);
+        rc = nn_ctx_recv (client, ctxs [i], buf, sizeof (buf), 0);
+        errno_assert (rc == (int) strlen (expected));
+        nn_assert (memcmp (buf, expected, rc) == 0);
+    }
+    for (i = 0; i != NWORKERS; ++i)
+        nn_thread_term (&workers [i]);
+
+    /*  The socket's own request and a context's request are independent
+        of each other. */
+    sctx = nn_ctx_open (server);
+    errno_assert (sctx >= 0);
+    test_send (client, "ABC");
+    rc = nn_ctx_send (client, ctxs [0], "DEF", 3, 0);
+    errno_assert (rc == 3);
+    rc = nn_ctx_send (server, sctx, "XYZ", 3, 0);
+    nn_assert (rc == -1 && nn_errno () == EFSM);
+    test_recv (server, "ABC");
+    rc = nn_ctx_recv (server, sctx, buf, sizeof (buf), 0);
+    errno_assert (rc == 3);
+    nn_assert (memcmp (buf, "DEF", 3) == 0);
+    rc = nn_ctx_send (server, sctx, buf, 3, 0);
+    errno_assert (rc == 3);
+    test_send (server, "ABC");
+    test_recv (client, "ABC");
+    rc = nn_ctx_recv (client, ctxs [0], buf, sizeof (buf), 0);
+    errno_assert (rc == 3);
+    nn_assert (memcmp (buf, "DEF", 3) == 0);
+
+    /*  Closing the socket with open contexts and requests in progress. */
+    test_send (client, "ABC");
+    rc = nn_ctx_recv (server, sctx, buf, sizeof (buf), 0);
+    errno_assert (rc == 3);
+    test_close (client);
+    test_close (server);
+
+    /*  Least-outstanding load balancing. Once a peer stops replying,
+        the requests go to the one that does. */
+    client = test_socket (AF_SP, NN_REQ);
+    sz = sizeof (strategy);
+    rc = nn_getsockopt (client, NN_REQ, NN_REQ_LB_STRATEGY, &strategy, &sz);
+    errno_assert (rc == 0);
+    nn_assert (sz == sizeof (strategy) && strategy == NN_LB_ROUND_ROBIN);
+    strategy = 42;
+    rc = nn_setsockopt (client, NN_REQ, NN_REQ_LB_STRATEGY, &strategy,
+        sizeof (strategy));
+    nn_assert (rc < 0 && nn_errno () == EINVAL);
+    strategy = NN_LB_LEAST_OUTSTANDING;
+    test_setsockopt (client, NN_REQ, NN_REQ_LB_STRATEGY, &strategy,
+        sizeof (strategy));
+    test_bind (client, SOCKET_ADDRESS_LB);
+    peer1 = test_socket (AF_SP, NN_REP);
+    test_connect (peer1, SOCKET_ADDRESS_LB);
+    peer2 = test_socket (AF_SP, NN_REP);
+    test_connect (peer2, SOCKET_ADDRESS_LB);
+    nn_sleep (10);
+
+    for (i = 0; i != 2; ++i) {
+        ctxs [i] = nn_ctx_open (client);
+        errno_assert (ctxs [i] >= 0);
+        sprintf (buf, "%d", i);
+        rc = nn_ctx_send (client, ctxs [i], buf, 1, 0);
+        errno_assert (rc == 1);
+    }
+    rc = nn_recv (peer1, buf, sizeof (buf), 0);
+    errno_assert (rc == 1);
+    rc = nn_recv (peer2, buf, sizeof (buf), 0);
+    errno_assert (rc == 1);
+    i = buf [0] - '0';
+    rc = nn_send (peer2, buf, 1, 0);
+    errno_assert (rc == 1);
+    rc = nn_ctx_recv (client, ctxs [i], buf, sizeof (buf), 0);
+    errno_assert (rc == 1);
+    for (j = 0; j != 3; ++j) {
+        rc = nn_ctx_send (client, ctxs [i], "ABC", 3, 0);
+        errno_assert (rc == 3);
+        test_recv (peer2, "ABC");
+        test_send (peer2, "DEF");
+        rc = nn_ctx_recv (client, ctxs [i], buf, sizeof (buf), 0);
+        errno_assert (rc == 3);
+        nn_assert (memcmp (buf, "DEF", 3) == 0);
+    }
+    rc = nn_recv (peer1, buf, sizeof (buf), NN_DONTWAIT);
+    nn_assert (rc < 0 && nn_errno () == EAGAIN);
+
+    test_close (client);
+    test_close (peer1);
+    test_close (peer2);
+
+    /*  Consistent hashing. Requests waiting for a peer that doesn't keep
+        up don't hold back those for the other peers. The peers queue just
+        one request at a time. */
+    client = test_socket (AF_SP, NN_REQ);
+    strategy = NN_LB_CONSISTENT_HASH;
+    test_setsockopt (client, NN_REQ, NN_REQ_LB_STRATEGY, &strategy,
+        sizeof (strategy));
+    keylen = 1;
+    test_setsockopt (client, NN_REQ, NN_REQ_LB_KEY_LEN, &keylen,
+        sizeof (keylen));
+    test_bind (client, SOCKET_ADDRESS_LB);
+    timeo = 1000;
+    for (i = 0; i != 2; ++i) {
+        peers [i] = test_socket (AF_SP, NN_REP);
+        test_setsockopt (peers [i], NN_SOL_SOCKET, NN_RCVTIMEO, &timeo,
+            sizeof (timeo));
+        test_setsockopt (peers [i], NN_SOL_SOCKET, NN_RCVBUF, &keylen,
+            sizeof (keylen));
+        test_connect (peers [i], SOCKET_ADDRESS_LB);
+    }
+    nn_sleep (10);
+    for (i = 0; i != 6; ++i) {
+        ctxs [i] = nn_ctx_open (client);
+        errno_assert (ctxs [i] >= 0);
+    }
+
+    /*  Find a key for each of the peers. */
+    keys [0] = 0;
+    keys [1] = 0;
+    for (buf [0] = 'A'; !keys [0] || !keys [1]; ++buf [0]) {
+        nn_assert (buf [0] <= 'Z');
+        rc = nn_ctx_send (client, ctxs [0], buf, 1, 0);
+        errno_assert (rc == 1);
+        nn_sleep (10);
+        j = nn_recv (peers [0], buf + 1, 1, NN_DONTWAIT) == 1 ? 0 : 1;
+        if (j == 1) {
+            rc = nn_recv (peers [1], buf + 1, 1, 0);
+            errno_assert (rc == 1);
+        }
+        rc = nn_send (peers [j], buf + 1, 1, 0);
+        errno_assert (rc == 1);
+        rc = nn_ctx_recv (client, ctxs [0], buf + 1, 1, 0);
+        errno_assert (rc == 1);
+        if (!keys [j])
+            keys [j] = buf [0];
+    }
+
+    /*  The first peer doesn't read its requests. */
+    for (i = 0; i != 6; ++i) {
+        rc = nn_ctx_send (client, ctxs [i], &keys [i / 3], 1, 0);
+        errno_assert (rc == 1);
+    }
+    for (i = 0; i != 3; ++i) {
+        rc = nn_recv (peers [1], buf, sizeof (buf), 0);
+        errno_assert (rc == 1);
+        nn_assert (buf [0] == keys [1]);
+        rc = nn_send (peers [1], buf, 1, 0);
+        errno_assert (rc == 1);
+    }
+
+    test_close (client);
+    test_close (peers [0]);
+    test_close (peers [1]);
+
+    /*  Batch of requests. Replies are received in the order they arrive,
+        along with the index of the request. */
+    rep = test_socket (AF_SP_RAW, NN_REP);
+    test_bind (rep, SOCKET_ADDRESS_BATCH);
+    client = test_socket (AF_SP, NN_REQ);
+    test_connect (client, SOCKET_ADDRESS_BATCH);
+    for (i = 0; i != NBATCH; ++i) {
+        sprintf (bodies [i], "%d", i);
+        iovs [i].iov_base = bodies [i];
+        iovs [i].iov_len = strlen (bodies [i]);
+    }
+    batch = nn_req_batch (client, iovs, NBATCH, -1);
+    errno_assert (batch >= 0);
+    for (i = 0; i != NBATCH; ++i)
+        recv_request (&reqs [i]);
+    rc = nn_req_batch_recv (client, batch, buf, sizeof (buf), &index,
+        NN_DONTWAIT);
+    nn_assert (rc == -1 && nn_errno () == EAGAIN);
+    for (i = NBATCH - 1; i >= 0; --i)
+        send_reply (&reqs [i]);
+    for (i = NBATCH - 1; i >= 0; --i) {
+        rc = nn_req_batch_recv (client, batch, buf, sizeof (buf), &index, 0);
+        errno_assert (rc == 1);
+        nn_assert (index == buf [0] - '0');
+    }
+    rc = nn_req_batch_recv (client, batch, buf, sizeof (buf), &index, 0);
+    nn_assert (rc == -1 && nn_errno () == EFSM);
+    rc = nn_ctx_send (client, batch, "ABC", 3, 0);
+    nn_assert (rc == -1 && nn_errno () == EFSM);
+    rc = nn_ctx_close (client, batch);
+    errno_assert (rc == 0);
+
+    /*  Once the deadline expires, the replies that have arrived can still
+        be received, the others are given up on. */
+    batch = nn_req_batch (client, iovs, 2, 100);
+    errno_assert (batch >= 0);
+    recv_request (&reqs [0]);
+    recv_request (&reqs [1]);
+    send_reply (&reqs [1]);
+    nn_sleep (200);
+    send_reply (&reqs [0]);
+    rc = nn_req_batch_recv (client, batch, buf, sizeof (buf), &index, 0);
+    errno_assert (rc == 1);
+    nn_assert (index == 1 && buf [0] == '1');
+    rc = nn_req_batch_recv (client, batch, buf, sizeof (buf), &index, 0);
+    nn_assert (rc == -1 && nn_errno () == ETIMEDOUT);
+    rc = nn_ctx_close (client, batch);
+    errno_assert (rc == 0);
+
+    rc = nn_req_batch (client, iovs, 0, -1);
+    nn_assert (rc == -1 && nn_errno () == EINVAL);
+    pair = test_socket (AF_SP, NN_PAIR);
+    rc = nn_req_batch (pair, iovs, NBATCH, -1);
+    nn_assert (rc == -1 && nn_errno () == ENOTSUP);
+    test_close (pair);
+
+    /*  Closing the socket with a batch in progress. */
+    batch = nn_req_batch (client, iovs, NBATCH, -1);
+    errno_assert (batch >= 0);
+    test_close (client);
+    test_close (rep);
+
+    /*  A context waiting for the requester to accept the reply stops
+        waiting once the requester is gone. */
+    server = test_socket (AF_SP, NN_REP);
+    timeo = 3000;
+    test_setsockopt (server, NN_SOL_SOCKET, NN_SNDTIMEO, &timeo,
+        sizeof (timeo));
+    test_bind (server, SOCKET_ADDRESS_GONE);
+    requester = test_socket (AF_SP_RAW, NN_REQ);
+    timeo = 256;
+    test_setsockopt (requester, NN_SOL_SOCKET, NN_RCVBUF, &timeo,
+        sizeof (timeo));
+    test_connect (requester, SOCKET_ADDRESS_GONE);
+    sctx = nn_ctx_open (server);
+    errno_assert (sctx >= 0);
+    memset (request, 'x', sizeof (request));
+    memcpy (request, "\x80\0\0\x01", 4);
+    for (i = 0; i != NCTXS; ++i) {
+        rc = nn_send (requester, request, sizeof (request), 0);
+        errno_assert (rc == sizeof (request));
+        rc = nn_ctx_recv (server, sctx, reply, sizeof (reply), 0);
+        errno_assert (rc == sizeof (request) - 4);
+        rc = nn_ctx_send (server, sctx, reply, rc, NN_DONTWAIT);
+        if (rc < 0)
+            break;
+    }
+    nn_assert (rc == -1 && nn_errno () == EAGAIN);
+    nn_thread_init (&thread, disconnect, NULL);
+    nn_stopwatch_init (&stopwatch);
+    rc = nn_ctx_send (server, sctx, reply, 3, 0);
+    elapsed = nn_stopwatch_term (&stopwatch);
+    errno_assert (rc == 3);
+    nn_assert (elapsed < 1000000);
+    nn_thread_term (&thread);
+    test_close (server);
+
+    return 0;
+}
@@ -35,8 +35,12 @@ int main ()
     int req1;
     int req2;
     int resend_ivl;
+    int hedge_ivl;
     char buf [7];
     int timeo;
+    int cache_size;
+    int cache_ttl;
+    size_t sz;
 
     /*  Test req/rep with full socket types. */
     rep1 = test_socket (AF_SP, NN_REP);
@@ -158,6 +162,48 @@ int main ()
     test_close (req1);
     test_close (rep2);
 
+    /*  Test hedging of the request. If rep1 doesn't reply in time, the request
+        is sent to rep2 as well and the first reply wins. */
+    req1 = test_socket (AF_SP, NN_REQ);
+    test_bind (req1, SOCKET_ADDRESS);
+    rep1 = test_socket (AF_SP, NN_REP);
+    test_connect (rep1, SOCKET_ADDRESS);
+    rep2 = test_socket (AF_SP, NN_REP);
+    test_connect (rep2, SOCKET_ADDRESS);
+
+    timeo = 1000;
+    test_setsockopt (rep2, NN_SOL_SOCKET, NN_RCVTIMEO, &timeo, sizeof (timeo));
+    hedge_ivl = 50;
+    test_setsockopt (req1, NN_REQ, NN_REQ_HEDGE_IVL, &hedge_ivl,
+        sizeof (hedge_ivl));
+    hedge_ivl = 101;
+    rc = nn_setsockopt (req1, NN_REQ, NN_REQ_HEDGE_PERCENTILE, &hedge_ivl,
+        sizeof (hedge_ivl));
+    nn_assert (rc < 0 && nn_errno () == EINVAL);
+
+    test_send (req1, "ABC");
+    test_recv (rep1, "ABC");
+    test_recv (rep2, "ABC");
+    test_send (rep2, "REPLY");
+    test_recv (req1, "REPLY");
+    nn_assert (nn_get_statistic (req1, NN_STAT_HEDGED_REQUESTS) == 1);
+    nn_assert (nn_get_statistic (req1, NN_STAT_HEDGES_WON) == 1);
+
+    /*  The late reply is dropped. */
+    test_send (rep1, "LATE");
+    hedge_ivl = -1;
+    test_setsockopt (req1, NN_REQ, NN_REQ_HEDGE_IVL, &hedge_ivl,
+        sizeof (hedge_ivl));
+    test_send (req1, "DEF");
+    test_recv (rep1, "DEF");
+    test_send (rep1, "REPLY");
+    test_recv (req1, "REPLY");
+    nn_assert (nn_get_statistic (req1, NN_STAT_HEDGED_REQUESTS) == 1);
+
+    test_close (req1);
+    test_close (rep1);
+    test_close (rep2);
+
     /*  Test cancelling delayed request  */
 
     req1 = test_socket (AF_SP, NN_REQ);
@@ -173,6 +219,71 @@ int main ()
     test_close (req1);
     test_close (rep1);
 
+    /*  Test the reply cache. Repeated requests are answered by the REP
+        socket itself, the least recently used replies are evicted and
+        the replies expire. */
+    rep1 = test_socket (AF_SP, NN_REP);
+    test_bind (rep1, SOCKET_ADDRESS);
+    req1 = test_socket (AF_SP, NN_REQ);
+    test_connect (req1, SOCKET_ADDRESS);
+    req2 = test_socket (AF_SP, NN_REQ);
+    test_connect (req2, SOCKET_ADDRESS);
+
+    cache_size = -1;
+    rc = nn_setsockopt (rep1, NN_REP, NN_REP_CACHE_SIZE, &cache_size,
+        sizeof (cache_size));
+    nn_assert (rc < 0 && nn_errno () == EINVAL);
+    cache_size = 2;
+    test_setsockopt (rep1, NN_REP, NN_REP_CACHE_SIZE, &cache_size,
+        sizeof (cache_size));
+    sz = sizeof (cache_ttl);
+    rc = nn_getsockopt (rep1, NN_REP, NN_REP_CACHE_TTL, &cache_ttl, &sz);
+    errno_assert (rc == 0);
+    nn_assert (sz == sizeof (cache_ttl) && cache_ttl == 1000);
+    timeo = 100;
+    test_setsockopt (rep1, NN_SOL_SOCKET, NN_RCVTIMEO, &timeo, sizeof (timeo));
+
+    test_send (req1, "ABC");
+    test_recv (rep1, "ABC");
+    test_send (rep1, "REPLY");
+    test_recv (req1, "REPLY");
+    test_send (req2, "ABC");
+    test_drop (rep1, ETIMEDOUT);
+    test_recv (req2, "REPLY");
+    nn_assert (nn_get_statistic (rep1, NN_STAT_CACHE_HITS) == 1);
+    nn_assert (nn_get_statistic (rep1, NN_STAT_CACHE_MISSES) == 1);
+
+    test_send (req1, "DEF");
+    test_recv (rep1, "DEF");
+    test_send (rep1, "DEF");
+    test_recv (req1, "DEF");
+    test_send (req1, "GHI");
+    test_recv (rep1, "GHI");
+    test_send (rep1, "GHI");
+    test_recv (req1, "GHI");
+    test_send (req2, "DEF");
+    test_drop (rep1, ETIMEDOUT);
+    test_recv (req2, "DEF");
+    test_send (req2, "ABC");
+    test_recv (rep1, "ABC");
+    test_send (rep1, "ABC");
+    test_recv (req2, "ABC");
+
+    cache_ttl = 50;
+    test_setsockopt (rep1, NN_REP, NN_REP_CACHE_TTL, &cache_ttl,
+        sizeof (cache_ttl));
+    nn_sleep (100);
+    test_send (req1, "ABC");
+    test_recv (rep1, "ABC");
+    test_send (rep1, "ABC");
+    test_recv (req1, "ABC");
+    nn_assert (nn_get_statistic (rep1, NN_STAT_CACHE_HITS) == 2);
+    nn_assert (nn_get_statistic (rep1, NN_STAT_CACHE_MISSES) == 5);
+
+    test_close (req2);
+    test_close (req1);
+    test_close (rep1);
+
     return 0;
 }
 
@@ -23,13 +23,21 @@
 
 #include "../src/nn.h"
 #include "../src/reqrep.h"
+#include "../src/pair.h"
 
 #include "testutil.h"
 
+#include <string.h>
+
 int main (int argc, const char *argv[])
 {
     int rep1;
     int req1;
+    int pair1;
+    int pair2;
+    int i;
+    int rc;
+    char buf [1000];
     char socket_address[128];
 
     test_addr_from(socket_address, "tcp", "127.0.0.1",
@@ -94,6 +102,41 @@ int main (int argc, const char *argv[])
 
     test_close (rep1);
 
+    /*  Test buffered message and memory statistics. */
+    pair1 = test_socket (AF_SP, NN_PAIR);
+    test_bind (pair1, "inproc://stats");
+    pair2 = test_socket (AF_SP, NN_PAIR);
+    test_connect (pair2, "inproc://stats");
+
+    memset (buf, 'A', sizeof (buf));
+    for (i = 0; i != 3; ++i) {
+        rc = nn_send (pair2, buf, sizeof (buf), 0);
+        errno_assert (rc == sizeof (buf));
+    }
+    nn_sleep (100);
+
+    nn_assert (nn_get_statistic(pair1, NN_STAT_CURRENT_BYTES_QUEUED) ==
+        3 * sizeof (buf));
+    nn_assert (nn_get_statistic(pair2, NN_STAT_CURRENT_BYTES_QUEUED) == 0);
+    nn_assert (nn_get_statistic(pair1, NN_STAT_MEMORY_CHUNKS) >= 3);
+    nn_assert (nn_get_statistic(pair1, NN_STAT_MEMORY_BYTES) >=
+        3 * sizeof (buf));
+    nn_assert (nn_get_statistic(pair1, NN_STAT_MEMORY_BYTES_1K) >=
+        3 * sizeof (buf));
+    nn_assert (nn_get_statistic(pair1, NN_STAT_MEMORY_PEAK_BYTES) >=
+        nn_get_statistic(pair1, NN_STAT_MEMORY_BYTES));
+
+    for (i = 0; i != 3; ++i) {
+        rc = nn_recv (pair1, buf, sizeof (buf), 0);
+        errno_assert (rc == sizeof (buf));
+    }
+    nn_assert (nn_get_statistic(pair1, NN_STAT_CURRENT_BYTES_QUEUED) == 0);
+    nn_assert (nn_get_statistic(pair1, NN_STAT_MEMORY_PEAK_BYTES) >=
+        3 * sizeof (buf));
+
+    test_close (pair2);
+    test_close (pair1);
+
     return 0;
 }
 
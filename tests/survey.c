@@ -25,6 +25,7 @@
 #include "../src/survey.h"
 
 #include "testutil.h"
+#include "../src/utils/stopwatch.c"
 
 #define SOCKET_ADDRESS "inproc://test"
 
@@ -36,7 +37,12 @@ int main ()
     int respondent2;
     int respondent3;
     int deadline;
+    int quorum;
+    int ctx;
+    size_t sz;
     char buf [7];
+    struct nn_stopwatch stopwatch;
+    uint64_t elapsed;
 
     /*  Test a simple survey with three respondents. */
     surveyor = test_socket (AF_SP, NN_SURVEYOR);
@@ -90,6 +96,85 @@ int main ()
     rc = nn_recv (surveyor, buf, sizeof (buf), 0);
     errno_assert (rc == -1 && nn_errno () == EFSM);
 
+    /*  Nobody answered the second survey. Drop it. */
+    test_recv (respondent1, "ABC");
+    test_recv (respondent2, "ABC");
+    test_recv (respondent3, "ABC");
+
+    /*  Check the quorum option. It's disabled by default. */
+    sz = sizeof (quorum);
+    rc = nn_getsockopt (surveyor, NN_SURVEYOR, NN_SURVEYOR_QUORUM,
+        &quorum, &sz);
+    errno_assert (rc == 0);
+    nn_assert (sz == sizeof (quorum) && quorum == 0);
+    deadline = 5000;
+    rc = nn_setsockopt (surveyor, NN_SURVEYOR, NN_SURVEYOR_DEADLINE,
+        &deadline, sizeof (deadline));
+    errno_assert (rc == 0);
+    quorum = 2;
+    rc = nn_setsockopt (surveyor, NN_SURVEYOR, NN_SURVEYOR_QUORUM,
+        &quorum, sizeof (quorum));
+    errno_assert (rc == 0);
+
+    /*  Survey finishes as soon as two responses are in. */
+    nn_stopwatch_init (&stopwatch);
+    test_send (surveyor, "ABC");
+    test_recv (respondent1, "ABC");
+    test_send (respondent1, "DEF");
+    test_recv (respondent2, "ABC");
+    test_send (respondent2, "DEF");
+    test_recv (surveyor, "DEF");
+    test_recv (surveyor, "DEF");
+    rc = nn_recv (surveyor, buf, sizeof (buf), 0);
+    errno_assert (rc == -1 && nn_errno () == ETIMEDOUT);
+    elapsed = nn_stopwatch_term (&stopwatch);
+    nn_assert (elapsed < 1000000);
+
+    /*  Late response is dropped. */
+    test_recv (respondent3, "ABC");
+    test_send (respondent3, "GHI");
+
+    /*  Negative quorum waits for all the respondents. Meanwhile, a survey
+        on a context runs concurrently with the one on the socket. */
+    quorum = -1;
+    rc = nn_setsockopt (surveyor, NN_SURVEYOR, NN_SURVEYOR_QUORUM,
+        &quorum, sizeof (quorum));
+    errno_assert (rc == 0);
+    ctx = nn_ctx_open (surveyor);
+    errno_assert (ctx >= 0);
+    nn_stopwatch_init (&stopwatch);
+    test_send (surveyor, "ABC");
+    rc = nn_ctx_send (surveyor, ctx, "JKL", 3, 0);
+    errno_assert (rc == 3);
+    test_recv (respondent1, "ABC");
+    test_send (respondent1, "DEF");
+    test_recv (respondent1, "JKL");
+    test_send (respondent1, "MNO");
+    test_recv (respondent2, "ABC");
+    test_send (respondent2, "DEF");
+    test_recv (respondent2, "JKL");
+    test_send (respondent2, "MNO");
+    test_recv (respondent3, "ABC");
+    test_send (respondent3, "DEF");
+    test_recv (respondent3, "JKL");
+    test_send (respondent3, "MNO");
+    for (rc = 0; rc != 3; ++rc) {
+        memset (buf, 0, sizeof (buf));
+        sz = nn_ctx_recv (surveyor, ctx, buf, sizeof (buf), 0);
+        nn_assert (sz == 3 && memcmp (buf, "MNO", 3) == 0);
+    }
+    rc = nn_ctx_recv (surveyor, ctx, buf, sizeof (buf), 0);
+    errno_assert (rc == -1 && nn_errno () == ETIMEDOUT);
+    test_recv (surveyor, "DEF");
+    test_recv (surveyor, "DEF");
+    test_recv (surveyor, "DEF");
+    rc = nn_recv (surveyor, buf, sizeof (buf), 0);
+    errno_assert (rc == -1 && nn_errno () == ETIMEDOUT);
+    elapsed = nn_stopwatch_term (&stopwatch);
+    nn_assert (elapsed < 1000000);
+    rc = nn_ctx_close (surveyor, ctx);
+    errno_assert (rc == 0);
+
     test_close (surveyor);
     test_close (respondent1);
     test_close (respondent2);
@@ -26,13 +26,94 @@
 #include "../src/pair.h"
 #include "../src/pubsub.h"
 #include "../src/tcp.h"
+#include "../src/pipeline.h"
+#include "../src/reqrep.h"
 
 #include "testutil.h"
 
+#if !defined NN_HAVE_WINDOWS
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <string.h>
+#endif
+
 /*  Tests TCP transport. */
 
 int sc;
 
+#if !defined NN_HAVE_WINDOWS
+
+/*  Connects to the port on the local host using a plain TCP socket. With
+    zero capabilities, the peer implements the SP TCP mapping strictly:
+    the reserved bytes of the protocol header are sent as zeros and
+    the connection is dropped if the ones received are not. Otherwise,
+    the capabilities are announced the way nanomsg does it. Returns
+    the connected socket, or -1 if the connection was dropped. */
+static int raw_connect (int port, int protocol, int caps)
+{
+    int rc;
+    int s;
+    struct sockaddr_in addr;
+    unsigned char hdr [8];
+
+    s = socket (AF_INET, SOCK_STREAM, 0);
+    errno_assert (s >= 0);
+    memset (&addr, 0, sizeof (addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons ((unsigned short) port);
+    addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+    rc = connect (s, (struct sockaddr*) &addr, sizeof (addr));
+    errno_assert (rc == 0);
+
+    memcpy (hdr, "\0SP\0\0\0\0\0", 8);
+    hdr [4] = (unsigned char) (protocol >> 8);
+    hdr [5] = (unsigned char) protocol;
+    hdr [7] = (unsigned char) caps;
+    rc = (int) send (s, hdr, sizeof (hdr), 0);
+    errno_assert (rc == sizeof (hdr));
+    rc = (int) recv (s, hdr, sizeof (hdr), MSG_WAITALL);
+    errno_assert (rc == sizeof (hdr));
+    nn_assert (memcmp (hdr, "\0SP\0", 4) == 0);
+    if (caps == 0 && (hdr [6] != 0 || hdr [7] != 0)) {
+        close (s);
+        return -1;
+    }
+    return s;
+}
+
+/*  Sends a message over the plain TCP connection. */
+static void raw_send (int s, const void *data, size_t size)
+{
+    int rc;
+    unsigned char buf [64];
+
+    nn_assert (size <= sizeof (buf) - 8);
+    memset (buf, 0, 8);
+    buf [7] = (unsigned char) size;
+    memcpy (buf + 8, data, size);
+    rc = (int) send (s, buf, size + 8, 0);
+    errno_assert (rc == (int) size + 8);
+}
+
+/*  Receives a message from the plain TCP connection and checks its
+    content. */
+static void raw_recv (int s, const void *data, size_t size)
+{
+    int rc;
+    unsigned char buf [64];
+
+    nn_assert (size <= sizeof (buf) - 8);
+    rc = (int) recv (s, buf, size + 8, MSG_WAITALL);
+    errno_assert (rc == (int) size + 8);
+    nn_assert (memcmp (buf, "\0\0\0\0\0\0\0", 7) == 0 && buf [7] == size);
+    nn_assert (memcmp (buf + 8, data, size) == 0);
+}
+
+#endif
+
 int main (int argc, const char *argv[])
 {
     int rc;
@@ -217,6 +298,71 @@ int main (int argc, const char *argv[])
     errno_assert (nn_errno () == EINVAL);
     test_close (sb);
 
+#if !defined NN_HAVE_WINDOWS
+
+    /*  Peers that don't allow non-zero reserved bytes in the protocol header
+        can talk to any socket type, unless NN_EXTENSIONS is set. */
+    sb = test_socket (AF_SP, NN_PUB);
+    test_bind (sb, socket_address);
+    s1 = raw_connect (port, NN_SUB, 0);
+    nn_assert (s1 >= 0);
+    nn_sleep (100);
+    test_send (sb, "ABC");
+    raw_recv (s1, "ABC", 3);
+    close (s1);
+    test_close (sb);
+
+    sb = test_socket (AF_SP, NN_PULL);
+    opt = 10;
+    test_setsockopt (sb, NN_PULL, NN_PULL_CREDITS, &opt, sizeof (opt));
+    test_bind (sb, socket_address);
+    s1 = raw_connect (port, NN_PUSH, 0);
+    nn_assert (s1 >= 0);
+    raw_send (s1, "ABC", 3);
+    test_recv (sb, "ABC");
+    close (s1);
+    test_close (sb);
+
+    /*  The request carries nothing but the request ID in its header. */
+    sb = test_socket (AF_SP, NN_REP);
+    test_bind (sb, socket_address);
+    s1 = raw_connect (port, NN_REQ, 0);
+    nn_assert (s1 >= 0);
+    raw_send (s1, "\x80\0\0\x01" "ABC", 7);
+    test_recv (sb, "ABC");
+    test_send (sb, "DEF");
+    raw_recv (s1, "\x80\0\0\x01" "DEF", 7);
+    close (s1);
+    test_close (sb);
+
+    sb = test_socket (AF_SP, NN_PUB);
+    sz = sizeof (opt);
+    rc = nn_getsockopt (sb, NN_SOL_SOCKET, NN_EXTENSIONS, &opt, &sz);
+    errno_assert (rc == 0);
+    nn_assert (sz == sizeof (opt) && opt == 0);
+    opt = 2;
+    rc = nn_setsockopt (sb, NN_SOL_SOCKET, NN_EXTENSIONS, &opt, sizeof (opt));
+    nn_assert (rc < 0 && nn_errno () == EINVAL);
+    opt = 1;
+    test_setsockopt (sb, NN_SOL_SOCKET, NN_EXTENSIONS, &opt, sizeof (opt));
+    test_bind (sb, socket_address);
+    s1 = raw_connect (port, NN_SUB, 0);
+    nn_assert (s1 < 0);
+
+    /*  Peers that announce subscription forwarding get only the messages
+        matching their subscriptions. */
+    s1 = raw_connect (port, NN_SUB, 1);
+    nn_assert (s1 >= 0);
+    raw_send (s1, "\1A", 2);
+    nn_sleep (100);
+    test_send (sb, "B");
+    test_send (sb, "AB");
+    raw_recv (s1, "AB", 2);
+    close (s1);
+    test_close (sb);
+
+#endif
+
     /*  Test closing a socket that is waiting to connect. */
     sc = test_socket (AF_SP, NN_PAIR);
     test_connect (sc, socket_address);
@@ -0,0 +1,117 @@
+/*
+    Copyright 2026 agent <agent@local>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"),
+    to deal in the Software without restriction, including without limitation
+    the rights to use, copy, modify, merge, publish, distribute, sublicense,
+    and/or sell copies of the Software, and to permit persons to whom
+    the Software is furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included
+    in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+#include "../src/protocols/pubsub/topics.c"
+#include "../src/utils/alloc.c"
+#include "../src/utils/err.c"
+
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_TOPICS 1000
+
+int main ()
+{
+    int rc;
+    int i;
+    int j;
+    char buf [32];
+    int counts [TEST_TOPICS];
+    uint32_t seed;
+    struct nn_topics topics;
+
+    /*  Try matching with an empty set. */
+    nn_topics_init (&topics);
+    rc = nn_topics_match (&topics, (const uint8_t*) "ABC", 3);
+    nn_assert (rc == 0);
+    rc = nn_topics_unsubscribe (&topics, (const uint8_t*) "ABC", 3);
+    nn_assert (rc == -EINVAL);
+    nn_topics_term (&topics);
+
+    /*  Topics are matched exactly, not as prefixes. */
+    nn_topics_init (&topics);
+    rc = nn_topics_subscribe (&topics, (const uint8_t*) "ABC", 3);
+    nn_assert (rc == 1);
+    rc = nn_topics_subscribe (&topics, (const uint8_t*) "", 0);
+    nn_assert (rc == 1);
+    rc = nn_topics_match (&topics, (const uint8_t*) "ABC", 3);
+    nn_assert (rc == 1);
+    rc = nn_topics_match (&topics, (const uint8_t*) "AB", 2);
+    nn_assert (rc == 0);
+    rc = nn_topics_match (&topics, (const uint8_t*) "ABCD", 4);
+    nn_assert (rc == 0);
+    rc = nn_topics_match (&topics, (const uint8_t*) "", 0);
+    nn_assert (rc == 1);
+    nn_topics_term (&topics);
+
+    /*  Check reference counting. */
+    nn_topics_init (&topics);
+    rc = nn_topics_subscribe (&topics, (const uint8_t*) "ABC", 3);
+    nn_assert (rc == 1);
+    rc = nn_topics_subscribe (&topics, (const uint8_t*) "ABC", 3);
+    nn_assert (rc == 0);
+    rc = nn_topics_unsubscribe (&topics, (const uint8_t*) "ABC", 3);
+    nn_assert (rc == 0);
+    rc = nn_topics_match (&topics, (const uint8_t*) "ABC", 3);
+    nn_assert (rc == 1);
+    rc = nn_topics_unsubscribe (&topics, (const uint8_t*) "ABC", 3);
+    nn_assert (rc == 1);
+    rc = nn_topics_match (&topics, (const uint8_t*) "ABC", 3);
+    nn_assert (rc == 0);
+    nn_topics_term (&topics);
+
+    /*  Random subscriptions and unsubscriptions, checked against a plain
+        array of reference counts. This exercises growing the table as
+        well as removing entries from the middle of collision chains. */
+    nn_topics_init (&topics);
+    memset (counts, 0, sizeof (counts));
+    seed = 1;
+    for (i = 0; i != 100000; ++i) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        j = seed % TEST_TOPICS;
+        sprintf (buf, "topic.%d", j);
+        if ((seed >> 16) % 3 == 0 || !counts [j]) {
+            rc = nn_topics_subscribe (&topics, (const uint8_t*) buf,
+                strlen (buf));
+            nn_assert (rc == (counts [j] ? 0 : 1));
+            ++counts [j];
+        }
+        else {
+            rc = nn_topics_unsubscribe (&topics, (const uint8_t*) buf,
+                strlen (buf));
+            nn_assert (rc == (counts [j] == 1 ? 1 : 0));
+            --counts [j];
+        }
+        if (i % 1000 == 0) {
+            for (j = 0; j != TEST_TOPICS; ++j) {
+                sprintf (buf, "topic.%d", j);
+                rc = nn_topics_match (&topics, (const uint8_t*) buf,
+                    strlen (buf));
+                nn_assert (rc == (counts [j] ? 1 : 0));
+            }
+        }
+    }
+    nn_topics_term (&topics);
+
+    return 0;
+}
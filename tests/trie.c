@@ -25,10 +25,18 @@
 #include "../src/utils/err.c"
 
 #include <stdio.h>
+#include <string.h>
 
 int main ()
 {
     int rc;
+    int i;
+    uint8_t c;
+    char buf [32];
+    char batchbuf [100][32];
+    const uint8_t *batch [100];
+    size_t sizes [100];
+    int results [100];
     struct nn_trie trie;
 
     /*  Try matching with an empty trie. */
@@ -205,6 +213,87 @@ int main ()
     nn_assert (rc == 1);
     nn_trie_term (&trie);
 
+    /*  Subscription on a node survives conversion to and from dense mode. */
+    nn_trie_init (&trie);
+    rc = nn_trie_subscribe (&trie, (const uint8_t*) "", 0);
+    nn_assert (rc == 1);
+    for (i = 0; i != 9; ++i) {
+        c = 'a' + i;
+        rc = nn_trie_subscribe (&trie, &c, 1);
+        nn_assert (rc == 1);
+    }
+    c = 'a';
+    rc = nn_trie_unsubscribe (&trie, &c, 1);
+    nn_assert (rc == 1);
+    rc = nn_trie_subscribe (&trie, (const uint8_t*) "", 0);
+    nn_assert (rc == 0);
+    rc = nn_trie_unsubscribe (&trie, (const uint8_t*) "", 0);
+    nn_assert (rc == 0);
+    rc = nn_trie_match (&trie, (const uint8_t*) "xyz", 3);
+    nn_assert (rc == 1);
+    nn_trie_term (&trie);
+
+    /*  Unsubscribing a non-existent string doesn't touch other
+        subscriptions. */
+    nn_trie_init (&trie);
+    rc = nn_trie_subscribe (&trie, (const uint8_t*) "ABC", 3);
+    nn_assert (rc == 1);
+    rc = nn_trie_subscribe (&trie, (const uint8_t*) "AD", 2);
+    nn_assert (rc == 1);
+    rc = nn_trie_unsubscribe (&trie, (const uint8_t*) "", 0);
+    nn_assert (rc <= 0);
+    rc = nn_trie_unsubscribe (&trie, (const uint8_t*) "AB", 2);
+    nn_assert (rc <= 0);
+    rc = nn_trie_unsubscribe (&trie, (const uint8_t*) "ABCD", 4);
+    nn_assert (rc <= 0);
+    rc = nn_trie_match (&trie, (const uint8_t*) "ABC", 3);
+    nn_assert (rc == 1);
+    rc = nn_trie_match (&trie, (const uint8_t*) "AB", 2);
+    nn_assert (rc == 0);
+    rc = nn_trie_match (&trie, (const uint8_t*) "AD", 2);
+    nn_assert (rc == 1);
+    nn_trie_term (&trie);
+
+    /*  Long subscriptions, more than enough to need several blocks. */
+    nn_trie_init (&trie);
+    for (i = 0; i != 10000; ++i) {
+        sprintf (buf, "topic.%d.end", i);
+        rc = nn_trie_subscribe (&trie, (const uint8_t*) buf, strlen (buf));
+        nn_assert (rc == 1);
+    }
+    for (i = 0; i != 10000; i += 2) {
+        sprintf (buf, "topic.%d.end", i);
+        rc = nn_trie_unsubscribe (&trie, (const uint8_t*) buf, strlen (buf));
+        nn_assert (rc == 1);
+    }
+    for (i = 0; i != 10000; ++i) {
+        sprintf (buf, "topic.%d.end!", i);
+        rc = nn_trie_match (&trie, (const uint8_t*) buf, strlen (buf));
+        nn_assert (rc == i % 2);
+    }
+
+    /*  Batch matching must give the same results as matching the strings
+        one by one, including strings that end inside a node's prefix. */
+    for (i = 0; i != 100; ++i) {
+        sprintf (batchbuf [i], i % 3 ? "topic.%d.end!" : "topic.%d",
+            i * 7);
+        batch [i] = (const uint8_t*) batchbuf [i];
+        sizes [i] = strlen (batchbuf [i]);
+    }
+    sizes [99] = 0;
+    nn_trie_match_batch (&trie, 100, batch, sizes, results);
+    for (i = 0; i != 100; ++i) {
+        rc = nn_trie_match (&trie, batch [i], sizes [i]);
+        nn_assert (results [i] == rc);
+    }
+    nn_trie_term (&trie);
+
+    nn_trie_init (&trie);
+    nn_trie_match_batch (&trie, 100, batch, sizes, results);
+    for (i = 0; i != 100; ++i)
+        nn_assert (results [i] == 0);
+    nn_trie_term (&trie);
+
     return 0;
 }
 